@@ -0,0 +1,337 @@
+#include "bench.h"
+
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_app_desc.h"
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "sdkconfig.h"
+
+#include "keymap_config.h"
+
+#if !CONFIG_FREERTOS_UNICORE && CONFIG_ESP_IPC_ISR_ENABLE
+#include "esp_ipc_isr.h"
+#define BENCH_STALL_OTHER_CPU 1
+#else
+#define BENCH_STALL_OTHER_CPU 0
+#endif
+
+#define TAG "BENCH"
+
+#define BENCH_TASK_STACK 4096
+// Above every application task, below esp_timer, Wi-Fi and IPC.
+#define BENCH_TASK_PRIO 20
+#define BENCH_TASK_CORE 1
+#define BENCH_LAYOUT_VERSION 1U
+#define BENCH_OVERHEAD_SAMPLES 64U
+#define BENCH_NVS_NS "bench"
+#define BENCH_NVS_KEY_LAST "last"
+#define BENCH_NVS_KEY_PREVIOUS "prev"
+// Anything earlier means SNTP has not set the clock yet.
+#define BENCH_MIN_VALID_UNIX_TIME 1700000000
+
+typedef struct {
+    bench_report_t *out;
+    bench_report_t *previous;
+} bench_job_t;
+
+typedef struct {
+    const bench_case_t *cases[BENCH_MAX_CASES];
+    uint8_t count;
+    atomic_bool running;
+    bench_job_t job;
+} bench_state_t;
+
+static bench_state_t s_bench;
+static portMUX_TYPE s_bench_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static void bench_noop(void *ctx)
+{
+    (void)ctx;
+}
+
+static const bench_case_t s_overhead_case = {
+    .name = "overhead",
+    .run = bench_noop,
+};
+
+esp_err_t bench_register(const bench_case_t *bench_case)
+{
+    if (bench_case == NULL || bench_case->name == NULL || bench_case->run == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!MACRO_BENCH_ENABLED) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    for (uint8_t i = 0; i < s_bench.count; ++i) {
+        if (s_bench.cases[i] == bench_case) {
+            return ESP_OK;
+        }
+    }
+    if (s_bench.count >= BENCH_MAX_CASES) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_bench.cases[s_bench.count++] = bench_case;
+    return ESP_OK;
+}
+
+// Quiesced samples run with interrupts masked on this core and the other core parked in the IPC ISR,
+// so nothing else touches the caches or the bus while the kernel runs.
+static uint32_t sample_once(const bench_case_t *c, bool quiesce)
+{
+    if (quiesce) {
+        portENTER_CRITICAL(&s_bench_mux);
+#if BENCH_STALL_OTHER_CPU
+        esp_ipc_isr_stall_other_cpu();
+#endif
+    }
+    if (c->before != NULL) {
+        c->before(c->ctx);
+    }
+    const uint32_t start = (uint32_t)esp_cpu_get_cycle_count();
+    c->run(c->ctx);
+    const uint32_t cycles = (uint32_t)esp_cpu_get_cycle_count() - start;
+    if (c->after != NULL) {
+        c->after(c->ctx);
+    }
+    if (quiesce) {
+#if BENCH_STALL_OTHER_CPU
+        esp_ipc_isr_release_other_cpu();
+#endif
+        portEXIT_CRITICAL(&s_bench_mux);
+    }
+    return cycles;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    const uint32_t x = *(const uint32_t *)a;
+    const uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void run_case(const bench_case_t *c, uint32_t overhead, uint32_t *samples, bench_result_t *out)
+{
+    const bool quiesce = (c->flags & BENCH_FLAG_BLOCKING) == 0U;
+    const uint32_t n = quiesce ? MACRO_BENCH_SAMPLES : MACRO_BENCH_BLOCKING_SAMPLES;
+
+    if (c->setup != NULL) {
+        c->setup(c->ctx);
+    }
+    // One untimed pass warms the flash cache and any lazily built tables.
+    (void)sample_once(c, quiesce);
+    for (uint32_t i = 0; i < n; ++i) {
+        const uint32_t cycles = sample_once(c, quiesce);
+        samples[i] = (cycles > overhead) ? (cycles - overhead) : 0U;
+        if ((c->flags & BENCH_FLAG_YIELD) != 0U) {
+            vTaskDelay(1);
+        }
+    }
+    if (c->teardown != NULL) {
+        c->teardown(c->ctx);
+    }
+    qsort(samples, n, sizeof(samples[0]), cmp_u32);
+
+    strlcpy(out->name, c->name, sizeof(out->name));
+    out->quiesced = quiesce;
+    out->samples = (uint16_t)n;
+    out->min_cycles = samples[0];
+    out->median_cycles = samples[n / 2U];
+    out->p99_cycles = samples[((n * 99U) + 99U) / 100U - 1U];
+}
+
+// The report being replaced moves to bench/prev, so last and prev are always two consecutive runs
+// (for example either side of an OTA update).
+static esp_err_t bench_save(const bench_report_t *report, const bench_report_t *previous)
+{
+    nvs_handle_t nvs = 0;
+    esp_err_t err = nvs_open(BENCH_NVS_NS, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (previous->count > 0U) {
+        err = nvs_set_blob(nvs, BENCH_NVS_KEY_PREVIOUS, previous, sizeof(*previous));
+    } else {
+        err = nvs_erase_key(nvs, BENCH_NVS_KEY_PREVIOUS);
+        err = (err == ESP_ERR_NVS_NOT_FOUND) ? ESP_OK : err;
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_blob(nvs, BENCH_NVS_KEY_LAST, report, sizeof(*report));
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    return err;
+}
+
+static esp_err_t bench_load(const char *key, bench_report_t *out)
+{
+    if (out == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(out, 0, sizeof(*out));
+
+    nvs_handle_t nvs = 0;
+    esp_err_t err = nvs_open(BENCH_NVS_NS, NVS_READONLY, &nvs);
+    if (err != ESP_OK) {
+        return (err == ESP_ERR_NVS_NOT_FOUND) ? ESP_ERR_NOT_FOUND : err;
+    }
+    size_t len = sizeof(*out);
+    err = nvs_get_blob(nvs, key, out, &len);
+    nvs_close(nvs);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (err == ESP_ERR_NVS_INVALID_LENGTH || (err == ESP_OK && (len != sizeof(*out) || out->layout != BENCH_LAYOUT_VERSION))) {
+        // Written by a firmware with a different report layout: not comparable.
+        memset(out, 0, sizeof(*out));
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (err != ESP_OK) {
+        memset(out, 0, sizeof(*out));
+        return err;
+    }
+    if (out->count > BENCH_MAX_CASES) {
+        out->count = BENCH_MAX_CASES;
+    }
+    return ESP_OK;
+}
+
+esp_err_t bench_load_last(bench_report_t *out)
+{
+    return bench_load(BENCH_NVS_KEY_LAST, out);
+}
+
+esp_err_t bench_load_previous(bench_report_t *out)
+{
+    return bench_load(BENCH_NVS_KEY_PREVIOUS, out);
+}
+
+static esp_err_t bench_execute(bench_report_t *out, bench_report_t *previous)
+{
+    if (bench_load_last(previous) != ESP_OK) {
+        memset(previous, 0, sizeof(*previous));
+    }
+
+    const uint32_t max_samples = (MACRO_BENCH_SAMPLES > MACRO_BENCH_BLOCKING_SAMPLES)
+                                     ? MACRO_BENCH_SAMPLES
+                                     : MACRO_BENCH_BLOCKING_SAMPLES;
+    uint32_t *samples = calloc(max_samples, sizeof(uint32_t));
+    if (samples == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    memset(out, 0, sizeof(*out));
+    out->layout = BENCH_LAYOUT_VERSION;
+    strlcpy(out->app_version, esp_app_get_description()->version, sizeof(out->app_version));
+    (void)esp_app_get_elf_sha256(out->elf_sha, sizeof(out->elf_sha));
+    out->cpu_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+    const time_t now = time(NULL);
+    out->unix_time = (now >= BENCH_MIN_VALID_UNIX_TIME) ? (uint32_t)now : 0U;
+
+    // Cost of the timing itself (indirect call plus two cycle-count reads), removed from every sample.
+    uint32_t overhead = UINT32_MAX;
+    for (uint32_t i = 0; i < BENCH_OVERHEAD_SAMPLES; ++i) {
+        const uint32_t cycles = sample_once(&s_overhead_case, true);
+        if (cycles < overhead) {
+            overhead = cycles;
+        }
+    }
+    out->overhead_cycles = overhead;
+
+    for (uint8_t i = 0; i < s_bench.count; ++i) {
+        run_case(s_bench.cases[i], overhead, samples, &out->results[out->count++]);
+        // Let the idle task feed the watchdog between cases.
+        vTaskDelay(1);
+    }
+    free(samples);
+
+    const esp_err_t err = bench_save(out, previous);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Saving bench report failed: %s", esp_err_to_name(err));
+    }
+    return ESP_OK;
+}
+
+static const bench_result_t *find_result(const bench_report_t *report, const char *name)
+{
+    for (uint8_t i = 0; report != NULL && i < report->count; ++i) {
+        if (strncmp(report->results[i].name, name, sizeof(report->results[i].name)) == 0) {
+            return &report->results[i];
+        }
+    }
+    return NULL;
+}
+
+static void print_report(const bench_report_t *report, const bench_report_t *previous)
+{
+    ESP_LOGI(TAG, "Bench %s (%s) %" PRIu32 " MHz, overhead %" PRIu32 " cycles",
+             report->app_version, report->elf_sha, report->cpu_mhz, report->overhead_cycles);
+    if (previous != NULL && previous->count > 0U) {
+        ESP_LOGI(TAG, "Compared with %s (%s)", previous->app_version, previous->elf_sha);
+    }
+    for (uint8_t i = 0; i < report->count; ++i) {
+        const bench_result_t *r = &report->results[i];
+        const bench_result_t *p = find_result(previous, r->name);
+        ESP_LOGI(TAG, "%-20s min %7" PRIu32 " med %7" PRIu32 " p99 %7" PRIu32 " cycles%s (prev med %" PRIu32 ")",
+                 r->name, r->min_cycles, r->median_cycles, r->p99_cycles,
+                 r->quiesced ? "" : " [preemptible]",
+                 (p != NULL) ? p->median_cycles : 0U);
+    }
+}
+
+static void bench_task(void *arg)
+{
+    bench_job_t *job = (bench_job_t *)arg;
+    const esp_err_t err = bench_execute(job->out, job->previous);
+    if (err == ESP_OK) {
+        print_report(job->out, job->previous);
+    } else {
+        ESP_LOGW(TAG, "Bench run failed: %s", esp_err_to_name(err));
+    }
+    free(job->out);
+    free(job->previous);
+    atomic_store(&s_bench.running, false);
+    vTaskDelete(NULL);
+}
+
+esp_err_t bench_start_background_run(void)
+{
+    if (!MACRO_BENCH_ENABLED) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (atomic_exchange(&s_bench.running, true)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    bench_report_t *out = calloc(1, sizeof(*out));
+    bench_report_t *previous = calloc(1, sizeof(*previous));
+    esp_err_t err = ESP_ERR_NO_MEM;
+    if (out != NULL && previous != NULL) {
+        s_bench.job = (bench_job_t){.out = out, .previous = previous};
+        if (xTaskCreatePinnedToCore(bench_task, "bench", BENCH_TASK_STACK, &s_bench.job, BENCH_TASK_PRIO, NULL,
+                                    BENCH_TASK_CORE) == pdPASS) {
+            err = ESP_OK;
+        }
+    }
+    if (err != ESP_OK) {
+        free(out);
+        free(previous);
+        atomic_store(&s_bench.running, false);
+    }
+    return err;
+}
+
+bool bench_is_running(void)
+{
+    return atomic_load(&s_bench.running);
+}
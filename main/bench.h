@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#define BENCH_MAX_CASES 12U
+#define BENCH_NAME_MAX 24U
+
+// May block or take locks: sampled preemptibly with the other core running, bench.blocking_samples times.
+#define BENCH_FLAG_BLOCKING (1U << 0)
+// Sleep one tick after each sample so a consumer task (log drain) keeps up.
+#define BENCH_FLAG_YIELD (1U << 1)
+
+typedef void (*bench_fn_t)(void *ctx);
+
+typedef struct {
+    const char *name;
+    bench_fn_t run;          // timed
+    bench_fn_t setup;        // optional, once per run before sampling; may block
+    bench_fn_t before;       // optional, untimed, right before every sample (same quiesced window)
+    bench_fn_t after;        // optional, untimed, right after every sample
+    bench_fn_t teardown;     // optional, once per run after sampling; undoes setup
+    void *ctx;
+    uint32_t flags;
+} bench_case_t;
+
+typedef struct {
+    char name[BENCH_NAME_MAX];
+    bool quiesced;           // interrupts off and the other core stalled while sampling
+    uint16_t samples;
+    uint32_t min_cycles;
+    uint32_t median_cycles;
+    uint32_t p99_cycles;
+} bench_result_t;
+
+typedef struct {
+    uint16_t layout;         // BENCH_LAYOUT_VERSION of the NVS blob
+    char app_version[32];
+    char elf_sha[9];         // first 8 hex digits of the app ELF SHA-256
+    uint32_t cpu_mhz;
+    uint32_t overhead_cycles; // subtracted from every sample (empty-case minimum)
+    uint32_t unix_time;      // 0 when the clock was not synced
+    uint8_t count;
+    bench_result_t results[BENCH_MAX_CASES];
+} bench_report_t;
+
+// Called by each module from its init; the case must stay valid forever.
+esp_err_t bench_register(const bench_case_t *bench_case);
+// Starts a run of every case on a pinned high-priority task and returns right away. The results are
+// logged with the previous medians and saved to NVS, the report they replace kept as the previous one.
+// ESP_ERR_INVALID_STATE while another run is in progress.
+esp_err_t bench_start_background_run(void);
+// True from the start of a run until its report is saved.
+bool bench_is_running(void);
+// Report of the most recent run; ESP_ERR_NOT_FOUND if none.
+esp_err_t bench_load_last(bench_report_t *out);
+// Report of the run before that one; ESP_ERR_NOT_FOUND if none.
+esp_err_t bench_load_previous(bench_report_t *out);
@@ -1,6 +1,7 @@
 #include "buzzer.h"
 
 #include <ctype.h>
+#include <stdatomic.h>
 #include <stddef.h>
 #include <stdbool.h>
 #include <string.h>
@@ -8,8 +9,10 @@
 #include "driver/ledc.h"
 #include "esp_check.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/task.h"
 
+#include "bench.h"
 #include "keymap_config.h"
 
 #define TAG "BUZZER"
@@ -24,12 +27,20 @@
 #if (MACRO_BUZZER_QUEUE_SIZE < 1)
 #error "MACRO_BUZZER_QUEUE_SIZE must be >= 1"
 #endif
+#if (MACRO_BUZZER_QUEUE_SIZE > 128)
+#error "MACRO_BUZZER_QUEUE_SIZE must be <= 128"
+#endif
 
-typedef struct {
-    uint16_t frequency_hz;
-    uint16_t duration_ms;
-    uint16_t silence_ms;
-} buzzer_tone_t;
+// Ring positions are free-running uint32 counters, so the slot count must be a power of two.
+#define BUZZER_RING_SIZE                              \
+    ((MACRO_BUZZER_QUEUE_SIZE <= 8) ? 8U :            \
+     (MACRO_BUZZER_QUEUE_SIZE <= 16) ? 16U :          \
+     (MACRO_BUZZER_QUEUE_SIZE <= 32) ? 32U :          \
+     (MACRO_BUZZER_QUEUE_SIZE <= 64) ? 64U : 128U)
+
+_Static_assert(MACRO_BUZZER_MELODY_COUNT == BUZZER_MELODY_COUNT, "g_buzzer_melodies out of sync with buzzer_melody_id_t");
+
+typedef macro_buzzer_tone_t buzzer_tone_t;
 
 typedef struct {
     uint16_t default_duration;
@@ -38,37 +49,37 @@ typedef struct {
     const char *notes;
 } rtttl_cfg_t;
 
-static buzzer_tone_t s_queue[MACRO_BUZZER_QUEUE_SIZE];
-static uint8_t s_queue_head = 0;
-static uint8_t s_queue_tail = 0;
-static uint8_t s_queue_count = 0;
+// Bounded multi-producer / single-consumer ring. A slot is free for position p when
+// seq == p and holds the tone for p when seq == p + 1. The sequencer callback is the
+// only consumer, so producers can reserve a whole melody in one CAS on s_ring_tail.
+typedef struct {
+    _Atomic uint32_t seq;
+    buzzer_tone_t tone;
+} buzzer_slot_t;
+
+static buzzer_slot_t s_ring[BUZZER_RING_SIZE];
+static _Atomic uint32_t s_ring_tail;
+static _Atomic uint32_t s_ring_head;
+// Queued positions below this mark are dropped; bumping s_flush_gen also cuts the current tone.
+static _Atomic uint32_t s_flush_before;
+static _Atomic uint32_t s_flush_gen;
+
+static esp_timer_handle_t s_seq_timer;
+static atomic_bool s_seq_busy;
+static atomic_bool s_initialized;
+static atomic_bool s_runtime_enabled = true;
+static atomic_bool s_disable_when_idle;
+static atomic_bool s_startup_stream_active;
+
+// Sequencer (esp_timer task) only.
 static buzzer_tone_t s_current_tone = {0};
-static TickType_t s_phase_deadline = 0;
-static bool s_initialized = false;
-static bool s_runtime_enabled = true;
 static bool s_tone_active = false;
 static bool s_silence_active = false;
-static bool s_disable_when_idle = false;
-static TickType_t s_encoder_last_enqueue_tick = 0;
-static bool s_startup_stream_active = false;
-static rtttl_cfg_t s_startup_stream_cfg = {0};
-static const char *s_startup_stream_cursor = NULL;
+static uint32_t s_seen_flush_gen = 0;
+static uint16_t s_startup_stream_index = 0;
 
-static esp_err_t queue_silence(uint16_t duration_ms);
-
-static inline bool tick_reached(TickType_t now, TickType_t deadline)
-{
-    return (int32_t)(now - deadline) >= 0;
-}
-
-static TickType_t ms_to_ticks_nonzero(uint16_t ms)
-{
-    TickType_t ticks = pdMS_TO_TICKS(ms);
-    if (ticks == 0 && ms > 0) {
-        ticks = 1;
-    }
-    return ticks;
-}
+// Encoder throttle state, written from the input path.
+static TickType_t s_encoder_last_enqueue_tick = 0;
 
 static uint32_t duty_from_percent(uint8_t duty_percent)
 {
@@ -78,33 +89,93 @@ static uint32_t duty_from_percent(uint8_t duty_percent)
     return ((uint32_t)duty_percent * BUZZER_DUTY_MAX) / 100U;
 }
 
-static void queue_clear(void)
+static void sequencer_kick(void)
 {
-    s_queue_head = 0;
-    s_queue_tail = 0;
-    s_queue_count = 0;
+    if (!atomic_exchange(&s_seq_busy, true)) {
+        (void)esp_timer_start_once(s_seq_timer, 0);
+    }
 }
 
-static esp_err_t queue_push(const buzzer_tone_t *tone)
+static esp_err_t ring_push(const buzzer_tone_t *tones, uint16_t count)
 {
-    if (s_queue_count >= MACRO_BUZZER_QUEUE_SIZE) {
+    if (count == 0U) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (count > MACRO_BUZZER_QUEUE_SIZE) {
         return ESP_ERR_NO_MEM;
     }
-    s_queue[s_queue_tail] = *tone;
-    s_queue_tail = (uint8_t)((s_queue_tail + 1U) % MACRO_BUZZER_QUEUE_SIZE);
-    s_queue_count++;
+
+    uint32_t pos = atomic_load_explicit(&s_ring_tail, memory_order_relaxed);
+    while (true) {
+        // Slots are released in order, so the batch fits if its last slot is free.
+        const uint32_t last = pos + count - 1U;
+        const uint32_t seq = atomic_load_explicit(&s_ring[last % BUZZER_RING_SIZE].seq, memory_order_acquire);
+        const int32_t diff = (int32_t)(seq - last);
+        if (diff < 0) {
+            return ESP_ERR_NO_MEM;
+        }
+        const uint32_t head = atomic_load_explicit(&s_ring_head, memory_order_acquire);
+        if (diff == 0 && (pos + count - head) > MACRO_BUZZER_QUEUE_SIZE) {
+            return ESP_ERR_NO_MEM;
+        }
+        if (diff == 0 &&
+            atomic_compare_exchange_weak_explicit(&s_ring_tail, &pos, pos + count,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+            break;
+        }
+        if (diff > 0) {
+            pos = atomic_load_explicit(&s_ring_tail, memory_order_relaxed);
+        }
+    }
+
+    for (uint16_t i = 0; i < count; ++i) {
+        buzzer_slot_t *slot = &s_ring[(pos + i) % BUZZER_RING_SIZE];
+        slot->tone = tones[i];
+        atomic_store_explicit(&slot->seq, pos + i + 1U, memory_order_release);
+    }
+    sequencer_kick();
     return ESP_OK;
 }
 
-static bool queue_pop(buzzer_tone_t *tone_out)
+static bool ring_pop(buzzer_tone_t *tone_out)
 {
-    if (s_queue_count == 0) {
-        return false;
+    const uint32_t flush_before = atomic_load_explicit(&s_flush_before, memory_order_acquire);
+    uint32_t head = atomic_load_explicit(&s_ring_head, memory_order_relaxed);
+    while (true) {
+        buzzer_slot_t *slot = &s_ring[head % BUZZER_RING_SIZE];
+        if (atomic_load_explicit(&slot->seq, memory_order_acquire) != head + 1U) {
+            return false;
+        }
+        const buzzer_tone_t tone = slot->tone;
+        const bool flushed = (int32_t)(head - flush_before) < 0;
+        atomic_store_explicit(&slot->seq, head + BUZZER_RING_SIZE, memory_order_release);
+        ++head;
+        atomic_store_explicit(&s_ring_head, head, memory_order_release);
+        if (!flushed) {
+            *tone_out = tone;
+            return true;
+        }
+    }
+}
+
+static uint32_t ring_pending(void)
+{
+    return atomic_load_explicit(&s_ring_tail, memory_order_acquire) -
+           atomic_load_explicit(&s_ring_head, memory_order_acquire);
+}
+
+// Drops everything queued so far and cuts the current tone; later pushes are unaffected.
+static void sequencer_flush(void)
+{
+    atomic_store(&s_startup_stream_active, false);
+    atomic_store_explicit(&s_flush_before, atomic_load(&s_ring_tail), memory_order_release);
+    atomic_fetch_add(&s_flush_gen, 1U);
+    if (esp_timer_stop(s_seq_timer) == ESP_OK) {
+        // Timer was armed for a tone/silence deadline; run the sequencer now instead.
+        (void)esp_timer_start_once(s_seq_timer, 0);
+    } else {
+        sequencer_kick();
     }
-    *tone_out = s_queue[s_queue_head];
-    s_queue_head = (uint8_t)((s_queue_head + 1U) % MACRO_BUZZER_QUEUE_SIZE);
-    s_queue_count--;
-    return true;
 }
 
 static inline const char *skip_spaces(const char *s)
@@ -162,10 +233,11 @@ static esp_err_t rtttl_parse_header(const char *rtttl, rtttl_cfg_t *cfg)
             continue;
         }
 
+        // A setting is exactly one letter, then '='; anything else ("dur=4") is skipped.
         const char key = (char)tolower((unsigned char)*s);
         ++s;
         s = skip_spaces(s);
-        if (*s != '=') {
+        if (!isalpha((unsigned char)key) || *s != '=') {
             while (s < second_colon && *s != ',') {
                 ++s;
             }
@@ -364,74 +436,68 @@ static esp_err_t rtttl_parse_next_tone(const rtttl_cfg_t *cfg,
     }
 }
 
-static esp_err_t queue_rtttl_tone(const buzzer_tone_t *parsed_tone)
+static void rtttl_apply_note_gap(buzzer_tone_t *tone)
 {
-    if (parsed_tone->frequency_hz == 0U) {
-        return queue_silence(parsed_tone->duration_ms);
+    if (tone->frequency_hz == 0U) {
+        return;
     }
-
-    buzzer_tone_t tone = *parsed_tone;
     if (MACRO_BUZZER_RTTTL_NOTE_GAP_MS > 0U &&
-        tone.duration_ms > (MACRO_BUZZER_RTTTL_NOTE_GAP_MS + 1U)) {
-        tone.silence_ms = MACRO_BUZZER_RTTTL_NOTE_GAP_MS;
-        tone.duration_ms = (uint16_t)(tone.duration_ms - tone.silence_ms);
+        tone->duration_ms > (MACRO_BUZZER_RTTTL_NOTE_GAP_MS + 1U)) {
+        tone->silence_ms = MACRO_BUZZER_RTTTL_NOTE_GAP_MS;
+        tone->duration_ms = (uint16_t)(tone->duration_ms - tone->silence_ms);
     }
-    return queue_push(&tone);
 }
 
-static esp_err_t rtttl_enqueue_next(const rtttl_cfg_t *cfg, const char **cursor, bool *done)
+// Does not log, so the bench can run it with interrupts off. ESP_ERR_NO_MEM past `cap` tones.
+static esp_err_t rtttl_parse_tones(const rtttl_cfg_t *cfg, buzzer_tone_t *tones, uint16_t cap, uint16_t *count_out)
 {
-    buzzer_tone_t tone = {0};
-    const char *next = *cursor;
-    bool end = false;
-    ESP_RETURN_ON_ERROR(rtttl_parse_next_tone(cfg, *cursor, &next, &tone, &end), TAG, "invalid RTTTL note");
-    if (end) {
-        *done = true;
-        return ESP_OK;
-    }
-
-    esp_err_t err = queue_rtttl_tone(&tone);
-    if (err != ESP_OK) {
-        return err;
-    }
-    *done = false;
-    *cursor = next;
-    return ESP_OK;
-}
-
-static void buzzer_feed_startup_stream(void)
-{
-    if (!s_startup_stream_active) {
-        return;
-    }
-    while (s_queue_count < MACRO_BUZZER_QUEUE_SIZE) {
+    uint16_t count = 0;
+    const char *cursor = cfg->notes;
+    while (true) {
+        buzzer_tone_t tone = {0};
+        const char *next = cursor;
         bool done = false;
-        esp_err_t err = rtttl_enqueue_next(&s_startup_stream_cfg, &s_startup_stream_cursor, &done);
-        if (err == ESP_ERR_NO_MEM) {
-            break;
-        }
+        const esp_err_t err = rtttl_parse_next_tone(cfg, cursor, &next, &tone, &done);
         if (err != ESP_OK) {
-            s_startup_stream_active = false;
-            ESP_LOGW(TAG, "startup RTTTL stream invalid: %s", esp_err_to_name(err));
-            break;
+            return err;
         }
         if (done) {
-            s_startup_stream_active = false;
             break;
         }
+        if (count >= cap) {
+            return ESP_ERR_NO_MEM;
+        }
+        rtttl_apply_note_gap(&tone);
+        tones[count++] = tone;
+        cursor = next;
     }
+    *count_out = count;
+    return ESP_OK;
 }
 
-static esp_err_t queue_silence(uint16_t duration_ms)
+typedef struct {
+    buzzer_tone_t tones[MACRO_BUZZER_QUEUE_SIZE];
+    uint16_t count;
+} bench_rtttl_ctx_t;
+
+static bench_rtttl_ctx_t s_bench_rtttl;
+
+// Header plus every note of the startup melody, the longest built-in string.
+static void bench_rtttl_run(void *ctx)
 {
-    const buzzer_tone_t tone = {
-        .frequency_hz = 0,
-        .duration_ms = duration_ms,
-        .silence_ms = 0,
-    };
-    return queue_push(&tone);
+    bench_rtttl_ctx_t *b = (bench_rtttl_ctx_t *)ctx;
+    rtttl_cfg_t cfg = {0};
+    if (rtttl_parse_header(MACRO_BUZZER_RTTTL_STARTUP, &cfg) == ESP_OK) {
+        (void)rtttl_parse_tones(&cfg, b->tones, MACRO_BUZZER_QUEUE_SIZE, &b->count);
+    }
 }
 
+static const bench_case_t s_bench_rtttl_parse = {
+    .name = "rtttl_parse",
+    .run = bench_rtttl_run,
+    .ctx = &s_bench_rtttl,
+};
+
 static esp_err_t buzzer_set_frequency(uint16_t frequency_hz)
 {
     const uint32_t actual = ledc_set_freq(BUZZER_SPEED_MODE, BUZZER_TIMER, frequency_hz);
@@ -468,25 +534,89 @@ static void buzzer_output_disable(void)
     ESP_ERROR_CHECK_WITHOUT_ABORT(ledc_update_duty(BUZZER_SPEED_MODE, BUZZER_CHANNEL));
 }
 
-static void buzzer_start_next_tone(TickType_t now)
+static void sequencer_arm(uint16_t ms)
 {
-    if (!queue_pop(&s_current_tone)) {
-        return;
+    (void)esp_timer_start_once(s_seq_timer, (uint64_t)((ms > 0U) ? ms : 1U) * 1000ULL);
+}
+
+static bool sequencer_next_tone(buzzer_tone_t *tone_out)
+{
+    if (ring_pop(tone_out)) {
+        return true;
+    }
+    if (!atomic_load(&s_startup_stream_active)) {
+        return false;
+    }
+    // Startup melody is read straight from its compiled table so its length is not bounded by the ring.
+    const macro_buzzer_melody_t *melody = &g_buzzer_melodies[BUZZER_MELODY_STARTUP];
+    if (s_startup_stream_index >= melody->count) {
+        atomic_store(&s_startup_stream_active, false);
+        return false;
     }
-    if (s_current_tone.frequency_hz == 0U) {
+    *tone_out = melody->tones[s_startup_stream_index++];
+    return true;
+}
+
+static bool sequencer_has_work(void)
+{
+    return ring_pending() > 0U || atomic_load(&s_startup_stream_active);
+}
+
+// One-shot esp_timer callback: each run ends the current phase at its exact deadline and starts the next.
+static void sequencer_timer_cb(void *arg)
+{
+    (void)arg;
+
+    const uint32_t flush_gen = atomic_load(&s_flush_gen);
+    if (flush_gen != s_seen_flush_gen) {
+        s_seen_flush_gen = flush_gen;
+        if (s_tone_active || s_silence_active) {
+            buzzer_output_disable();
+            s_tone_active = false;
+            s_silence_active = false;
+        }
+    } else if (s_tone_active) {
+        buzzer_output_disable();
         s_tone_active = false;
-        s_silence_active = true;
-        s_phase_deadline = now + ms_to_ticks_nonzero(s_current_tone.duration_ms);
-        return;
+        if (s_current_tone.silence_ms > 0U) {
+            s_silence_active = true;
+            sequencer_arm(s_current_tone.silence_ms);
+            return;
+        }
+    } else {
+        s_silence_active = false;
     }
-    if (buzzer_output_enable(s_current_tone.frequency_hz) != ESP_OK) {
+
+    while (sequencer_next_tone(&s_current_tone)) {
+        if (s_current_tone.frequency_hz == 0U) {
+            s_silence_active = true;
+            sequencer_arm(s_current_tone.duration_ms);
+            return;
+        }
+        if (buzzer_output_enable(s_current_tone.frequency_hz) == ESP_OK) {
+            s_tone_active = true;
+            sequencer_arm(s_current_tone.duration_ms);
+            return;
+        }
         ESP_LOGW(TAG, "failed to start tone freq=%u", (unsigned)s_current_tone.frequency_hz);
-        s_current_tone.frequency_hz = 0;
-        return;
     }
-    s_tone_active = true;
-    s_silence_active = false;
-    s_phase_deadline = now + ms_to_ticks_nonzero(s_current_tone.duration_ms);
+
+    if (atomic_exchange(&s_disable_when_idle, false)) {
+        atomic_store(&s_runtime_enabled, false);
+        buzzer_output_disable();
+    }
+
+    atomic_store(&s_seq_busy, false);
+    // A producer may have pushed after the last pop but before busy was cleared.
+    if (sequencer_has_work() && !atomic_exchange(&s_seq_busy, true)) {
+        sequencer_arm(0);
+    }
+}
+
+static inline bool buzzer_accepting(void)
+{
+    return MACRO_BUZZER_ENABLED && atomic_load(&s_initialized) &&
+           atomic_load(&s_runtime_enabled) && !atomic_load(&s_disable_when_idle);
 }
 
 esp_err_t buzzer_init(void)
@@ -494,7 +624,7 @@ esp_err_t buzzer_init(void)
     if (!MACRO_BUZZER_ENABLED) {
         return ESP_OK;
     }
-    if (s_initialized) {
+    if (atomic_load(&s_initialized)) {
         return ESP_OK;
     }
 
@@ -520,92 +650,95 @@ esp_err_t buzzer_init(void)
     ESP_ERROR_CHECK(ledc_channel_config(&channel_cfg));
     buzzer_output_disable();
 
-    queue_clear();
-    s_runtime_enabled = true;
-    s_tone_active = false;
-    s_silence_active = false;
-    s_disable_when_idle = false;
+    for (uint32_t i = 0; i < BUZZER_RING_SIZE; ++i) {
+        atomic_init(&s_ring[i].seq, i);
+    }
+    atomic_store(&s_ring_tail, 0U);
+    atomic_store(&s_ring_head, 0U);
+    atomic_store(&s_flush_before, 0U);
+
+    // Dispatched from the esp_timer task: LEDC reconfiguration is not ISR-safe.
+    const esp_timer_create_args_t seq_timer_args = {
+        .callback = sequencer_timer_cb,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "buzzer_seq",
+        .skip_unhandled_events = false,
+    };
+    ESP_RETURN_ON_ERROR(esp_timer_create(&seq_timer_args, &s_seq_timer), TAG, "sequencer timer create failed");
+
+    atomic_store(&s_runtime_enabled, true);
+    atomic_store(&s_disable_when_idle, false);
+    atomic_store(&s_startup_stream_active, false);
     s_encoder_last_enqueue_tick = 0;
-    s_startup_stream_active = false;
-    s_startup_stream_cursor = NULL;
-    s_initialized = true;
-    ESP_LOGI(TAG, "ready gpio=%d duty=%u%%", (int)MACRO_BUZZER_GPIO, (unsigned)MACRO_BUZZER_DUTY_PERCENT);
+    atomic_store(&s_initialized, true);
+    ESP_LOGI(TAG, "ready gpio=%d duty=%u%% ring=%u", (int)MACRO_BUZZER_GPIO, (unsigned)MACRO_BUZZER_DUTY_PERCENT,
+             (unsigned)BUZZER_RING_SIZE);
+    (void)bench_register(&s_bench_rtttl_parse);
     return ESP_OK;
 }
 
 void buzzer_stop(void)
 {
-    if (!MACRO_BUZZER_ENABLED || !s_initialized) {
+    if (!MACRO_BUZZER_ENABLED || !atomic_load(&s_initialized)) {
         return;
     }
-    queue_clear();
-    s_tone_active = false;
-    s_silence_active = false;
-    s_disable_when_idle = false;
+    atomic_store(&s_disable_when_idle, false);
     s_encoder_last_enqueue_tick = 0;
-    s_startup_stream_active = false;
-    s_startup_stream_cursor = NULL;
-    s_current_tone = (buzzer_tone_t){0};
-    buzzer_output_disable();
+    sequencer_flush();
 }
 
 void buzzer_set_enabled(bool enabled)
 {
-    if (!MACRO_BUZZER_ENABLED || !s_initialized) {
+    if (!MACRO_BUZZER_ENABLED || !atomic_load(&s_initialized)) {
         return;
     }
     if (enabled) {
-        s_disable_when_idle = false;
-        s_runtime_enabled = true;
+        atomic_store(&s_disable_when_idle, false);
+        atomic_store(&s_runtime_enabled, true);
         return;
     }
 
-    s_runtime_enabled = false;
-    s_disable_when_idle = false;
+    atomic_store(&s_runtime_enabled, false);
     buzzer_stop();
 }
 
 bool buzzer_is_enabled(void)
 {
-    return MACRO_BUZZER_ENABLED && s_initialized && s_runtime_enabled;
+    return MACRO_BUZZER_ENABLED && atomic_load(&s_initialized) && atomic_load(&s_runtime_enabled);
 }
 
 bool buzzer_toggle_enabled(void)
 {
-    if (!MACRO_BUZZER_ENABLED || !s_initialized) {
+    if (!MACRO_BUZZER_ENABLED || !atomic_load(&s_initialized)) {
         return false;
     }
 
-    if (s_runtime_enabled && !s_disable_when_idle) {
+    if (atomic_load(&s_runtime_enabled) && !atomic_load(&s_disable_when_idle)) {
         // Keep only toggle-off feedback tone, then disable when it finishes.
-        queue_clear();
-        s_tone_active = false;
-        s_silence_active = false;
-        s_startup_stream_active = false;
-        s_startup_stream_cursor = NULL;
-        buzzer_output_disable();
+        sequencer_flush();
 
-        if (MACRO_BUZZER_RTTTL_TOGGLE_OFF[0] != '\0') {
-            esp_err_t err = buzzer_play_rtttl(MACRO_BUZZER_RTTTL_TOGGLE_OFF);
+        const macro_buzzer_melody_t *off = &g_buzzer_melodies[BUZZER_MELODY_TOGGLE_OFF];
+        if (off->count > 0U) {
+            esp_err_t err = ring_push(off->tones, off->count);
             if (err == ESP_OK) {
-                s_disable_when_idle = true;
+                atomic_store(&s_disable_when_idle, true);
                 return false;
             }
-            ESP_LOGW(TAG, "toggle-off RTTTL invalid: %s", esp_err_to_name(err));
+            ESP_LOGW(TAG, "toggle-off melody failed: %s", esp_err_to_name(err));
         }
 
-        s_runtime_enabled = false;
-        s_disable_when_idle = false;
-        buzzer_output_disable();
+        atomic_store(&s_runtime_enabled, false);
+        atomic_store(&s_disable_when_idle, false);
         return false;
     }
 
-    s_runtime_enabled = true;
-    s_disable_when_idle = false;
-    if (MACRO_BUZZER_RTTTL_TOGGLE_ON[0] != '\0') {
-        esp_err_t err = buzzer_play_rtttl(MACRO_BUZZER_RTTTL_TOGGLE_ON);
+    atomic_store(&s_runtime_enabled, true);
+    atomic_store(&s_disable_when_idle, false);
+    if (g_buzzer_melodies[BUZZER_MELODY_TOGGLE_ON].count > 0U) {
+        esp_err_t err = buzzer_play_melody(BUZZER_MELODY_TOGGLE_ON);
         if (err != ESP_OK) {
-            ESP_LOGW(TAG, "toggle-on RTTTL invalid: %s", esp_err_to_name(err));
+            ESP_LOGW(TAG, "toggle-on melody failed: %s", esp_err_to_name(err));
         }
     }
     return true;
@@ -613,7 +746,7 @@ bool buzzer_toggle_enabled(void)
 
 esp_err_t buzzer_play_tone_ex(uint16_t frequency_hz, uint16_t duration_ms, uint16_t silence_ms)
 {
-    if (!MACRO_BUZZER_ENABLED || !s_initialized || !s_runtime_enabled || s_disable_when_idle) {
+    if (!buzzer_accepting()) {
         return ESP_OK;
     }
     if (frequency_hz == 0 || duration_ms == 0) {
@@ -624,7 +757,7 @@ esp_err_t buzzer_play_tone_ex(uint16_t frequency_hz, uint16_t duration_ms, uint1
         .duration_ms = duration_ms,
         .silence_ms = silence_ms,
     };
-    return queue_push(&tone);
+    return ring_push(&tone, 1U);
 }
 
 esp_err_t buzzer_play_tone(uint16_t frequency_hz, uint16_t duration_ms)
@@ -632,132 +765,93 @@ esp_err_t buzzer_play_tone(uint16_t frequency_hz, uint16_t duration_ms)
     return buzzer_play_tone_ex(frequency_hz, duration_ms, 0);
 }
 
-esp_err_t buzzer_play_rtttl(const char *rtttl)
+esp_err_t buzzer_play_melody(buzzer_melody_id_t melody_id)
 {
-    if (!MACRO_BUZZER_ENABLED || !s_initialized || !s_runtime_enabled || s_disable_when_idle) {
+    if (!buzzer_accepting()) {
         return ESP_OK;
     }
-    if (rtttl == NULL || rtttl[0] == '\0') {
+    if ((unsigned)melody_id >= (unsigned)BUZZER_MELODY_COUNT) {
         return ESP_ERR_INVALID_ARG;
     }
-
-    rtttl_cfg_t cfg = {0};
-    ESP_RETURN_ON_ERROR(rtttl_parse_header(rtttl, &cfg), TAG, "invalid RTTTL header");
-
-    const char *cursor = cfg.notes;
-    while (*cursor != '\0') {
-        bool done = false;
-        esp_err_t err = rtttl_enqueue_next(&cfg, &cursor, &done);
-        if (err != ESP_OK) {
-            return err;
-        }
-        if (done) {
-            break;
-        }
+    const macro_buzzer_melody_t *melody = &g_buzzer_melodies[melody_id];
+    if (melody->count == 0U) {
+        return ESP_ERR_NOT_FOUND;
     }
-    return ESP_OK;
+    return ring_push(melody->tones, melody->count);
 }
 
-void buzzer_update(TickType_t now)
+esp_err_t buzzer_play_rtttl(const char *rtttl)
 {
-    if (!MACRO_BUZZER_ENABLED || !s_initialized) {
-        return;
-    }
-    if (!s_runtime_enabled && !s_disable_when_idle) {
-        return;
+    if (!buzzer_accepting()) {
+        return ESP_OK;
     }
-
-    buzzer_feed_startup_stream();
-
-    if (!s_tone_active && !s_silence_active) {
-        buzzer_start_next_tone(now);
-        if (s_disable_when_idle && !s_tone_active && !s_silence_active && s_queue_count == 0) {
-            s_runtime_enabled = false;
-            s_disable_when_idle = false;
-            buzzer_output_disable();
-        }
-        return;
+    if (rtttl == NULL || rtttl[0] == '\0') {
+        return ESP_ERR_INVALID_ARG;
     }
 
-    if (s_tone_active && tick_reached(now, s_phase_deadline)) {
-        buzzer_output_disable();
-        s_tone_active = false;
-
-        if (s_current_tone.silence_ms > 0) {
-            s_silence_active = true;
-            s_phase_deadline = now + ms_to_ticks_nonzero(s_current_tone.silence_ms);
-            return;
-        }
-
-        buzzer_start_next_tone(now);
-        return;
-    }
+    rtttl_cfg_t cfg = {0};
+    ESP_RETURN_ON_ERROR(rtttl_parse_header(rtttl, &cfg), TAG, "invalid RTTTL header");
 
-    if (s_silence_active && tick_reached(now, s_phase_deadline)) {
-        s_silence_active = false;
-        buzzer_start_next_tone(now);
+    // Parse the whole melody first so it is queued atomically and never interleaves with other sounds.
+    buzzer_tone_t tones[MACRO_BUZZER_QUEUE_SIZE];
+    uint16_t count = 0;
+    const esp_err_t err = rtttl_parse_tones(&cfg, tones, MACRO_BUZZER_QUEUE_SIZE, &count);
+    if (err == ESP_ERR_NO_MEM) {
+        return err;
     }
-
-    if (s_disable_when_idle && !s_tone_active && !s_silence_active && s_queue_count == 0) {
-        s_runtime_enabled = false;
-        s_disable_when_idle = false;
-        buzzer_output_disable();
+    ESP_RETURN_ON_ERROR(err, TAG, "invalid RTTTL note");
+    if (count == 0U) {
+        return ESP_ERR_INVALID_ARG;
     }
+    return ring_push(tones, count);
 }
 
 void buzzer_play_startup(void)
 {
-    if (!MACRO_BUZZER_STARTUP_ENABLED) {
+    if (!MACRO_BUZZER_STARTUP_ENABLED || !buzzer_accepting()) {
         return;
     }
-    if (!s_runtime_enabled || s_disable_when_idle) {
-        return;
-    }
-
-    rtttl_cfg_t cfg = {0};
-    esp_err_t err = rtttl_parse_header(MACRO_BUZZER_RTTTL_STARTUP, &cfg);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "startup RTTTL invalid: %s", esp_err_to_name(err));
+    if (g_buzzer_melodies[BUZZER_MELODY_STARTUP].count == 0U) {
         return;
     }
 
-    s_startup_stream_cfg = cfg;
-    s_startup_stream_cursor = cfg.notes;
-    s_startup_stream_active = true;
-    buzzer_feed_startup_stream();
+    // Sequencer is idle at boot; the index is published before the active flag.
+    s_startup_stream_index = 0;
+    atomic_store(&s_startup_stream_active, true);
+    sequencer_kick();
 }
 
 void buzzer_play_keypress(void)
 {
-    if (!MACRO_BUZZER_KEYPRESS_ENABLED || !s_runtime_enabled || s_disable_when_idle) {
+    if (!MACRO_BUZZER_KEYPRESS_ENABLED || !buzzer_accepting()) {
         return;
     }
-    esp_err_t err = buzzer_play_rtttl(MACRO_BUZZER_RTTTL_KEYPRESS);
+    esp_err_t err = buzzer_play_melody(BUZZER_MELODY_KEYPRESS);
     if (err != ESP_OK) {
-        ESP_LOGW(TAG, "keypress RTTTL invalid: %s", esp_err_to_name(err));
+        ESP_LOGW(TAG, "keypress melody failed: %s", esp_err_to_name(err));
     }
 }
 
 void buzzer_play_layer_switch(uint8_t layer_index)
 {
-    if (!MACRO_BUZZER_LAYER_SWITCH_ENABLED || !s_runtime_enabled || s_disable_when_idle) {
+    if (!MACRO_BUZZER_LAYER_SWITCH_ENABLED || !buzzer_accepting()) {
         return;
     }
-    const char *rtttl = MACRO_BUZZER_RTTTL_LAYER1;
+    buzzer_melody_id_t melody = BUZZER_MELODY_LAYER1;
     if (layer_index == 1U) {
-        rtttl = MACRO_BUZZER_RTTTL_LAYER2;
+        melody = BUZZER_MELODY_LAYER2;
     } else if (layer_index >= 2U) {
-        rtttl = MACRO_BUZZER_RTTTL_LAYER3;
+        melody = BUZZER_MELODY_LAYER3;
     }
-    esp_err_t err = buzzer_play_rtttl(rtttl);
+    esp_err_t err = buzzer_play_melody(melody);
     if (err != ESP_OK) {
-        ESP_LOGW(TAG, "layer RTTTL invalid: layer=%u err=%s", (unsigned)layer_index + 1U, esp_err_to_name(err));
+        ESP_LOGW(TAG, "layer melody failed: layer=%u err=%s", (unsigned)layer_index + 1U, esp_err_to_name(err));
     }
 }
 
 void buzzer_play_encoder_step(int8_t direction)
 {
-    if (!MACRO_BUZZER_ENCODER_STEP_ENABLED || !s_runtime_enabled || s_disable_when_idle) {
+    if (!MACRO_BUZZER_ENCODER_STEP_ENABLED || !buzzer_accepting()) {
         return;
     }
 
@@ -767,14 +861,14 @@ void buzzer_play_encoder_step(int8_t direction)
         return;
     }
     // Coalesce bursty encoder events: keep at most one pending encoder tone.
-    if (s_queue_count > 0) {
+    if (ring_pending() > 0U) {
         return;
     }
 
-    const char *rtttl = (direction >= 0) ? MACRO_BUZZER_RTTTL_ENCODER_CW : MACRO_BUZZER_RTTTL_ENCODER_CCW;
-    esp_err_t err = buzzer_play_rtttl(rtttl);
+    const buzzer_melody_id_t melody = (direction >= 0) ? BUZZER_MELODY_ENCODER_CW : BUZZER_MELODY_ENCODER_CCW;
+    esp_err_t err = buzzer_play_melody(melody);
     if (err != ESP_OK) {
-        ESP_LOGW(TAG, "encoder RTTTL invalid: %s", esp_err_to_name(err));
+        ESP_LOGW(TAG, "encoder melody failed: %s", esp_err_to_name(err));
         return;
     }
     s_encoder_last_enqueue_tick = now;
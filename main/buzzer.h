@@ -6,8 +6,22 @@
 #include "esp_err.h"
 #include "freertos/FreeRTOS.h"
 
+// Configured melodies, compiled from RTTTL by tools/generate_keymap_header.py (g_buzzer_melodies order).
+typedef enum {
+    BUZZER_MELODY_STARTUP = 0,
+    BUZZER_MELODY_KEYPRESS,
+    BUZZER_MELODY_LAYER1,
+    BUZZER_MELODY_LAYER2,
+    BUZZER_MELODY_LAYER3,
+    BUZZER_MELODY_ENCODER_CW,
+    BUZZER_MELODY_ENCODER_CCW,
+    BUZZER_MELODY_TOGGLE_ON,
+    BUZZER_MELODY_TOGGLE_OFF,
+    BUZZER_MELODY_COUNT,
+} buzzer_melody_id_t;
+
+// Playback is sequenced by an esp_timer one-shot; all play/stop calls are safe from any task.
 esp_err_t buzzer_init(void);
-void buzzer_update(TickType_t now);
 void buzzer_stop(void);
 void buzzer_set_enabled(bool enabled);
 bool buzzer_is_enabled(void);
@@ -15,6 +29,8 @@ bool buzzer_toggle_enabled(void);
 
 esp_err_t buzzer_play_tone(uint16_t frequency_hz, uint16_t duration_ms);
 esp_err_t buzzer_play_tone_ex(uint16_t frequency_hz, uint16_t duration_ms, uint16_t silence_ms);
+esp_err_t buzzer_play_melody(buzzer_melody_id_t melody_id);
+// Parses at runtime; intended for ad-hoc melodies, configured ones use buzzer_play_melody().
 esp_err_t buzzer_play_rtttl(const char *rtttl);
 
 void buzzer_play_startup(void);
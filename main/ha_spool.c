@@ -0,0 +1,500 @@
+#include "ha_spool.h"
+
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "nvs.h"
+
+#include "keymap_config.h"
+#include "log_store.h"
+
+#define TAG "HA_SPOOL"
+
+#define HA_SPOOL_SECTOR_SIZE 4096U
+#define HA_SPOOL_MAX_SECTORS 256U
+#define HA_SPOOL_SECTOR_MAGIC 0x4C505348U
+#define HA_SPOOL_RECORDS_PER_SECTOR \
+    ((HA_SPOOL_SECTOR_SIZE - sizeof(ha_spool_sector_hdr_t)) / sizeof(ha_spool_record_t))
+#define HA_SPOOL_STAGE_RECORDS 16U
+#define HA_SPOOL_READ_CHUNK 16U
+#define HA_SPOOL_CURSOR_SAVE_EVERY 32U
+
+#define NVS_NS "ha_spool"
+#define NVS_KEY_DRAINED "drained"
+
+#if (MACRO_HA_SPOOL_SIZE / 4096) > 256
+#error "home_assistant.spool.size must not exceed 256 sectors"
+#endif
+
+typedef struct {
+    uint32_t magic;
+    uint32_t sector_seq;
+    uint32_t erase_count;
+    uint32_t crc;
+} ha_spool_sector_hdr_t;
+
+_Static_assert(sizeof(ha_spool_record_t) == 48U, "spool record layout is stored in flash");
+
+// RAM index per flash sector. Records inside a sector carry consecutive seqs from first_seq.
+typedef struct {
+    uint32_t sector_seq;     // 0 = erased or invalid
+    uint32_t erase_count;
+    uint32_t first_seq;
+    uint16_t count;
+} ha_spool_sector_t;
+
+typedef struct {
+    bool mounted;
+    const esp_partition_t *part;
+    uint32_t sector_count;
+    uint32_t head_sector;
+    uint32_t head_slot;          // next free slot in head_sector
+    uint32_t next_sector_seq;
+    uint32_t next_seq;           // seq of the next staged record
+    uint32_t flash_end_seq;      // one past the newest record in flash
+    uint32_t drain_seq;          // oldest undrained record
+    uint32_t saved_drain_seq;    // last value committed to NVS
+    uint32_t boot_first_seq;
+    portMUX_TYPE lock;           // staging, next_seq and stats
+    uint16_t staged;
+    ha_spool_record_t stage[HA_SPOOL_STAGE_RECORDS];
+    ha_spool_record_t io[HA_SPOOL_STAGE_RECORDS];
+    ha_spool_sector_t sectors[HA_SPOOL_MAX_SECTORS];
+    ha_spool_stats_t stats;
+} ha_spool_state_t;
+
+static ha_spool_state_t s_spool = {.lock = portMUX_INITIALIZER_UNLOCKED};
+
+static inline uint32_t sector_addr(uint32_t index)
+{
+    return (uint32_t)MACRO_HA_SPOOL_OFFSET + (index * HA_SPOOL_SECTOR_SIZE);
+}
+
+static inline uint32_t slot_addr(uint32_t index, uint32_t slot)
+{
+    return sector_addr(index) + (uint32_t)sizeof(ha_spool_sector_hdr_t) + (slot * (uint32_t)sizeof(ha_spool_record_t));
+}
+
+static inline uint32_t uptime_s(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000000LL);
+}
+
+static uint32_t sector_hdr_crc(const ha_spool_sector_hdr_t *hdr)
+{
+    return esp_rom_crc32_le(0U, (const uint8_t *)hdr, (uint32_t)offsetof(ha_spool_sector_hdr_t, crc));
+}
+
+static uint32_t record_crc(const ha_spool_record_t *rec)
+{
+    return esp_rom_crc32_le(0U, (const uint8_t *)rec, (uint32_t)offsetof(ha_spool_record_t, crc));
+}
+
+static bool record_erased(const ha_spool_record_t *rec)
+{
+    return rec->seq == UINT32_MAX && rec->crc == UINT32_MAX;
+}
+
+static void save_cursor(void)
+{
+    nvs_handle_t nvs = 0;
+    if (nvs_open(NVS_NS, NVS_READWRITE, &nvs) != ESP_OK) {
+        return;
+    }
+    if (nvs_set_u32(nvs, NVS_KEY_DRAINED, s_spool.drain_seq) == ESP_OK && nvs_commit(nvs) == ESP_OK) {
+        s_spool.saved_drain_seq = s_spool.drain_seq;
+    }
+    nvs_close(nvs);
+}
+
+static void save_cursor_if_due(void)
+{
+    if (s_spool.drain_seq == s_spool.saved_drain_seq) {
+        return;
+    }
+    // Committed every few dozen records and when the spool runs empty; a reset in between
+    // re-sends at most that many.
+    if ((s_spool.drain_seq - s_spool.saved_drain_seq) >= HA_SPOOL_CURSOR_SAVE_EVERY ||
+        s_spool.drain_seq == s_spool.flash_end_seq) {
+        save_cursor();
+    }
+}
+
+// Same rotation-only erase as log_archive: the next sector in ring order is the oldest.
+static esp_err_t sector_open(uint32_t index)
+{
+    ha_spool_sector_t *sec = &s_spool.sectors[index];
+    if (sec->count > 0U && (int32_t)(sec->first_seq + sec->count - s_spool.drain_seq) > 0) {
+        const uint32_t from = ((int32_t)(s_spool.drain_seq - sec->first_seq) > 0) ? s_spool.drain_seq : sec->first_seq;
+        const uint32_t lost = sec->first_seq + sec->count - from;
+        s_spool.drain_seq = sec->first_seq + sec->count;
+        portENTER_CRITICAL(&s_spool.lock);
+        s_spool.stats.overwritten += lost;
+        portEXIT_CRITICAL(&s_spool.lock);
+        ESP_LOGW(TAG, "Spool full; %lu undrained events overwritten", (unsigned long)lost);
+    }
+
+    sec->sector_seq = 0U;
+    sec->count = 0U;
+    ESP_RETURN_ON_ERROR(esp_partition_erase_range(s_spool.part, sector_addr(index), HA_SPOOL_SECTOR_SIZE),
+                        TAG, "erase sector %lu failed", (unsigned long)index);
+
+    ha_spool_sector_hdr_t hdr = {
+        .magic = HA_SPOOL_SECTOR_MAGIC,
+        .sector_seq = s_spool.next_sector_seq++,
+        .erase_count = sec->erase_count + 1U,
+    };
+    hdr.crc = sector_hdr_crc(&hdr);
+    ESP_RETURN_ON_ERROR(esp_partition_write(s_spool.part, sector_addr(index), &hdr, sizeof(hdr)),
+                        TAG, "sector header write failed");
+
+    sec->sector_seq = hdr.sector_seq;
+    sec->erase_count = hdr.erase_count;
+    s_spool.head_sector = index;
+    s_spool.head_slot = 0U;
+    return ESP_OK;
+}
+
+// Counts the valid records of a sector; sets *torn when a damaged slot ends it early.
+static uint32_t sector_walk(uint32_t index, bool *torn)
+{
+    ha_spool_sector_t *sec = &s_spool.sectors[index];
+    *torn = false;
+    uint32_t slot = 0;
+    while (slot < HA_SPOOL_RECORDS_PER_SECTOR) {
+        uint32_t n = HA_SPOOL_RECORDS_PER_SECTOR - slot;
+        if (n > HA_SPOOL_READ_CHUNK) {
+            n = HA_SPOOL_READ_CHUNK;
+        }
+        if (esp_partition_read(s_spool.part, slot_addr(index, slot), s_spool.io, n * sizeof(ha_spool_record_t)) != ESP_OK) {
+            *torn = true;
+            return slot;
+        }
+        for (uint32_t i = 0; i < n; ++i, ++slot) {
+            const ha_spool_record_t *rec = &s_spool.io[i];
+            if (record_erased(rec)) {
+                return slot;
+            }
+            if (rec->crc != record_crc(rec) || (slot > 0U && rec->seq != sec->first_seq + slot)) {
+                *torn = true;
+                return slot;
+            }
+            if (slot == 0U) {
+                sec->first_seq = rec->seq;
+            }
+        }
+    }
+    return slot;
+}
+
+static esp_err_t mount(void)
+{
+    uint32_t newest = HA_SPOOL_MAX_SECTORS;
+    bool newest_torn = false;
+    s_spool.flash_end_seq = 1U;
+    uint32_t oldest_seq = 0U;
+    bool have_records = false;
+
+    for (uint32_t i = 0; i < s_spool.sector_count; ++i) {
+        ha_spool_sector_t *sec = &s_spool.sectors[i];
+        *sec = (ha_spool_sector_t){0};
+        ha_spool_sector_hdr_t hdr;
+        ESP_RETURN_ON_ERROR(esp_partition_read(s_spool.part, sector_addr(i), &hdr, sizeof(hdr)),
+                            TAG, "sector header read failed");
+        if (hdr.magic != HA_SPOOL_SECTOR_MAGIC || hdr.crc != sector_hdr_crc(&hdr) || hdr.sector_seq == 0U) {
+            continue;
+        }
+        sec->sector_seq = hdr.sector_seq;
+        sec->erase_count = hdr.erase_count;
+
+        bool torn = false;
+        sec->count = (uint16_t)sector_walk(i, &torn);
+        if (sec->count > 0U) {
+            if ((int32_t)(sec->first_seq + sec->count - s_spool.flash_end_seq) > 0) {
+                s_spool.flash_end_seq = sec->first_seq + sec->count;
+            }
+            if (!have_records || (int32_t)(sec->first_seq - oldest_seq) < 0) {
+                oldest_seq = sec->first_seq;
+            }
+            have_records = true;
+        }
+        if (newest == HA_SPOOL_MAX_SECTORS || (int32_t)(sec->sector_seq - s_spool.sectors[newest].sector_seq) > 0) {
+            newest = i;
+            newest_torn = torn;
+        }
+    }
+
+    uint32_t cursor = 0;
+    nvs_handle_t nvs = 0;
+    if (nvs_open(NVS_NS, NVS_READONLY, &nvs) == ESP_OK) {
+        (void)nvs_get_u32(nvs, NVS_KEY_DRAINED, &cursor);
+        nvs_close(nvs);
+    }
+    if (!have_records) {
+        oldest_seq = s_spool.flash_end_seq;
+    }
+    if ((int32_t)(cursor - s_spool.flash_end_seq) > 0) {
+        // Region erased behind NVS' back: continue numbering after the cursor.
+        s_spool.flash_end_seq = cursor;
+    }
+    s_spool.drain_seq = ((int32_t)(cursor - oldest_seq) > 0) ? cursor : oldest_seq;
+    s_spool.saved_drain_seq = cursor;
+    s_spool.next_seq = s_spool.flash_end_seq;
+    s_spool.boot_first_seq = s_spool.next_seq;
+
+    if (newest == HA_SPOOL_MAX_SECTORS) {
+        s_spool.next_sector_seq = 1U;
+        return sector_open(0U);
+    }
+    s_spool.next_sector_seq = s_spool.sectors[newest].sector_seq + 1U;
+    s_spool.head_sector = newest;
+    // Never program over a torn slot; the next flush opens a fresh sector.
+    s_spool.head_slot = newest_torn ? HA_SPOOL_RECORDS_PER_SECTOR : s_spool.sectors[newest].count;
+    return ESP_OK;
+}
+
+// Sector and slot of the first record with seq >= *io_seq; *io_seq moves forward over gaps left
+// by torn or failed writes.
+static bool locate(uint32_t *io_seq, uint32_t *out_sector, uint32_t *out_slot)
+{
+    uint32_t best = HA_SPOOL_MAX_SECTORS;
+    for (uint32_t i = 0; i < s_spool.sector_count; ++i) {
+        const ha_spool_sector_t *sec = &s_spool.sectors[i];
+        if (sec->sector_seq == 0U || sec->count == 0U) {
+            continue;
+        }
+        const int32_t delta = (int32_t)(*io_seq - sec->first_seq);
+        if (delta >= 0 && (uint32_t)delta < sec->count) {
+            *out_sector = i;
+            *out_slot = (uint32_t)delta;
+            return true;
+        }
+        if (delta < 0 && (best == HA_SPOOL_MAX_SECTORS ||
+                          (int32_t)(sec->first_seq - s_spool.sectors[best].first_seq) < 0)) {
+            best = i;
+        }
+    }
+    if (best == HA_SPOOL_MAX_SECTORS) {
+        return false;
+    }
+    *io_seq = s_spool.sectors[best].first_seq;
+    *out_sector = best;
+    *out_slot = 0U;
+    return true;
+}
+
+static bool record_expired(const ha_spool_record_t *rec)
+{
+    if (MACRO_HA_SPOOL_MAX_AGE_SEC <= 0) {
+        return false;
+    }
+    if (rec->epoch != 0U && log_store_is_time_synced()) {
+        return ((uint32_t)time(NULL) - rec->epoch) > (uint32_t)MACRO_HA_SPOOL_MAX_AGE_SEC;
+    }
+    if ((int32_t)(rec->seq - s_spool.boot_first_seq) >= 0) {
+        return (uptime_s() - rec->uptime_s) > (uint32_t)MACRO_HA_SPOOL_MAX_AGE_SEC;
+    }
+    // Spooled before this boot without wall time: its age is unknown, so it is kept.
+    return false;
+}
+
+esp_err_t ha_spool_init(void)
+{
+    if (!MACRO_HA_SPOOL_ENABLED || s_spool.mounted) {
+        return ESP_OK;
+    }
+
+    s_spool.part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                            ESP_PARTITION_SUBTYPE_ANY,
+                                            MACRO_HA_SPOOL_PARTITION_LABEL);
+    ESP_RETURN_ON_FALSE(s_spool.part != NULL, ESP_ERR_NOT_FOUND, TAG, "partition '%s' not found",
+                        MACRO_HA_SPOOL_PARTITION_LABEL);
+    ESP_RETURN_ON_FALSE(((uint32_t)MACRO_HA_SPOOL_OFFSET + (uint32_t)MACRO_HA_SPOOL_SIZE) <= s_spool.part->size,
+                        ESP_ERR_INVALID_SIZE, TAG, "spool region exceeds partition");
+    s_spool.sector_count = (uint32_t)MACRO_HA_SPOOL_SIZE / HA_SPOOL_SECTOR_SIZE;
+    ESP_RETURN_ON_ERROR(mount(), TAG, "mount failed");
+
+    s_spool.mounted = true;
+    s_spool.stats.mounted = true;
+    ESP_LOGI(TAG, "Mounted %lu sectors at '%s'+0x%lx, %lu events pending",
+             (unsigned long)s_spool.sector_count,
+             MACRO_HA_SPOOL_PARTITION_LABEL,
+             (unsigned long)MACRO_HA_SPOOL_OFFSET,
+             (unsigned long)(s_spool.flash_end_seq - s_spool.drain_seq));
+    return ESP_OK;
+}
+
+bool ha_spool_is_mounted(void)
+{
+    return s_spool.mounted;
+}
+
+uint32_t ha_spool_pending(void)
+{
+    if (!s_spool.mounted) {
+        return 0U;
+    }
+    portENTER_CRITICAL(&s_spool.lock);
+    const uint32_t staged = s_spool.staged;
+    portEXIT_CRITICAL(&s_spool.lock);
+    return (s_spool.flash_end_seq - s_spool.drain_seq) + staged;
+}
+
+bool ha_spool_stage(const ha_spool_record_t *rec)
+{
+    if (!s_spool.mounted || rec == NULL) {
+        return false;
+    }
+    const uint32_t epoch = log_store_is_time_synced() ? (uint32_t)time(NULL) : 0U;
+    const uint32_t up = uptime_s();
+
+    bool ok = false;
+    portENTER_CRITICAL(&s_spool.lock);
+    if (s_spool.staged < HA_SPOOL_STAGE_RECORDS) {
+        ha_spool_record_t *dst = &s_spool.stage[s_spool.staged++];
+        *dst = *rec;
+        dst->seq = s_spool.next_seq++;
+        dst->epoch = epoch;
+        dst->uptime_s = up;
+        s_spool.stats.spooled++;
+        ok = true;
+    } else {
+        s_spool.stats.staging_full++;
+    }
+    portEXIT_CRITICAL(&s_spool.lock);
+    return ok;
+}
+
+esp_err_t ha_spool_flush(void)
+{
+    if (!s_spool.mounted) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    portENTER_CRITICAL(&s_spool.lock);
+    const uint32_t n = s_spool.staged;
+    memcpy(s_spool.io, s_spool.stage, n * sizeof(ha_spool_record_t));
+    s_spool.staged = 0U;
+    portEXIT_CRITICAL(&s_spool.lock);
+    if (n == 0U) {
+        return ESP_OK;
+    }
+
+    esp_err_t err = ESP_OK;
+    uint32_t i = 0;
+    while (i < n) {
+        if (s_spool.head_slot >= HA_SPOOL_RECORDS_PER_SECTOR) {
+            err = sector_open((s_spool.head_sector + 1U) % s_spool.sector_count);
+            if (err != ESP_OK) {
+                break;
+            }
+        }
+        uint32_t k = n - i;
+        if (k > (HA_SPOOL_RECORDS_PER_SECTOR - s_spool.head_slot)) {
+            k = HA_SPOOL_RECORDS_PER_SECTOR - s_spool.head_slot;
+        }
+        for (uint32_t j = 0; j < k; ++j) {
+            s_spool.io[i + j].crc = record_crc(&s_spool.io[i + j]);
+        }
+
+        ha_spool_sector_t *sec = &s_spool.sectors[s_spool.head_sector];
+        err = esp_partition_write(s_spool.part, slot_addr(s_spool.head_sector, s_spool.head_slot),
+                                  &s_spool.io[i], k * sizeof(ha_spool_record_t));
+        if (err != ESP_OK) {
+            s_spool.head_slot = HA_SPOOL_RECORDS_PER_SECTOR;
+            break;
+        }
+        if (sec->count == 0U) {
+            sec->first_seq = s_spool.io[i].seq;
+        }
+        sec->count = (uint16_t)(sec->count + k);
+        s_spool.head_slot += k;
+        i += k;
+    }
+
+    // Seqs of records that did not make it become a gap that ha_spool_peek() steps over.
+    s_spool.flash_end_seq = s_spool.io[n - 1U].seq + 1U;
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Flash write failed, %lu events lost: %s", (unsigned long)(n - i), esp_err_to_name(err));
+    }
+    return err;
+}
+
+size_t ha_spool_peek(ha_spool_record_t *out, size_t max)
+{
+    if (!s_spool.mounted || out == NULL) {
+        return 0U;
+    }
+
+    size_t n = 0;
+    while (n < max && (int32_t)(s_spool.flash_end_seq - (s_spool.drain_seq + (uint32_t)n)) > 0) {
+        uint32_t seq = s_spool.drain_seq + (uint32_t)n;
+        uint32_t sector = 0;
+        uint32_t slot = 0;
+        if (!locate(&seq, &sector, &slot) || (int32_t)(seq - s_spool.flash_end_seq) >= 0) {
+            if (n == 0U) {
+                s_spool.drain_seq = s_spool.flash_end_seq;
+            }
+            break;
+        }
+        if (seq != s_spool.drain_seq + (uint32_t)n) {
+            if (n > 0U) {
+                break;
+            }
+            s_spool.drain_seq = seq;
+        }
+
+        ha_spool_record_t *rec = &out[n];
+        const bool valid = esp_partition_read(s_spool.part, slot_addr(sector, slot), rec, sizeof(*rec)) == ESP_OK &&
+                           rec->crc == record_crc(rec) && rec->seq == seq;
+        const bool expired = valid && record_expired(rec);
+        if (valid && !expired) {
+            n++;
+            continue;
+        }
+        if (n > 0U) {
+            break;
+        }
+        // Only the front of the spool is skipped; anything behind it waits for the next peek.
+        s_spool.drain_seq++;
+        if (expired) {
+            portENTER_CRITICAL(&s_spool.lock);
+            s_spool.stats.expired++;
+            portEXIT_CRITICAL(&s_spool.lock);
+        }
+    }
+    save_cursor_if_due();
+    return n;
+}
+
+void ha_spool_consume(size_t count)
+{
+    if (!s_spool.mounted || count == 0U) {
+        return;
+    }
+    s_spool.drain_seq += (uint32_t)count;
+    portENTER_CRITICAL(&s_spool.lock);
+    s_spool.stats.drained += (uint32_t)count;
+    portEXIT_CRITICAL(&s_spool.lock);
+    save_cursor_if_due();
+}
+
+void ha_spool_get_stats(ha_spool_stats_t *out)
+{
+    if (out == NULL) {
+        return;
+    }
+    portENTER_CRITICAL(&s_spool.lock);
+    *out = s_spool.stats;
+    out->staged = s_spool.staged;
+    portEXIT_CRITICAL(&s_spool.lock);
+    out->pending = s_spool.mounted ? (s_spool.flash_end_seq - s_spool.drain_seq) + out->staged : 0U;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#define HA_SPOOL_NAME_MAX 22U
+
+// One spooled Home Assistant event. seq and crc are filled in by the spool.
+typedef struct {
+    uint32_t seq;
+    uint32_t epoch;          // wall time when spooled; 0 before SNTP sync
+    uint32_t uptime_s;       // ages records from this boot when epoch is 0
+    int32_t steps;
+    uint16_t usage;
+    uint8_t kind;
+    uint8_t layer_index;
+    uint8_t arg;
+    uint8_t pressed;
+    char key_name[HA_SPOOL_NAME_MAX];
+    uint32_t crc;
+} ha_spool_record_t;
+
+typedef struct {
+    bool mounted;
+    uint32_t pending;        // spooled and not yet drained, staged records included
+    uint32_t staged;         // waiting in RAM for the next flash write
+    uint32_t spooled;        // since boot
+    uint32_t drained;        // since boot
+    uint32_t expired;        // older than home_assistant.spool.max_age_sec when their turn came
+    uint32_t overwritten;    // lost when the ring wrapped onto undrained records
+    uint32_t staging_full;   // not spooled because the RAM staging buffer was full
+} ha_spool_stats_t;
+
+// Mounts the region and restores the drain cursor from NVS. Not thread-safe; called once.
+esp_err_t ha_spool_init(void);
+bool ha_spool_is_mounted(void);
+uint32_t ha_spool_pending(void);
+// Copies rec into RAM staging; any task, never blocks or touches flash. False when staging is full.
+bool ha_spool_stage(const ha_spool_record_t *rec);
+// Writes staged records to flash. Only the Home Assistant worker calls this and the functions below.
+esp_err_t ha_spool_flush(void);
+// Oldest undrained records in order, skipping (and counting) expired ones. Returns the count copied.
+size_t ha_spool_peek(ha_spool_record_t *out, size_t max);
+// Marks the first count records returned by ha_spool_peek() as delivered.
+void ha_spool_consume(size_t count);
+void ha_spool_get_stats(ha_spool_stats_t *out);
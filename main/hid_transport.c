@@ -11,10 +11,14 @@
 #include "hid_usb_backend.h"
 #include "keyboard_mode_store.h"
 #include "keymap_config.h"
+#include "metrics.h"
 #include "sdkconfig.h"
+#include "trace_buffer.h"
 
 #define TAG "HID_TRANSPORT"
 
+#define HID_TRANSPORT_STATUS_CHECK_MS 100U
+
 typedef struct {
     bool initialized;
     hid_mode_t mode;
@@ -23,6 +27,11 @@ typedef struct {
     TickType_t mode_switch_reboot_tick;
     bool ble_init_failed;
     esp_err_t ble_init_error;
+    // Link-state fingerprint sampled by hid_transport_poll(); status_version is read without locks.
+    uint32_t status_flags;
+    char status_peer_addr[18];
+    TickType_t next_status_check_tick;
+    volatile uint32_t status_version;
 } hid_transport_ctx_t;
 
 static hid_transport_ctx_t s_ctx = {0};
@@ -113,6 +122,29 @@ esp_err_t hid_transport_init(void)
     return ESP_OK;
 }
 
+static void hid_transport_check_status(TickType_t now)
+{
+    if ((int32_t)(now - s_ctx.next_status_check_tick) < 0) {
+        return;
+    }
+    s_ctx.next_status_check_tick = now + pdMS_TO_TICKS(HID_TRANSPORT_STATUS_CHECK_MS);
+
+    hid_transport_status_t st = {0};
+    if (!hid_transport_get_status(&st)) {
+        return;
+    }
+    const uint32_t flags = ((uint32_t)st.mode << 0) | ((uint32_t)st.mode_switch_pending << 1) |
+                           ((uint32_t)st.mode_switch_target << 2) | ((uint32_t)st.usb_mounted << 3) |
+                           ((uint32_t)st.usb_hid_ready << 4) | ((uint32_t)st.ble_connected << 5) |
+                           ((uint32_t)st.ble_bonded << 6) | ((uint32_t)st.ble_pairing_window_active << 7) |
+                           ((uint32_t)st.ble_advertising << 8);
+    if (flags != s_ctx.status_flags || strcmp(st.ble_peer_addr, s_ctx.status_peer_addr) != 0) {
+        s_ctx.status_flags = flags;
+        strlcpy(s_ctx.status_peer_addr, st.ble_peer_addr, sizeof(s_ctx.status_peer_addr));
+        s_ctx.status_version++;
+    }
+}
+
 void hid_transport_poll(TickType_t now)
 {
     if (!s_ctx.initialized) {
@@ -122,6 +154,7 @@ void hid_transport_poll(TickType_t now)
     if (s_ctx.mode == HID_MODE_BLE && ble_feature_enabled()) {
         hid_ble_backend_poll(now);
     }
+    hid_transport_check_status(now);
 
     if (s_ctx.mode_switch_pending && now >= s_ctx.mode_switch_reboot_tick) {
         ESP_LOGI(TAG,
@@ -156,34 +189,51 @@ bool hid_transport_cdc_connected(void)
     return hid_usb_backend_cdc_connected();
 }
 
+void hid_transport_set_cdc_line_handler(hid_transport_cdc_line_cb_t cb)
+{
+    hid_usb_backend_set_cdc_line_handler(cb);
+}
+
+static void count_report(hid_mode_t mode, esp_err_t err)
+{
+    if (mode == HID_MODE_USB) {
+        metrics_inc((err == ESP_OK) ? METRIC_HID_REPORTS_USB_SENT : METRIC_HID_REPORTS_USB_FAILED);
+    } else {
+        metrics_inc((err == ESP_OK) ? METRIC_HID_REPORTS_BLE_SENT : METRIC_HID_REPORTS_BLE_FAILED);
+    }
+}
+
 void hid_transport_send_keyboard_report(const bool *key_pressed, uint8_t active_layer)
 {
     if (!s_ctx.initialized) {
         return;
     }
 
+    TRACE_SPAN(TRACE_SPAN_HID_SEND);
     if (s_ctx.mode == HID_MODE_USB) {
-        hid_usb_backend_send_keyboard_report(key_pressed, active_layer);
+        count_report(HID_MODE_USB, hid_usb_backend_send_keyboard_report(key_pressed, active_layer));
         return;
     }
     if (ble_feature_enabled()) {
-        (void)hid_ble_backend_send_keyboard_report(key_pressed, active_layer);
+        count_report(HID_MODE_BLE, hid_ble_backend_send_keyboard_report(key_pressed, active_layer));
     }
 }
 
 void hid_transport_send_consumer_report(uint16_t usage)
 {
-    if (!s_ctx.initialized) {
+    if (!s_ctx.initialized || usage == 0) {
         return;
     }
 
+    TRACE_SPAN(TRACE_SPAN_HID_SEND);
+    // Press, hold and release block the caller, so this is how many sends are queued up behind it.
+    metrics_inc(METRIC_HID_CONSUMER_INFLIGHT);
     if (s_ctx.mode == HID_MODE_USB) {
-        hid_usb_backend_send_consumer_report(usage);
-        return;
-    }
-    if (ble_feature_enabled()) {
-        (void)hid_ble_backend_send_consumer_report(usage);
+        count_report(HID_MODE_USB, hid_usb_backend_send_consumer_report(usage));
+    } else if (ble_feature_enabled()) {
+        count_report(HID_MODE_BLE, hid_ble_backend_send_consumer_report(usage));
     }
+    metrics_dec(METRIC_HID_CONSUMER_INFLIGHT);
 }
 
 esp_err_t hid_transport_request_mode_switch(hid_mode_t target)
@@ -232,6 +282,11 @@ esp_err_t hid_transport_clear_bond(void)
     return hid_ble_backend_clear_bond();
 }
 
+uint32_t hid_transport_status_version(void)
+{
+    return s_ctx.status_version;
+}
+
 bool hid_transport_get_status(hid_transport_status_t *out_status)
 {
     if (out_status == NULL) {
@@ -273,6 +328,16 @@ bool hid_transport_get_status(hid_transport_status_t *out_status)
     return true;
 }
 
+void hid_transport_get_link_flags(bool *usb_mounted, bool *link_ready)
+{
+    if (usb_mounted != NULL) {
+        *usb_mounted = s_ctx.initialized && hid_usb_backend_mounted();
+    }
+    if (link_ready != NULL) {
+        *link_ready = hid_transport_is_link_ready();
+    }
+}
+
 bool hid_transport_get_oled_lines(char *line0,
                                   size_t line0_size,
                                   char *line1,
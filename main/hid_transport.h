@@ -40,12 +40,16 @@ typedef struct {
     char ble_peer_addr[18];
 } hid_transport_status_t;
 
+// One line typed into the CDC console; runs on the TinyUSB task and must not block.
+typedef void (*hid_transport_cdc_line_cb_t)(const char *line);
+
 esp_err_t hid_transport_init(void);
 void hid_transport_poll(TickType_t now);
 
 hid_mode_t hid_transport_get_mode(void);
 bool hid_transport_is_link_ready(void);
 bool hid_transport_cdc_connected(void);
+void hid_transport_set_cdc_line_handler(hid_transport_cdc_line_cb_t cb);
 
 void hid_transport_send_keyboard_report(const bool *key_pressed, uint8_t active_layer);
 void hid_transport_send_consumer_report(uint16_t usage);
@@ -55,6 +59,11 @@ esp_err_t hid_transport_start_pairing_window(uint32_t timeout_ms);
 esp_err_t hid_transport_clear_bond(void);
 
 bool hid_transport_get_status(hid_transport_status_t *out_status);
+// Changes when mode or link state (USB mount, BLE connect/bond/pairing/peer) changes; sampled every
+// 100 ms by hid_transport_poll() and read without locks.
+uint32_t hid_transport_status_version(void);
+// Lightweight subset of hid_transport_get_status() for per-scan consumers (LED indicators).
+void hid_transport_get_link_flags(bool *usb_mounted, bool *link_ready);
 bool hid_transport_get_oled_lines(char *line0,
                                   size_t line0_size,
                                   char *line1,
@@ -7,14 +7,14 @@ esp_err_t hid_usb_backend_init(bool enable_hid_keyboard)
     return macropad_usb_init_mode(enable_hid_keyboard);
 }
 
-void hid_usb_backend_send_keyboard_report(const bool *key_pressed, uint8_t active_layer)
+esp_err_t hid_usb_backend_send_keyboard_report(const bool *key_pressed, uint8_t active_layer)
 {
-    macropad_send_keyboard_report(key_pressed, active_layer);
+    return macropad_send_keyboard_report(key_pressed, active_layer);
 }
 
-void hid_usb_backend_send_consumer_report(uint16_t usage)
+esp_err_t hid_usb_backend_send_consumer_report(uint16_t usage)
 {
-    macropad_send_consumer_report(usage);
+    return macropad_send_consumer_report(usage);
 }
 
 bool hid_usb_backend_mounted(void)
@@ -31,3 +31,8 @@ bool hid_usb_backend_cdc_connected(void)
 {
     return macropad_usb_cdc_connected();
 }
+
+void hid_usb_backend_set_cdc_line_handler(hid_usb_cdc_line_cb_t cb)
+{
+    macropad_usb_set_cdc_line_handler(cb);
+}
@@ -1,10 +1,11 @@
 #include "home_assistant.h"
 
+#include <ctype.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "freertos/FreeRTOS.h"
-#include "freertos/queue.h"
 #include "freertos/semphr.h"
 #include "freertos/task.h"
 
@@ -12,9 +13,18 @@
 #include "esp_check.h"
 #include "esp_http_client.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_websocket_client.h"
+#include "mqtt_client.h"
 
+#include "ha_spool.h"
+#include "json_reader.h"
+#include "json_writer.h"
 #include "keymap_config.h"
+#include "metrics.h"
+#include "net_breaker.h"
 #include "sdkconfig.h"
+#include "trace_buffer.h"
 
 #define TAG "HOME_ASSISTANT"
 
@@ -25,7 +35,6 @@
 #define HA_EVENT_SUFFIX_MAX 48
 #define HA_EVENT_TYPE_MAX 96
 #define HA_JSON_MAX 320
-#define HA_KEY_NAME_MAX 32
 #define HA_ENTITY_ID_MAX 96
 #define HA_CONTROL_DOMAIN_MAX 32
 #define HA_CONTROL_SERVICE_MAX 32
@@ -33,6 +42,17 @@
 #define HA_DISPLAY_NAME_MAX 64
 #define HA_DISPLAY_STATE_MAX 64
 #define HA_HTTP_BODY_MAX 896
+#define HA_WS_TASK_STACK 6144
+#define HA_WS_RX_MAX 2048
+#define HA_WS_TX_MAX 640
+#define HA_WS_TOKENS 160
+#define HA_WS_SEND_TIMEOUT_MS 1000
+#define HA_CUSTOM_SLOTS 2
+#define HA_BATCH_JSON_MAX 2048
+#define HA_SPOOL_FLUSH_RECORDS 8U
+#define HA_MQTT_TOPIC_MAX 160
+#define HA_MQTT_TX_MAX 512
+#define HA_MQTT_TASK_STACK 6144
 
 typedef enum {
     HA_EVT_LAYER_SWITCH = 0,
@@ -43,44 +63,37 @@ typedef enum {
     HA_EVT_SERVICE_CALL,
 } ha_event_kind_t;
 
+// Pending-queue record. Strings live elsewhere: key names are keymap config strings, custom
+// JSON sits in s_custom[arg], and the service call is always home_assistant.control.
 typedef struct {
-    ha_event_kind_t kind;
+    uint8_t kind;            // ha_event_kind_t
     uint8_t retry_count;
-    union {
-        struct {
-            uint8_t layer_index;
-        } layer_switch;
-        struct {
-            uint8_t layer_index;
-            uint8_t key_index;
-            bool pressed;
-            uint16_t usage;
-            char key_name[HA_KEY_NAME_MAX];
-        } key_event;
-        struct {
-            uint8_t layer_index;
-            int32_t steps;
-            uint16_t usage;
-        } encoder_step;
-        struct {
-            uint8_t layer_index;
-            bool left_to_right;
-            uint16_t usage;
-        } touch_swipe;
-        struct {
-            char event_suffix[HA_EVENT_SUFFIX_MAX];
-            char json_payload[HA_JSON_MAX];
-        } custom_json;
-        struct {
-            char domain[HA_CONTROL_DOMAIN_MAX];
-            char service[HA_CONTROL_SERVICE_MAX];
-            char entity_id[HA_ENTITY_ID_MAX];
-        } service_call;
-    } data;
+    uint8_t layer_index;
+    uint8_t arg;             // key index, swipe direction (1 = L to R) or custom slot
+    uint16_t usage;
+    bool pressed;
+    bool spooled;            // replayed from the offline spool
+    int32_t steps;           // encoder: sum of the coalesced steps
+    const char *key_name;
 } ha_event_t;
 
-static QueueHandle_t s_queue;
+typedef struct {
+    bool used;
+    char event_suffix[HA_EVENT_SUFFIX_MAX];
+    char json_payload[HA_JSON_MAX];
+} ha_custom_slot_t;
+
+// Ring of MACRO_HA_QUEUE_SIZE records; producers coalesce into it under s_pending_lock.
+static ha_event_t *s_pending;
+static uint16_t s_pending_head;
+static uint16_t s_pending_count;
+static portMUX_TYPE s_pending_lock = portMUX_INITIALIZER_UNLOCKED;
+static ha_custom_slot_t s_custom[HA_CUSTOM_SLOTS];
+static char s_batch_json[HA_BATCH_JSON_MAX];
+static TickType_t s_spool_next_drain_tick;
+static TickType_t s_spool_last_flush_tick;
 static TaskHandle_t s_task;
+static net_breaker_t *s_breaker;
 static SemaphoreHandle_t s_display_lock;
 static bool s_runtime_enabled;
 static bool s_display_runtime_enabled;
@@ -90,45 +103,60 @@ static uint32_t s_last_display_error_log_ms;
 static TickType_t s_display_next_poll_tick;
 static char s_base_url[HA_URL_MAX];
 static char s_auth_header[HA_AUTH_MAX];
-static char s_device_name_escaped[HA_KEY_NAME_MAX];
+
+// Long-lived client for s_base_url, used only by ha_worker. NULL until the first request and after
+// a transport error; recreated on demand.
+static esp_http_client_handle_t s_client;
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static home_assistant_stats_t s_stats;
 
 static char s_display_line[HA_DISPLAY_LINE_MAX];
 static uint32_t s_display_updated_ms;
 static bool s_display_ready;
 
+// home_assistant.transport: websocket. rx/toks/state/name belong to the client task; tx and
+// next_id are shared with ha_worker under send_lock so ids go out in increasing order.
+typedef struct {
+    esp_websocket_client_handle_t client;
+    SemaphoreHandle_t send_lock;
+    uint32_t next_id;
+    uint32_t subscribe_id;
+    volatile bool authenticated;
+    volatile bool subscribed;
+    volatile bool auth_rejected;
+    volatile bool refresh_requested;
+    bool rx_overflow;
+    size_t rx_len;
+    char rx[HA_WS_RX_MAX];
+    char tx[HA_WS_TX_MAX];
+    json_tok_t toks[HA_WS_TOKENS];
+    char state[HA_DISPLAY_STATE_MAX];
+    char friendly_name[HA_DISPLAY_NAME_MAX];
+} ha_ws_t;
+
+static ha_ws_t s_ha_ws;
+
+// home_assistant.transport: mqtt. Topics live under <topic_prefix>/<device_name>. tx, state and
+// friendly_name belong to the client task; ha_worker only enqueues into the esp-mqtt outbox.
+typedef struct {
+    esp_mqtt_client_handle_t client;
+    volatile bool connected;
+    char base[HA_MQTT_TOPIC_MAX];
+    char status_topic[HA_MQTT_TOPIC_MAX];
+    char state_topic[HA_MQTT_TOPIC_MAX];
+    char name_topic[HA_MQTT_TOPIC_MAX];
+    char tx[HA_MQTT_TX_MAX];
+    char state[HA_DISPLAY_STATE_MAX];
+    char friendly_name[HA_DISPLAY_NAME_MAX];
+} ha_mqtt_t;
+
+static ha_mqtt_t s_ha_mqtt;
+
 static inline uint32_t now_ms(void)
 {
     return (uint32_t)xTaskGetTickCount() * portTICK_PERIOD_MS;
 }
 
-static void json_escape_copy(char *dst, size_t dst_size, const char *src)
-{
-    size_t w = 0;
-    if (dst_size == 0) {
-        return;
-    }
-    if (src == NULL) {
-        dst[0] = '\0';
-        return;
-    }
-
-    for (size_t i = 0; src[i] != '\0'; ++i) {
-        const char c = src[i];
-        if (w + 2 >= dst_size) {
-            break;
-        }
-        if (c == '"' || c == '\\') {
-            dst[w++] = '\\';
-            dst[w++] = c;
-        } else if ((unsigned char)c < 0x20) {
-            dst[w++] = '_';
-        } else {
-            dst[w++] = c;
-        }
-    }
-    dst[w] = '\0';
-}
-
 static void normalize_base_url(void)
 {
     strlcpy(s_base_url, CONFIG_MACROPAD_HA_BASE_URL, sizeof(s_base_url));
@@ -148,12 +176,57 @@ static void build_event_type(char *out, size_t out_size, const char *suffix)
     strlcpy(out, suffix, out_size);
 }
 
-static esp_http_client_handle_t ha_http_client_init(const char *url, esp_http_client_method_t method)
+typedef struct {
+    char *buf;
+    size_t cap;
+    size_t used;
+    bool truncated;
+} ha_body_sink_t;
+
+static esp_err_t ha_http_event_handler(esp_http_client_event_t *evt)
+{
+    switch (evt->event_id) {
+    case HTTP_EVENT_ON_CONNECTED:
+        // One TCP connect (plus TLS handshake for https) per event; reused requests do not get here.
+        metrics_inc(METRIC_HA_CONNECTS);
+        portENTER_CRITICAL(&s_stats_lock);
+        s_stats.connects++;
+        s_stats.connected = true;
+        portEXIT_CRITICAL(&s_stats_lock);
+        break;
+    case HTTP_EVENT_DISCONNECTED:
+        portENTER_CRITICAL(&s_stats_lock);
+        s_stats.connected = false;
+        portEXIT_CRITICAL(&s_stats_lock);
+        break;
+    case HTTP_EVENT_ON_DATA: {
+        ha_body_sink_t *sink = (ha_body_sink_t *)evt->user_data;
+        if (sink == NULL || evt->data_len <= 0) {
+            break;
+        }
+        const size_t room = sink->cap - 1U - sink->used;
+        const size_t n = ((size_t)evt->data_len < room) ? (size_t)evt->data_len : room;
+        memcpy(sink->buf + sink->used, evt->data, n);
+        sink->used += n;
+        sink->buf[sink->used] = '\0';
+        if (n < (size_t)evt->data_len) {
+            sink->truncated = true;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    return ESP_OK;
+}
+
+static esp_http_client_handle_t ha_http_client_init(const char *url)
 {
     esp_http_client_config_t cfg = {
         .url = url,
-        .method = method,
         .timeout_ms = MACRO_HA_REQUEST_TIMEOUT_MS,
+        .event_handler = ha_http_event_handler,
+        .keep_alive_enable = MACRO_HA_KEEP_ALIVE,
     };
     if (strncmp(url, "https://", 8) == 0) {
         cfg.crt_bundle_attach = esp_crt_bundle_attach;
@@ -170,6 +243,109 @@ static esp_http_client_handle_t ha_http_client_init(const char *url, esp_http_cl
     return client;
 }
 
+static void ha_client_drop(void)
+{
+    if (s_client != NULL) {
+        esp_http_client_cleanup(s_client);
+        s_client = NULL;
+    }
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.connected = false;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+static esp_err_t ha_perform_once(esp_http_client_method_t method,
+                                 const char *url,
+                                 const char *json_body,
+                                 ha_body_sink_t *sink,
+                                 int *status_out)
+{
+    if (s_client == NULL) {
+        s_client = ha_http_client_init(url);
+        if (s_client == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    // Same host every time, so the client keeps its socket (and TLS session) across URL changes.
+    ESP_RETURN_ON_ERROR(esp_http_client_set_url(s_client, url), TAG, "set url failed");
+    (void)esp_http_client_set_method(s_client, method);
+    if (json_body != NULL) {
+        (void)esp_http_client_set_header(s_client, "Content-Type", "application/json");
+        (void)esp_http_client_set_post_field(s_client, json_body, (int)strlen(json_body));
+    } else {
+        (void)esp_http_client_delete_header(s_client, "Content-Type");
+        (void)esp_http_client_set_post_field(s_client, NULL, 0);
+    }
+    if (sink != NULL) {
+        sink->used = 0U;
+        sink->truncated = false;
+        sink->buf[0] = '\0';
+    }
+    (void)esp_http_client_set_user_data(s_client, sink);
+
+    const esp_err_t err = esp_http_client_perform(s_client);
+    *status_out = esp_http_client_get_status_code(s_client);
+    return err;
+}
+
+// One request on the shared client. A kept-alive socket that the server closed while idle only
+// shows up as a failed write or read, so a failure on a reused connection is retried once on a
+// fresh one; a failure on a fresh connection is returned as is. While the breaker is open the
+// request is refused without touching the network.
+static esp_err_t ha_request(esp_http_client_method_t method,
+                            const char *url,
+                            const char *json_body,
+                            ha_body_sink_t *sink,
+                            int *status_out)
+{
+    *status_out = 0;
+    if (!net_breaker_allow(s_breaker)) {
+        return ESP_ERR_NOT_ALLOWED;
+    }
+    const int64_t start_us = esp_timer_get_time();
+    const bool reused = (s_client != NULL);
+    portENTER_CRITICAL(&s_stats_lock);
+    const uint32_t connects_before = s_stats.connects;
+    portEXIT_CRITICAL(&s_stats_lock);
+
+    esp_err_t err = ha_perform_once(method, url, json_body, sink, status_out);
+    if (err != ESP_OK) {
+        portENTER_CRITICAL(&s_stats_lock);
+        const bool fresh = s_stats.connects != connects_before;
+        portEXIT_CRITICAL(&s_stats_lock);
+        ha_client_drop();
+        if (reused && !fresh) {
+            err = ha_perform_once(method, url, json_body, sink, status_out);
+            if (err != ESP_OK) {
+                ha_client_drop();
+            }
+        }
+    } else if (!MACRO_HA_KEEP_ALIVE) {
+        ha_client_drop();
+    }
+
+    const uint32_t elapsed_us = (uint32_t)(esp_timer_get_time() - start_us);
+    const bool failed = (err != ESP_OK) || *status_out < 200 || *status_out >= 300;
+    // A 4xx is the server answering; only silence and 5xx say it is down.
+    net_breaker_record(s_breaker, err == ESP_OK && *status_out < 500);
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.requests++;
+    if (failed) {
+        s_stats.failures++;
+    }
+    s_stats.last_request_us = elapsed_us;
+    if (elapsed_us > s_stats.max_request_us) {
+        s_stats.max_request_us = elapsed_us;
+    }
+    portEXIT_CRITICAL(&s_stats_lock);
+    metrics_observe_us((method == HTTP_METHOD_GET) ? METRIC_HIST_HA_GET : METRIC_HIST_HA_POST, elapsed_us);
+    if (failed && method != HTTP_METHOD_GET) {
+        metrics_inc(METRIC_HA_POST_FAILURES);
+    }
+    return err;
+}
+
 static esp_err_t post_event_json(const char *event_suffix, const char *json_payload)
 {
     char event_type[HA_EVENT_TYPE_MAX];
@@ -182,17 +358,10 @@ static esp_err_t post_event_json(const char *event_suffix, const char *json_payl
         return ESP_ERR_INVALID_SIZE;
     }
 
-    esp_http_client_handle_t client = ha_http_client_init(url, HTTP_METHOD_POST);
-    if (client == NULL) {
-        return ESP_FAIL;
-    }
-
-    (void)esp_http_client_set_header(client, "Content-Type", "application/json");
-    (void)esp_http_client_set_post_field(client, json_payload, strlen(json_payload));
-
-    esp_err_t err = esp_http_client_perform(client);
-    const int status = esp_http_client_get_status_code(client);
-    esp_http_client_cleanup(client);
+    int status = 0;
+    trace_buffer_begin(TRACE_SPAN_HA_POST);
+    const esp_err_t err = ha_request(HTTP_METHOD_POST, url, json_payload, NULL, &status);
+    trace_buffer_end(TRACE_SPAN_HA_POST);
 
     if (err != ESP_OK) {
         ESP_LOGW(TAG, "POST failed event=%s err=%s", event_type, esp_err_to_name(err));
@@ -215,17 +384,10 @@ static esp_err_t post_service_json(const char *domain, const char *service, cons
         return ESP_ERR_INVALID_SIZE;
     }
 
-    esp_http_client_handle_t client = ha_http_client_init(url, HTTP_METHOD_POST);
-    if (client == NULL) {
-        return ESP_FAIL;
-    }
-
-    (void)esp_http_client_set_header(client, "Content-Type", "application/json");
-    (void)esp_http_client_set_post_field(client, json_payload, strlen(json_payload));
-
-    esp_err_t err = esp_http_client_perform(client);
-    const int status = esp_http_client_get_status_code(client);
-    esp_http_client_cleanup(client);
+    int status = 0;
+    trace_buffer_begin(TRACE_SPAN_HA_POST);
+    const esp_err_t err = ha_request(HTTP_METHOD_POST, url, json_payload, NULL, &status);
+    trace_buffer_end(TRACE_SPAN_HA_POST);
 
     if (err != ESP_OK) {
         ESP_LOGW(TAG, "Service call failed %s/%s err=%s", domain, service, esp_err_to_name(err));
@@ -246,45 +408,14 @@ static esp_err_t http_get_body(const char *url, char *out, size_t out_size)
     }
     out[0] = '\0';
 
-    esp_http_client_handle_t client = ha_http_client_init(url, HTTP_METHOD_GET);
-    if (client == NULL) {
-        return ESP_FAIL;
-    }
-
-    esp_err_t err = esp_http_client_open(client, 0);
-    if (err != ESP_OK) {
-        esp_http_client_cleanup(client);
-        return err;
-    }
-
-    (void)esp_http_client_fetch_headers(client);
-    const int status = esp_http_client_get_status_code(client);
-
-    size_t used = 0;
-    while (used < (out_size - 1U)) {
-        const int rd = esp_http_client_read(client, out + used, (int)(out_size - 1U - used));
-        if (rd < 0) {
-            esp_http_client_close(client);
-            esp_http_client_cleanup(client);
-            return ESP_FAIL;
-        }
-        if (rd == 0) {
-            break;
-        }
-        used += (size_t)rd;
-    }
-    out[used] = '\0';
+    ha_body_sink_t sink = {.buf = out, .cap = out_size};
+    int status = 0;
+    ESP_RETURN_ON_ERROR(ha_request(HTTP_METHOD_GET, url, NULL, &sink, &status), TAG, "GET failed");
 
     // Response larger than our buffer.
-    if (esp_http_client_is_chunked_response(client) && used == (out_size - 1U)) {
-        esp_http_client_close(client);
-        esp_http_client_cleanup(client);
+    if (sink.truncated) {
         return ESP_ERR_INVALID_SIZE;
     }
-
-    esp_http_client_close(client);
-    esp_http_client_cleanup(client);
-
     if (status < 200 || status >= 300) {
         return ESP_FAIL;
     }
@@ -370,6 +501,19 @@ static void build_display_line(const char *name, const char *state, char *out, s
     (void)snprintf(out, out_size, "%s: %s", label, state);
 }
 
+static void set_display_line(const char *name, const char *state)
+{
+    char line[HA_DISPLAY_LINE_MAX];
+    build_display_line(name, state, line, sizeof(line));
+
+    if (s_display_lock != NULL && xSemaphoreTake(s_display_lock, pdMS_TO_TICKS(5)) == pdTRUE) {
+        strlcpy(s_display_line, line, sizeof(s_display_line));
+        s_display_updated_ms = now_ms();
+        s_display_ready = true;
+        xSemaphoreGive(s_display_lock);
+    }
+}
+
 static esp_err_t refresh_display_state(void)
 {
     if (!s_display_runtime_enabled) {
@@ -393,84 +537,703 @@ static esp_err_t refresh_display_state(void)
     char friendly_name[HA_DISPLAY_NAME_MAX];
     (void)json_extract_string_field(body, "friendly_name", friendly_name, sizeof(friendly_name));
 
-    char line[HA_DISPLAY_LINE_MAX];
-    build_display_line(friendly_name, state, line, sizeof(line));
+    set_display_line(friendly_name, state);
+    return ESP_OK;
+}
 
-    if (s_display_lock != NULL && xSemaphoreTake(s_display_lock, pdMS_TO_TICKS(5)) == pdTRUE) {
-        strlcpy(s_display_line, line, sizeof(s_display_line));
-        s_display_updated_ms = now_ms();
-        s_display_ready = true;
-        xSemaphoreGive(s_display_lock);
+static bool ha_ws_ready(void)
+{
+    return MACRO_HA_TRANSPORT_WEBSOCKET && s_ha_ws.client != NULL && s_ha_ws.authenticated;
+}
+
+// Sends one command frame. With a type, the next message id is assigned and written first;
+// fields() appends the rest of the object.
+static esp_err_t ha_ws_send(const char *type,
+                            void (*fields)(json_writer_t *w, const void *arg),
+                            const void *arg,
+                            uint32_t *out_id)
+{
+    if (xSemaphoreTake(s_ha_ws.send_lock, pdMS_TO_TICKS(HA_WS_SEND_TIMEOUT_MS)) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    json_writer_t w;
+    json_writer_init(&w, s_ha_ws.tx, sizeof(s_ha_ws.tx), NULL, NULL);
+    json_writer_obj_begin(&w);
+    uint32_t id = 0;
+    if (type != NULL) {
+        id = s_ha_ws.next_id;
+        json_writer_kv_u32(&w, "id", id);
+        json_writer_kv_str(&w, "type", type);
+    }
+    fields(&w, arg);
+    json_writer_obj_end(&w);
+
+    esp_err_t err = json_writer_finish(&w);
+    if (err == ESP_OK) {
+        const int len = (int)strlen(s_ha_ws.tx);
+        const int sent = esp_websocket_client_send_text(s_ha_ws.client, s_ha_ws.tx, len,
+                                                        pdMS_TO_TICKS(HA_WS_SEND_TIMEOUT_MS));
+        if (sent == len) {
+            // HA closes the socket on a non-increasing id, so only consume one that went out.
+            if (type != NULL) {
+                s_ha_ws.next_id++;
+            }
+        } else {
+            err = ESP_FAIL;
+        }
+    }
+    xSemaphoreGive(s_ha_ws.send_lock);
+
+    if (err == ESP_OK && out_id != NULL) {
+        *out_id = id;
+    }
+    return err;
+}
+
+static void ha_ws_write_auth(json_writer_t *w, const void *arg)
+{
+    (void)arg;
+    json_writer_kv_str(w, "type", "auth");
+    json_writer_kv_str(w, "access_token", CONFIG_MACROPAD_HA_BEARER_TOKEN);
+}
+
+static void ha_ws_write_subscribe(json_writer_t *w, const void *arg)
+{
+    (void)arg;
+    json_writer_key(w, "entity_ids");
+    json_writer_arr_begin(w);
+    json_writer_str(w, MACRO_HA_DISPLAY_ENTITY_ID);
+    json_writer_arr_end(w);
+}
+
+typedef struct {
+    const char *event_type;
+    const char *json;
+} ha_ws_fire_args_t;
+
+static void ha_ws_write_fire_event(json_writer_t *w, const void *arg)
+{
+    const ha_ws_fire_args_t *a = arg;
+    json_writer_kv_str(w, "event_type", a->event_type);
+    json_writer_key(w, "event_data");
+    json_writer_raw(w, a->json);
+}
+
+typedef struct {
+    const char *domain;
+    const char *service;
+    const char *json;
+} ha_ws_service_args_t;
+
+static void ha_ws_write_call_service(json_writer_t *w, const void *arg)
+{
+    const ha_ws_service_args_t *a = arg;
+    json_writer_kv_str(w, "domain", a->domain);
+    json_writer_kv_str(w, "service", a->service);
+    json_writer_key(w, "service_data");
+    json_writer_raw(w, a->json);
+}
+
+static esp_err_t ha_ws_fire_event(const char *event_suffix, const char *json_payload)
+{
+    char event_type[HA_EVENT_TYPE_MAX];
+    build_event_type(event_type, sizeof(event_type), event_suffix);
+    const ha_ws_fire_args_t args = {.event_type = event_type, .json = json_payload};
+
+    trace_buffer_begin(TRACE_SPAN_HA_POST);
+    const esp_err_t err = ha_ws_send("fire_event", ha_ws_write_fire_event, &args, NULL);
+    trace_buffer_end(TRACE_SPAN_HA_POST);
+    return err;
+}
+
+static esp_err_t ha_ws_call_service(const char *domain, const char *service, const char *json_payload)
+{
+    const ha_ws_service_args_t args = {.domain = domain, .service = service, .json = json_payload};
+
+    trace_buffer_begin(TRACE_SPAN_HA_POST);
+    const esp_err_t err = ha_ws_send("call_service", ha_ws_write_call_service, &args, NULL);
+    trace_buffer_end(TRACE_SPAN_HA_POST);
+    return err;
+}
+
+// subscribe_entities messages: {"a":{id:{"s":..,"a":{..}}}} for the initial state and
+// {"c":{id:{"+":{"s":..,"a":{..}}}}} for changes; "s" is absent on attribute-only changes.
+static void ha_ws_apply_entities(const json_doc_t *doc, int event)
+{
+    int entity = -1;
+    int added = json_reader_find(doc, event, "a");
+    if (added >= 0) {
+        entity = json_reader_find(doc, added, MACRO_HA_DISPLAY_ENTITY_ID);
+    } else {
+        const int changed = json_reader_find(doc, event, "c");
+        if (changed >= 0) {
+            entity = json_reader_find(doc, json_reader_find(doc, changed, MACRO_HA_DISPLAY_ENTITY_ID), "+");
+        }
+    }
+    if (entity < 0) {
+        return;
+    }
+
+    bool updated = false;
+    const int state = json_reader_find(doc, entity, "s");
+    if (state >= 0) {
+        updated |= json_reader_string(doc, state, s_ha_ws.state, sizeof(s_ha_ws.state));
+    }
+    const int attrs = json_reader_find(doc, entity, "a");
+    const int name = (attrs >= 0) ? json_reader_find(doc, attrs, "friendly_name") : -1;
+    if (name >= 0) {
+        updated |= json_reader_string(doc, name, s_ha_ws.friendly_name, sizeof(s_ha_ws.friendly_name));
+    }
+    if (!updated || s_ha_ws.state[0] == '\0') {
+        return;
+    }
+
+    set_display_line(s_ha_ws.friendly_name, s_ha_ws.state);
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.ws_updates++;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+static void ha_ws_handle_message(const char *msg, size_t len)
+{
+    json_doc_t doc;
+    const esp_err_t err = json_reader_parse(&doc, msg, len, s_ha_ws.toks, HA_WS_TOKENS);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "WebSocket message (%u bytes) not parsed: %s", (unsigned)len, esp_err_to_name(err));
+        // Might have been our entity; let the worker fetch it once over REST.
+        s_ha_ws.refresh_requested = true;
+        return;
+    }
+
+    char type[24];
+    if (!json_reader_get_string(&doc, "type", type, sizeof(type))) {
+        return;
+    }
+    int id = 0;
+    (void)json_reader_get_int(&doc, "id", &id);
+
+    if (strcmp(type, "event") == 0) {
+        if (s_ha_ws.subscribed && (uint32_t)id == s_ha_ws.subscribe_id) {
+            ha_ws_apply_entities(&doc, json_reader_find(&doc, 0, "event"));
+        }
+    } else if (strcmp(type, "result") == 0) {
+        bool success = true;
+        (void)json_reader_get_bool(&doc, "success", &success);
+        if (!success) {
+            ESP_LOGW(TAG, "WebSocket command id=%d failed", id);
+            if ((uint32_t)id == s_ha_ws.subscribe_id && s_ha_ws.subscribed) {
+                // Server without subscribe_entities; keep polling over REST.
+                s_ha_ws.subscribed = false;
+            }
+        }
+    } else if (strcmp(type, "auth_required") == 0) {
+        if (ha_ws_send(NULL, ha_ws_write_auth, NULL, NULL) != ESP_OK) {
+            ESP_LOGW(TAG, "WebSocket auth send failed");
+        }
+    } else if (strcmp(type, "auth_ok") == 0) {
+        s_ha_ws.authenticated = true;
+        if (s_display_runtime_enabled) {
+            uint32_t sub_id = 0;
+            if (ha_ws_send("subscribe_entities", ha_ws_write_subscribe, NULL, &sub_id) == ESP_OK) {
+                s_ha_ws.subscribe_id = sub_id;
+                s_ha_ws.subscribed = true;
+            }
+        }
+        ESP_LOGI(TAG, "WebSocket authenticated subscribed=%d", s_ha_ws.subscribed ? 1 : 0);
+    } else if (strcmp(type, "auth_invalid") == 0) {
+        // Repeated bad logins get the device IP banned by HA; ha_worker stops the client.
+        ESP_LOGE(TAG, "WebSocket auth rejected; staying on REST");
+        s_ha_ws.auth_rejected = true;
+    }
+}
+
+static void ha_ws_event_handler(void *arg, esp_event_base_t base, int32_t event_id, void *event_data)
+{
+    (void)arg;
+    (void)base;
+    const esp_websocket_event_data_t *data = event_data;
+
+    switch (event_id) {
+    case WEBSOCKET_EVENT_CONNECTED:
+        // Message ids are per connection and restart at 1. HA only needs them to increase, so if a
+        // sender stuck on the old socket holds the lock, carrying on from the old count is fine.
+        if (xSemaphoreTake(s_ha_ws.send_lock, pdMS_TO_TICKS(HA_WS_SEND_TIMEOUT_MS)) == pdTRUE) {
+            s_ha_ws.next_id = 1U;
+            xSemaphoreGive(s_ha_ws.send_lock);
+        } else {
+            ESP_LOGW(TAG, "WebSocket send lock busy; message ids continue from %lu", (unsigned long)s_ha_ws.next_id);
+        }
+        s_ha_ws.rx_len = 0U;
+        s_ha_ws.rx_overflow = false;
+        portENTER_CRITICAL(&s_stats_lock);
+        s_stats.ws_connects++;
+        portEXIT_CRITICAL(&s_stats_lock);
+        break;
+    case WEBSOCKET_EVENT_DISCONNECTED:
+    case WEBSOCKET_EVENT_CLOSED:
+        s_ha_ws.authenticated = false;
+        s_ha_ws.subscribed = false;
+        break;
+    case WEBSOCKET_EVENT_DATA:
+        // Text frames only; a frame larger than the client buffer arrives in several chunks.
+        if (data->op_code != 0x1 || data->data_len < 0) {
+            break;
+        }
+        if (data->payload_offset == 0) {
+            s_ha_ws.rx_len = 0U;
+            s_ha_ws.rx_overflow = false;
+        }
+        if (!s_ha_ws.rx_overflow) {
+            if (s_ha_ws.rx_len + (size_t)data->data_len < sizeof(s_ha_ws.rx)) {
+                memcpy(&s_ha_ws.rx[s_ha_ws.rx_len], data->data_ptr, (size_t)data->data_len);
+                s_ha_ws.rx_len += (size_t)data->data_len;
+            } else {
+                s_ha_ws.rx_overflow = true;
+            }
+        }
+        if (data->payload_offset + data->data_len < data->payload_len) {
+            break;
+        }
+        if (s_ha_ws.rx_overflow) {
+            ESP_LOGW(TAG, "WebSocket message of %d bytes dropped", data->payload_len);
+            s_ha_ws.refresh_requested = true;
+            break;
+        }
+        s_ha_ws.rx[s_ha_ws.rx_len] = '\0';
+        ha_ws_handle_message(s_ha_ws.rx, s_ha_ws.rx_len);
+        break;
+    default:
+        break;
+    }
+}
+
+static esp_err_t ha_ws_start(void)
+{
+    char uri[HA_URL_MAX + 24];
+    const char *rest = NULL;
+    const char *scheme = NULL;
+    if (strncmp(s_base_url, "https://", 8) == 0) {
+        scheme = "wss://";
+        rest = s_base_url + 8;
+    } else if (strncmp(s_base_url, "http://", 7) == 0) {
+        scheme = "ws://";
+        rest = s_base_url + 7;
+    } else {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const int n = snprintf(uri, sizeof(uri), "%s%s/api/websocket", scheme, rest);
+    if (n <= 0 || (size_t)n >= sizeof(uri)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    s_ha_ws.send_lock = xSemaphoreCreateMutex();
+    if (s_ha_ws.send_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_websocket_client_config_t cfg = {
+        .uri = uri,
+        .task_name = "ha_ws",
+        .task_stack = HA_WS_TASK_STACK,
+        .task_prio = HA_TASK_PRIO,
+        .network_timeout_ms = MACRO_HA_REQUEST_TIMEOUT_MS,
+    };
+    if (scheme[2] == 's') {
+        cfg.crt_bundle_attach = esp_crt_bundle_attach;
+    }
+    s_ha_ws.client = esp_websocket_client_init(&cfg);
+    if (s_ha_ws.client == NULL) {
+        vSemaphoreDelete(s_ha_ws.send_lock);
+        s_ha_ws.send_lock = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = esp_websocket_register_events(s_ha_ws.client, WEBSOCKET_EVENT_ANY, ha_ws_event_handler, NULL);
+    if (err == ESP_OK) {
+        err = esp_websocket_client_start(s_ha_ws.client);
+    }
+    if (err != ESP_OK) {
+        (void)esp_websocket_client_destroy(s_ha_ws.client);
+        s_ha_ws.client = NULL;
+    }
+    return err;
+}
+
+// Runs on ha_worker: the client cannot be stopped from its own event handler.
+static void ha_ws_check_auth(void)
+{
+    if (!MACRO_HA_TRANSPORT_WEBSOCKET || s_ha_ws.client == NULL || !s_ha_ws.auth_rejected) {
+        return;
+    }
+    (void)esp_websocket_client_stop(s_ha_ws.client);
+    (void)esp_websocket_client_destroy(s_ha_ws.client);
+    s_ha_ws.client = NULL;
+    s_ha_ws.authenticated = false;
+    s_ha_ws.subscribed = false;
+}
+
+// Event families that get an MQTT discovery config; "control" carries the encoder service action.
+static const char *const s_ha_mqtt_families[] = {
+    "layer_switch", "key_event", "encoder_step", "touch_swipe", "control",
+};
+
+static bool ha_mqtt_family_enabled(size_t index)
+{
+    switch (index) {
+    case 0:
+        return MACRO_HA_PUBLISH_LAYER_SWITCH;
+    case 1:
+        return MACRO_HA_PUBLISH_KEY_EVENT;
+    case 2:
+        return MACRO_HA_PUBLISH_ENCODER_STEP;
+    case 3:
+        return MACRO_HA_PUBLISH_TOUCH_SWIPE;
+    case 4:
+        return s_control_runtime_enabled;
+    default:
+        return false;
+    }
+}
+
+// QoS 1 messages wait in the esp-mqtt outbox while the broker is away; QoS 0 needs a connection.
+static bool ha_mqtt_accepting(void)
+{
+    return MACRO_HA_TRANSPORT_MQTT && s_ha_mqtt.client != NULL &&
+           (s_ha_mqtt.connected || MACRO_HA_MQTT_QOS > 0);
+}
+
+// <base>/event/<suffix> carrying {"event_type":"<suffix>",<fields of json>}: HA's MQTT event
+// entity takes event_type from the payload and keeps the other fields as attributes.
+static esp_err_t ha_mqtt_publish_event(const char *event_suffix, const char *json)
+{
+    if (!ha_mqtt_accepting()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    char topic[HA_MQTT_TOPIC_MAX + HA_EVENT_SUFFIX_MAX];
+    char payload[HA_JSON_MAX + HA_EVENT_SUFFIX_MAX + 24];
+    int n = snprintf(topic, sizeof(topic), "%s/event/%s", s_ha_mqtt.base, event_suffix);
+    if (n <= 0 || (size_t)n >= sizeof(topic)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    // Members of json without its opening brace; "}" for an empty object or a non-object.
+    const char *fields = json;
+    while (isspace((unsigned char)*fields)) {
+        ++fields;
+    }
+    if (*fields == '{') {
+        ++fields;
+        while (isspace((unsigned char)*fields)) {
+            ++fields;
+        }
+    } else {
+        fields = "}";
+    }
+    n = snprintf(payload, sizeof(payload), "{\"event_type\":\"%s\"%s%s",
+                 event_suffix, (fields[0] == '}') ? "" : ",", fields);
+    if (n <= 0 || (size_t)n >= sizeof(payload)) {
+        return ESP_ERR_INVALID_SIZE;
     }
+
+    // Enqueue returns at once; the client task writes it to the socket.
+    trace_buffer_begin(TRACE_SPAN_HA_POST);
+    const int msg_id = esp_mqtt_client_enqueue(s_ha_mqtt.client, topic, payload, n, MACRO_HA_MQTT_QOS, 0, true);
+    trace_buffer_end(TRACE_SPAN_HA_POST);
+    if (msg_id < 0) {
+        ESP_LOGW(TAG, "MQTT enqueue failed topic=%s (outbox full?)", topic);
+        return ESP_FAIL;
+    }
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.mqtt_published++;
+    portEXIT_CRITICAL(&s_stats_lock);
     return ESP_OK;
 }
 
+// Retained <discovery_prefix>/event/<device>/<family>/config per enabled family, so HA creates
+// one event entity each under a single device. Runs on the client task after every connect.
+static void ha_mqtt_publish_discovery(void)
+{
+    for (size_t i = 0; i < sizeof(s_ha_mqtt_families) / sizeof(s_ha_mqtt_families[0]); ++i) {
+        if (!ha_mqtt_family_enabled(i)) {
+            continue;
+        }
+        const char *family = s_ha_mqtt_families[i];
+        char topic[HA_MQTT_TOPIC_MAX];
+        char value[HA_MQTT_TOPIC_MAX];
+        const int n = snprintf(topic, sizeof(topic), "%s/event/%s/%s/config",
+                               MACRO_HA_MQTT_DISCOVERY_PREFIX, MACRO_HA_DEVICE_NAME, family);
+        if (n <= 0 || (size_t)n >= sizeof(topic)) {
+            continue;
+        }
+
+        json_writer_t w;
+        json_writer_init(&w, s_ha_mqtt.tx, sizeof(s_ha_mqtt.tx), NULL, NULL);
+        json_writer_obj_begin(&w);
+        json_writer_kv_str(&w, "name", family);
+        (void)snprintf(value, sizeof(value), "%s_%s", MACRO_HA_DEVICE_NAME, family);
+        json_writer_kv_str(&w, "unique_id", value);
+        (void)snprintf(value, sizeof(value), "%s/event/%s", s_ha_mqtt.base, family);
+        json_writer_kv_str(&w, "state_topic", value);
+        json_writer_key(&w, "event_types");
+        json_writer_arr_begin(&w);
+        json_writer_str(&w, family);
+        json_writer_arr_end(&w);
+        json_writer_kv_str(&w, "availability_topic", s_ha_mqtt.status_topic);
+        json_writer_key(&w, "device");
+        json_writer_obj_begin(&w);
+        json_writer_key(&w, "identifiers");
+        json_writer_arr_begin(&w);
+        json_writer_str(&w, MACRO_HA_DEVICE_NAME);
+        json_writer_arr_end(&w);
+        json_writer_kv_str(&w, "name", MACRO_HA_DEVICE_NAME);
+        json_writer_kv_str(&w, "model", "ESP32-S3 MacroPad");
+        json_writer_obj_end(&w);
+        json_writer_obj_end(&w);
+        if (json_writer_finish(&w) != ESP_OK) {
+            ESP_LOGW(TAG, "MQTT discovery config for %s too large", family);
+            continue;
+        }
+        (void)esp_mqtt_client_enqueue(s_ha_mqtt.client, topic, s_ha_mqtt.tx, (int)strlen(s_ha_mqtt.tx), 1, 1, true);
+    }
+}
+
+// mqtt_statestream publishes attributes JSON-encoded ("\"Living Room\""); states come raw.
+static void ha_mqtt_copy_payload(const char *data, int len, bool unquote, char *out, size_t out_size)
+{
+    if (unquote && len >= 2 && data[0] == '"' && data[len - 1] == '"') {
+        data++;
+        len -= 2;
+    }
+    const size_t n = ((size_t)len < out_size - 1U) ? (size_t)len : out_size - 1U;
+    memcpy(out, data, n);
+    out[n] = '\0';
+}
+
+static void ha_mqtt_handle_data(const esp_mqtt_event_t *event)
+{
+    // State payloads are short; anything split across several DATA events is not a display value.
+    if (event->current_data_offset != 0 || event->data_len != event->total_data_len || event->topic_len <= 0) {
+        return;
+    }
+    const size_t topic_len = (size_t)event->topic_len;
+    if (topic_len == strlen(s_ha_mqtt.state_topic) &&
+        strncmp(event->topic, s_ha_mqtt.state_topic, topic_len) == 0) {
+        ha_mqtt_copy_payload(event->data, event->data_len, false, s_ha_mqtt.state, sizeof(s_ha_mqtt.state));
+    } else if (s_ha_mqtt.name_topic[0] != '\0' && topic_len == strlen(s_ha_mqtt.name_topic) &&
+               strncmp(event->topic, s_ha_mqtt.name_topic, topic_len) == 0) {
+        ha_mqtt_copy_payload(event->data, event->data_len, true,
+                             s_ha_mqtt.friendly_name, sizeof(s_ha_mqtt.friendly_name));
+    } else {
+        return;
+    }
+    if (s_ha_mqtt.state[0] == '\0') {
+        return;
+    }
+    set_display_line(s_ha_mqtt.friendly_name, s_ha_mqtt.state);
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.mqtt_updates++;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+static void ha_mqtt_event_handler(void *arg, esp_event_base_t base, int32_t event_id, void *event_data)
+{
+    (void)arg;
+    (void)base;
+    const esp_mqtt_event_t *event = event_data;
+
+    switch ((esp_mqtt_event_id_t)event_id) {
+    case MQTT_EVENT_CONNECTED:
+        s_ha_mqtt.connected = true;
+        portENTER_CRITICAL(&s_stats_lock);
+        s_stats.mqtt_connects++;
+        portEXIT_CRITICAL(&s_stats_lock);
+        (void)esp_mqtt_client_enqueue(s_ha_mqtt.client, s_ha_mqtt.status_topic, "online", 6, 1, 1, true);
+        if (MACRO_HA_MQTT_DISCOVERY) {
+            ha_mqtt_publish_discovery();
+        }
+        if (s_ha_mqtt.state_topic[0] != '\0') {
+            (void)esp_mqtt_client_subscribe(s_ha_mqtt.client, s_ha_mqtt.state_topic, 0);
+        }
+        if (s_ha_mqtt.name_topic[0] != '\0') {
+            (void)esp_mqtt_client_subscribe(s_ha_mqtt.client, s_ha_mqtt.name_topic, 0);
+        }
+        ESP_LOGI(TAG, "MQTT connected base=%s", s_ha_mqtt.base);
+        break;
+    case MQTT_EVENT_DISCONNECTED:
+        s_ha_mqtt.connected = false;
+        break;
+    case MQTT_EVENT_DATA:
+        ha_mqtt_handle_data(event);
+        break;
+    default:
+        break;
+    }
+}
+
+// Display topics: home_assistant.mqtt.display_state_topic, or the mqtt_statestream layout
+// <statestream_prefix>/<domain>/<object_id>/state (+ /friendly_name) derived from the entity id.
+static void ha_mqtt_build_display_topics(void)
+{
+    if (!s_display_runtime_enabled) {
+        return;
+    }
+    if (MACRO_HA_MQTT_DISPLAY_STATE_TOPIC[0] != '\0') {
+        strlcpy(s_ha_mqtt.state_topic, MACRO_HA_MQTT_DISPLAY_STATE_TOPIC, sizeof(s_ha_mqtt.state_topic));
+        return;
+    }
+    const char *dot = strchr(MACRO_HA_DISPLAY_ENTITY_ID, '.');
+    if (dot == NULL) {
+        ESP_LOGW(TAG, "display.entity_id has no domain; no MQTT state topic");
+        return;
+    }
+    const int domain_len = (int)(dot - MACRO_HA_DISPLAY_ENTITY_ID);
+    (void)snprintf(s_ha_mqtt.state_topic, sizeof(s_ha_mqtt.state_topic), "%s/%.*s/%s/state",
+                   MACRO_HA_MQTT_STATESTREAM_PREFIX, domain_len, MACRO_HA_DISPLAY_ENTITY_ID, dot + 1);
+    (void)snprintf(s_ha_mqtt.name_topic, sizeof(s_ha_mqtt.name_topic), "%s/%.*s/%s/friendly_name",
+                   MACRO_HA_MQTT_STATESTREAM_PREFIX, domain_len, MACRO_HA_DISPLAY_ENTITY_ID, dot + 1);
+}
+
+static esp_err_t ha_mqtt_start(void)
+{
+    if (CONFIG_MACROPAD_HA_MQTT_BROKER_URI[0] == '\0') {
+        return ESP_ERR_INVALID_ARG;
+    }
+    int n = snprintf(s_ha_mqtt.base, sizeof(s_ha_mqtt.base), "%s/%s", MACRO_HA_MQTT_TOPIC_PREFIX, MACRO_HA_DEVICE_NAME);
+    if (n <= 0 || (size_t)n >= sizeof(s_ha_mqtt.base)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    (void)snprintf(s_ha_mqtt.status_topic, sizeof(s_ha_mqtt.status_topic), "%s/status", s_ha_mqtt.base);
+    ha_mqtt_build_display_topics();
+
+    esp_mqtt_client_config_t cfg = {
+        .broker.address.uri = CONFIG_MACROPAD_HA_MQTT_BROKER_URI,
+        .credentials.client_id = MACRO_HA_DEVICE_NAME,
+        .session.keepalive = MACRO_HA_MQTT_KEEPALIVE_SEC,
+        .session.last_will.topic = s_ha_mqtt.status_topic,
+        .session.last_will.msg = "offline",
+        .session.last_will.qos = 1,
+        .session.last_will.retain = 1,
+        .network.timeout_ms = MACRO_HA_REQUEST_TIMEOUT_MS,
+        .task.priority = HA_TASK_PRIO,
+        .task.stack_size = HA_MQTT_TASK_STACK,
+        .outbox.limit = MACRO_HA_MQTT_OUTBOX_LIMIT_BYTES,
+    };
+    if (CONFIG_MACROPAD_HA_MQTT_USERNAME[0] != '\0') {
+        cfg.credentials.username = CONFIG_MACROPAD_HA_MQTT_USERNAME;
+        cfg.credentials.authentication.password = CONFIG_MACROPAD_HA_MQTT_PASSWORD;
+    }
+    if (strncmp(CONFIG_MACROPAD_HA_MQTT_BROKER_URI, "mqtts://", 8) == 0) {
+        cfg.broker.verification.crt_bundle_attach = esp_crt_bundle_attach;
+    }
+
+    s_ha_mqtt.client = esp_mqtt_client_init(&cfg);
+    if (s_ha_mqtt.client == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = esp_mqtt_client_register_event(s_ha_mqtt.client, MQTT_EVENT_ANY, ha_mqtt_event_handler, NULL);
+    if (err == ESP_OK) {
+        err = esp_mqtt_client_start(s_ha_mqtt.client);
+    }
+    if (err != ESP_OK) {
+        (void)esp_mqtt_client_destroy(s_ha_mqtt.client);
+        s_ha_mqtt.client = NULL;
+    }
+    return err;
+}
+
+// Events cannot leave right now: REST breaker open (WebSocket down), or MQTT unable to take them.
+static bool ha_transport_offline(void)
+{
+    if (MACRO_HA_TRANSPORT_MQTT) {
+        return !ha_mqtt_accepting();
+    }
+    return !ha_ws_ready() && !net_breaker_ready(s_breaker);
+}
+
+static void write_layer_fields(json_writer_t *w, uint8_t layer_index)
+{
+    json_writer_kv_str(w, "device", MACRO_HA_DEVICE_NAME);
+    json_writer_kv_u32(w, "layer_index", layer_index);
+    json_writer_kv_u32(w, "layer", (uint32_t)layer_index + 1U);
+}
+
 static bool build_event_payload(const ha_event_t *event, char *event_suffix, size_t event_suffix_size, char *json, size_t json_size)
 {
-    char key_name_escaped[HA_KEY_NAME_MAX];
+    json_writer_t w;
+
+    if (event->kind == HA_EVT_CUSTOM_JSON) {
+        strlcpy(event_suffix, s_custom[event->arg].event_suffix, event_suffix_size);
+        strlcpy(json, s_custom[event->arg].json_payload, json_size);
+        return true;
+    }
 
+    json_writer_init(&w, json, json_size, NULL, NULL);
+    json_writer_obj_begin(&w);
     switch (event->kind) {
     case HA_EVT_LAYER_SWITCH:
         strlcpy(event_suffix, "layer_switch", event_suffix_size);
-        (void)snprintf(json,
-                       json_size,
-                       "{\"device\":\"%s\",\"layer_index\":%u,\"layer\":%u}",
-                       s_device_name_escaped,
-                       (unsigned)event->data.layer_switch.layer_index,
-                       (unsigned)event->data.layer_switch.layer_index + 1U);
-        return true;
+        write_layer_fields(&w, event->layer_index);
+        break;
     case HA_EVT_KEY_EVENT:
         strlcpy(event_suffix, "key_event", event_suffix_size);
-        json_escape_copy(key_name_escaped, sizeof(key_name_escaped), event->data.key_event.key_name);
-        (void)snprintf(json,
-                       json_size,
-                       "{\"device\":\"%s\",\"layer_index\":%u,\"layer\":%u,\"key_index\":%u,\"key\":%u,\"pressed\":%s,\"usage\":%u,\"name\":\"%s\"}",
-                       s_device_name_escaped,
-                       (unsigned)event->data.key_event.layer_index,
-                       (unsigned)event->data.key_event.layer_index + 1U,
-                       (unsigned)event->data.key_event.key_index,
-                       (unsigned)event->data.key_event.key_index + 1U,
-                       event->data.key_event.pressed ? "true" : "false",
-                       (unsigned)event->data.key_event.usage,
-                       key_name_escaped);
-        return true;
+        write_layer_fields(&w, event->layer_index);
+        json_writer_kv_u32(&w, "key_index", event->arg);
+        json_writer_kv_u32(&w, "key", (uint32_t)event->arg + 1U);
+        json_writer_kv_bool(&w, "pressed", event->pressed);
+        json_writer_kv_u32(&w, "usage", event->usage);
+        json_writer_kv_str(&w, "name", (event->key_name != NULL) ? event->key_name : "");
+        break;
     case HA_EVT_ENCODER_STEP:
         strlcpy(event_suffix, "encoder_step", event_suffix_size);
-        (void)snprintf(json,
-                       json_size,
-                       "{\"device\":\"%s\",\"layer_index\":%u,\"layer\":%u,\"steps\":%ld,\"usage\":%u}",
-                       s_device_name_escaped,
-                       (unsigned)event->data.encoder_step.layer_index,
-                       (unsigned)event->data.encoder_step.layer_index + 1U,
-                       (long)event->data.encoder_step.steps,
-                       (unsigned)event->data.encoder_step.usage);
-        return true;
+        write_layer_fields(&w, event->layer_index);
+        json_writer_kv_i32(&w, "steps", event->steps);
+        json_writer_kv_u32(&w, "usage", event->usage);
+        break;
     case HA_EVT_TOUCH_SWIPE:
         strlcpy(event_suffix, "touch_swipe", event_suffix_size);
-        (void)snprintf(json,
-                       json_size,
-                       "{\"device\":\"%s\",\"layer_index\":%u,\"layer\":%u,\"direction\":\"%s\",\"usage\":%u}",
-                       s_device_name_escaped,
-                       (unsigned)event->data.touch_swipe.layer_index,
-                       (unsigned)event->data.touch_swipe.layer_index + 1U,
-                       event->data.touch_swipe.left_to_right ? "L_to_R" : "R_to_L",
-                       (unsigned)event->data.touch_swipe.usage);
-        return true;
-    case HA_EVT_CUSTOM_JSON:
-        strlcpy(event_suffix, event->data.custom_json.event_suffix, event_suffix_size);
-        strlcpy(json, event->data.custom_json.json_payload, json_size);
-        return true;
+        write_layer_fields(&w, event->layer_index);
+        json_writer_kv_str(&w, "direction", (event->arg != 0U) ? "L_to_R" : "R_to_L");
+        json_writer_kv_u32(&w, "usage", event->usage);
+        break;
     default:
         return false;
     }
+    if (event->spooled) {
+        json_writer_kv_bool(&w, "spooled", true);
+    }
+    json_writer_obj_end(&w);
+    if (json_writer_finish(&w) != ESP_OK) {
+        ESP_LOGW(TAG, "Event payload for %s exceeds %u bytes; dropped", event_suffix, (unsigned)json_size);
+        return false;
+    }
+    return true;
 }
 
 static esp_err_t process_event(const ha_event_t *event)
 {
     if (event->kind == HA_EVT_SERVICE_CALL) {
         char payload[HA_JSON_MAX];
-        (void)snprintf(payload, sizeof(payload), "{\"entity_id\":\"%s\"}", event->data.service_call.entity_id);
-        return post_service_json(event->data.service_call.domain, event->data.service_call.service, payload);
+        json_writer_t w;
+        json_writer_init(&w, payload, sizeof(payload), NULL, NULL);
+        json_writer_obj_begin(&w);
+        if (MACRO_HA_TRANSPORT_MQTT) {
+            // MQTT cannot call services; an automation on the "control" event entity does it.
+            json_writer_kv_str(&w, "device", MACRO_HA_DEVICE_NAME);
+            json_writer_kv_str(&w, "domain", MACRO_HA_CONTROL_DOMAIN);
+            json_writer_kv_str(&w, "service", MACRO_HA_CONTROL_SERVICE);
+        }
+        json_writer_kv_str(&w, "entity_id", MACRO_HA_CONTROL_ENTITY_ID);
+        json_writer_obj_end(&w);
+        if (json_writer_finish(&w) != ESP_OK) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        if (MACRO_HA_TRANSPORT_MQTT) {
+            return ha_mqtt_publish_event("control", payload);
+        }
+        if (ha_ws_ready() && ha_ws_call_service(MACRO_HA_CONTROL_DOMAIN, MACRO_HA_CONTROL_SERVICE, payload) == ESP_OK) {
+            return ESP_OK;
+        }
+        return post_service_json(MACRO_HA_CONTROL_DOMAIN, MACRO_HA_CONTROL_SERVICE, payload);
     }
 
     char event_suffix[HA_EVENT_SUFFIX_MAX] = {0};
@@ -478,36 +1241,408 @@ static esp_err_t process_event(const ha_event_t *event)
     if (!build_event_payload(event, event_suffix, sizeof(event_suffix), json, sizeof(json))) {
         return ESP_ERR_INVALID_ARG;
     }
+    if (MACRO_HA_TRANSPORT_MQTT) {
+        return ha_mqtt_publish_event(event_suffix, json);
+    }
+    if (ha_ws_ready() && ha_ws_fire_event(event_suffix, json) == ESP_OK) {
+        return ESP_OK;
+    }
     return post_event_json(event_suffix, json);
 }
 
-static void queue_event(const ha_event_t *event)
+static void ha_count_drop(void)
 {
-    if (!s_runtime_enabled || s_queue == NULL) {
-        return;
+    metrics_inc(METRIC_HA_EVENTS_DROPPED);
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.dropped++;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+static void ha_event_release(const ha_event_t *event)
+{
+    if (event->kind == HA_EVT_CUSTOM_JSON) {
+        portENTER_CRITICAL(&s_pending_lock);
+        s_custom[event->arg].used = false;
+        portEXIT_CRITICAL(&s_pending_lock);
     }
-    if (xQueueSend(s_queue, event, 0) == pdTRUE) {
-        return;
+}
+
+// Caller holds s_pending_lock. Merges a steady encoder spin into the newest pending step and
+// keeps one pending layer switch carrying the latest layer.
+static bool ha_pending_coalesce_locked(const ha_event_t *event)
+{
+    if (!MACRO_HA_COALESCE || s_pending_count == 0U) {
+        return false;
+    }
+
+    if (event->kind == HA_EVT_ENCODER_STEP) {
+        ha_event_t *tail = &s_pending[(s_pending_head + s_pending_count - 1U) % (uint16_t)MACRO_HA_QUEUE_SIZE];
+        if (tail->kind == HA_EVT_ENCODER_STEP && tail->retry_count == 0U &&
+            tail->layer_index == event->layer_index && tail->usage == event->usage) {
+            tail->steps += event->steps;
+            return true;
+        }
+        return false;
+    }
+
+    if (event->kind == HA_EVT_LAYER_SWITCH) {
+        // Only the newest layer matters, but it must not overtake events queued after the older
+        // switch: merge into the tail, otherwise drop the stale switch and append this one.
+        ha_event_t *tail = &s_pending[(s_pending_head + s_pending_count - 1U) % (uint16_t)MACRO_HA_QUEUE_SIZE];
+        if (tail->kind == HA_EVT_LAYER_SWITCH) {
+            tail->layer_index = event->layer_index;
+            tail->retry_count = 0U;
+            return true;
+        }
+        for (uint16_t i = 0; i < s_pending_count; ++i) {
+            if (s_pending[(s_pending_head + i) % (uint16_t)MACRO_HA_QUEUE_SIZE].kind != HA_EVT_LAYER_SWITCH) {
+                continue;
+            }
+            for (uint16_t j = i; (j + 1U) < s_pending_count; ++j) {
+                s_pending[(s_pending_head + j) % (uint16_t)MACRO_HA_QUEUE_SIZE] =
+                    s_pending[(s_pending_head + j + 1U) % (uint16_t)MACRO_HA_QUEUE_SIZE];
+            }
+            *tail = *event;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool ha_pending_push(const ha_event_t *event, bool coalesce)
+{
+    bool queued = true;
+    bool merged = false;
+    uint16_t depth;
+
+    portENTER_CRITICAL(&s_pending_lock);
+    if (coalesce && ha_pending_coalesce_locked(event)) {
+        merged = true;
+    } else if (s_pending_count < (uint16_t)MACRO_HA_QUEUE_SIZE) {
+        s_pending[(s_pending_head + s_pending_count) % (uint16_t)MACRO_HA_QUEUE_SIZE] = *event;
+        s_pending_count++;
+    } else {
+        queued = false;
+    }
+    depth = s_pending_count;
+    portEXIT_CRITICAL(&s_pending_lock);
+
+    if (merged) {
+        metrics_inc(METRIC_HA_EVENTS_COALESCED);
+        portENTER_CRITICAL(&s_stats_lock);
+        s_stats.coalesced++;
+        portEXIT_CRITICAL(&s_stats_lock);
+    }
+    metrics_set(METRIC_HA_QUEUE_DEPTH, depth);
+    return queued;
+}
+
+// With batchable_only, stops at a service call so it is not reordered into a batch.
+static bool ha_pending_pop(ha_event_t *out, bool batchable_only)
+{
+    bool ok = false;
+    uint16_t depth;
+
+    portENTER_CRITICAL(&s_pending_lock);
+    if (s_pending_count > 0U &&
+        (!batchable_only || s_pending[s_pending_head].kind != HA_EVT_SERVICE_CALL)) {
+        *out = s_pending[s_pending_head];
+        s_pending_head = (uint16_t)((s_pending_head + 1U) % (uint16_t)MACRO_HA_QUEUE_SIZE);
+        s_pending_count--;
+        ok = true;
     }
+    depth = s_pending_count;
+    portEXIT_CRITICAL(&s_pending_lock);
+
+    if (ok) {
+        metrics_set(METRIC_HA_QUEUE_DEPTH, depth);
+    }
+    return ok;
+}
+
+static bool ha_event_spoolable(const ha_event_t *event)
+{
+    return event->kind == HA_EVT_LAYER_SWITCH || event->kind == HA_EVT_KEY_EVENT ||
+           event->kind == HA_EVT_ENCODER_STEP || event->kind == HA_EVT_TOUCH_SWIPE;
+}
 
+// Service calls and custom JSON are never spooled: a late toggle is worse than none.
+static bool ha_spool_event(const ha_event_t *event)
+{
+    if (ha_spool_is_mounted() && ha_event_spoolable(event)) {
+        ha_spool_record_t rec = {
+            .steps = event->steps,
+            .usage = event->usage,
+            .kind = event->kind,
+            .layer_index = event->layer_index,
+            .arg = event->arg,
+            .pressed = event->pressed ? 1U : 0U,
+        };
+        strlcpy(rec.key_name, (event->key_name != NULL) ? event->key_name : "", sizeof(rec.key_name));
+        if (ha_spool_stage(&rec)) {
+            return true;
+        }
+    }
+    ha_event_release(event);
+    ha_count_drop();
+    return false;
+}
+
+static void ha_event_from_record(const ha_spool_record_t *rec, ha_event_t *out)
+{
+    *out = (ha_event_t){
+        .kind = rec->kind,
+        .layer_index = rec->layer_index,
+        .arg = rec->arg,
+        .usage = rec->usage,
+        .pressed = rec->pressed != 0U,
+        .spooled = true,
+        .steps = rec->steps,
+        .key_name = rec->key_name,
+    };
+}
+
+static bool queue_event(const ha_event_t *event)
+{
+    if (!s_runtime_enabled || s_pending == NULL) {
+        ha_event_release(event);
+        return false;
+    }
+    if (ha_pending_push(event, true)) {
+        xTaskNotifyGive(s_task);
+        return true;
+    }
+    // Full: with the spool, the oldest queued event moves to flash staging to make room.
+    ha_event_t oldest;
+    if (ha_spool_is_mounted() && ha_pending_pop(&oldest, false)) {
+        (void)ha_spool_event(&oldest);
+        if (ha_pending_push(event, false)) {
+            xTaskNotifyGive(s_task);
+            return true;
+        }
+    }
+
+    ha_event_release(event);
+    ha_count_drop();
     const uint32_t t = now_ms();
     if ((t - s_last_drop_log_ms) >= 1000U) {
         s_last_drop_log_ms = t;
         ESP_LOGW(TAG, "Event queue full; dropping events");
     }
+    return false;
+}
+
+static void ha_retry_or_drop(ha_event_t *event)
+{
+    if (event->retry_count < MACRO_HA_MAX_RETRY) {
+        event->retry_count++;
+        if (ha_pending_push(event, false)) {
+            return;
+        }
+        ESP_LOGW(TAG, "Retry enqueue failed; event dropped");
+        ha_count_drop();
+        ha_event_release(event);
+        return;
+    }
+    if (ha_spool_is_mounted()) {
+        (void)ha_spool_event(event);
+        return;
+    }
+    ha_event_release(event);
+}
+
+static bool ha_batch_enabled(void)
+{
+    return !MACRO_HA_TRANSPORT_MQTT && CONFIG_MACROPAD_HA_WEBHOOK_ID[0] != '\0';
+}
+
+// One POST to /api/webhook/<id>: {"device":..,"events":[{"event_type":..,"data":{..}},..]}.
+static esp_err_t post_batch(const ha_event_t *events, size_t count)
+{
+    json_writer_t w;
+    json_writer_init(&w, s_batch_json, sizeof(s_batch_json), NULL, NULL);
+    json_writer_obj_begin(&w);
+    json_writer_kv_str(&w, "device", MACRO_HA_DEVICE_NAME);
+    json_writer_key(&w, "events");
+    json_writer_arr_begin(&w);
+    for (size_t i = 0; i < count; ++i) {
+        char event_suffix[HA_EVENT_SUFFIX_MAX] = {0};
+        char event_type[HA_EVENT_TYPE_MAX];
+        char json[HA_JSON_MAX] = {0};
+        if (!build_event_payload(&events[i], event_suffix, sizeof(event_suffix), json, sizeof(json))) {
+            continue;
+        }
+        build_event_type(event_type, sizeof(event_type), event_suffix);
+        json_writer_obj_begin(&w);
+        json_writer_kv_str(&w, "event_type", event_type);
+        json_writer_key(&w, "data");
+        json_writer_raw(&w, json);
+        json_writer_obj_end(&w);
+    }
+    json_writer_arr_end(&w);
+    json_writer_obj_end(&w);
+    if (json_writer_finish(&w) != ESP_OK) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    char url[HA_URL_MAX + 96];
+    const int n = snprintf(url, sizeof(url), "%s/api/webhook/%s", s_base_url, CONFIG_MACROPAD_HA_WEBHOOK_ID);
+    if (n <= 0 || (size_t)n >= sizeof(url)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    int status = 0;
+    trace_buffer_begin(TRACE_SPAN_HA_POST);
+    const esp_err_t err = ha_request(HTTP_METHOD_POST, url, s_batch_json, NULL, &status);
+    trace_buffer_end(TRACE_SPAN_HA_POST);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Batch POST failed events=%u err=%s", (unsigned)count, esp_err_to_name(err));
+        return err;
+    }
+    if (status < 200 || status >= 300) {
+        ESP_LOGW(TAG, "Batch POST rejected events=%u http=%d", (unsigned)count, status);
+        return ESP_FAIL;
+    }
+
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.batches++;
+    portEXIT_CRITICAL(&s_stats_lock);
+    return ESP_OK;
+}
+
+// Sends the oldest pending event, or everything batchable up to batch.max_events when a
+// webhook is configured and the WebSocket is not carrying events. Returns true while more wait.
+static bool ha_process_pending(void)
+{
+    // Transport down: nothing goes out. Events move to the spool, or wait here until it is back.
+    const bool offline = ha_transport_offline();
+    if (offline && !ha_spool_is_mounted()) {
+        return false;
+    }
+
+    ha_event_t batch[MACRO_HA_BATCH_MAX_EVENTS];
+    if (!ha_pending_pop(&batch[0], false)) {
+        return false;
+    }
+
+    // While a backlog is spooled, new events queue up behind it to keep their order.
+    if ((offline || ha_spool_pending() > 0U) && ha_event_spoolable(&batch[0])) {
+        (void)ha_spool_event(&batch[0]);
+        return s_pending_count > 0U;
+    }
+
+    size_t count = 1U;
+    esp_err_t err = ESP_ERR_NOT_SUPPORTED;
+    if (ha_batch_enabled() && !ha_ws_ready() && batch[0].kind != HA_EVT_SERVICE_CALL) {
+        while (count < MACRO_HA_BATCH_MAX_EVENTS && ha_pending_pop(&batch[count], true)) {
+            count++;
+        }
+        err = post_batch(batch, count);
+        if (err == ESP_ERR_INVALID_SIZE) {
+            // Large custom payloads; fall back to one request per event.
+            for (size_t i = 0; i < count; ++i) {
+                if (process_event(&batch[i]) == ESP_OK) {
+                    ha_event_release(&batch[i]);
+                } else {
+                    ha_retry_or_drop(&batch[i]);
+                }
+            }
+            return s_pending_count > 0U;
+        }
+    } else {
+        err = process_event(&batch[0]);
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        if (err == ESP_OK) {
+            ha_event_release(&batch[i]);
+        } else {
+            ha_retry_or_drop(&batch[i]);
+        }
+    }
+    return s_pending_count > 0U;
+}
+
+// Batches staged records into one flash write, or writes a few of them once they have waited
+// home_assistant.spool.flush_interval_ms.
+static void ha_spool_flush_if_due(TickType_t now)
+{
+    ha_spool_stats_t st;
+    ha_spool_get_stats(&st);
+    if (st.staged == 0U) {
+        s_spool_last_flush_tick = now;
+        return;
+    }
+    if (st.staged < HA_SPOOL_FLUSH_RECORDS &&
+        (now - s_spool_last_flush_tick) < pdMS_TO_TICKS(MACRO_HA_SPOOL_FLUSH_INTERVAL_MS)) {
+        return;
+    }
+    s_spool_last_flush_tick = now;
+    (void)ha_spool_flush();
+}
+
+// Replays the oldest spooled events at home_assistant.spool.drain_per_sec. Failures are paced by
+// the breaker: once it opens, the drain waits for its probe instead of hammering a dead server.
+static void ha_spool_drain_if_due(TickType_t now)
+{
+    if ((int32_t)(now - s_spool_next_drain_tick) < 0 || ha_spool_pending() == 0U) {
+        return;
+    }
+    // Over MQTT the backlog waits for a live connection rather than moving into the RAM outbox.
+    if (MACRO_HA_TRANSPORT_MQTT ? !s_ha_mqtt.connected : ha_transport_offline()) {
+        return;
+    }
+    // Staged records go to flash first so the drain sees one ordered backlog.
+    s_spool_last_flush_tick = now;
+    (void)ha_spool_flush();
+
+    ha_spool_record_t recs[MACRO_HA_BATCH_MAX_EVENTS];
+    ha_event_t events[MACRO_HA_BATCH_MAX_EVENTS];
+    const bool batch = ha_batch_enabled() && !ha_ws_ready();
+    size_t count = ha_spool_peek(recs, batch ? MACRO_HA_BATCH_MAX_EVENTS : 1U);
+    if (count == 0U) {
+        return;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        ha_event_from_record(&recs[i], &events[i]);
+    }
+
+    esp_err_t err = batch ? post_batch(events, count) : process_event(&events[0]);
+    if (err == ESP_ERR_INVALID_SIZE && count > 1U) {
+        count = 1U;
+        err = process_event(&events[0]);
+    }
+    const uint32_t drain_period_ms = 1000U / (uint32_t)MACRO_HA_SPOOL_DRAIN_PER_SEC;
+    if (err != ESP_OK) {
+        s_spool_next_drain_tick = now + pdMS_TO_TICKS(drain_period_ms);
+        return;
+    }
+    ha_spool_consume(count);
+    s_spool_next_drain_tick = now + pdMS_TO_TICKS((uint32_t)count * drain_period_ms);
 }
 
 static void ha_poll_display_if_due(TickType_t now)
 {
-    if (!s_display_runtime_enabled) {
+    // Over MQTT the display entity arrives on its state topic.
+    if (!s_display_runtime_enabled || MACRO_HA_TRANSPORT_MQTT) {
         return;
     }
-    if (now < s_display_next_poll_tick) {
+    // While subscribed HA pushes every change; REST is only needed when a push was lost.
+    if (s_ha_ws.subscribed) {
+        if (!s_ha_ws.refresh_requested) {
+            return;
+        }
+        s_ha_ws.refresh_requested = false;
+    } else if (now < s_display_next_poll_tick) {
         return;
     }
 
     const int poll_ms = (MACRO_HA_DISPLAY_POLL_INTERVAL_MS < 500) ? 500 : MACRO_HA_DISPLAY_POLL_INTERVAL_MS;
     s_display_next_poll_tick = now + pdMS_TO_TICKS((uint32_t)poll_ms);
+    // Skipped while the breaker is open; once its backoff runs out this poll may be the probe.
+    if (!net_breaker_ready(s_breaker)) {
+        return;
+    }
 
     const esp_err_t err = refresh_display_state();
     if (err != ESP_OK) {
@@ -524,20 +1659,20 @@ static void ha_worker_task(void *arg)
     (void)arg;
 
     const TickType_t idle_wait_ticks = pdMS_TO_TICKS(MACRO_HA_WORKER_INTERVAL_MS);
+    TickType_t wait_ticks = idle_wait_ticks;
     s_display_next_poll_tick = xTaskGetTickCount();
 
     while (1) {
-        ha_event_t event = {0};
-        if (xQueueReceive(s_queue, &event, idle_wait_ticks) == pdTRUE) {
-            const esp_err_t err = process_event(&event);
-            if (err != ESP_OK && event.retry_count < MACRO_HA_MAX_RETRY) {
-                event.retry_count++;
-                if (xQueueSend(s_queue, &event, pdMS_TO_TICKS(1)) != pdTRUE) {
-                    ESP_LOGW(TAG, "Retry enqueue failed; event dropped");
-                }
-            }
+        // Producers notify on every push; a burst then goes out as one batch.
+        (void)ulTaskNotifyTake(pdTRUE, wait_ticks);
+        wait_ticks = ha_process_pending() ? 0 : idle_wait_ticks;
+
+        if (ha_spool_is_mounted()) {
+            const TickType_t now = xTaskGetTickCount();
+            ha_spool_flush_if_due(now);
+            ha_spool_drain_if_due(now);
         }
-
+        ha_ws_check_auth();
         ha_poll_display_if_due(xTaskGetTickCount());
     }
 }
@@ -554,32 +1689,52 @@ esp_err_t home_assistant_init(void)
         s_runtime_enabled = false;
         return ESP_OK;
     }
-    if (strlen(CONFIG_MACROPAD_HA_BASE_URL) == 0) {
+    if (MACRO_HA_TRANSPORT_MQTT) {
+        // REST is not used at all; no base URL or bearer token needed.
+        if (strlen(CONFIG_MACROPAD_HA_MQTT_BROKER_URI) == 0) {
+            ESP_LOGW(TAG, "Disabled: empty CONFIG_MACROPAD_HA_MQTT_BROKER_URI");
+            s_runtime_enabled = false;
+            return ESP_OK;
+        }
+    } else if (strlen(CONFIG_MACROPAD_HA_BASE_URL) == 0) {
         ESP_LOGW(TAG, "Disabled: empty CONFIG_MACROPAD_HA_BASE_URL");
         s_runtime_enabled = false;
         return ESP_OK;
     }
 
     normalize_base_url();
-    json_escape_copy(s_device_name_escaped, sizeof(s_device_name_escaped), MACRO_HA_DEVICE_NAME);
     if (strlen(CONFIG_MACROPAD_HA_BEARER_TOKEN) > 0U) {
         (void)snprintf(s_auth_header, sizeof(s_auth_header), "Bearer %s", CONFIG_MACROPAD_HA_BEARER_TOKEN);
     } else {
         s_auth_header[0] = '\0';
     }
 
-    s_queue = xQueueCreate((UBaseType_t)MACRO_HA_QUEUE_SIZE, sizeof(ha_event_t));
-    if (s_queue == NULL) {
+    s_pending = calloc((size_t)MACRO_HA_QUEUE_SIZE, sizeof(ha_event_t));
+    if (s_pending == NULL) {
         return ESP_ERR_NO_MEM;
     }
 
     s_display_lock = xSemaphoreCreateMutex();
     if (s_display_lock == NULL) {
-        vQueueDelete(s_queue);
-        s_queue = NULL;
+        free(s_pending);
+        s_pending = NULL;
         return ESP_ERR_NO_MEM;
     }
 
+    const net_breaker_config_t breaker_cfg = {
+        .failure_threshold = MACRO_HA_BREAKER_FAILURE_THRESHOLD,
+        .base_delay_ms = MACRO_HA_BREAKER_BASE_DELAY_MS,
+        .max_delay_ms = MACRO_HA_BREAKER_MAX_DELAY_MS,
+    };
+    s_breaker = net_breaker_create("home_assistant", &breaker_cfg);
+
+    if (MACRO_HA_SPOOL_ENABLED) {
+        const esp_err_t spool_err = ha_spool_init();
+        if (spool_err != ESP_OK) {
+            ESP_LOGW(TAG, "Offline spool unavailable: %s", esp_err_to_name(spool_err));
+        }
+    }
+
     s_display_runtime_enabled =
         MACRO_HA_DISPLAY_ENABLED &&
         (strlen(MACRO_HA_DISPLAY_ENTITY_ID) > 0U);
@@ -598,18 +1753,38 @@ esp_err_t home_assistant_init(void)
     if (xTaskCreate(ha_worker_task, "ha_worker", HA_TASK_STACK, NULL, HA_TASK_PRIO, &s_task) != pdPASS) {
         vSemaphoreDelete(s_display_lock);
         s_display_lock = NULL;
-        vQueueDelete(s_queue);
-        s_queue = NULL;
+        free(s_pending);
+        s_pending = NULL;
         return ESP_ERR_NO_MEM;
     }
 
+    if (MACRO_HA_TRANSPORT_WEBSOCKET) {
+        const esp_err_t ws_err = ha_ws_start();
+        if (ws_err != ESP_OK) {
+            ESP_LOGW(TAG, "WebSocket transport unavailable (%s); using REST", esp_err_to_name(ws_err));
+        }
+    }
+    if (MACRO_HA_TRANSPORT_MQTT) {
+        const esp_err_t mqtt_err = ha_mqtt_start();
+        if (mqtt_err != ESP_OK) {
+            ESP_LOGE(TAG, "MQTT client failed to start (%s); events will spool", esp_err_to_name(mqtt_err));
+        }
+    }
+
     s_runtime_enabled = true;
     ESP_LOGI(TAG,
-             "ready url=%s queue=%d timeout=%dms retries=%d display=%d control=%d",
-             s_base_url,
+             "ready url=%s queue=%d coalesce=%d batch=%d spool=%d timeout=%dms retries=%d keep_alive=%d websocket=%d "
+             "mqtt=%d display=%d control=%d",
+             MACRO_HA_TRANSPORT_MQTT ? CONFIG_MACROPAD_HA_MQTT_BROKER_URI : s_base_url,
              (int)MACRO_HA_QUEUE_SIZE,
+             MACRO_HA_COALESCE,
+             ha_batch_enabled() ? (int)MACRO_HA_BATCH_MAX_EVENTS : 0,
+             ha_spool_is_mounted() ? 1 : 0,
              (int)MACRO_HA_REQUEST_TIMEOUT_MS,
              (int)MACRO_HA_MAX_RETRY,
+             MACRO_HA_KEEP_ALIVE,
+             (s_ha_ws.client != NULL) ? 1 : 0,
+             (s_ha_mqtt.client != NULL) ? 1 : 0,
              s_display_runtime_enabled ? 1 : 0,
              s_control_runtime_enabled ? 1 : 0);
     return ESP_OK;
@@ -620,6 +1795,20 @@ bool home_assistant_is_enabled(void)
     return s_runtime_enabled;
 }
 
+void home_assistant_get_stats(home_assistant_stats_t *out)
+{
+    if (out == NULL) {
+        return;
+    }
+    portENTER_CRITICAL(&s_stats_lock);
+    *out = s_stats;
+    portEXIT_CRITICAL(&s_stats_lock);
+    out->enabled = s_runtime_enabled;
+    out->ws_authenticated = s_ha_ws.authenticated;
+    out->ws_subscribed = s_ha_ws.subscribed;
+    out->mqtt_connected = s_ha_mqtt.connected;
+}
+
 bool home_assistant_get_display_text(char *out, size_t out_size, uint32_t *age_ms)
 {
     if (out == NULL || out_size == 0U || !s_runtime_enabled || !s_display_runtime_enabled || s_display_lock == NULL) {
@@ -649,10 +1838,7 @@ esp_err_t home_assistant_trigger_default_control(void)
 
     ha_event_t event = {0};
     event.kind = HA_EVT_SERVICE_CALL;
-    strlcpy(event.data.service_call.domain, MACRO_HA_CONTROL_DOMAIN, sizeof(event.data.service_call.domain));
-    strlcpy(event.data.service_call.service, MACRO_HA_CONTROL_SERVICE, sizeof(event.data.service_call.service));
-    strlcpy(event.data.service_call.entity_id, MACRO_HA_CONTROL_ENTITY_ID, sizeof(event.data.service_call.entity_id));
-    queue_event(&event);
+    (void)queue_event(&event);
     return ESP_OK;
 }
 
@@ -664,8 +1850,8 @@ void home_assistant_notify_layer_switch(uint8_t layer_index)
 
     ha_event_t event = {0};
     event.kind = HA_EVT_LAYER_SWITCH;
-    event.data.layer_switch.layer_index = layer_index;
-    queue_event(&event);
+    event.layer_index = layer_index;
+    (void)queue_event(&event);
 }
 
 void home_assistant_notify_key_event(uint8_t layer_index,
@@ -680,12 +1866,12 @@ void home_assistant_notify_key_event(uint8_t layer_index,
 
     ha_event_t event = {0};
     event.kind = HA_EVT_KEY_EVENT;
-    event.data.key_event.layer_index = layer_index;
-    event.data.key_event.key_index = key_index;
-    event.data.key_event.pressed = pressed;
-    event.data.key_event.usage = usage;
-    strlcpy(event.data.key_event.key_name, (key_name != NULL) ? key_name : "", sizeof(event.data.key_event.key_name));
-    queue_event(&event);
+    event.layer_index = layer_index;
+    event.arg = key_index;
+    event.pressed = pressed;
+    event.usage = usage;
+    event.key_name = key_name;
+    (void)queue_event(&event);
 }
 
 void home_assistant_notify_encoder_step(uint8_t layer_index, int32_t steps, uint16_t usage)
@@ -696,10 +1882,10 @@ void home_assistant_notify_encoder_step(uint8_t layer_index, int32_t steps, uint
 
     ha_event_t event = {0};
     event.kind = HA_EVT_ENCODER_STEP;
-    event.data.encoder_step.layer_index = layer_index;
-    event.data.encoder_step.steps = steps;
-    event.data.encoder_step.usage = usage;
-    queue_event(&event);
+    event.layer_index = layer_index;
+    event.steps = steps;
+    event.usage = usage;
+    (void)queue_event(&event);
 }
 
 void home_assistant_notify_touch_swipe(uint8_t layer_index, bool left_to_right, uint16_t usage)
@@ -710,10 +1896,10 @@ void home_assistant_notify_touch_swipe(uint8_t layer_index, bool left_to_right,
 
     ha_event_t event = {0};
     event.kind = HA_EVT_TOUCH_SWIPE;
-    event.data.touch_swipe.layer_index = layer_index;
-    event.data.touch_swipe.left_to_right = left_to_right;
-    event.data.touch_swipe.usage = usage;
-    queue_event(&event);
+    event.layer_index = layer_index;
+    event.arg = left_to_right ? 1U : 0U;
+    event.usage = usage;
+    (void)queue_event(&event);
 }
 
 esp_err_t home_assistant_queue_custom_event(const char *event_suffix, const char *json_payload)
@@ -725,10 +1911,27 @@ esp_err_t home_assistant_queue_custom_event(const char *event_suffix, const char
         return ESP_ERR_INVALID_ARG;
     }
 
+    int slot = -1;
+    portENTER_CRITICAL(&s_pending_lock);
+    for (int i = 0; i < HA_CUSTOM_SLOTS; ++i) {
+        if (!s_custom[i].used) {
+            s_custom[i].used = true;
+            slot = i;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_pending_lock);
+    if (slot < 0) {
+        ha_count_drop();
+        return ESP_ERR_NO_MEM;
+    }
+
+    // The slot is ours until the worker releases it, so the copy needs no lock.
+    strlcpy(s_custom[slot].event_suffix, event_suffix, sizeof(s_custom[slot].event_suffix));
+    strlcpy(s_custom[slot].json_payload, json_payload, sizeof(s_custom[slot].json_payload));
+
     ha_event_t event = {0};
     event.kind = HA_EVT_CUSTOM_JSON;
-    strlcpy(event.data.custom_json.event_suffix, event_suffix, sizeof(event.data.custom_json.event_suffix));
-    strlcpy(event.data.custom_json.json_payload, json_payload, sizeof(event.data.custom_json.json_payload));
-    queue_event(&event);
-    return ESP_OK;
+    event.arg = (uint8_t)slot;
+    return queue_event(&event) ? ESP_OK : ESP_ERR_NO_MEM;
 }
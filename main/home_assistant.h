@@ -6,12 +6,35 @@
 
 #include "esp_err.h"
 
+typedef struct {
+    bool enabled;
+    bool connected;          // the shared client currently holds an open socket
+    uint32_t connects;       // TCP connects, each with a TLS handshake for https
+    uint32_t requests;
+    uint32_t failures;       // transport errors and non-2xx replies
+    uint32_t last_request_us;
+    uint32_t max_request_us;
+    bool ws_authenticated;   // transport websocket: socket up and auth_ok received
+    bool ws_subscribed;      // display entity pushed by HA instead of polled
+    uint32_t ws_connects;
+    uint32_t ws_updates;     // display changes applied from pushes
+    bool mqtt_connected;     // transport mqtt: session with the broker is up
+    uint32_t mqtt_connects;
+    uint32_t mqtt_published; // events handed to the esp-mqtt outbox
+    uint32_t mqtt_updates;   // display changes received on the state topic
+    uint32_t coalesced;      // events merged into one already pending
+    uint32_t dropped;        // events lost to a full queue
+    uint32_t batches;        // webhook POSTs carrying several events
+} home_assistant_stats_t;
+
 esp_err_t home_assistant_init(void);
 bool home_assistant_is_enabled(void);
+void home_assistant_get_stats(home_assistant_stats_t *out);
 bool home_assistant_get_display_text(char *out, size_t out_size, uint32_t *age_ms);
 esp_err_t home_assistant_trigger_default_control(void);
 
 void home_assistant_notify_layer_switch(uint8_t layer_index);
+// key_name is queued by pointer and must outlive the event (keymap config strings do).
 void home_assistant_notify_key_event(uint8_t layer_index,
                                      uint8_t key_index,
                                      bool pressed,
@@ -20,5 +43,6 @@ void home_assistant_notify_key_event(uint8_t layer_index,
 void home_assistant_notify_encoder_step(uint8_t layer_index, int32_t steps, uint16_t usage);
 void home_assistant_notify_touch_swipe(uint8_t layer_index, bool left_to_right, uint16_t usage);
 
-/* Queue a pre-serialized JSON object payload to HA event bus (future extension API). */
+/* Queue a pre-serialized JSON object payload to HA event bus (future extension API).
+ * At most two can be pending; ESP_ERR_NO_MEM when both slots or the queue are full. */
 esp_err_t home_assistant_queue_custom_event(const char *event_suffix, const char *json_payload);
@@ -0,0 +1,465 @@
+#include "json_reader.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define JSON_READER_MAX_LEN 0xFFFFU
+#define JSON_READER_KEY_MAX 48U
+
+typedef enum {
+    EXPECT_VALUE = 0,
+    EXPECT_VALUE_OR_CLOSE,  // right after '['
+    EXPECT_KEY,             // after ',' inside an object
+    EXPECT_KEY_OR_CLOSE,    // right after '{'
+    EXPECT_COLON,
+    EXPECT_COMMA_OR_CLOSE,
+    EXPECT_END,
+} json_reader_state_t;
+
+static inline bool is_ws(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static inline bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// Scans a string body starting after the opening quote; returns the closing quote index or 0.
+static size_t scan_string(const char *json, size_t len, size_t pos)
+{
+    while (pos < len) {
+        const unsigned char c = (unsigned char)json[pos];
+        if (c == '"') {
+            return pos;
+        }
+        if (c < 0x20U) {
+            return 0U;
+        }
+        if (c != '\\') {
+            ++pos;
+            continue;
+        }
+        if (++pos >= len) {
+            return 0U;
+        }
+        switch (json[pos]) {
+        case '"':
+        case '\\':
+        case '/':
+        case 'b':
+        case 'f':
+        case 'n':
+        case 'r':
+        case 't':
+            ++pos;
+            break;
+        case 'u':
+            if (pos + 4U >= len) {
+                return 0U;
+            }
+            for (size_t i = 1; i <= 4U; ++i) {
+                if (hex_value(json[pos + i]) < 0) {
+                    return 0U;
+                }
+            }
+            pos += 5U;
+            break;
+        default:
+            return 0U;
+        }
+    }
+    return 0U;
+}
+
+// Validates a number/true/false/null; returns the index just past it or 0.
+static size_t scan_primitive(const char *json, size_t len, size_t pos)
+{
+    static const char *const words[] = {"true", "false", "null"};
+    for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); ++i) {
+        const size_t n = strlen(words[i]);
+        if (len - pos >= n && memcmp(&json[pos], words[i], n) == 0) {
+            return pos + n;
+        }
+    }
+
+    if (pos < len && json[pos] == '-') {
+        ++pos;
+    }
+    if (pos >= len || !is_digit(json[pos])) {
+        return 0U;
+    }
+    if (json[pos] == '0') {
+        ++pos;
+    } else {
+        while (pos < len && is_digit(json[pos])) {
+            ++pos;
+        }
+    }
+    if (pos < len && json[pos] == '.') {
+        if (++pos >= len || !is_digit(json[pos])) {
+            return 0U;
+        }
+        while (pos < len && is_digit(json[pos])) {
+            ++pos;
+        }
+    }
+    if (pos < len && (json[pos] == 'e' || json[pos] == 'E')) {
+        ++pos;
+        if (pos < len && (json[pos] == '+' || json[pos] == '-')) {
+            ++pos;
+        }
+        if (pos >= len || !is_digit(json[pos])) {
+            return 0U;
+        }
+        while (pos < len && is_digit(json[pos])) {
+            ++pos;
+        }
+    }
+    return pos;
+}
+
+// The enclosing object or array of a token, skipping over object keys.
+static int container_of(const json_tok_t *toks, int tok)
+{
+    int parent = toks[tok].parent;
+    if (parent >= 0 && toks[parent].type == JSON_TOK_STRING) {
+        parent = toks[parent].parent;
+    }
+    return parent;
+}
+
+esp_err_t json_reader_parse(json_doc_t *doc, const char *json, size_t len, json_tok_t *toks, size_t max_toks)
+{
+    if (doc == NULL || json == NULL || toks == NULL || len >= JSON_READER_MAX_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (max_toks > (size_t)INT16_MAX) {
+        max_toks = (size_t)INT16_MAX;
+    }
+    doc->json = json;
+    doc->toks = toks;
+    doc->count = 0;
+
+    json_reader_state_t state = EXPECT_VALUE;
+    int container = -1;  // innermost open object/array
+    int key = -1;        // last key of the innermost object
+    size_t count = 0;
+    size_t pos = 0;
+
+    while (pos < len) {
+        const char c = json[pos];
+        if (is_ws(c)) {
+            ++pos;
+            continue;
+        }
+        if (state == EXPECT_END) {
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        const bool want_value = (state == EXPECT_VALUE || state == EXPECT_VALUE_OR_CLOSE);
+        const bool want_key = (state == EXPECT_KEY || state == EXPECT_KEY_OR_CLOSE);
+
+        if (c == ':') {
+            if (state != EXPECT_COLON) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            state = EXPECT_VALUE;
+            ++pos;
+            continue;
+        }
+        if (c == ',') {
+            if (state != EXPECT_COMMA_OR_CLOSE) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            state = (toks[container].type == JSON_TOK_OBJECT) ? EXPECT_KEY : EXPECT_VALUE;
+            ++pos;
+            continue;
+        }
+        if (c == '}' || c == ']') {
+            const uint8_t type = (c == '}') ? JSON_TOK_OBJECT : JSON_TOK_ARRAY;
+            const bool can_close = (state == EXPECT_COMMA_OR_CLOSE) ||
+                                   (type == JSON_TOK_OBJECT && state == EXPECT_KEY_OR_CLOSE) ||
+                                   (type == JSON_TOK_ARRAY && state == EXPECT_VALUE_OR_CLOSE);
+            if (!can_close || container < 0 || toks[container].type != type) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            toks[container].end = (uint16_t)(pos + 1U);
+            container = container_of(toks, container);
+            state = (container < 0) ? EXPECT_END : EXPECT_COMMA_OR_CLOSE;
+            ++pos;
+            continue;
+        }
+        if (!want_value && !(want_key && c == '"')) {
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        if (count >= max_toks) {
+            return ESP_ERR_NO_MEM;
+        }
+        json_tok_t *tok = &toks[count];
+        memset(tok, 0, sizeof(*tok));
+        if (want_key) {
+            tok->parent = (int16_t)container;
+        } else if (container >= 0 && toks[container].type == JSON_TOK_OBJECT) {
+            tok->parent = (int16_t)key;
+        } else {
+            tok->parent = (int16_t)container;
+        }
+
+        if (c == '{' || c == '[') {
+            tok->type = (c == '{') ? JSON_TOK_OBJECT : JSON_TOK_ARRAY;
+            tok->start = (uint16_t)pos;
+            if (container >= 0 && toks[container].type == JSON_TOK_ARRAY) {
+                ++toks[container].size;
+            }
+            container = (int)count;
+            key = -1;
+            state = (c == '{') ? EXPECT_KEY_OR_CLOSE : EXPECT_VALUE_OR_CLOSE;
+            ++count;
+            ++pos;
+            continue;
+        }
+
+        size_t next = 0;
+        if (c == '"') {
+            const size_t close = scan_string(json, len, pos + 1U);
+            if (close == 0U) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            tok->type = JSON_TOK_STRING;
+            tok->start = (uint16_t)(pos + 1U);
+            tok->end = (uint16_t)close;
+            next = close + 1U;
+        } else {
+            next = scan_primitive(json, len, pos);
+            if (next == 0U || (next < len && !is_ws(json[next]) && json[next] != ',' &&
+                               json[next] != ']' && json[next] != '}')) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            tok->type = JSON_TOK_PRIMITIVE;
+            tok->start = (uint16_t)pos;
+            tok->end = (uint16_t)next;
+        }
+
+        if (want_key) {
+            ++toks[container].size;
+            key = (int)count;
+            state = EXPECT_COLON;
+        } else {
+            if (container >= 0 && toks[container].type == JSON_TOK_ARRAY) {
+                ++toks[container].size;
+            }
+            state = (container < 0) ? EXPECT_END : EXPECT_COMMA_OR_CLOSE;
+        }
+        ++count;
+        pos = next;
+    }
+
+    if (state != EXPECT_END) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    doc->count = (uint16_t)count;
+    return ESP_OK;
+}
+
+static void put_utf8(char *out, size_t *w, uint32_t cp)
+{
+    if (cp < 0x80U) {
+        out[(*w)++] = (char)cp;
+    } else if (cp < 0x800U) {
+        out[(*w)++] = (char)(0xC0U | (cp >> 6));
+        out[(*w)++] = (char)(0x80U | (cp & 0x3FU));
+    } else if (cp < 0x10000U) {
+        out[(*w)++] = (char)(0xE0U | (cp >> 12));
+        out[(*w)++] = (char)(0x80U | ((cp >> 6) & 0x3FU));
+        out[(*w)++] = (char)(0x80U | (cp & 0x3FU));
+    } else {
+        out[(*w)++] = (char)(0xF0U | (cp >> 18));
+        out[(*w)++] = (char)(0x80U | ((cp >> 12) & 0x3FU));
+        out[(*w)++] = (char)(0x80U | ((cp >> 6) & 0x3FU));
+        out[(*w)++] = (char)(0x80U | (cp & 0x3FU));
+    }
+}
+
+static uint32_t read_hex4(const char *p)
+{
+    return ((uint32_t)hex_value(p[0]) << 12) | ((uint32_t)hex_value(p[1]) << 8) |
+           ((uint32_t)hex_value(p[2]) << 4) | (uint32_t)hex_value(p[3]);
+}
+
+bool json_reader_string(const json_doc_t *doc, int tok, char *out, size_t out_size)
+{
+    if (doc == NULL || out == NULL || out_size == 0U || tok < 0 || tok >= doc->count ||
+        doc->toks[tok].type != JSON_TOK_STRING) {
+        return false;
+    }
+    out[0] = '\0';
+
+    const char *p = &doc->json[doc->toks[tok].start];
+    const char *end = &doc->json[doc->toks[tok].end];
+    size_t w = 0;
+    while (p < end) {
+        if (*p != '\\') {
+            if (w + 1U >= out_size) {
+                return false;
+            }
+            out[w++] = *p++;
+            continue;
+        }
+        ++p;
+        char c = *p++;
+        switch (c) {
+        case 'b':
+            c = '\b';
+            break;
+        case 'f':
+            c = '\f';
+            break;
+        case 'n':
+            c = '\n';
+            break;
+        case 'r':
+            c = '\r';
+            break;
+        case 't':
+            c = '\t';
+            break;
+        case 'u': {
+            uint32_t cp = read_hex4(p);
+            p += 4;
+            if (cp >= 0xD800U && cp <= 0xDBFFU && end - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+                const uint32_t lo = read_hex4(&p[2]);
+                if (lo >= 0xDC00U && lo <= 0xDFFFU) {
+                    cp = 0x10000U + ((cp - 0xD800U) << 10) + (lo - 0xDC00U);
+                    p += 6;
+                }
+            }
+            if (cp == 0U) {
+                return false;
+            }
+            if (cp >= 0xD800U && cp <= 0xDFFFU) {
+                cp = '?';
+            }
+            const size_t need = (cp < 0x80U) ? 1U : (cp < 0x800U) ? 2U : (cp < 0x10000U) ? 3U : 4U;
+            if (w + need >= out_size) {
+                return false;
+            }
+            put_utf8(out, &w, cp);
+            continue;
+        }
+        default:
+            break;  // '"', '\\' and '/' stand for themselves
+        }
+        if (w + 1U >= out_size) {
+            return false;
+        }
+        out[w++] = c;
+    }
+    out[w] = '\0';
+    return true;
+}
+
+int json_reader_find(const json_doc_t *doc, int obj, const char *key)
+{
+    if (doc == NULL || key == NULL || obj < 0 || obj >= doc->count || doc->toks[obj].type != JSON_TOK_OBJECT) {
+        return -1;
+    }
+
+    const size_t key_len = strlen(key);
+    const uint16_t obj_end = doc->toks[obj].end;
+    for (int i = obj + 1; i < doc->count && doc->toks[i].start < obj_end; ++i) {
+        const json_tok_t *t = &doc->toks[i];
+        if (t->parent != obj) {
+            continue;
+        }
+        const char *raw = &doc->json[t->start];
+        const size_t raw_len = (size_t)(t->end - t->start);
+        bool match = false;
+        if (memchr(raw, '\\', raw_len) == NULL) {
+            match = (raw_len == key_len) && (memcmp(raw, key, key_len) == 0);
+        } else {
+            char decoded[JSON_READER_KEY_MAX];
+            match = json_reader_string(doc, i, decoded, sizeof(decoded)) && strcmp(decoded, key) == 0;
+        }
+        if (match) {
+            return i + 1;
+        }
+    }
+    return -1;
+}
+
+bool json_reader_int(const json_doc_t *doc, int tok, int *out)
+{
+    if (doc == NULL || out == NULL || tok < 0 || tok >= doc->count || doc->toks[tok].type != JSON_TOK_PRIMITIVE) {
+        return false;
+    }
+
+    // Copied out because the input need not be NUL-terminated.
+    char digits[24];
+    const size_t n = (size_t)(doc->toks[tok].end - doc->toks[tok].start);
+    if (n >= sizeof(digits)) {
+        return false;
+    }
+    memcpy(digits, &doc->json[doc->toks[tok].start], n);
+    digits[n] = '\0';
+
+    char *parsed_end = NULL;
+    const long long v = strtoll(digits, &parsed_end, 10);
+    if (parsed_end != &digits[n] || v < INT_MIN || v > INT_MAX) {
+        return false;
+    }
+    *out = (int)v;
+    return true;
+}
+
+bool json_reader_bool(const json_doc_t *doc, int tok, bool *out)
+{
+    if (doc == NULL || out == NULL || tok < 0 || tok >= doc->count || doc->toks[tok].type != JSON_TOK_PRIMITIVE) {
+        return false;
+    }
+
+    const char *v = &doc->json[doc->toks[tok].start];
+    const size_t n = (size_t)(doc->toks[tok].end - doc->toks[tok].start);
+    // 1/0 are accepted as well; existing clients send them.
+    if ((n == 4U && memcmp(v, "true", 4) == 0) || (n == 1U && v[0] == '1')) {
+        *out = true;
+        return true;
+    }
+    if ((n == 5U && memcmp(v, "false", 5) == 0) || (n == 1U && v[0] == '0')) {
+        *out = false;
+        return true;
+    }
+    return false;
+}
+
+bool json_reader_get_int(const json_doc_t *doc, const char *key, int *out)
+{
+    return json_reader_int(doc, json_reader_find(doc, 0, key), out);
+}
+
+bool json_reader_get_bool(const json_doc_t *doc, const char *key, bool *out)
+{
+    return json_reader_bool(doc, json_reader_find(doc, 0, key), out);
+}
+
+bool json_reader_get_string(const json_doc_t *doc, const char *key, char *out, size_t out_size)
+{
+    return json_reader_string(doc, json_reader_find(doc, 0, key), out, out_size);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+typedef enum {
+    JSON_TOK_OBJECT = 1,
+    JSON_TOK_ARRAY,
+    JSON_TOK_STRING,     // start/end exclude the quotes; escapes are left in place
+    JSON_TOK_PRIMITIVE,  // number, true, false or null
+} json_tok_type_t;
+
+typedef struct {
+    uint8_t type;
+    uint16_t start;
+    uint16_t end;        // exclusive
+    uint16_t size;       // objects: key count, arrays: element count
+    int16_t parent;      // object keys point at the object, object values at their key, -1 for the root
+} json_tok_t;
+
+typedef struct {
+    const char *json;
+    const json_tok_t *toks;
+    uint16_t count;
+} json_doc_t;
+
+// Tokenizes json[0..len) in one pass without allocating. Token 0 is the root value.
+// Returns ESP_ERR_INVALID_ARG for malformed or truncated input and ESP_ERR_NO_MEM when
+// max_toks is too small. Inputs must be shorter than 64 KB.
+esp_err_t json_reader_parse(json_doc_t *doc, const char *json, size_t len, json_tok_t *toks, size_t max_toks);
+
+// Returns the index of the value stored under key in object token obj, or -1.
+int json_reader_find(const json_doc_t *doc, int obj, const char *key);
+
+// Typed reads of a single token; false when the token has another type or does not fit.
+bool json_reader_int(const json_doc_t *doc, int tok, int *out);
+bool json_reader_bool(const json_doc_t *doc, int tok, bool *out);
+// Unescapes into out; strings that do not fit (or contain \u0000) are rejected, not truncated.
+bool json_reader_string(const json_doc_t *doc, int tok, char *out, size_t out_size);
+
+// Shorthands for members of the root object.
+bool json_reader_get_int(const json_doc_t *doc, const char *key, int *out);
+bool json_reader_get_bool(const json_doc_t *doc, const char *key, bool *out);
+bool json_reader_get_string(const json_doc_t *doc, const char *key, char *out, size_t out_size);
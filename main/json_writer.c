@@ -0,0 +1,314 @@
+#include "json_writer.h"
+
+#include <string.h>
+
+static void writer_fail(json_writer_t *w, esp_err_t err)
+{
+    if (w->err == ESP_OK) {
+        w->err = err;
+    }
+}
+
+static bool writer_drain(json_writer_t *w)
+{
+    if (w->flush == NULL) {
+        writer_fail(w, ESP_ERR_INVALID_SIZE);
+        return false;
+    }
+    if (w->len > 0U) {
+        const esp_err_t err = w->flush(w->flush_ctx, w->buf, w->len);
+        w->len = 0U;
+        if (err != ESP_OK) {
+            writer_fail(w, err);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void writer_put(json_writer_t *w, const char *data, size_t len)
+{
+    // Fixed buffers keep one byte back for the terminator.
+    const size_t cap = (w->flush == NULL) ? w->cap - 1U : w->cap;
+
+    while (len > 0U && w->err == ESP_OK) {
+        if (w->len >= cap && !writer_drain(w)) {
+            return;
+        }
+        size_t n = cap - w->len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(&w->buf[w->len], data, n);
+        w->len += n;
+        w->total += n;
+        data += n;
+        len -= n;
+    }
+}
+
+static inline void writer_putc(json_writer_t *w, char c)
+{
+    writer_put(w, &c, 1U);
+}
+
+// Separator bookkeeping shared by every value and key.
+static void writer_value_prefix(json_writer_t *w)
+{
+    if (w->after_key) {
+        w->after_key = false;
+        return;
+    }
+    if (w->depth == 0U) {
+        return;
+    }
+    const uint32_t bit = 1UL << (w->depth - 1U);
+    if ((w->has_items & bit) != 0U) {
+        writer_putc(w, ',');
+    }
+    w->has_items |= bit;
+}
+
+static void writer_string_body(json_writer_t *w, const char *s)
+{
+    static const char hex[] = "0123456789abcdef";
+    const char *run = s;
+
+    for (; *s != '\0'; ++s) {
+        const unsigned char c = (unsigned char)*s;
+        if (c >= 0x20U && c != '"' && c != '\\') {
+            continue;
+        }
+        writer_put(w, run, (size_t)(s - run));
+        run = s + 1;
+
+        char esc[6] = {'\\', 0, 0, 0, 0, 0};
+        size_t esc_len = 2U;
+        switch (c) {
+        case '"':
+        case '\\':
+            esc[1] = (char)c;
+            break;
+        case '\b':
+            esc[1] = 'b';
+            break;
+        case '\f':
+            esc[1] = 'f';
+            break;
+        case '\n':
+            esc[1] = 'n';
+            break;
+        case '\r':
+            esc[1] = 'r';
+            break;
+        case '\t':
+            esc[1] = 't';
+            break;
+        default:
+            esc[1] = 'u';
+            esc[2] = '0';
+            esc[3] = '0';
+            esc[4] = hex[c >> 4];
+            esc[5] = hex[c & 0x0FU];
+            esc_len = 6U;
+            break;
+        }
+        writer_put(w, esc, esc_len);
+    }
+    writer_put(w, run, (size_t)(s - run));
+}
+
+static void writer_digits(json_writer_t *w, bool negative, uint64_t value)
+{
+    char digits[21];
+    size_t pos = sizeof(digits);
+
+    do {
+        digits[--pos] = (char)('0' + (value % 10U));
+        value /= 10U;
+    } while (value != 0U);
+    if (negative) {
+        digits[--pos] = '-';
+    }
+    writer_put(w, &digits[pos], sizeof(digits) - pos);
+}
+
+void json_writer_init(json_writer_t *w, char *buf, size_t cap, json_writer_flush_fn_t flush, void *ctx)
+{
+    if (w == NULL) {
+        return;
+    }
+    memset(w, 0, sizeof(*w));
+    w->buf = buf;
+    w->cap = cap;
+    w->flush = flush;
+    w->flush_ctx = ctx;
+    if (buf == NULL || cap < 2U) {
+        w->err = ESP_ERR_INVALID_ARG;
+        return;
+    }
+    buf[0] = '\0';
+}
+
+esp_err_t json_writer_finish(json_writer_t *w)
+{
+    if (w == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (w->err == ESP_OK && w->depth != 0U) {
+        w->err = ESP_ERR_INVALID_STATE;
+    }
+    if (w->flush == NULL) {
+        if (w->buf != NULL && w->cap > 0U) {
+            w->buf[w->len] = '\0';
+        }
+    } else if (w->err == ESP_OK) {
+        (void)writer_drain(w);
+    }
+    return w->err;
+}
+
+static void writer_open(json_writer_t *w, char c)
+{
+    writer_value_prefix(w);
+    if (w->depth >= JSON_WRITER_MAX_DEPTH) {
+        writer_fail(w, ESP_ERR_INVALID_STATE);
+        return;
+    }
+    writer_putc(w, c);
+    ++w->depth;
+    w->has_items &= ~(1UL << (w->depth - 1U));
+}
+
+static void writer_close(json_writer_t *w, char c)
+{
+    if (w->depth == 0U || w->after_key) {
+        writer_fail(w, ESP_ERR_INVALID_STATE);
+        return;
+    }
+    --w->depth;
+    writer_putc(w, c);
+}
+
+void json_writer_obj_begin(json_writer_t *w)
+{
+    writer_open(w, '{');
+}
+
+void json_writer_obj_end(json_writer_t *w)
+{
+    writer_close(w, '}');
+}
+
+void json_writer_arr_begin(json_writer_t *w)
+{
+    writer_open(w, '[');
+}
+
+void json_writer_arr_end(json_writer_t *w)
+{
+    writer_close(w, ']');
+}
+
+void json_writer_key(json_writer_t *w, const char *key)
+{
+    if (w->after_key || w->depth == 0U || key == NULL) {
+        writer_fail(w, ESP_ERR_INVALID_STATE);
+        return;
+    }
+    writer_value_prefix(w);
+    writer_putc(w, '"');
+    writer_string_body(w, key);
+    writer_put(w, "\":", 2U);
+    w->after_key = true;
+}
+
+void json_writer_str(json_writer_t *w, const char *value)
+{
+    if (value == NULL) {
+        json_writer_null(w);
+        return;
+    }
+    writer_value_prefix(w);
+    writer_putc(w, '"');
+    writer_string_body(w, value);
+    writer_putc(w, '"');
+}
+
+void json_writer_u32(json_writer_t *w, uint32_t value)
+{
+    writer_value_prefix(w);
+    writer_digits(w, false, value);
+}
+
+void json_writer_i32(json_writer_t *w, int32_t value)
+{
+    writer_value_prefix(w);
+    if (value < 0) {
+        writer_digits(w, true, (uint64_t)(-(int64_t)value));
+    } else {
+        writer_digits(w, false, (uint64_t)value);
+    }
+}
+
+void json_writer_u64(json_writer_t *w, uint64_t value)
+{
+    writer_value_prefix(w);
+    writer_digits(w, false, value);
+}
+
+void json_writer_bool(json_writer_t *w, bool value)
+{
+    writer_value_prefix(w);
+    if (value) {
+        writer_put(w, "true", 4U);
+    } else {
+        writer_put(w, "false", 5U);
+    }
+}
+
+void json_writer_null(json_writer_t *w)
+{
+    writer_value_prefix(w);
+    writer_put(w, "null", 4U);
+}
+
+void json_writer_raw(json_writer_t *w, const char *json)
+{
+    if (json == NULL) {
+        json_writer_null(w);
+        return;
+    }
+    writer_value_prefix(w);
+    writer_put(w, json, strlen(json));
+}
+
+void json_writer_kv_str(json_writer_t *w, const char *key, const char *value)
+{
+    json_writer_key(w, key);
+    json_writer_str(w, value);
+}
+
+void json_writer_kv_u32(json_writer_t *w, const char *key, uint32_t value)
+{
+    json_writer_key(w, key);
+    json_writer_u32(w, value);
+}
+
+void json_writer_kv_i32(json_writer_t *w, const char *key, int32_t value)
+{
+    json_writer_key(w, key);
+    json_writer_i32(w, value);
+}
+
+void json_writer_kv_u64(json_writer_t *w, const char *key, uint64_t value)
+{
+    json_writer_key(w, key);
+    json_writer_u64(w, value);
+}
+
+void json_writer_kv_bool(json_writer_t *w, const char *key, bool value)
+{
+    json_writer_key(w, key);
+    json_writer_bool(w, value);
+}
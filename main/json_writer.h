@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#define JSON_WRITER_MAX_DEPTH 32U
+
+// Called whenever the buffer fills up and once more from json_writer_finish().
+typedef esp_err_t (*json_writer_flush_fn_t)(void *ctx, const char *data, size_t len);
+
+typedef struct {
+    char *buf;
+    size_t cap;
+    size_t len;
+    size_t total;              // bytes produced so far, flushed ones included
+    json_writer_flush_fn_t flush;
+    void *flush_ctx;
+    uint32_t has_items;        // bit n: the container at depth n already holds a value
+    uint8_t depth;
+    bool after_key;
+    esp_err_t err;             // first error; later writes are ignored
+} json_writer_t;
+
+// flush == NULL writes into buf only: the output is NUL-terminated and overflow
+// fails with ESP_ERR_INVALID_SIZE instead of truncating.
+void json_writer_init(json_writer_t *w, char *buf, size_t cap, json_writer_flush_fn_t flush, void *ctx);
+// Flushes what is left and returns the first error seen.
+esp_err_t json_writer_finish(json_writer_t *w);
+
+void json_writer_obj_begin(json_writer_t *w);
+void json_writer_obj_end(json_writer_t *w);
+void json_writer_arr_begin(json_writer_t *w);
+void json_writer_arr_end(json_writer_t *w);
+void json_writer_key(json_writer_t *w, const char *key);
+
+// NULL strings are written as null.
+void json_writer_str(json_writer_t *w, const char *value);
+void json_writer_u32(json_writer_t *w, uint32_t value);
+void json_writer_i32(json_writer_t *w, int32_t value);
+void json_writer_u64(json_writer_t *w, uint64_t value);
+void json_writer_bool(json_writer_t *w, bool value);
+void json_writer_null(json_writer_t *w);
+// Writes an already encoded JSON value as-is.
+void json_writer_raw(json_writer_t *w, const char *json);
+
+void json_writer_kv_str(json_writer_t *w, const char *key, const char *value);
+void json_writer_kv_u32(json_writer_t *w, const char *key, uint32_t value);
+void json_writer_kv_i32(json_writer_t *w, const char *key, int32_t value);
+void json_writer_kv_u64(json_writer_t *w, const char *key, uint64_t value);
+void json_writer_kv_bool(json_writer_t *w, const char *key, bool value);
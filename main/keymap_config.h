@@ -30,6 +30,12 @@ typedef struct {
     uint8_t b;
 } macro_rgb_t;
 
+typedef struct {
+    macro_rgb_t indicator;
+    macro_rgb_t key_idle;
+    macro_rgb_t key_active;
+} macro_layer_led_palette_t;
+
 typedef struct {
     uint16_t button_single_usage;
     uint16_t cw_usage;
@@ -45,6 +51,23 @@ typedef struct {
     uint16_t hold_repeat_ms;
 } macro_touch_layer_config_t;
 
+typedef struct {
+    uint16_t frequency_hz;
+    uint16_t duration_ms;
+    uint16_t silence_ms;
+} macro_buzzer_tone_t;
+
+typedef struct {
+    const macro_buzzer_tone_t *tones;
+    uint16_t count;
+} macro_buzzer_melody_t;
+
+typedef struct {
+    const char *tag;
+    uint16_t per_sec;
+    uint16_t burst;
+} macro_log_rate_limit_t;
+
 #define MACRO_KEY_COUNT 12
 #define MACRO_LAYER_COUNT 3
 
@@ -108,6 +131,26 @@ static const macro_rgb_t g_layer_backlight_color[MACRO_LAYER_COUNT] = {
 #define MACRO_LAYER_KEY_DIM_SCALE 45
 #define MACRO_LAYER_KEY_ACTIVE_SCALE 140
 
+// Layer colors pre-scaled by led.* brightness/scale settings (final SK6812 channel values).
+static const macro_layer_led_palette_t g_layer_led_palette[MACRO_LAYER_COUNT] = {
+    {{5, 5, 0}, {0, 0, 0}, {1, 1, 0}},
+    {{0, 5, 0}, {0, 0, 0}, {0, 1, 0}},
+    {{0, 0, 5}, {0, 0, 0}, {0, 0, 1}},
+};
+
+static const macro_rgb_t g_led_status_mounted_color = {0, 2, 0};
+static const macro_rgb_t g_led_status_link_color = {0, 0, 2};
+
+#define MACRO_LED_EFFECTS_ENABLED true
+#define MACRO_LED_EFFECTS_FRAME_RATE_HZ 50
+#define MACRO_LED_EFFECTS_FRAME_BUDGET_US 2000
+#define MACRO_LED_EFFECTS_REACTIVE_FADE_MS 300
+#define MACRO_LED_EFFECTS_LAYER_TRANSITION_MS 250
+#define MACRO_LED_EFFECTS_BREATHING_ENABLED true
+#define MACRO_LED_EFFECTS_BREATHING_AFTER_SEC 30
+#define MACRO_LED_EFFECTS_BREATHING_PERIOD_MS 4000
+#define MACRO_LED_EFFECTS_BREATHING_MIN_PERCENT 20
+
 static const macro_encoder_layer_config_t g_encoder_layer_config[MACRO_LAYER_COUNT] = {
     {HID_USAGE_CONSUMER_PLAY_PAUSE, HID_USAGE_CONSUMER_VOLUME_INCREMENT, HID_USAGE_CONSUMER_VOLUME_DECREMENT},
     {HID_USAGE_CONSUMER_SCAN_NEXT_TRACK, HID_USAGE_CONSUMER_VOLUME_INCREMENT, HID_USAGE_CONSUMER_VOLUME_DECREMENT},
@@ -180,6 +223,60 @@ static const macro_touch_layer_config_t g_touch_layer_config[MACRO_LAYER_COUNT]
 #define MACRO_BUZZER_RTTTL_TOGGLE_ON "bon:d=32,o=6,b=180:g"
 #define MACRO_BUZZER_RTTTL_TOGGLE_OFF "boff:d=32,o=5,b=180:e"
 
+// RTTTL melodies compiled at build time: {frequency_hz (0 = rest), duration_ms, silence_ms}.
+// rtttl_note_gap_ms is already split off each note into silence_ms.
+static const macro_buzzer_tone_t g_buzzer_melody_startup[] = {
+    {1320, 142, 8},
+    {1320, 142, 8},
+    {0, 75, 0},
+    {1320, 292, 8},
+    {1048, 142, 8},
+    {1320, 292, 8},
+    {1568, 292, 8},
+    {0, 300, 0},
+    {784, 292, 8},
+    {0, 300, 0},
+};
+static const macro_buzzer_tone_t g_buzzer_melody_keypress[] = {
+    {1048, 33, 8},
+};
+static const macro_buzzer_tone_t g_buzzer_melody_layer1[] = {
+    {1568, 75, 8},
+};
+static const macro_buzzer_tone_t g_buzzer_melody_layer2[] = {
+    {1568, 75, 8},
+    {1568, 75, 8},
+};
+static const macro_buzzer_tone_t g_buzzer_melody_layer3[] = {
+    {1568, 75, 8},
+    {1568, 75, 8},
+    {1568, 75, 8},
+};
+static const macro_buzzer_tone_t g_buzzer_melody_encoder_cw[] = {
+    {1320, 26, 8},
+};
+static const macro_buzzer_tone_t g_buzzer_melody_encoder_ccw[] = {
+    {1176, 26, 8},
+};
+static const macro_buzzer_tone_t g_buzzer_melody_toggle_on[] = {
+    {1568, 33, 8},
+};
+static const macro_buzzer_tone_t g_buzzer_melody_toggle_off[] = {
+    {660, 33, 8},
+};
+#define MACRO_BUZZER_MELODY_COUNT 9
+static const macro_buzzer_melody_t g_buzzer_melodies[MACRO_BUZZER_MELODY_COUNT] = {
+    {g_buzzer_melody_startup, 10}, // startup
+    {g_buzzer_melody_keypress, 1}, // keypress
+    {g_buzzer_melody_layer1, 1}, // layer1
+    {g_buzzer_melody_layer2, 2}, // layer2
+    {g_buzzer_melody_layer3, 3}, // layer3
+    {g_buzzer_melody_encoder_cw, 1}, // encoder_cw
+    {g_buzzer_melody_encoder_ccw, 1}, // encoder_ccw
+    {g_buzzer_melody_toggle_on, 1}, // toggle_on
+    {g_buzzer_melody_toggle_off, 1}, // toggle_off
+};
+
 #define MACRO_HA_ENABLED true
 #define MACRO_HA_DEVICE_NAME "esp32-macropad"
 #define MACRO_HA_EVENT_PREFIX "macropad"
@@ -187,6 +284,29 @@ static const macro_touch_layer_config_t g_touch_layer_config[MACRO_LAYER_COUNT]
 #define MACRO_HA_QUEUE_SIZE 24
 #define MACRO_HA_WORKER_INTERVAL_MS 30
 #define MACRO_HA_MAX_RETRY 1
+#define MACRO_HA_KEEP_ALIVE true
+#define MACRO_HA_TRANSPORT_WEBSOCKET false
+#define MACRO_HA_TRANSPORT_MQTT false
+#define MACRO_HA_MQTT_TOPIC_PREFIX "macropad"
+#define MACRO_HA_MQTT_DISCOVERY true
+#define MACRO_HA_MQTT_DISCOVERY_PREFIX "homeassistant"
+#define MACRO_HA_MQTT_QOS 1
+#define MACRO_HA_MQTT_KEEPALIVE_SEC 30
+#define MACRO_HA_MQTT_OUTBOX_LIMIT_BYTES 8192
+#define MACRO_HA_MQTT_DISPLAY_STATE_TOPIC ""
+#define MACRO_HA_MQTT_STATESTREAM_PREFIX "homeassistant"
+#define MACRO_HA_COALESCE true
+#define MACRO_HA_BATCH_MAX_EVENTS 8
+#define MACRO_HA_SPOOL_ENABLED true
+#define MACRO_HA_SPOOL_PARTITION_LABEL "cfgstore"
+#define MACRO_HA_SPOOL_OFFSET 786432
+#define MACRO_HA_SPOOL_SIZE 262144
+#define MACRO_HA_SPOOL_MAX_AGE_SEC 86400
+#define MACRO_HA_SPOOL_DRAIN_PER_SEC 5
+#define MACRO_HA_SPOOL_FLUSH_INTERVAL_MS 2000
+#define MACRO_HA_BREAKER_FAILURE_THRESHOLD 3
+#define MACRO_HA_BREAKER_BASE_DELAY_MS 2000
+#define MACRO_HA_BREAKER_MAX_DELAY_MS 120000
 #define MACRO_HA_PUBLISH_LAYER_SWITCH true
 #define MACRO_HA_PUBLISH_KEY_EVENT false
 #define MACRO_HA_PUBLISH_ENCODER_STEP false
@@ -209,6 +329,38 @@ static const macro_touch_layer_config_t g_touch_layer_config[MACRO_LAYER_COUNT]
 #define MACRO_WEB_SERVICE_SEND_TIMEOUT_SEC 5
 #define MACRO_WEB_SERVICE_CORS_ENABLED true
 #define MACRO_WEB_SERVICE_CONTROL_ENABLED false
+#define MACRO_WEB_SERVICE_LOG_STREAM_MAX_CLIENTS 2
+#define MACRO_WEB_SERVICE_STATE_STREAM_MAX_CLIENTS 2
+
+#define MACRO_LOG_STORE_BINARY_ENABLED true
+#define MACRO_LOG_STORE_RING_BYTES 46080
+#define MACRO_LOG_STORE_STAGING_BYTES 4096
+#define MACRO_LOG_STORE_RTC_ENABLED true
+#define MACRO_LOG_STORE_RTC_BYTES 4096
+#define MACRO_LOG_STORE_DRAIN_PERIOD_MS 20
+#define MACRO_LOG_STORE_COLLAPSE true
+#define MACRO_LOG_STORE_COLLAPSE_TEMPLATE false
+#define MACRO_LOG_STORE_RATE_LIMIT_COUNT 0
+static const macro_log_rate_limit_t g_log_store_rate_limits[] = {
+    {NULL, 0, 0},
+};
+
+#define MACRO_LOG_ARCHIVE_ENABLED true
+#define MACRO_LOG_ARCHIVE_PARTITION_LABEL "cfgstore"
+#define MACRO_LOG_ARCHIVE_OFFSET 0
+#define MACRO_LOG_ARCHIVE_SIZE 786432
+#define MACRO_LOG_ARCHIVE_FLUSH_INTERVAL_SEC 30
+
+#define MACRO_PROFILER_ENABLED true
+#define MACRO_PROFILER_WINDOW_SEC 10
+#define MACRO_PROFILER_TOP_SCOPES 5
+
+#define MACRO_TRACE_ENABLED true
+#define MACRO_TRACE_BUFFER_RECORDS 4096
+
+#define MACRO_BENCH_ENABLED true
+#define MACRO_BENCH_SAMPLES 200
+#define MACRO_BENCH_BLOCKING_SAMPLES 20
 
 #define MACRO_OTA_ENABLED true
 #define MACRO_OTA_ALLOW_HTTP true
@@ -217,6 +369,10 @@ static const macro_touch_layer_config_t g_touch_layer_config[MACRO_LAYER_COUNT]
 #define MACRO_OTA_CONFIRM_TIMEOUT_SEC 120
 #define MACRO_OTA_SELF_CHECK_DURATION_MS 2000
 #define MACRO_OTA_SELF_CHECK_MIN_HEAP_BYTES 65536
+#define MACRO_OTA_DOWNLOAD_ATTEMPTS 3
+#define MACRO_OTA_BREAKER_FAILURE_THRESHOLD 1
+#define MACRO_OTA_BREAKER_BASE_DELAY_MS 5000
+#define MACRO_OTA_BREAKER_MAX_DELAY_MS 300000
 
 #define MACRO_TOUCH_TRIGGER_PERCENT 85
 #define MACRO_TOUCH_RELEASE_PERCENT 92
@@ -0,0 +1,373 @@
+#include "led_effects.h"
+
+#include <string.h>
+
+#include "freertos/task.h"
+
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "led_strip.h"
+
+#include "keymap_config.h"
+#include "profiler.h"
+
+#define TAG "LED_FX"
+
+#define LED_STRIP_GPIO GPIO_NUM_38
+#define LED_STRIP_COUNT 15
+#define LED_FX_TASK_STACK 3072
+#define LED_FX_TASK_PRIO 3
+// One DMA buffer holds a whole 15 x 24-bit SK6812 frame plus reset slot.
+#define LED_FX_RMT_DMA_SYMBOLS 512
+#define LED_FX_Q8_ONE 256U
+// After a frame overruns its budget, animations are suspended for this many frame periods.
+#define LED_FX_DEGRADE_FRAMES 50U
+
+_Static_assert(MACRO_KEY_COUNT <= 16, "led_effects_input_t.key_mask holds at most 16 keys");
+
+// Everything that decides whether a static frame can be reused.
+typedef struct {
+    uint16_t key_mask;
+    uint8_t layer;
+    bool mounted;
+    bool link_ready;
+    bool idle_off;
+    bool breathing;
+} led_fx_frame_key_t;
+
+typedef struct {
+    led_strip_handle_t strip;
+    TaskHandle_t task;
+    portMUX_TYPE lock;
+
+    // Written by led_effects_set_input() (input_task), read by the LED task under lock.
+    led_effects_input_t input;
+    uint16_t press_latch;
+    bool input_valid;
+
+    // LED task only.
+    uint8_t frames[2][LED_STRIP_COUNT][3];
+    uint8_t front;
+    bool front_valid;
+    bool refresh_pending;
+    led_fx_frame_key_t last_key;
+    bool last_key_valid;
+    bool animating;
+    uint16_t key_fade_q8[MACRO_KEY_COUNT];
+    uint8_t layer;
+    uint8_t prev_layer;
+    TickType_t layer_switch_tick;
+    uint32_t degrade_frames_left;
+
+    // Written by the LED task under lock.
+    led_effects_stats_t stats;
+} led_fx_ctx_t;
+
+static led_fx_ctx_t s_fx = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static uint32_t led_fx_frame_ms(void)
+{
+    const uint32_t hz = (MACRO_LED_EFFECTS_FRAME_RATE_HZ > 0) ? (uint32_t)MACRO_LED_EFFECTS_FRAME_RATE_HZ : 50U;
+    const uint32_t ms = 1000U / hz;
+    return (ms > 0U) ? ms : 1U;
+}
+
+static uint16_t led_fx_fade_step_q8(void)
+{
+    if (MACRO_LED_EFFECTS_REACTIVE_FADE_MS <= 0) {
+        return LED_FX_Q8_ONE;
+    }
+    const uint32_t step = (LED_FX_Q8_ONE * led_fx_frame_ms()) / (uint32_t)MACRO_LED_EFFECTS_REACTIVE_FADE_MS;
+    return (uint16_t)((step > 0U) ? step : 1U);
+}
+
+static macro_rgb_t led_fx_mix(const macro_rgb_t *a, const macro_rgb_t *b, uint32_t t_q8)
+{
+    const uint32_t inv = LED_FX_Q8_ONE - t_q8;
+    return (macro_rgb_t){
+        .r = (uint8_t)((((uint32_t)a->r * inv) + ((uint32_t)b->r * t_q8)) >> 8),
+        .g = (uint8_t)((((uint32_t)a->g * inv) + ((uint32_t)b->g * t_q8)) >> 8),
+        .b = (uint8_t)((((uint32_t)a->b * inv) + ((uint32_t)b->b * t_q8)) >> 8),
+    };
+}
+
+static inline void led_fx_put(uint8_t pixel[3], const macro_rgb_t *color, uint32_t level_q8)
+{
+    pixel[0] = (uint8_t)(((uint32_t)color->r * level_q8) >> 8);
+    pixel[1] = (uint8_t)(((uint32_t)color->g * level_q8) >> 8);
+    pixel[2] = (uint8_t)(((uint32_t)color->b * level_q8) >> 8);
+}
+
+// Eased triangle wave in Q8, floor at breathing_min_percent.
+static uint32_t led_fx_breath_level_q8(uint32_t idle_ms)
+{
+    const uint32_t period = (MACRO_LED_EFFECTS_BREATHING_PERIOD_MS > 0) ? (uint32_t)MACRO_LED_EFFECTS_BREATHING_PERIOD_MS : 4000U;
+    const uint32_t phase = ((idle_ms % period) * 512U) / period;
+    const uint32_t tri = (phase < 256U) ? phase : (511U - phase);
+    const uint32_t eased = (tri * tri) >> 8;
+    const uint32_t floor_q8 = ((uint32_t)MACRO_LED_EFFECTS_BREATHING_MIN_PERCENT * LED_FX_Q8_ONE) / 100U;
+    return floor_q8 + (((LED_FX_Q8_ONE - floor_q8) * eased) >> 8);
+}
+
+static bool led_fx_frame_key_equal(const led_fx_frame_key_t *a, const led_fx_frame_key_t *b)
+{
+    return a->key_mask == b->key_mask &&
+           a->layer == b->layer &&
+           a->mounted == b->mounted &&
+           a->link_ready == b->link_ready &&
+           a->idle_off == b->idle_off &&
+           a->breathing == b->breathing;
+}
+
+// Renders one frame; returns true while any effect is still in motion.
+static bool led_fx_render(const led_effects_input_t *in,
+                          const led_fx_frame_key_t *key,
+                          uint16_t press_edges,
+                          TickType_t now,
+                          uint8_t frame[LED_STRIP_COUNT][3])
+{
+    PROF_SCOPE(PROF_SCOPE_LED_RENDER);
+    memset(frame, 0, LED_STRIP_COUNT * 3U);
+
+    if (in->layer != s_fx.layer) {
+        s_fx.prev_layer = s_fx.layer;
+        s_fx.layer = in->layer;
+        s_fx.layer_switch_tick = now;
+    }
+
+    if (key->idle_off) {
+        memset(s_fx.key_fade_q8, 0, sizeof(s_fx.key_fade_q8));
+        s_fx.prev_layer = s_fx.layer;
+        return false;
+    }
+
+    const bool effects = MACRO_LED_EFFECTS_ENABLED && s_fx.degrade_frames_left == 0U;
+    bool animating = false;
+
+    uint32_t layer_t_q8 = LED_FX_Q8_ONE;
+    if (effects && MACRO_LED_EFFECTS_LAYER_TRANSITION_MS > 0 && s_fx.prev_layer != s_fx.layer) {
+        const uint32_t elapsed_ms = pdTICKS_TO_MS(now - s_fx.layer_switch_tick);
+        if (elapsed_ms < (uint32_t)MACRO_LED_EFFECTS_LAYER_TRANSITION_MS) {
+            layer_t_q8 = (elapsed_ms * LED_FX_Q8_ONE) / (uint32_t)MACRO_LED_EFFECTS_LAYER_TRANSITION_MS;
+            animating = true;
+        }
+    }
+    if (layer_t_q8 >= LED_FX_Q8_ONE) {
+        s_fx.prev_layer = s_fx.layer;
+    }
+
+    const macro_layer_led_palette_t *from = &g_layer_led_palette[s_fx.prev_layer];
+    const macro_layer_led_palette_t *to = &g_layer_led_palette[s_fx.layer];
+    const macro_rgb_t indicator = led_fx_mix(&from->indicator, &to->indicator, layer_t_q8);
+    const macro_rgb_t key_idle = led_fx_mix(&from->key_idle, &to->key_idle, layer_t_q8);
+    const macro_rgb_t key_active = led_fx_mix(&from->key_active, &to->key_active, layer_t_q8);
+
+    if (key->mounted) {
+        led_fx_put(frame[0], &g_led_status_mounted_color, LED_FX_Q8_ONE);
+    }
+    if (key->link_ready) {
+        led_fx_put(frame[1], &g_led_status_link_color, LED_FX_Q8_ONE);
+    }
+    led_fx_put(frame[2], &indicator, LED_FX_Q8_ONE);
+
+    uint32_t idle_level_q8 = LED_FX_Q8_ONE;
+    if (effects && key->breathing) {
+        idle_level_q8 = led_fx_breath_level_q8(pdTICKS_TO_MS(now - in->last_activity_tick));
+        animating = true;
+    }
+
+    const uint16_t fade_step = led_fx_fade_step_q8();
+    const uint16_t lit_mask = in->key_mask | press_edges;
+    for (size_t i = 0; i < MACRO_KEY_COUNT; ++i) {
+        const bool pressed = (lit_mask & (uint16_t)(1U << i)) != 0U;
+        uint16_t fade = s_fx.key_fade_q8[i];
+        if (pressed || !effects) {
+            fade = pressed ? (uint16_t)LED_FX_Q8_ONE : 0U;
+        } else if (fade > 0U) {
+            fade = (fade > fade_step) ? (uint16_t)(fade - fade_step) : 0U;
+        }
+        s_fx.key_fade_q8[i] = fade;
+        if (!pressed && fade > 0U) {
+            animating = true;
+        }
+
+        const macro_action_config_t *cfg = &g_macro_keymap_layers[s_fx.layer][i];
+        if (cfg->led_index >= LED_STRIP_COUNT) {
+            continue;
+        }
+        const macro_rgb_t color = led_fx_mix(&key_idle, &key_active, fade);
+        led_fx_put(frame[cfg->led_index], &color, (fade > 0U) ? LED_FX_Q8_ONE : idle_level_q8);
+    }
+
+    return animating;
+}
+
+static esp_err_t led_fx_push(uint8_t back)
+{
+    // The strip's pixel buffer is the DMA source; never touch it while a transfer is in flight.
+    if (s_fx.refresh_pending) {
+        ESP_RETURN_ON_ERROR(led_strip_refresh_wait_done(s_fx.strip), TAG, "wait refresh failed");
+        s_fx.refresh_pending = false;
+    }
+
+    const uint8_t (*next)[3] = s_fx.frames[back];
+    const uint8_t (*prev)[3] = s_fx.frames[s_fx.front];
+    for (size_t i = 0; i < LED_STRIP_COUNT; ++i) {
+        if (!s_fx.front_valid || memcmp(next[i], prev[i], 3U) != 0) {
+            ESP_RETURN_ON_ERROR(led_strip_set_pixel(s_fx.strip, i, next[i][0], next[i][1], next[i][2]),
+                                TAG, "set led %u failed", (unsigned)i);
+        }
+    }
+
+    ESP_RETURN_ON_ERROR(led_strip_refresh_async(s_fx.strip), TAG, "refresh failed");
+    s_fx.refresh_pending = true;
+    s_fx.front = back;
+    s_fx.front_valid = true;
+    return ESP_OK;
+}
+
+static void led_fx_task(void *arg)
+{
+    (void)arg;
+    const TickType_t frame_ticks = (pdMS_TO_TICKS(led_fx_frame_ms()) > 0) ? pdMS_TO_TICKS(led_fx_frame_ms()) : 1;
+    const TickType_t off_timeout_ticks = pdMS_TO_TICKS((uint32_t)MACRO_LED_OFF_TIMEOUT_SEC * 1000U);
+    const TickType_t breathing_after_ticks = pdMS_TO_TICKS((uint32_t)MACRO_LED_EFFECTS_BREATHING_AFTER_SEC * 1000U);
+    TickType_t last_wake = xTaskGetTickCount();
+
+    while (true) {
+        vTaskDelayUntil(&last_wake, frame_ticks);
+        const TickType_t now = xTaskGetTickCount();
+        if (s_fx.degrade_frames_left > 0U && --s_fx.degrade_frames_left == 0U) {
+            // Re-render once so effects resume even if nothing else changes.
+            s_fx.animating = true;
+        }
+
+        led_effects_input_t in;
+        uint16_t press_edges;
+        bool valid;
+        portENTER_CRITICAL(&s_fx.lock);
+        in = s_fx.input;
+        press_edges = s_fx.press_latch;
+        s_fx.press_latch = 0;
+        valid = s_fx.input_valid;
+        portEXIT_CRITICAL(&s_fx.lock);
+        if (!valid) {
+            continue;
+        }
+
+        const TickType_t idle_ticks = now - in.last_activity_tick;
+        const led_fx_frame_key_t key = {
+            .key_mask = in.key_mask,
+            .layer = in.layer,
+            .mounted = in.mounted,
+            .link_ready = in.link_ready,
+            .idle_off = (off_timeout_ticks > 0) && (idle_ticks >= off_timeout_ticks),
+            .breathing = MACRO_LED_EFFECTS_BREATHING_ENABLED && (idle_ticks >= breathing_after_ticks),
+        };
+        if (!s_fx.animating && press_edges == 0U && s_fx.last_key_valid &&
+            led_fx_frame_key_equal(&key, &s_fx.last_key)) {
+            continue;
+        }
+        s_fx.last_key = key;
+        s_fx.last_key_valid = true;
+
+        const int64_t start_us = esp_timer_get_time();
+        const uint8_t back = (uint8_t)(s_fx.front ^ 1U);
+        s_fx.animating = led_fx_render(&in, &key, press_edges, now, s_fx.frames[back]);
+
+        bool pushed = false;
+        if (!s_fx.front_valid || memcmp(s_fx.frames[back], s_fx.frames[s_fx.front], sizeof(s_fx.frames[back])) != 0) {
+            const esp_err_t err = led_fx_push(back);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "LED push failed: %s", esp_err_to_name(err));
+            } else {
+                pushed = true;
+            }
+        }
+
+        const uint32_t frame_us = (uint32_t)(esp_timer_get_time() - start_us);
+        const bool overrun = frame_us > (uint32_t)MACRO_LED_EFFECTS_FRAME_BUDGET_US;
+        if (overrun) {
+            s_fx.degrade_frames_left = LED_FX_DEGRADE_FRAMES;
+        }
+
+        portENTER_CRITICAL(&s_fx.lock);
+        ++s_fx.stats.frames_rendered;
+        if (pushed) {
+            ++s_fx.stats.refreshes;
+        }
+        if (overrun) {
+            ++s_fx.stats.budget_overruns;
+        }
+        s_fx.stats.last_frame_us = frame_us;
+        if (frame_us > s_fx.stats.max_frame_us) {
+            s_fx.stats.max_frame_us = frame_us;
+        }
+        s_fx.stats.degraded = s_fx.degrade_frames_left > 0U;
+        portEXIT_CRITICAL(&s_fx.lock);
+    }
+}
+
+esp_err_t led_effects_init(void)
+{
+    if (s_fx.strip != NULL) {
+        return ESP_OK;
+    }
+
+    const led_strip_config_t strip_cfg = {
+        .strip_gpio_num = LED_STRIP_GPIO,
+        .max_leds = LED_STRIP_COUNT,
+        .led_model = LED_MODEL_SK6812,
+        .flags.invert_out = false,
+    };
+    const led_strip_rmt_config_t rmt_cfg = {
+        .resolution_hz = 10 * 1000 * 1000,
+        .mem_block_symbols = LED_FX_RMT_DMA_SYMBOLS,
+        .flags.with_dma = true,
+    };
+    ESP_RETURN_ON_ERROR(led_strip_new_rmt_device(&strip_cfg, &rmt_cfg, &s_fx.strip), TAG, "led strip init failed");
+
+    s_fx.layer = s_fx.input.layer;
+    s_fx.prev_layer = s_fx.input.layer;
+    if (xTaskCreate(led_fx_task, "led_fx", LED_FX_TASK_STACK, NULL, LED_FX_TASK_PRIO, &s_fx.task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    portENTER_CRITICAL(&s_fx.lock);
+    s_fx.stats.running = true;
+    portEXIT_CRITICAL(&s_fx.lock);
+    ESP_LOGI(TAG,
+             "LED effects task started: %u Hz, budget %u us, effects %s",
+             (unsigned)(1000U / led_fx_frame_ms()),
+             (unsigned)MACRO_LED_EFFECTS_FRAME_BUDGET_US,
+             MACRO_LED_EFFECTS_ENABLED ? "on" : "off");
+    return ESP_OK;
+}
+
+void led_effects_set_input(const led_effects_input_t *input)
+{
+    if (input == NULL) {
+        return;
+    }
+
+    portENTER_CRITICAL(&s_fx.lock);
+    // Latch rising edges so a tap shorter than one frame still starts a fade.
+    s_fx.press_latch |= (uint16_t)(input->key_mask & (uint16_t)~s_fx.input.key_mask);
+    s_fx.input = *input;
+    s_fx.input_valid = true;
+    portEXIT_CRITICAL(&s_fx.lock);
+}
+
+void led_effects_get_stats(led_effects_stats_t *out_stats)
+{
+    if (out_stats == NULL) {
+        return;
+    }
+
+    portENTER_CRITICAL(&s_fx.lock);
+    *out_stats = s_fx.stats;
+    portEXIT_CRITICAL(&s_fx.lock);
+}
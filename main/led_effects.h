@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "esp_err.h"
+
+typedef struct {
+    uint16_t key_mask;
+    uint8_t layer;
+    bool mounted;
+    bool link_ready;
+    TickType_t last_activity_tick;
+} led_effects_input_t;
+
+typedef struct {
+    bool running;
+    uint32_t frames_rendered;
+    uint32_t refreshes;
+    uint32_t budget_overruns;
+    uint32_t last_frame_us;
+    uint32_t max_frame_us;
+    bool degraded;
+} led_effects_stats_t;
+
+esp_err_t led_effects_init(void);
+// Called from the scan loop; only copies the input snapshot, rendering happens on the LED task.
+void led_effects_set_input(const led_effects_input_t *input);
+void led_effects_get_stats(led_effects_stats_t *out_stats);
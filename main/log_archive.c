@@ -0,0 +1,600 @@
+#include "log_archive.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_log_timestamp.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_system.h"
+
+#include "keymap_config.h"
+#include "log_store.h"
+
+#define TAG "LOG_ARCHIVE"
+
+#define LOG_ARCHIVE_SECTOR_SIZE 4096U
+#define LOG_ARCHIVE_MAX_SECTORS 256U
+#define LOG_ARCHIVE_SECTOR_MAGIC 0x3141474CU
+#define LOG_ARCHIVE_BLOCK_MAGIC 0x4C42U
+#define LOG_ARCHIVE_ERASED_MAGIC 0xFFFFU
+#define LOG_ARCHIVE_RAW_MAX 3072U
+#define LOG_ARCHIVE_COMP_MAX (LOG_ARCHIVE_RAW_MAX + (LOG_ARCHIVE_RAW_MAX / 8U) + 8U)
+#define LOG_ARCHIVE_HASH_BITS 10U
+#define LOG_ARCHIVE_NO_SEQ UINT32_MAX
+#define LOG_ARCHIVE_TASK_STACK 4096U
+#define LOG_ARCHIVE_TASK_PRIO 1U
+#define LOG_ARCHIVE_LOCK_TIMEOUT_MS 2000U
+
+// LZSS: a flag byte precedes every 8 items; a set bit is a 2-byte match (12-bit offset, 4-bit length).
+#define LZ_MIN_MATCH 3U
+#define LZ_MAX_MATCH 18U
+#define LZ_WINDOW 4095U
+
+#if (MACRO_LOG_ARCHIVE_SIZE / 4096) > 256
+#error "log_archive.size must not exceed 256 sectors"
+#endif
+
+typedef struct {
+    uint32_t magic;
+    uint32_t sector_seq;
+    uint32_t erase_count;
+    uint32_t crc;
+} log_archive_sector_hdr_t;
+
+typedef struct {
+    uint16_t magic;
+    uint16_t comp_len;
+    uint16_t raw_len;
+    uint16_t line_count;
+    uint32_t first_seq;
+    uint32_t first_epoch;  // 0 when wall time was not synced
+    uint32_t data_crc;
+    uint32_t hdr_crc;
+} log_archive_block_hdr_t;
+
+// RAM index entry per flash sector, rebuilt from sector and first-block headers at mount.
+typedef struct {
+    uint32_t sector_seq;      // 0 = erased or invalid
+    uint32_t first_line_seq;  // LOG_ARCHIVE_NO_SEQ while the sector holds no block
+    uint32_t first_epoch;
+    uint32_t erase_count;
+} log_archive_sector_t;
+
+typedef struct {
+    bool initialized;
+    SemaphoreHandle_t lock;
+    TaskHandle_t task;
+    const esp_partition_t *part;
+    uint32_t sector_count;
+    uint32_t head_sector;
+    uint32_t head_offset;
+    uint32_t next_sector_seq;
+    uint32_t next_line_seq;
+    log_store_cursor_t cursor;
+    uint32_t blocks_written;
+    uint32_t raw_bytes;
+    uint32_t stored_bytes;
+    uint32_t lines_missed;
+    uint32_t raw_len;
+    uint32_t raw_lines;
+    uint32_t raw_first_seq;
+    uint32_t raw_first_epoch;
+    log_archive_sector_t sectors[LOG_ARCHIVE_MAX_SECTORS];
+    uint16_t lz_hash[1U << LOG_ARCHIVE_HASH_BITS];
+    char raw[LOG_ARCHIVE_RAW_MAX];
+    uint8_t block[sizeof(log_archive_block_hdr_t) + LOG_ARCHIVE_COMP_MAX];
+} log_archive_state_t;
+
+static log_archive_state_t s_archive = {0};
+
+static inline uint32_t align4(uint32_t v)
+{
+    return (v + 3U) & ~3U;
+}
+
+static inline uint32_t sector_addr(uint32_t index)
+{
+    return (uint32_t)MACRO_LOG_ARCHIVE_OFFSET + (index * LOG_ARCHIVE_SECTOR_SIZE);
+}
+
+static uint32_t sector_hdr_crc(const log_archive_sector_hdr_t *hdr)
+{
+    return esp_rom_crc32_le(0U, (const uint8_t *)hdr, (uint32_t)offsetof(log_archive_sector_hdr_t, crc));
+}
+
+static uint32_t block_hdr_crc(const log_archive_block_hdr_t *hdr)
+{
+    return esp_rom_crc32_le(0U, (const uint8_t *)hdr, (uint32_t)offsetof(log_archive_block_hdr_t, hdr_crc));
+}
+
+static bool block_hdr_valid(const log_archive_block_hdr_t *hdr)
+{
+    return hdr->magic == LOG_ARCHIVE_BLOCK_MAGIC &&
+           hdr->hdr_crc == block_hdr_crc(hdr) &&
+           hdr->comp_len <= LOG_ARCHIVE_COMP_MAX &&
+           hdr->raw_len <= LOG_ARCHIVE_RAW_MAX &&
+           hdr->line_count > 0U;
+}
+
+static size_t lz_compress(const uint8_t *in, size_t in_len, uint8_t *out, uint16_t *hash)
+{
+    memset(hash, 0xFF, sizeof(uint16_t) << LOG_ARCHIVE_HASH_BITS);
+    size_t ip = 0;
+    size_t op = 0;
+    size_t flag_pos = 0;
+    uint32_t bit = 8U;
+    while (ip < in_len) {
+        if (bit == 8U) {
+            flag_pos = op++;
+            out[flag_pos] = 0U;
+            bit = 0U;
+        }
+
+        size_t match_len = 0;
+        size_t match_off = 0;
+        if ((ip + LZ_MIN_MATCH) <= in_len) {
+            const uint32_t key = ((uint32_t)in[ip] << 16) | ((uint32_t)in[ip + 1U] << 8) | in[ip + 2U];
+            const uint32_t h = (key * 2654435761U) >> (32U - LOG_ARCHIVE_HASH_BITS);
+            const uint16_t cand = hash[h];
+            hash[h] = (uint16_t)ip;
+            if (cand != 0xFFFFU && (ip - cand) <= LZ_WINDOW) {
+                const size_t max_len = ((in_len - ip) < LZ_MAX_MATCH) ? (in_len - ip) : LZ_MAX_MATCH;
+                while (match_len < max_len && in[cand + match_len] == in[ip + match_len]) {
+                    match_len++;
+                }
+                match_off = ip - cand;
+            }
+        }
+
+        if (match_len >= LZ_MIN_MATCH) {
+            out[flag_pos] |= (uint8_t)(1U << bit);
+            out[op++] = (uint8_t)(match_off & 0xFFU);
+            out[op++] = (uint8_t)(((match_off >> 8) << 4) | (match_len - LZ_MIN_MATCH));
+            ip += match_len;
+        } else {
+            out[op++] = in[ip++];
+        }
+        bit++;
+    }
+    return op;
+}
+
+static bool lz_decompress(const uint8_t *in, size_t in_len, uint8_t *out, size_t out_len)
+{
+    size_t ip = 0;
+    size_t op = 0;
+    while (op < out_len) {
+        if (ip >= in_len) {
+            return false;
+        }
+        const uint8_t flags = in[ip++];
+        for (uint32_t bit = 0; bit < 8U && op < out_len; ++bit) {
+            if ((flags & (1U << bit)) == 0U) {
+                if (ip >= in_len) {
+                    return false;
+                }
+                out[op++] = in[ip++];
+                continue;
+            }
+            if ((ip + 2U) > in_len) {
+                return false;
+            }
+            const size_t off = (size_t)in[ip] | ((size_t)(in[ip + 1U] >> 4) << 8);
+            const size_t len = (size_t)(in[ip + 1U] & 0x0FU) + LZ_MIN_MATCH;
+            ip += 2U;
+            if (off == 0U || off > op || (op + len) > out_len) {
+                return false;
+            }
+            for (size_t i = 0; i < len; ++i, ++op) {
+                out[op] = out[op - off];
+            }
+        }
+    }
+    return true;
+}
+
+// Erasing the next sector in ring order is the only erase path, so wear is spread evenly.
+static esp_err_t sector_open_locked(uint32_t index)
+{
+    log_archive_sector_t *sec = &s_archive.sectors[index];
+    const uint32_t addr = sector_addr(index);
+    sec->sector_seq = 0U;
+    sec->first_line_seq = LOG_ARCHIVE_NO_SEQ;
+    sec->first_epoch = 0U;
+    ESP_RETURN_ON_ERROR(esp_partition_erase_range(s_archive.part, addr, LOG_ARCHIVE_SECTOR_SIZE),
+                        TAG, "erase sector %lu failed", (unsigned long)index);
+
+    log_archive_sector_hdr_t hdr = {
+        .magic = LOG_ARCHIVE_SECTOR_MAGIC,
+        .sector_seq = s_archive.next_sector_seq++,
+        .erase_count = sec->erase_count + 1U,
+    };
+    hdr.crc = sector_hdr_crc(&hdr);
+    ESP_RETURN_ON_ERROR(esp_partition_write(s_archive.part, addr, &hdr, sizeof(hdr)),
+                        TAG, "sector header write failed");
+
+    sec->sector_seq = hdr.sector_seq;
+    sec->erase_count = hdr.erase_count;
+    s_archive.head_sector = index;
+    s_archive.head_offset = sizeof(hdr);
+    return ESP_OK;
+}
+
+static esp_err_t write_block_locked(void)
+{
+    if (s_archive.raw_lines == 0U) {
+        return ESP_OK;
+    }
+
+    log_archive_block_hdr_t *hdr = (log_archive_block_hdr_t *)s_archive.block;
+    uint8_t *payload = &s_archive.block[sizeof(*hdr)];
+    const size_t comp_len = lz_compress((const uint8_t *)s_archive.raw, s_archive.raw_len, payload, s_archive.lz_hash);
+    *hdr = (log_archive_block_hdr_t){
+        .magic = LOG_ARCHIVE_BLOCK_MAGIC,
+        .comp_len = (uint16_t)comp_len,
+        .raw_len = (uint16_t)s_archive.raw_len,
+        .line_count = (uint16_t)s_archive.raw_lines,
+        .first_seq = s_archive.raw_first_seq,
+        .first_epoch = s_archive.raw_first_epoch,
+        .data_crc = esp_rom_crc32_le(0U, payload, (uint32_t)comp_len),
+    };
+    hdr->hdr_crc = block_hdr_crc(hdr);
+
+    const uint32_t total = align4((uint32_t)(sizeof(*hdr) + comp_len));
+    memset(&payload[comp_len], 0xFF, total - sizeof(*hdr) - comp_len);
+    if ((s_archive.head_offset + total) > LOG_ARCHIVE_SECTOR_SIZE) {
+        ESP_RETURN_ON_ERROR(sector_open_locked((s_archive.head_sector + 1U) % s_archive.sector_count),
+                            TAG, "sector advance failed");
+    }
+    ESP_RETURN_ON_ERROR(esp_partition_write(s_archive.part,
+                                            sector_addr(s_archive.head_sector) + s_archive.head_offset,
+                                            s_archive.block,
+                                            total),
+                        TAG, "block write failed");
+
+    log_archive_sector_t *sec = &s_archive.sectors[s_archive.head_sector];
+    if (sec->first_line_seq == LOG_ARCHIVE_NO_SEQ) {
+        sec->first_line_seq = hdr->first_seq;
+        sec->first_epoch = hdr->first_epoch;
+    }
+    s_archive.head_offset += total;
+    s_archive.blocks_written++;
+    s_archive.raw_bytes += s_archive.raw_len;
+    s_archive.stored_bytes += total;
+    s_archive.raw_len = 0U;
+    s_archive.raw_lines = 0U;
+    return ESP_OK;
+}
+
+// Wall time of a "[+<ms> ms] ..." line, or 0 before SNTP sync.
+static uint32_t line_epoch(const char *line)
+{
+    if (!log_store_is_time_synced()) {
+        return 0U;
+    }
+    const time_t now = time(NULL);
+    const uint32_t now_ms = esp_log_timestamp();
+    unsigned long line_ms = 0;
+    if (sscanf(line, "[+%lu ms]", &line_ms) == 1 && line_ms <= now_ms) {
+        return (uint32_t)now - ((now_ms - (uint32_t)line_ms) / 1000U);
+    }
+    return (uint32_t)now;
+}
+
+static esp_err_t append_line_locked(const char *line)
+{
+    const size_t len = strnlen(line, sizeof(((log_store_entry_t *)0)->line));
+    if ((s_archive.raw_len + len + 1U) > LOG_ARCHIVE_RAW_MAX) {
+        ESP_RETURN_ON_ERROR(write_block_locked(), TAG, "flush block failed");
+    }
+    if (s_archive.raw_lines == 0U) {
+        s_archive.raw_first_seq = s_archive.next_line_seq;
+        s_archive.raw_first_epoch = line_epoch(line);
+    }
+    memcpy(&s_archive.raw[s_archive.raw_len], line, len);
+    s_archive.raw[s_archive.raw_len + len] = '\n';
+    s_archive.raw_len += (uint32_t)len + 1U;
+    s_archive.raw_lines++;
+    s_archive.next_line_seq++;
+    return ESP_OK;
+}
+
+// The cursor keeps the ring position of the last archived line, so a flush only walks new lines.
+static bool flush_visit(const log_store_entry_t *entry, void *ctx)
+{
+    (void)ctx;
+    const uint32_t last_id = s_archive.cursor.last_id;
+    if (last_id != 0U && entry->id > (last_id + 1U)) {
+        s_archive.lines_missed += entry->id - last_id - 1U;
+    }
+    return append_line_locked(entry->line) == ESP_OK;
+}
+
+static void flush_locked(void)
+{
+    (void)log_store_visit_since(&s_archive.cursor, NULL, flush_visit, NULL);
+    (void)write_block_locked();
+}
+
+// Scans a sector's blocks; returns the first free offset (sector size if a torn block was found).
+static uint32_t sector_walk(uint32_t index, uint32_t *io_next_seq)
+{
+    uint32_t offset = sizeof(log_archive_sector_hdr_t);
+    while ((offset + sizeof(log_archive_block_hdr_t)) <= LOG_ARCHIVE_SECTOR_SIZE) {
+        log_archive_block_hdr_t hdr;
+        if (esp_partition_read(s_archive.part, sector_addr(index) + offset, &hdr, sizeof(hdr)) != ESP_OK ||
+            hdr.magic == LOG_ARCHIVE_ERASED_MAGIC) {
+            break;
+        }
+        if (!block_hdr_valid(&hdr)) {
+            // Interrupted write: never program over it, continue in the next sector.
+            return LOG_ARCHIVE_SECTOR_SIZE;
+        }
+        *io_next_seq = hdr.first_seq + hdr.line_count;
+        offset += align4((uint32_t)(sizeof(hdr) + hdr.comp_len));
+    }
+    return offset;
+}
+
+static esp_err_t mount(void)
+{
+    uint32_t newest = LOG_ARCHIVE_MAX_SECTORS;
+    uint32_t newest_with_data = LOG_ARCHIVE_MAX_SECTORS;
+    for (uint32_t i = 0; i < s_archive.sector_count; ++i) {
+        log_archive_sector_t *sec = &s_archive.sectors[i];
+        log_archive_sector_hdr_t hdr;
+        sec->sector_seq = 0U;
+        sec->first_line_seq = LOG_ARCHIVE_NO_SEQ;
+        sec->first_epoch = 0U;
+        sec->erase_count = 0U;
+        ESP_RETURN_ON_ERROR(esp_partition_read(s_archive.part, sector_addr(i), &hdr, sizeof(hdr)),
+                            TAG, "sector header read failed");
+        if (hdr.magic != LOG_ARCHIVE_SECTOR_MAGIC || hdr.crc != sector_hdr_crc(&hdr) || hdr.sector_seq == 0U) {
+            continue;
+        }
+        sec->sector_seq = hdr.sector_seq;
+        sec->erase_count = hdr.erase_count;
+
+        log_archive_block_hdr_t block;
+        if (esp_partition_read(s_archive.part, sector_addr(i) + sizeof(hdr), &block, sizeof(block)) == ESP_OK &&
+            block_hdr_valid(&block)) {
+            sec->first_line_seq = block.first_seq;
+            sec->first_epoch = block.first_epoch;
+            if (newest_with_data == LOG_ARCHIVE_MAX_SECTORS ||
+                (int32_t)(sec->sector_seq - s_archive.sectors[newest_with_data].sector_seq) > 0) {
+                newest_with_data = i;
+            }
+        }
+        if (newest == LOG_ARCHIVE_MAX_SECTORS || (int32_t)(sec->sector_seq - s_archive.sectors[newest].sector_seq) > 0) {
+            newest = i;
+        }
+    }
+
+    s_archive.next_line_seq = 1U;
+    if (newest_with_data != LOG_ARCHIVE_MAX_SECTORS) {
+        (void)sector_walk(newest_with_data, &s_archive.next_line_seq);
+    }
+    if (newest == LOG_ARCHIVE_MAX_SECTORS) {
+        s_archive.next_sector_seq = 1U;
+        return sector_open_locked(0U);
+    }
+
+    s_archive.next_sector_seq = s_archive.sectors[newest].sector_seq + 1U;
+    s_archive.head_sector = newest;
+    uint32_t unused_seq = 0;
+    s_archive.head_offset = sector_walk(newest, &unused_seq);
+    return ESP_OK;
+}
+
+static void log_archive_task(void *arg)
+{
+    (void)arg;
+    while (true) {
+        (void)ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(MACRO_LOG_ARCHIVE_FLUSH_INTERVAL_SEC * 1000U));
+        log_archive_flush();
+    }
+}
+
+esp_err_t log_archive_init(void)
+{
+    if (!MACRO_LOG_ARCHIVE_ENABLED || s_archive.initialized) {
+        return ESP_OK;
+    }
+
+    s_archive.part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                              ESP_PARTITION_SUBTYPE_ANY,
+                                              MACRO_LOG_ARCHIVE_PARTITION_LABEL);
+    ESP_RETURN_ON_FALSE(s_archive.part != NULL, ESP_ERR_NOT_FOUND, TAG, "partition '%s' not found",
+                        MACRO_LOG_ARCHIVE_PARTITION_LABEL);
+    ESP_RETURN_ON_FALSE(((uint32_t)MACRO_LOG_ARCHIVE_OFFSET + (uint32_t)MACRO_LOG_ARCHIVE_SIZE) <= s_archive.part->size,
+                        ESP_ERR_INVALID_SIZE, TAG, "archive region exceeds partition");
+    s_archive.sector_count = (uint32_t)MACRO_LOG_ARCHIVE_SIZE / LOG_ARCHIVE_SECTOR_SIZE;
+
+    s_archive.lock = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(s_archive.lock != NULL, ESP_ERR_NO_MEM, TAG, "mutex alloc failed");
+    ESP_RETURN_ON_ERROR(mount(), TAG, "mount failed");
+
+    // After a clean esp_restart() the previous boot was archived by the shutdown hook, so the lines
+    // replayed from RTC memory are skipped; after a crash they may be the only copy.
+    if (esp_reset_reason() == ESP_RST_SW) {
+        log_store_stats_t log_stats = {0};
+        log_store_get_stats(&log_stats);
+        s_archive.cursor.last_id = log_stats.replay_last_id;
+    }
+
+    s_archive.initialized = true;
+    log_store_set_shutdown_callback(log_archive_flush);
+    if (xTaskCreate(log_archive_task, "log_archive", LOG_ARCHIVE_TASK_STACK, NULL, LOG_ARCHIVE_TASK_PRIO,
+                    &s_archive.task) != pdPASS) {
+        s_archive.initialized = false;
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Mounted %lu sectors at '%s'+0x%lx, next seq %lu",
+             (unsigned long)s_archive.sector_count,
+             MACRO_LOG_ARCHIVE_PARTITION_LABEL,
+             (unsigned long)MACRO_LOG_ARCHIVE_OFFSET,
+             (unsigned long)s_archive.next_line_seq);
+    return ESP_OK;
+}
+
+void log_archive_flush(void)
+{
+    if (!s_archive.initialized) {
+        return;
+    }
+    if (xSemaphoreTake(s_archive.lock, pdMS_TO_TICKS(LOG_ARCHIVE_LOCK_TIMEOUT_MS)) != pdTRUE) {
+        return;
+    }
+    flush_locked();
+    xSemaphoreGive(s_archive.lock);
+}
+
+typedef struct {
+    log_archive_block_hdr_t hdr;
+    uint8_t payload[LOG_ARCHIVE_COMP_MAX];
+    char raw[LOG_ARCHIVE_RAW_MAX];
+    uint8_t order[LOG_ARCHIVE_MAX_SECTORS];
+    uint32_t order_seq[LOG_ARCHIVE_MAX_SECTORS];
+} log_archive_reader_t;
+
+esp_err_t log_archive_read(uint32_t since_seq, uint32_t since_epoch, log_archive_line_cb_t cb, void *ctx)
+{
+    ESP_RETURN_ON_FALSE(cb != NULL, ESP_ERR_INVALID_ARG, TAG, "no callback");
+    if (!s_archive.initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    log_archive_reader_t *rd = malloc(sizeof(*rd));
+    if (rd == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Snapshot sectors holding data in write order (oldest first), then seek in that index.
+    (void)xSemaphoreTake(s_archive.lock, portMAX_DELAY);
+    size_t count = 0;
+    for (uint32_t k = 1; k <= s_archive.sector_count; ++k) {
+        const uint32_t index = (s_archive.head_sector + k) % s_archive.sector_count;
+        if (s_archive.sectors[index].sector_seq != 0U && s_archive.sectors[index].first_line_seq != LOG_ARCHIVE_NO_SEQ) {
+            rd->order[count] = (uint8_t)index;
+            rd->order_seq[count] = s_archive.sectors[index].sector_seq;
+            count++;
+        }
+    }
+
+    // Binary search: last sector whose first line is <= since_seq.
+    size_t start = 0;
+    size_t lo = 0;
+    size_t hi = count;
+    while (lo < hi) {
+        const size_t mid = lo + ((hi - lo) / 2U);
+        if ((int32_t)(s_archive.sectors[rd->order[mid]].first_line_seq - since_seq) <= 0) {
+            start = mid;
+            lo = mid + 1U;
+        } else {
+            hi = mid;
+        }
+    }
+    if (since_epoch != 0U) {
+        // Epochs are 0 for unsynced periods, so this seek is a linear scan.
+        for (size_t i = start; i < count; ++i) {
+            const uint32_t epoch = s_archive.sectors[rd->order[i]].first_epoch;
+            if (epoch != 0U && epoch <= since_epoch) {
+                start = i;
+            }
+        }
+    }
+    xSemaphoreGive(s_archive.lock);
+
+    esp_err_t err = ESP_OK;
+    bool stop = false;
+    for (size_t i = start; i < count && !stop; ++i) {
+        const uint32_t index = rd->order[i];
+        uint32_t offset = sizeof(log_archive_sector_hdr_t);
+        while (!stop && (offset + sizeof(log_archive_block_hdr_t)) <= LOG_ARCHIVE_SECTOR_SIZE) {
+            (void)xSemaphoreTake(s_archive.lock, portMAX_DELAY);
+            bool ok = s_archive.sectors[index].sector_seq == rd->order_seq[i] &&
+                      esp_partition_read(s_archive.part, sector_addr(index) + offset, &rd->hdr, sizeof(rd->hdr)) == ESP_OK &&
+                      block_hdr_valid(&rd->hdr) &&
+                      esp_partition_read(s_archive.part,
+                                         sector_addr(index) + offset + sizeof(rd->hdr),
+                                         rd->payload,
+                                         rd->hdr.comp_len) == ESP_OK;
+            xSemaphoreGive(s_archive.lock);
+            if (!ok) {
+                // End of written data, or the sector was recycled while we were reading it.
+                break;
+            }
+            offset += align4((uint32_t)(sizeof(rd->hdr) + rd->hdr.comp_len));
+
+            if ((int32_t)(rd->hdr.first_seq + rd->hdr.line_count - since_seq) <= 0 ||
+                (since_epoch != 0U && rd->hdr.first_epoch != 0U && rd->hdr.first_epoch < since_epoch)) {
+                continue;
+            }
+            if (esp_rom_crc32_le(0U, rd->payload, rd->hdr.comp_len) != rd->hdr.data_crc ||
+                !lz_decompress(rd->payload, rd->hdr.comp_len, (uint8_t *)rd->raw, rd->hdr.raw_len)) {
+                err = ESP_ERR_INVALID_CRC;
+                continue;
+            }
+
+            uint32_t seq = rd->hdr.first_seq;
+            size_t line_start = 0;
+            for (size_t p = 0; p < rd->hdr.raw_len && !stop; ++p) {
+                if (rd->raw[p] != '\n') {
+                    continue;
+                }
+                if ((int32_t)(seq - since_seq) >= 0 && !cb(seq, &rd->raw[line_start], p - line_start, ctx)) {
+                    stop = true;
+                }
+                seq++;
+                line_start = p + 1U;
+            }
+        }
+    }
+
+    free(rd);
+    return err;
+}
+
+void log_archive_get_stats(log_archive_stats_t *out_stats)
+{
+    if (out_stats == NULL) {
+        return;
+    }
+    memset(out_stats, 0, sizeof(*out_stats));
+    if (!s_archive.initialized) {
+        return;
+    }
+
+    (void)xSemaphoreTake(s_archive.lock, portMAX_DELAY);
+    out_stats->mounted = true;
+    out_stats->sector_count = s_archive.sector_count;
+    out_stats->next_seq = s_archive.next_line_seq;
+    out_stats->first_seq = s_archive.next_line_seq;
+    out_stats->blocks_written = s_archive.blocks_written;
+    out_stats->raw_bytes = s_archive.raw_bytes;
+    out_stats->stored_bytes = s_archive.stored_bytes;
+    out_stats->lines_missed = s_archive.lines_missed;
+    for (uint32_t i = 0; i < s_archive.sector_count; ++i) {
+        const log_archive_sector_t *sec = &s_archive.sectors[i];
+        if (sec->sector_seq != 0U) {
+            out_stats->sectors_used++;
+        }
+        if (sec->first_line_seq != LOG_ARCHIVE_NO_SEQ && (int32_t)(sec->first_line_seq - out_stats->first_seq) < 0) {
+            out_stats->first_seq = sec->first_line_seq;
+        }
+        if (sec->erase_count > out_stats->max_erase_count) {
+            out_stats->max_erase_count = sec->erase_count;
+        }
+    }
+    xSemaphoreGive(s_archive.lock);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+typedef struct {
+    bool mounted;
+    uint32_t sector_count;
+    uint32_t sectors_used;
+    uint32_t first_seq;       // oldest line still in flash
+    uint32_t next_seq;        // sequence number the next archived line gets
+    uint32_t blocks_written;  // since boot
+    uint32_t raw_bytes;       // since boot, before compression
+    uint32_t stored_bytes;    // since boot, block headers included
+    uint32_t lines_missed;    // lines overwritten in RAM before they were archived
+    uint32_t max_erase_count;
+} log_archive_stats_t;
+
+// Return false to stop the read.
+typedef bool (*log_archive_line_cb_t)(uint32_t seq, const char *line, size_t len, void *ctx);
+
+esp_err_t log_archive_init(void);
+// Archives pending log lines now instead of waiting for the flush interval.
+void log_archive_flush(void);
+// Streams archived lines oldest first, starting at since_seq or at the first block written at/after
+// since_epoch (0 = no time filter; time seek has block granularity).
+esp_err_t log_archive_read(uint32_t since_seq, uint32_t since_epoch, log_archive_line_cb_t cb, void *ctx);
+void log_archive_get_stats(log_archive_stats_t *out_stats);
@@ -1,38 +1,190 @@
 #include "log_store.h"
 
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
 #include "freertos/FreeRTOS.h"
-#include "freertos/semphr.h"
+#include "freertos/task.h"
 
+#include "esp_app_desc.h"
+#include "esp_attr.h"
 #include "esp_log_timestamp.h"
 #include "esp_log_write.h"
+#include "esp_memory_utils.h"
+#include "esp_rom_crc.h"
+#include "esp_system.h"
+
+#include "bench.h"
+#include "keymap_config.h"
 
-#define LOG_STORE_MAX_ENTRIES 240U
-#define LOG_STORE_LINE_MAX 192U
 #define LOG_STORE_FORMAT_BUF_MAX 160U
-#define LOG_STORE_ACCUM_MAX 768U
+#define LOG_STORE_RING_WORDS (MACRO_LOG_STORE_RING_BYTES / 4U)
+#define LOG_STORE_HDR_WORDS 4U
+#define LOG_STORE_MAX_ARGS 16U
+#define LOG_STORE_INLINE_STR_MAX 48U
+#define LOG_STORE_RECORD_MAX_WORDS 128U
+#define LOG_STORE_FMT_CACHE_SIZE 64U
+#define LOG_STORE_SPEC_MAX 24U
+#define LOG_STORE_STAGING_WORDS (MACRO_LOG_STORE_STAGING_BYTES / 4U)
+#define LOG_STORE_PARTIAL_FLUSH_MS 200U
+#define LOG_STORE_DRAIN_TASK_STACK 3072U
+#define LOG_STORE_DRAIN_TASK_PRIO 1U
+#define LOG_STORE_NOTICE_MAX 80U
+#define LOG_STORE_RTC_WORDS (MACRO_LOG_STORE_RTC_BYTES / 4U)
+#define LOG_STORE_RTC_MAGIC 0x4C475254U
+#define LOG_STORE_RATE_SLOTS 8U
+// Rate limiter time base: 1/16 ms, so intervals stay exact enough up to 1000 lines/s.
+#define LOG_STORE_RATE_TICKS_PER_MS 16U
+#define LOG_STORE_RATE_MAX_PER_SEC 1000U
+#define LOG_STORE_RATE_REPORT_MS 10000U
+// A run of repeats is reported once it has been quiet this long, and at least this often while it lasts.
+#define LOG_STORE_REPEAT_IDLE_MS 1000U
+#define LOG_STORE_REPEAT_REPORT_MS 10000U
+
+// Header word 0: [7:0] length in words, [9:8] kind, [10] ends line, [23:16] argument words.
+#define LOG_REC_LEN(w) ((w) & 0xFFU)
+#define LOG_REC_KIND(w) (((w) >> 8) & 0x3U)
+#define LOG_REC_EOL (1U << 10)
+// Set on every committed staging header; a zero word means the slot is reserved but not written yet.
+#define LOG_REC_STAGED (1U << 11)
+#define LOG_REC_ARG_WORDS(w) (((w) >> 16) & 0xFFU)
+#define LOG_REC_HEADER(len, kind, eol, arg_words) \
+    ((uint32_t)(len) | ((uint32_t)(kind) << 8) | ((eol) ? LOG_REC_EOL : 0U) | ((uint32_t)(arg_words) << 16))
+
+// Claimed signature cache slot that is still being filled in.
+#define LOG_FMT_SLOT_BUSY ((const char *)1)
+
+// %s argument copied into the record: low 16 bits are the byte offset into the string area.
+#define LOG_STORE_INLINE_STR_TAG 0xFFFF0000U
+
+#if (LOG_STORE_RING_WORDS < (LOG_STORE_RECORD_MAX_WORDS * 4U))
+#error "log_store.ring_bytes is too small"
+#endif
+#if (LOG_STORE_STAGING_WORDS < (LOG_STORE_RECORD_MAX_WORDS * 4U)) || ((LOG_STORE_STAGING_WORDS & (LOG_STORE_STAGING_WORDS - 1U)) != 0U)
+#error "log_store.staging_bytes must be a power of two >= 2048"
+#endif
+#if MACRO_LOG_STORE_RTC_ENABLED && ((LOG_STORE_RTC_WORDS < (LOG_STORE_RECORD_MAX_WORDS * 2U)) || ((LOG_STORE_RTC_WORDS & (LOG_STORE_RTC_WORDS - 1U)) != 0U))
+#error "log_store.rtc_bytes must be a power of two >= 1024"
+#endif
+
+_Static_assert(sizeof(int) == 4 && sizeof(long) == 4 && sizeof(void *) == 4 && sizeof(size_t) == 4,
+               "binary log capture assumes 32-bit int/long/pointer");
+
+enum {
+    LOG_REC_PAD = 0,   // rest of the ring up to the wrap point is unused
+    LOG_REC_BINARY = 1,
+    LOG_REC_TEXT = 2,
+};
+
+enum {
+    LOG_ARG_NONE = 0,
+    LOG_ARG_I32,
+    LOG_ARG_I64,
+    LOG_ARG_F64,
+    LOG_ARG_STR,
+};
+
+typedef struct {
+    const char *start;  // points at '%'
+    const char *end;    // one past the conversion character
+    uint8_t stars;      // '*' width/precision arguments (int) preceding the value
+    uint8_t kind;       // LOG_ARG_*; LOG_ARG_NONE for "%%"
+    char conv;
+    bool supported;
+} log_spec_t;
+
+// Argument layout of one format string, computed once and looked up by pointer.
+typedef struct {
+    const char *fmt;
+    uint8_t nargs;
+    uint8_t arg_words;
+    bool ends_line;
+    bool deferrable;
+    bool has_tag;  // ESP_LOGx prefix; the tag is the second argument
+    uint8_t kinds[LOG_STORE_MAX_ARGS];
+} log_fmt_sig_t;
+
+// GCRA token bucket for one tag. Producers only CAS tat and bump suppressed; interval == 0 marks a free slot.
+typedef struct {
+    char tag[24];
+    uint32_t interval;   // ticks between lines at the sustained rate
+    uint32_t tolerance;  // burst allowance in ticks
+    uint32_t tat;        // theoretical arrival time of the next line
+    uint32_t suppressed; // since the last report
+    uint32_t suppressed_total;
+    uint16_t per_sec;
+    uint16_t burst;
+} log_rate_slot_t;
+
+// Per-core multi-producer staging ring. Producers reserve with a CAS on head and publish by writing
+// the header word last; only the drain task advances tail, zeroing the words it consumed.
+typedef struct {
+    uint32_t head;
+    uint32_t tail;
+    uint32_t dropped;
+    uint32_t peak_words;
+    uint32_t words[LOG_STORE_STAGING_WORDS];
+} log_staging_t;
 
 typedef struct {
     bool initialized;
     bool time_synced;
-    SemaphoreHandle_t lock;
+    // Guards the shared ring only; held by the drain task and readers, never by logging tasks.
+    portMUX_TYPE lock;
     vprintf_like_t prev_vprintf;
     uint32_t next_id;
-    size_t head;
-    size_t count;
-    size_t accum_len;
-    bool pending_tag_line;
-    char accum[LOG_STORE_ACCUM_MAX];
-    char pending_monitor_prefix[32];
-    char pending_tag_payload[48];
-    log_store_entry_t entries[LOG_STORE_MAX_ENTRIES];
+    bool line_open;
+    uint32_t replay_last_id;
+    // Absolute word positions; ring index is pos % LOG_STORE_RING_WORDS.
+    uint64_t head_pos;
+    uint64_t tail_pos;
+    uint32_t records;
+    uint32_t dropped_total;
+    uint32_t collapsed_total;
+    uint32_t rate_limited_total;
+    uint32_t rate_active;
+    uint32_t rate_report_ms;
+    // Newest line in the ring while it is a single complete record; later identical lines are counted
+    // against it instead of stored, and reported as one notice when the run ends.
+    uint64_t repeat_pos;
+    uint32_t repeat_id;  // 0 = no candidate
+    uint32_t repeat_count;
+    uint32_t repeat_first_ms;
+    uint32_t repeat_last_ms;
+    bool repeat_varied;
+    TaskHandle_t drain_task;
+    log_store_shutdown_cb_t shutdown_cb;
+    log_store_commit_cb_t commit_cb;
+    log_staging_t staging[portNUM_PROCESSORS];
+    log_fmt_sig_t fmt_cache[LOG_STORE_FMT_CACHE_SIZE];
+    log_rate_slot_t rate[LOG_STORE_RATE_SLOTS];
+    uint32_t ring[LOG_STORE_RING_WORDS];
 } log_store_state_t;
 
-static log_store_state_t s_log_store = {0};
+static log_store_state_t s_log_store = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+#if MACRO_LOG_STORE_RTC_ENABLED
+// Copy of the newest records in RTC slow memory. It survives software, panic and watchdog resets
+// (not power-on) and is validated by magic + header CRC + per-record CRC before it is replayed.
+typedef struct {
+    uint32_t magic;
+    uint32_t words;
+    uint32_t head;
+    uint32_t tail;
+    uint32_t image_id[2];  // binary records reference flash of this image; other images only take text
+    uint32_t crc;
+    uint32_t ring[LOG_STORE_RTC_WORDS];
+} log_rtc_ring_t;
+
+RTC_NOINIT_ATTR static log_rtc_ring_t s_rtc_log;
+static bool s_rtc_frozen;
+#endif
 
 static bool is_wall_time_valid(void)
 {
@@ -59,44 +211,571 @@ static void trim_log_message(char *line)
     }
 }
 
-static void build_prefix(char *out, size_t out_size)
+static const char *parse_spec(const char *p, log_spec_t *spec)
 {
-    if (out == NULL || out_size == 0U) {
-        return;
+    memset(spec, 0, sizeof(*spec));
+    spec->start = p++;
+    spec->supported = true;
+    if (*p == '%') {
+        spec->conv = '%';
+        spec->end = p + 1;
+        return spec->end;
+    }
+
+    while (*p != '\0' && strchr("-+ #0", *p) != NULL) {
+        ++p;
+    }
+    if (*p == '*') {
+        spec->stars++;
+        ++p;
+    }
+    while (*p >= '0' && *p <= '9') {
+        ++p;
+    }
+    if (*p == '.') {
+        ++p;
+        if (*p == '*') {
+            spec->stars++;
+            ++p;
+        }
+        while (*p >= '0' && *p <= '9') {
+            ++p;
+        }
     }
 
-    /* Keep the log hook lightweight and deterministic to avoid callback-time crashes. */
-    (void)snprintf(out, out_size, "+%lu ms", (unsigned long)esp_log_timestamp());
+    bool wide = false;
+    if (p[0] == 'l' && p[1] == 'l') {
+        wide = true;
+        p += 2;
+    } else if (p[0] == 'h' && p[1] == 'h') {
+        p += 2;
+    } else if (*p == 'j') {
+        wide = true;
+        ++p;
+    } else if (*p == 'l' || *p == 'h' || *p == 'z' || *p == 't') {
+        if (*p == 'l' && p[1] == 's') {
+            spec->supported = false;
+        }
+        ++p;
+    } else if (*p == 'L') {
+        spec->supported = false;
+        ++p;
+    }
+
+    spec->conv = *p;
+    if (*p != '\0') {
+        ++p;
+    }
+    spec->end = p;
+
+    switch (spec->conv) {
+    case 'd':
+    case 'i':
+    case 'u':
+    case 'x':
+    case 'X':
+    case 'o':
+        spec->kind = wide ? LOG_ARG_I64 : LOG_ARG_I32;
+        break;
+    case 'c':
+    case 'p':
+        spec->kind = LOG_ARG_I32;
+        break;
+    case 's':
+        spec->kind = LOG_ARG_STR;
+        break;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+        spec->kind = LOG_ARG_F64;
+        break;
+    default:
+        spec->supported = false;
+        break;
+    }
+    return spec->end;
+}
+
+static uint32_t level_rank(char level)
+{
+    switch (level) {
+    case 'E':
+        return 1U;
+    case 'W':
+        return 2U;
+    case 'I':
+        return 3U;
+    case 'D':
+        return 4U;
+    case 'V':
+        return 5U;
+    default:
+        return 0U;
+    }
 }
 
-static void push_log_line_locked(const char *line)
+// Skips the "\033[0;3Xm" colour prefix added with CONFIG_LOG_COLORS.
+static const char *skip_color(const char *p)
 {
-    if (!s_log_store.initialized || line == NULL || line[0] == '\0') {
+    if (p[0] == '\033') {
+        const char *m = strchr(p, 'm');
+        if (m != NULL) {
+            return m + 1;
+        }
+    }
+    return p;
+}
+
+// Level letter if fmt starts with the ESP_LOGx prefix "L (%lu) %s: " (tag in the second argument), else '\0'.
+static char fmt_log_level(const char *fmt)
+{
+    const char *p = skip_color(fmt);
+    if (level_rank(p[0]) == 0U || p[1] != ' ' || p[2] != '(' || p[3] != '%') {
+        return '\0';
+    }
+    log_spec_t spec;
+    const char *rest = parse_spec(&p[3], &spec);
+    if ((spec.kind != LOG_ARG_I32 && spec.kind != LOG_ARG_STR) || spec.stars != 0U || strncmp(rest, ") %s:", 5) != 0) {
+        return '\0';
+    }
+    return p[0];
+}
+
+static void build_signature(const char *fmt, log_fmt_sig_t *sig)
+{
+    memset(sig, 0, sizeof(*sig));
+    // Formats built at runtime may not outlive the call, so only flash-resident ones are deferred.
+    sig->deferrable = esp_ptr_in_drom(fmt);
+
+    const char *p = fmt;
+    while (*p != '\0' && sig->deferrable) {
+        if (*p != '%') {
+            ++p;
+            continue;
+        }
+        log_spec_t spec;
+        p = parse_spec(p, &spec);
+        if (!spec.supported || (sig->nargs + spec.stars + 1U) > LOG_STORE_MAX_ARGS) {
+            sig->deferrable = false;
+            break;
+        }
+        for (uint8_t i = 0; i < spec.stars; ++i) {
+            sig->kinds[sig->nargs++] = LOG_ARG_I32;
+            sig->arg_words++;
+        }
+        if (spec.kind != LOG_ARG_NONE) {
+            sig->kinds[sig->nargs++] = spec.kind;
+            sig->arg_words += (spec.kind == LOG_ARG_I64 || spec.kind == LOG_ARG_F64) ? 2U : 1U;
+        }
+    }
+
+    const size_t len = strlen(fmt);
+    sig->ends_line = (len > 0U) && (fmt[len - 1U] == '\n');
+    sig->has_tag = fmt_log_level(fmt) != '\0';
+}
+
+static const log_fmt_sig_t *lookup_signature(const char *fmt, log_fmt_sig_t *scratch)
+{
+    const uint32_t hash = ((uint32_t)(uintptr_t)fmt * 2654435761U) >> 26;
+    for (uint32_t probe = 0; probe < 8U; ++probe) {
+        log_fmt_sig_t *slot = &s_log_store.fmt_cache[(hash + probe) % LOG_STORE_FMT_CACHE_SIZE];
+        const char *cached = __atomic_load_n(&slot->fmt, __ATOMIC_ACQUIRE);
+        if (cached == fmt) {
+            return slot;
+        }
+        if (cached == NULL) {
+            build_signature(fmt, scratch);
+            scratch->fmt = fmt;
+            const char *expected = NULL;
+            if (__atomic_compare_exchange_n(&slot->fmt, &expected, LOG_FMT_SLOT_BUSY, false,
+                                            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                // fmt is published last so lock-free readers never see a half-written slot.
+                slot->nargs = scratch->nargs;
+                slot->arg_words = scratch->arg_words;
+                slot->ends_line = scratch->ends_line;
+                slot->deferrable = scratch->deferrable;
+                slot->has_tag = scratch->has_tag;
+                memcpy(slot->kinds, scratch->kinds, sizeof(slot->kinds));
+                __atomic_store_n(&slot->fmt, fmt, __ATOMIC_RELEASE);
+            }
+            return scratch;
+        }
+    }
+
+    build_signature(fmt, scratch);
+    scratch->fmt = fmt;
+    return scratch;
+}
+
+static void ring_drop_oldest_locked(void)
+{
+    const uint32_t idx = (uint32_t)(s_log_store.tail_pos % LOG_STORE_RING_WORDS);
+    const uint32_t hdr = s_log_store.ring[idx];
+    if (LOG_REC_KIND(hdr) == LOG_REC_PAD) {
+        s_log_store.tail_pos += LOG_STORE_RING_WORDS - idx;
         return;
     }
-    log_store_entry_t *dst = &s_log_store.entries[s_log_store.head];
-    dst->id = ++s_log_store.next_id;
-    strlcpy(dst->line, line, sizeof(dst->line));
+    s_log_store.tail_pos += LOG_REC_LEN(hdr);
+    if (s_log_store.records > 0U) {
+        s_log_store.records--;
+    }
+}
+
+static void ring_reserve_locked(uint32_t words)
+{
+    while ((s_log_store.head_pos + words - s_log_store.tail_pos) > LOG_STORE_RING_WORDS) {
+        ring_drop_oldest_locked();
+    }
+}
+
+static void ring_append_locked(uint32_t *record, uint32_t len)
+{
+    uint32_t idx = (uint32_t)(s_log_store.head_pos % LOG_STORE_RING_WORDS);
+    if ((idx + len) > LOG_STORE_RING_WORDS) {
+        const uint32_t pad = LOG_STORE_RING_WORDS - idx;
+        ring_reserve_locked(pad);
+        s_log_store.ring[idx] = LOG_REC_HEADER(0U, LOG_REC_PAD, false, 0U);
+        s_log_store.head_pos += pad;
+        idx = 0U;
+    }
+
+    ring_reserve_locked(len);
+    // Ids number lines, not records: continuation records share the id of the line they extend.
+    record[1] = s_log_store.line_open ? s_log_store.next_id : ++s_log_store.next_id;
+    s_log_store.line_open = (record[0] & LOG_REC_EOL) == 0U;
+    s_log_store.repeat_id = 0U;
+    memcpy(&s_log_store.ring[idx], record, len * sizeof(uint32_t));
+    s_log_store.head_pos += len;
+    s_log_store.records++;
+}
+
+#if MACRO_LOG_STORE_RTC_ENABLED
+static uint32_t rtc_header_crc(void)
+{
+    return esp_rom_crc32_le(0U, (const uint8_t *)&s_rtc_log, (uint32_t)offsetof(log_rtc_ring_t, crc));
+}
+
+static void rtc_reset(void)
+{
+    const esp_app_desc_t *app = esp_app_get_description();
+    s_rtc_log.magic = LOG_STORE_RTC_MAGIC;
+    s_rtc_log.words = LOG_STORE_RTC_WORDS;
+    s_rtc_log.head = 0U;
+    s_rtc_log.tail = 0U;
+    memcpy(s_rtc_log.image_id, app->app_elf_sha256, sizeof(s_rtc_log.image_id));
+    s_rtc_log.crc = rtc_header_crc();
+}
+
+// CRC of a record as the RTC ring stores it: header hdr, id word zero. Computed before the lock is taken.
+static uint32_t rtc_record_crc(uint32_t hdr, const uint32_t *record, uint32_t len)
+{
+    const uint32_t head[2] = {hdr, 0U};
+    const uint32_t crc = esp_rom_crc32_le(0U, (const uint8_t *)head, sizeof(head));
+    return esp_rom_crc32_le(crc, (const uint8_t *)&record[2], (len - 2U) * sizeof(uint32_t));
+}
+
+static void rtc_write(const uint32_t *record, uint32_t len, uint32_t crc)
+{
+    uint32_t idx = s_rtc_log.head % LOG_STORE_RTC_WORDS;
+    const uint32_t pad = ((idx + len) > LOG_STORE_RTC_WORDS) ? (LOG_STORE_RTC_WORDS - idx) : 0U;
+    while ((s_rtc_log.head + pad + len - s_rtc_log.tail) > LOG_STORE_RTC_WORDS) {
+        const uint32_t tail_idx = s_rtc_log.tail % LOG_STORE_RTC_WORDS;
+        const uint32_t hdr = s_rtc_log.ring[tail_idx];
+        s_rtc_log.tail += (LOG_REC_KIND(hdr) == LOG_REC_PAD) ? (LOG_STORE_RTC_WORDS - tail_idx) : LOG_REC_LEN(hdr);
+    }
+    if (pad > 0U) {
+        s_rtc_log.ring[idx] = LOG_REC_HEADER(0U, LOG_REC_PAD, false, 0U);
+        idx = 0U;
+    }
+
+    // The record (with its CRC in the id word) is complete before head and the header CRC move.
+    uint32_t *dst = &s_rtc_log.ring[idx];
+    memcpy(dst, record, len * sizeof(uint32_t));
+    dst[1] = crc;
+    s_rtc_log.head += pad + len;
+    s_rtc_log.crc = rtc_header_crc();
+}
+
+static void rtc_append_locked(const uint32_t *record, uint32_t len, uint32_t crc)
+{
+    if (!s_rtc_frozen) {
+        rtc_write(record, len, crc);
+    }
+}
+#else
+static uint32_t rtc_record_crc(uint32_t hdr, const uint32_t *record, uint32_t len)
+{
+    (void)hdr;
+    (void)record;
+    (void)len;
+    return 0U;
+}
+
+static void rtc_append_locked(const uint32_t *record, uint32_t len, uint32_t crc)
+{
+    (void)record;
+    (void)len;
+    (void)crc;
+}
+#endif
+
+// Producer side: never blocks. Reserves len contiguous words in this core's staging ring; a full ring
+// counts a drop and returns NULL. The caller fills words 1..len-1, then publishes with staging_publish().
+static uint32_t *staging_reserve(uint32_t len)
+{
+    log_staging_t *st = &s_log_store.staging[xPortGetCoreID()];
+    uint32_t head = __atomic_load_n(&st->head, __ATOMIC_RELAXED);
+    uint32_t pad = 0;
+    uint32_t used = 0;
+    do {
+        const uint32_t idx = head % LOG_STORE_STAGING_WORDS;
+        pad = ((idx + len) > LOG_STORE_STAGING_WORDS) ? (LOG_STORE_STAGING_WORDS - idx) : 0U;
+        used = head + pad + len - __atomic_load_n(&st->tail, __ATOMIC_ACQUIRE);
+        if (used > LOG_STORE_STAGING_WORDS) {
+            (void)__atomic_fetch_add(&st->dropped, 1U, __ATOMIC_RELAXED);
+            return NULL;
+        }
+    } while (!__atomic_compare_exchange_n(&st->head, &head, head + pad + len, true,
+                                          __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+    if (used > __atomic_load_n(&st->peak_words, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&st->peak_words, used, __ATOMIC_RELAXED);
+    }
+    if (pad > 0U) {
+        __atomic_store_n(&st->words[head % LOG_STORE_STAGING_WORDS],
+                         LOG_REC_HEADER(0U, LOG_REC_PAD, false, 0U) | LOG_REC_STAGED,
+                         __ATOMIC_RELEASE);
+        head += pad;
+    }
+    return &st->words[head % LOG_STORE_STAGING_WORDS];
+}
+
+// The header is written last; the drain task stops at a reserved slot until then.
+static void staging_publish(uint32_t *slot, uint32_t header)
+{
+    __atomic_store_n(slot, header | LOG_REC_STAGED, __ATOMIC_RELEASE);
+}
 
-    s_log_store.head = (s_log_store.head + 1U) % LOG_STORE_MAX_ENTRIES;
-    if (s_log_store.count < LOG_STORE_MAX_ENTRIES) {
-        s_log_store.count++;
+static void commit_record(const uint32_t *record, uint32_t len)
+{
+    uint32_t *slot = staging_reserve(len);
+    if (slot != NULL) {
+        memcpy(&slot[1], &record[1], (len - 1U) * sizeof(uint32_t));
+        staging_publish(slot, record[0]);
     }
 }
 
-static void emit_accum_line_locked(void)
+// Packs text into a TEXT record; returns the record length in words.
+static uint32_t make_text_record(uint32_t *record, size_t record_words, const char *text, bool eol, uint32_t timestamp_ms)
 {
-    trim_log_message(s_log_store.accum);
-    if (s_log_store.accum[0] == '\0') {
+    const size_t cap = (record_words - LOG_STORE_HDR_WORDS) * sizeof(uint32_t);
+    const size_t text_len = strnlen(text, cap - 1U);
+    const uint32_t len = LOG_STORE_HDR_WORDS + (uint32_t)((text_len + 4U) / 4U);
+    record[len - 1U] = 0U;
+    memcpy(&record[LOG_STORE_HDR_WORDS], text, text_len);
+    ((char *)&record[LOG_STORE_HDR_WORDS])[text_len] = '\0';
+    record[0] = LOG_REC_HEADER(len, LOG_REC_TEXT, eol, 0U);
+    record[1] = 0U;
+    record[2] = timestamp_ms;
+    record[3] = (uint32_t)text_len;
+    return len;
+}
+
+static void store_text(const char *fmt, va_list args)
+{
+    uint32_t record[LOG_STORE_HDR_WORDS + (LOG_STORE_FORMAT_BUF_MAX / 4U)] = {0};
+    char *text = (char *)&record[LOG_STORE_HDR_WORDS];
+    const int n = vsnprintf(text, LOG_STORE_FORMAT_BUF_MAX, fmt, args);
+    if (n <= 0) {
         return;
     }
+    const size_t text_len = strnlen(text, LOG_STORE_FORMAT_BUF_MAX - 1U);
+    const bool eol = text_len > 0U && text[text_len - 1U] == '\n';
+    const uint32_t len = LOG_STORE_HDR_WORDS + (uint32_t)((text_len + 4U) / 4U);
+    record[0] = LOG_REC_HEADER(len, LOG_REC_TEXT, eol, 0U);
+    record[2] = esp_log_timestamp();
+    record[3] = (uint32_t)text_len;
+    commit_record(record, len);
+}
+
+// Hot path: copies the format pointer and raw argument words; no formatting. The record is sized first
+// and then written straight into staging, so the logging task's stack holds no record buffer.
+static bool store_binary(const char *fmt, va_list args)
+{
+    log_fmt_sig_t scratch;
+    const log_fmt_sig_t *sig = lookup_signature(fmt, &scratch);
+    if (!sig->deferrable) {
+        return false;
+    }
+
+    size_t strings_len = 0;
+    va_list size_args;
+    va_copy(size_args, args);
+    for (uint8_t i = 0; i < sig->nargs; ++i) {
+        switch (sig->kinds[i]) {
+        case LOG_ARG_I64:
+            (void)va_arg(size_args, unsigned long long);
+            break;
+        case LOG_ARG_F64:
+            (void)va_arg(size_args, double);
+            break;
+        case LOG_ARG_STR: {
+            const char *s = va_arg(size_args, const char *);
+            if (s != NULL && !esp_ptr_in_drom(s)) {
+                strings_len += strnlen(s, LOG_STORE_INLINE_STR_MAX - 1U) + 1U;
+            }
+            break;
+        }
+        default:
+            (void)va_arg(size_args, uint32_t);
+            break;
+        }
+    }
+    va_end(size_args);
 
-    char time_prefix[24] = {0};
-    char with_prefix[LOG_STORE_LINE_MAX] = {0};
-    build_prefix(time_prefix, sizeof(time_prefix));
-    (void)snprintf(with_prefix, sizeof(with_prefix), "[%s] %s", time_prefix, s_log_store.accum);
+    const uint32_t string_words = (uint32_t)((strings_len + 3U) / 4U);
+    const uint32_t len = LOG_STORE_HDR_WORDS + sig->arg_words + string_words;
+    if (len > LOG_STORE_RECORD_MAX_WORDS) {
+        return false;
+    }
+    uint32_t *record = staging_reserve(len);
+    if (record == NULL) {
+        return true;
+    }
+
+    uint32_t *arg_words = &record[LOG_STORE_HDR_WORDS];
+    uint32_t n = 0;
+    // Inline strings are written straight behind the argument words.
+    char *strings = (char *)&arg_words[sig->arg_words];
+    const size_t strings_cap = string_words * sizeof(uint32_t);
+    size_t used = 0;
 
-    push_log_line_locked(with_prefix);
+    for (uint8_t i = 0; i < sig->nargs; ++i) {
+        switch (sig->kinds[i]) {
+        case LOG_ARG_I64: {
+            const unsigned long long v = va_arg(args, unsigned long long);
+            arg_words[n++] = (uint32_t)v;
+            arg_words[n++] = (uint32_t)(v >> 32);
+            break;
+        }
+        case LOG_ARG_F64: {
+            const double v = va_arg(args, double);
+            memcpy(&arg_words[n], &v, sizeof(v));
+            n += 2U;
+            break;
+        }
+        case LOG_ARG_STR: {
+            const char *s = va_arg(args, const char *);
+            if (s == NULL || esp_ptr_in_drom(s)) {
+                arg_words[n++] = (uint32_t)(uintptr_t)s;
+                break;
+            }
+            // Stack/heap strings are copied (truncated) since they will not exist at read time. The
+            // bound is re-checked because another task may have changed the string since it was sized.
+            if (used >= strings_cap) {
+                arg_words[n++] = (uint32_t)(uintptr_t)"";
+                break;
+            }
+            size_t copy = strnlen(s, LOG_STORE_INLINE_STR_MAX - 1U);
+            if (used + copy + 1U > strings_cap) {
+                copy = strings_cap - used - 1U;
+            }
+            arg_words[n++] = LOG_STORE_INLINE_STR_TAG | (uint32_t)used;
+            memcpy(&strings[used], s, copy);
+            strings[used + copy] = '\0';
+            used += copy + 1U;
+            break;
+        }
+        default:
+            arg_words[n++] = va_arg(args, uint32_t);
+            break;
+        }
+    }
+
+    // Zero the pad bytes so identical lines compare equal when they are collapsed.
+    memset(&strings[used], 0, strings_cap - used);
+    record[1] = 0U;
+    record[2] = esp_log_timestamp();
+    record[3] = (uint32_t)(uintptr_t)fmt;
+    staging_publish(record, LOG_REC_HEADER(len, LOG_REC_BINARY, sig->ends_line, n));
+    return true;
+}
+
+static uint32_t rate_now(void)
+{
+    return esp_log_timestamp() * LOG_STORE_RATE_TICKS_PER_MS;
+}
+
+static bool rate_slot_admit(log_rate_slot_t *slot, uint32_t interval, uint32_t now)
+{
+    uint32_t tat = __atomic_load_n(&slot->tat, __ATOMIC_RELAXED);
+    while (true) {
+        const uint32_t start = ((int32_t)(tat - now) > 0) ? tat : now;
+        if ((start - now) > slot->tolerance) {
+            return false;
+        }
+        if (__atomic_compare_exchange_n(&slot->tat, &tat, start + interval, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            return true;
+        }
+    }
+}
+
+// Lock-free per-tag limit checked before anything is staged. Only ESP_LOGx calls carry a tag.
+static bool rate_limit_drop(const char *fmt, va_list args)
+{
+    if (__atomic_load_n(&s_log_store.rate_active, __ATOMIC_RELAXED) == 0U || !esp_ptr_in_drom(fmt)) {
+        return false;
+    }
+    log_fmt_sig_t scratch;
+    if (!lookup_signature(fmt, &scratch)->has_tag) {
+        return false;
+    }
+    va_list tag_args;
+    va_copy(tag_args, args);
+    (void)va_arg(tag_args, uint32_t);
+    const char *tag = va_arg(tag_args, const char *);
+    va_end(tag_args);
+    if (tag == NULL) {
+        return false;
+    }
+
+    const uint32_t now = rate_now();
+    for (uint32_t i = 0; i < LOG_STORE_RATE_SLOTS; ++i) {
+        log_rate_slot_t *slot = &s_log_store.rate[i];
+        const uint32_t interval = __atomic_load_n(&slot->interval, __ATOMIC_ACQUIRE);
+        if (interval == 0U || strncmp(slot->tag, tag, sizeof(slot->tag)) != 0) {
+            continue;
+        }
+        if (rate_slot_admit(slot, interval, now)) {
+            return false;
+        }
+        (void)__atomic_fetch_add(&slot->suppressed, 1U, __ATOMIC_RELAXED);
+        return true;
+    }
+    return false;
+}
+
+// Everything after the console copy: rate limit, then a binary record or formatted text.
+static void store_line(const char *fmt, va_list args)
+{
+    if (rate_limit_drop(fmt, args)) {
+        return;
+    }
+
+    va_list store_args;
+    va_copy(store_args, args);
+    const bool stored = MACRO_LOG_STORE_BINARY_ENABLED && store_binary(fmt, store_args);
+    va_end(store_args);
+    if (!stored) {
+        va_copy(store_args, args);
+        store_text(fmt, store_args);
+        va_end(store_args);
+    }
 }
 
 static int log_store_vprintf(const char *fmt, va_list args)
@@ -109,49 +788,684 @@ static int log_store_vprintf(const char *fmt, va_list args)
         va_end(out_args);
     }
 
-    if (xPortInIsrContext()) {
+    if (!s_log_store.initialized || fmt == NULL || fmt[0] == '\0' || xPortInIsrContext()) {
         return raw_ret;
     }
+    store_line(fmt, args);
+    return raw_ret;
+}
+
+static void bench_log_append_line(const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    store_line(fmt, args);
+    va_end(args);
+}
 
-    char formatted[LOG_STORE_FORMAT_BUF_MAX] = {0};
-    va_list format_args;
-    va_copy(format_args, args);
-    (void)vsnprintf(formatted, sizeof(formatted), fmt, format_args);
-    va_end(format_args);
+// The capture half of an ESP_LOGI line (console output excluded). Identical lines collapse in
+// the ring, so a run adds only a handful of entries.
+static void bench_log_append_run(void *ctx)
+{
+    (void)ctx;
+    bench_log_append_line("I (%lu) %s: bench append\n", (unsigned long)esp_log_timestamp(), "BENCH");
+}
 
-    if (formatted[0] == '\0') {
-        return raw_ret;
+// Sleeping between samples lets the drain task empty the staging ring, so no sample hits the drop path.
+static const bench_case_t s_bench_log_append = {
+    .name = "log_append",
+    .run = bench_log_append_run,
+    .flags = BENCH_FLAG_YIELD,
+};
+
+static uint32_t staging_header(log_staging_t *st, uint32_t pos)
+{
+    return __atomic_load_n(&st->words[pos % LOG_STORE_STAGING_WORDS], __ATOMIC_ACQUIRE);
+}
+
+// Finds the next whole line (records up to one with EOL) committed in st; returns its end position.
+// A partial line is released only once it is older than LOG_STORE_PARTIAL_FLUSH_MS.
+static bool staging_next_line(log_staging_t *st, uint32_t now_ms, uint32_t *out_end, uint32_t *out_ts)
+{
+    const uint32_t head = __atomic_load_n(&st->head, __ATOMIC_ACQUIRE);
+    uint32_t pos = st->tail;
+    bool have_record = false;
+    while (pos != head) {
+        const uint32_t hdr = staging_header(st, pos);
+        if ((hdr & LOG_REC_STAGED) == 0U) {
+            break;
+        }
+        const uint32_t idx = pos % LOG_STORE_STAGING_WORDS;
+        if (LOG_REC_KIND(hdr) == LOG_REC_PAD) {
+            pos += LOG_STORE_STAGING_WORDS - idx;
+            continue;
+        }
+        if (!have_record) {
+            *out_ts = st->words[idx + 2U];
+            have_record = true;
+        }
+        pos += LOG_REC_LEN(hdr);
+        if ((hdr & LOG_REC_EOL) != 0U) {
+            *out_end = pos;
+            return true;
+        }
+    }
+    if (have_record && (now_ms - *out_ts) >= LOG_STORE_PARTIAL_FLUSH_MS) {
+        *out_end = pos;
+        return true;
     }
+    return false;
+}
 
-    if (s_log_store.lock != NULL) {
-        (void)xSemaphoreTakeRecursive(s_log_store.lock, portMAX_DELAY);
+// Counts a single-record line that repeats the newest stored line (same format pointer for binary
+// records, same text length for text) instead of storing it. The stored line keeps its timestamp and
+// values; the run is reported by repeat_report().
+static bool collapse_locked(uint32_t hdr, const uint32_t *record, uint32_t len)
+{
+    if (!MACRO_LOG_STORE_COLLAPSE || s_log_store.repeat_id == 0U || s_log_store.line_open ||
+        (hdr & LOG_REC_EOL) == 0U || s_log_store.repeat_pos < s_log_store.tail_pos) {
+        return false;
     }
-    for (size_t i = 0; formatted[i] != '\0'; ++i) {
-        const char c = formatted[i];
-        if (s_log_store.accum_len < (LOG_STORE_ACCUM_MAX - 1U)) {
-            s_log_store.accum[s_log_store.accum_len++] = c;
-            s_log_store.accum[s_log_store.accum_len] = '\0';
-        } else {
-            emit_accum_line_locked();
-            s_log_store.accum_len = 0U;
-            s_log_store.accum[0] = '\0';
-            if (c != '\n') {
-                s_log_store.accum[s_log_store.accum_len++] = c;
-                s_log_store.accum[s_log_store.accum_len] = '\0';
+    const uint32_t *stored = &s_log_store.ring[s_log_store.repeat_pos % LOG_STORE_RING_WORDS];
+    if (stored[1] != s_log_store.repeat_id || LOG_REC_LEN(stored[0]) != len ||
+        LOG_REC_KIND(stored[0]) != LOG_REC_KIND(hdr) || stored[3] != record[3]) {
+        return false;
+    }
+    const size_t body = (len - LOG_STORE_HDR_WORDS) * sizeof(uint32_t);
+    const bool identical = memcmp(&stored[LOG_STORE_HDR_WORDS], &record[LOG_STORE_HDR_WORDS], body) == 0;
+    if (!identical && (!MACRO_LOG_STORE_COLLAPSE_TEMPLATE || LOG_REC_KIND(hdr) != LOG_REC_BINARY)) {
+        return false;
+    }
+    if (s_log_store.repeat_count == 0U) {
+        s_log_store.repeat_first_ms = record[2];
+    }
+    s_log_store.repeat_count++;
+    s_log_store.repeat_last_ms = record[2];
+    s_log_store.repeat_varied |= !identical;
+    s_log_store.collapsed_total++;
+    return true;
+}
+
+// Called right after the first record of a line was appended.
+static void collapse_remember_locked(uint32_t hdr, uint32_t len)
+{
+    if (MACRO_LOG_STORE_COLLAPSE && (hdr & LOG_REC_EOL) != 0U) {
+        s_log_store.repeat_pos = s_log_store.head_pos - len;
+        s_log_store.repeat_id = s_log_store.next_id;
+    }
+}
+
+// The header a staged record is stored with: the last record always closes the line, including a
+// partial line flushed on age.
+static uint32_t staged_final_header(uint32_t hdr, uint32_t pos, uint32_t end)
+{
+    return (hdr & ~LOG_REC_STAGED) | (((pos + LOG_REC_LEN(hdr)) == end) ? LOG_REC_EOL : 0U);
+}
+
+// Outside the lock: puts each record's RTC CRC into its (unused while staged) id word.
+static void staging_prepare_line(log_staging_t *st, uint32_t end)
+{
+    if (!MACRO_LOG_STORE_RTC_ENABLED) {
+        return;
+    }
+    uint32_t pos = st->tail;
+    while (pos != end) {
+        const uint32_t idx = pos % LOG_STORE_STAGING_WORDS;
+        const uint32_t hdr = st->words[idx];
+        if (LOG_REC_KIND(hdr) == LOG_REC_PAD) {
+            pos += LOG_STORE_STAGING_WORDS - idx;
+            continue;
+        }
+        st->words[idx + 1U] = rtc_record_crc(staged_final_header(hdr, pos, end), &st->words[idx], LOG_REC_LEN(hdr));
+        pos += LOG_REC_LEN(hdr);
+    }
+}
+
+// Returns false, with the line left staged, when a counted run of repeats has to be reported first.
+static bool staging_move_line_locked(log_staging_t *st, uint32_t end)
+{
+    uint32_t pos = st->tail;
+    bool line_start = true;
+    while (pos != end) {
+        const uint32_t idx = pos % LOG_STORE_STAGING_WORDS;
+        const uint32_t hdr = st->words[idx];
+        const uint32_t len = (LOG_REC_KIND(hdr) == LOG_REC_PAD) ? (LOG_STORE_STAGING_WORDS - idx) : LOG_REC_LEN(hdr);
+        if (LOG_REC_KIND(hdr) != LOG_REC_PAD) {
+            const uint32_t final_hdr = staged_final_header(hdr, pos, end);
+            const bool first = line_start;
+            line_start = false;
+            bool collapsed = false;
+            if (first) {
+                collapsed = collapse_locked(final_hdr, &st->words[idx], len);
+                if (!collapsed && s_log_store.repeat_count > 0U) {
+                    // Pads cleared so far are consumed; the line is picked again after the report.
+                    __atomic_store_n(&st->tail, pos, __ATOMIC_RELEASE);
+                    return false;
+                }
+            }
+            if (!collapsed) {
+                st->words[idx] = final_hdr;
+                // ring_append_locked() replaces the CRC with the line id.
+                const uint32_t crc = st->words[idx + 1U];
+                ring_append_locked(&st->words[idx], len);
+                rtc_append_locked(&st->words[idx], len, crc);
+                if (first) {
+                    collapse_remember_locked(final_hdr, len);
+                }
+            }
+        }
+        // Producers detect committed records by a non-zero header, so the whole span is cleared.
+        memset(&st->words[idx], 0, len * sizeof(uint32_t));
+        pos += len;
+    }
+    __atomic_store_n(&st->tail, end, __ATOMIC_RELEASE);
+    return true;
+}
+
+// The record and its CRC are built before the lock is taken.
+static void append_text_line(const char *text, uint32_t timestamp_ms)
+{
+    uint32_t record[LOG_STORE_HDR_WORDS + (LOG_STORE_NOTICE_MAX / 4U)];
+    const uint32_t len = make_text_record(record, LOG_STORE_HDR_WORDS + (LOG_STORE_NOTICE_MAX / 4U), text, true,
+                                          timestamp_ms);
+    const uint32_t crc = rtc_record_crc(record[0], record, len);
+    portENTER_CRITICAL(&s_log_store.lock);
+    ring_append_locked(record, len);
+    rtc_append_locked(record, len, crc);
+    portEXIT_CRITICAL(&s_log_store.lock);
+}
+
+// Adds the "last line repeated N more times" line for the run counted so far, once the run has been
+// quiet for LOG_STORE_REPEAT_IDLE_MS or has lasted LOG_STORE_REPEAT_REPORT_MS (always when force).
+// The line carries the time of the last repeat, so it is a new entry with its own id that cursor
+// readers and the archive pick up.
+static bool repeat_report(uint32_t now_ms, bool force)
+{
+    portENTER_CRITICAL(&s_log_store.lock);
+    uint32_t count = s_log_store.repeat_count;
+    const uint32_t last_ms = s_log_store.repeat_last_ms;
+    const bool varied = s_log_store.repeat_varied;
+    // Signed: a line staged after now_ms was read may carry a later timestamp.
+    if (count > 0U && (force || (int32_t)(now_ms - last_ms) >= (int32_t)LOG_STORE_REPEAT_IDLE_MS ||
+                       (int32_t)(now_ms - s_log_store.repeat_first_ms) >= (int32_t)LOG_STORE_REPEAT_REPORT_MS)) {
+        s_log_store.repeat_count = 0U;
+        s_log_store.repeat_varied = false;
+    } else {
+        count = 0U;
+    }
+    portEXIT_CRITICAL(&s_log_store.lock);
+    if (count == 0U) {
+        return false;
+    }
+
+    char notice[LOG_STORE_NOTICE_MAX];
+    (void)snprintf(notice, sizeof(notice), "log_store: last line repeated %lu more times%s",
+                   (unsigned long)count, varied ? " (values varied)" : "");
+    append_text_line(notice, last_ms);
+    return true;
+}
+
+// Adds a line of the store's own after any pending repeat report, so that report still follows its line.
+static void append_notice(const char *text)
+{
+    (void)repeat_report(0U, true);
+    append_text_line(text, esp_log_timestamp());
+}
+
+// Every LOG_STORE_RATE_REPORT_MS: adds one notice per tag that was limited and re-bases idle buckets so
+// their tat never falls 2^31 ticks behind.
+static bool rate_report(uint32_t now_ms)
+{
+    if ((now_ms - s_log_store.rate_report_ms) < LOG_STORE_RATE_REPORT_MS) {
+        return false;
+    }
+    s_log_store.rate_report_ms = now_ms;
+
+    bool reported = false;
+    const uint32_t now = now_ms * LOG_STORE_RATE_TICKS_PER_MS;
+    for (uint32_t i = 0; i < LOG_STORE_RATE_SLOTS; ++i) {
+        log_rate_slot_t *slot = &s_log_store.rate[i];
+        if (__atomic_load_n(&slot->interval, __ATOMIC_ACQUIRE) == 0U) {
+            continue;
+        }
+        uint32_t tat = __atomic_load_n(&slot->tat, __ATOMIC_RELAXED);
+        if ((int32_t)(now - tat) > 0) {
+            (void)__atomic_compare_exchange_n(&slot->tat, &tat, now, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+        }
+        const uint32_t suppressed = __atomic_exchange_n(&slot->suppressed, 0U, __ATOMIC_RELAXED);
+        if (suppressed == 0U) {
+            continue;
+        }
+        char notice[LOG_STORE_NOTICE_MAX];
+        (void)snprintf(notice, sizeof(notice), "log_store: %lu lines from %.23s rate-limited",
+                       (unsigned long)suppressed, slot->tag);
+        portENTER_CRITICAL(&s_log_store.lock);
+        slot->suppressed_total += suppressed;
+        s_log_store.rate_limited_total += suppressed;
+        portEXIT_CRITICAL(&s_log_store.lock);
+        append_notice(notice);
+        reported = true;
+    }
+    return reported;
+}
+
+// Moves staged lines into the shared ring, oldest line head first across cores, then reports drops.
+// final reports a pending run of repeats right away (shutdown).
+static void drain_staging(bool final)
+{
+    const uint32_t now_ms = esp_log_timestamp();
+    bool moved = false;
+    while (true) {
+        log_staging_t *pick = NULL;
+        uint32_t pick_end = 0;
+        uint32_t pick_ts = 0;
+        for (uint32_t core = 0; core < portNUM_PROCESSORS; ++core) {
+            log_staging_t *st = &s_log_store.staging[core];
+            uint32_t end = 0;
+            uint32_t ts = 0;
+            if (staging_next_line(st, now_ms, &end, &ts) && (pick == NULL || (int32_t)(ts - pick_ts) < 0)) {
+                pick = st;
+                pick_end = end;
+                pick_ts = ts;
             }
         }
+        if (pick == NULL) {
+            break;
+        }
+        staging_prepare_line(pick, pick_end);
+        portENTER_CRITICAL(&s_log_store.lock);
+        const bool line_moved = staging_move_line_locked(pick, pick_end);
+        portEXIT_CRITICAL(&s_log_store.lock);
+        if (!line_moved) {
+            // A different line ends the run; its count goes in ahead of it.
+            (void)repeat_report(now_ms, true);
+        }
+        moved = true;
+    }
 
-        if (c == '\n') {
-            emit_accum_line_locked();
-            s_log_store.accum_len = 0U;
-            s_log_store.accum[0] = '\0';
+    for (uint32_t core = 0; core < portNUM_PROCESSORS; ++core) {
+        log_staging_t *st = &s_log_store.staging[core];
+        const uint32_t dropped = __atomic_exchange_n(&st->dropped, 0U, __ATOMIC_RELAXED);
+        if (dropped > 0U) {
+            portENTER_CRITICAL(&s_log_store.lock);
+            s_log_store.dropped_total += dropped;
+            portEXIT_CRITICAL(&s_log_store.lock);
+            char notice[LOG_STORE_NOTICE_MAX];
+            (void)snprintf(notice, sizeof(notice), "log_store: %lu lines dropped on core %lu",
+                           (unsigned long)dropped, (unsigned long)core);
+            append_notice(notice);
+            moved = true;
         }
     }
-    if (s_log_store.lock != NULL) {
-        (void)xSemaphoreGiveRecursive(s_log_store.lock);
+
+    if (rate_report(now_ms)) {
+        moved = true;
+    }
+    if (repeat_report(now_ms, final)) {
+        moved = true;
     }
 
-    return raw_ret;
+    const log_store_commit_cb_t commit_cb = s_log_store.commit_cb;
+    if (moved && commit_cb != NULL) {
+        commit_cb();
+    }
+}
+
+static void log_drain_task(void *arg)
+{
+    (void)arg;
+    while (true) {
+        vTaskDelay(pdMS_TO_TICKS(MACRO_LOG_STORE_DRAIN_PERIOD_MS));
+        drain_staging(false);
+    }
+}
+
+// Copies the record at *pos (skipping pads) and advances *pos. Jumps to the oldest record if *pos was overwritten.
+static bool ring_read_record(uint64_t *pos, uint64_t end_pos, uint32_t *out, uint32_t out_words)
+{
+    bool found = false;
+    portENTER_CRITICAL(&s_log_store.lock);
+    while (*pos < end_pos && *pos < s_log_store.head_pos) {
+        if (*pos < s_log_store.tail_pos) {
+            *pos = s_log_store.tail_pos;
+            continue;
+        }
+        const uint32_t idx = (uint32_t)(*pos % LOG_STORE_RING_WORDS);
+        const uint32_t hdr = s_log_store.ring[idx];
+        if (LOG_REC_KIND(hdr) == LOG_REC_PAD) {
+            *pos += LOG_STORE_RING_WORDS - idx;
+            continue;
+        }
+        const uint32_t len = LOG_REC_LEN(hdr);
+        const uint32_t copy = (len < out_words) ? len : out_words;
+        memcpy(out, &s_log_store.ring[idx], copy * sizeof(uint32_t));
+        *pos += len;
+        found = true;
+        break;
+    }
+    portEXIT_CRITICAL(&s_log_store.lock);
+    return found;
+}
+
+static size_t append_text(char *out, size_t out_size, size_t used, const char *text)
+{
+    if (used >= out_size - 1U) {
+        return used;
+    }
+    const size_t room = out_size - 1U - used;
+    const size_t n = strnlen(text, room);
+    memcpy(&out[used], text, n);
+    out[used + n] = '\0';
+    return used + n;
+}
+
+static const char *record_string(const uint32_t *record, uint32_t word)
+{
+    if ((word & 0xFFFF0000U) == LOG_STORE_INLINE_STR_TAG) {
+        const char *strings = (const char *)&record[LOG_STORE_HDR_WORDS + LOG_REC_ARG_WORDS(record[0])];
+        return &strings[word & 0xFFFFU];
+    }
+    return (word == 0U) ? "(null)" : (const char *)(uintptr_t)word;
+}
+
+// Read side: re-walks the format string and renders each conversion from the stored words.
+static size_t format_binary_record(const uint32_t *record, char *out, size_t out_size, size_t used)
+{
+    const char *fmt = (const char *)(uintptr_t)record[3];
+    const uint32_t *words = &record[LOG_STORE_HDR_WORDS];
+    const uint32_t nwords = LOG_REC_ARG_WORDS(record[0]);
+    uint32_t w = 0;
+    char piece[LOG_STORE_FORMAT_BUF_MAX];
+
+    const char *p = fmt;
+    while (*p != '\0' && used < out_size - 1U) {
+        if (*p != '%') {
+            const char *next = strchr(p, '%');
+            const size_t run = (next != NULL) ? (size_t)(next - p) : strlen(p);
+            const size_t room = out_size - 1U - used;
+            const size_t n = (run < room) ? run : room;
+            memcpy(&out[used], p, n);
+            used += n;
+            out[used] = '\0';
+            p += run;
+            continue;
+        }
+
+        log_spec_t spec;
+        p = parse_spec(p, &spec);
+        if (spec.kind == LOG_ARG_NONE) {
+            used = append_text(out, out_size, used, "%");
+            continue;
+        }
+
+        // Rebuild the spec with star values substituted and length modifiers normalized.
+        char spec_fmt[LOG_STORE_SPEC_MAX];
+        size_t s = 0;
+        for (const char *c = spec.start; c < spec.end - 1 && s < sizeof(spec_fmt) - 4U; ++c) {
+            if (*c == '*') {
+                const int v = (w < nwords) ? (int)words[w++] : 0;
+                s += (size_t)snprintf(&spec_fmt[s], sizeof(spec_fmt) - s, "%d", v);
+            } else if (strchr("lhjzt", *c) == NULL) {
+                spec_fmt[s++] = *c;
+            }
+        }
+        if (spec.kind == LOG_ARG_I64 && s < sizeof(spec_fmt) - 3U) {
+            spec_fmt[s++] = 'l';
+            spec_fmt[s++] = 'l';
+        }
+        spec_fmt[s++] = spec.conv;
+        spec_fmt[s] = '\0';
+
+        piece[0] = '\0';
+        switch (spec.kind) {
+        case LOG_ARG_I64: {
+            const unsigned long long v = (w + 2U <= nwords)
+                ? ((unsigned long long)words[w] | ((unsigned long long)words[w + 1U] << 32)) : 0ULL;
+            w += 2U;
+            (void)snprintf(piece, sizeof(piece), spec_fmt, v);
+            break;
+        }
+        case LOG_ARG_F64: {
+            double v = 0.0;
+            if (w + 2U <= nwords) {
+                memcpy(&v, &words[w], sizeof(v));
+            }
+            w += 2U;
+            (void)snprintf(piece, sizeof(piece), spec_fmt, v);
+            break;
+        }
+        case LOG_ARG_STR:
+            (void)snprintf(piece, sizeof(piece), spec_fmt, (w < nwords) ? record_string(record, words[w]) : "");
+            w++;
+            break;
+        default:
+            if (spec.conv == 'p') {
+                (void)snprintf(piece, sizeof(piece), spec_fmt, (void *)(uintptr_t)((w < nwords) ? words[w] : 0U));
+            } else {
+                (void)snprintf(piece, sizeof(piece), spec_fmt, (w < nwords) ? words[w] : 0U);
+            }
+            w++;
+            break;
+        }
+        used = append_text(out, out_size, used, piece);
+    }
+    return used;
+}
+
+// Renders the line starting at *pos into out; consecutive records are joined until one ends the line.
+static bool format_line(uint64_t *pos, uint64_t end_pos, log_store_entry_t *out)
+{
+    uint32_t record[LOG_STORE_RECORD_MAX_WORDS];
+    size_t used = 0;
+    bool first = true;
+    out->line[0] = '\0';
+
+    const uint64_t start_pos = *pos;
+    while (ring_read_record(pos, end_pos, record, LOG_STORE_RECORD_MAX_WORDS)) {
+        if (first && (*pos - LOG_REC_LEN(record[0])) != start_pos) {
+            // The line was overwritten after it was selected.
+            return false;
+        }
+        if (first) {
+            out->id = record[1];
+            used = (size_t)snprintf(out->line, sizeof(out->line), "[+%lu ms] ", (unsigned long)record[2]);
+            first = false;
+        }
+        if (LOG_REC_KIND(record[0]) == LOG_REC_TEXT) {
+            used = append_text(out->line, sizeof(out->line), used, (const char *)&record[LOG_STORE_HDR_WORDS]);
+        } else {
+            used = format_binary_record(record, out->line, sizeof(out->line), used);
+        }
+        if ((record[0] & LOG_REC_EOL) != 0U) {
+            break;
+        }
+    }
+    trim_log_message(out->line);
+    return !first;
+}
+
+// Parses the "L (time) TAG: " prefix of ESP_LOGx output.
+static bool text_level_tag(const char *text, char *out_level, const char **out_tag, size_t *out_tag_len)
+{
+    const char *p = skip_color(text);
+    if (level_rank(p[0]) == 0U || p[1] != ' ' || p[2] != '(') {
+        return false;
+    }
+    const char *close = strchr(&p[3], ')');
+    if (close == NULL || close[1] != ' ') {
+        return false;
+    }
+    const char *colon = strchr(&close[2], ':');
+    if (colon == NULL) {
+        return false;
+    }
+    *out_level = p[0];
+    *out_tag = &close[2];
+    *out_tag_len = (size_t)(colon - &close[2]);
+    return true;
+}
+
+// Binary records keep the level in the format literal and the tag in the second argument word.
+static bool binary_level_tag(const uint32_t *record, char *out_level, const char **out_tag, size_t *out_tag_len)
+{
+    const char level = fmt_log_level((const char *)(uintptr_t)record[3]);
+    if (level == '\0' || LOG_REC_ARG_WORDS(record[0]) < 2U) {
+        return false;
+    }
+    *out_level = level;
+    *out_tag = record_string(record, record[LOG_STORE_HDR_WORDS + 1U]);
+    *out_tag_len = strlen(*out_tag);
+    return true;
+}
+
+static bool filter_accepts(const log_store_filter_t *filter, bool known, char level, const char *tag, size_t tag_len)
+{
+    if (!known) {
+        level = 'I';
+        tag = "";
+        tag_len = 0U;
+    }
+    if (filter->max_level != '\0' && level_rank(level) > level_rank(filter->max_level)) {
+        return false;
+    }
+    if (filter->tag[0] != '\0' && (strlen(filter->tag) != tag_len || strncmp(filter->tag, tag, tag_len) != 0)) {
+        return false;
+    }
+    return true;
+}
+
+static bool filter_is_empty(const log_store_filter_t *filter)
+{
+    return filter == NULL || (filter->max_level == '\0' && filter->tag[0] == '\0');
+}
+
+#if MACRO_LOG_STORE_RTC_ENABLED
+// Replays the previous boot's RTC records into the ring between two marker lines, then restarts the RTC ring.
+static void rtc_import(void)
+{
+    const bool valid = esp_reset_reason() != ESP_RST_POWERON &&
+                       s_rtc_log.magic == LOG_STORE_RTC_MAGIC &&
+                       s_rtc_log.words == LOG_STORE_RTC_WORDS &&
+                       s_rtc_log.crc == rtc_header_crc() &&
+                       (s_rtc_log.head - s_rtc_log.tail) <= LOG_STORE_RTC_WORDS;
+    if (!valid || s_rtc_log.head == s_rtc_log.tail) {
+        rtc_reset();
+        return;
+    }
+
+    const esp_app_desc_t *app = esp_app_get_description();
+    const bool same_image = memcmp(s_rtc_log.image_id, app->app_elf_sha256, sizeof(s_rtc_log.image_id)) == 0;
+    uint32_t record[LOG_STORE_RECORD_MAX_WORDS];
+    uint32_t imported = 0;
+    uint32_t skipped = 0;
+
+    // Keep the markers and replayed records out of the RTC ring while it is being read.
+    s_rtc_frozen = true;
+    append_notice("---- previous boot (from RTC memory) ----");
+
+    uint32_t pos = s_rtc_log.tail;
+    while (pos != s_rtc_log.head) {
+        const uint32_t idx = pos % LOG_STORE_RTC_WORDS;
+        const uint32_t hdr = s_rtc_log.ring[idx];
+        if (LOG_REC_KIND(hdr) == LOG_REC_PAD) {
+            pos += LOG_STORE_RTC_WORDS - idx;
+            continue;
+        }
+        const uint32_t len = LOG_REC_LEN(hdr);
+        if (len < LOG_STORE_HDR_WORDS || len > LOG_STORE_RECORD_MAX_WORDS || (idx + len) > LOG_STORE_RTC_WORDS) {
+            // Walk structure is broken; nothing after this point can be located.
+            break;
+        }
+        memcpy(record, &s_rtc_log.ring[idx], len * sizeof(uint32_t));
+        pos += len;
+        const uint32_t crc = record[1];
+        record[1] = 0U;
+        if (crc != esp_rom_crc32_le(0U, (const uint8_t *)record, len * sizeof(uint32_t)) ||
+            (LOG_REC_KIND(hdr) == LOG_REC_BINARY && !same_image)) {
+            skipped++;
+            continue;
+        }
+        portENTER_CRITICAL(&s_log_store.lock);
+        ring_append_locked(record, len);
+        portEXIT_CRITICAL(&s_log_store.lock);
+        imported++;
+    }
+
+    char notice[LOG_STORE_NOTICE_MAX];
+    (void)snprintf(notice, sizeof(notice), "---- end of previous boot: %lu records, %lu skipped ----",
+                   (unsigned long)imported, (unsigned long)skipped);
+    append_notice(notice);
+    portENTER_CRITICAL(&s_log_store.lock);
+    s_log_store.replay_last_id = s_log_store.next_id;
+    portEXIT_CRITICAL(&s_log_store.lock);
+    rtc_reset();
+    s_rtc_frozen = false;
+}
+
+// Rewrites binary RTC records as text, because the next image (e.g. after OTA) cannot resolve
+// this image's format pointers.
+static void rtc_textify(void)
+{
+    portENTER_CRITICAL(&s_log_store.lock);
+    s_rtc_frozen = true;
+    portEXIT_CRITICAL(&s_log_store.lock);
+
+    uint32_t *copy = malloc(sizeof(s_rtc_log.ring));
+    if (copy == NULL) {
+        return;
+    }
+    memcpy(copy, s_rtc_log.ring, sizeof(s_rtc_log.ring));
+    const uint32_t head = s_rtc_log.head;
+    uint32_t pos = s_rtc_log.tail;
+    rtc_reset();
+
+    uint32_t record[LOG_STORE_HDR_WORDS + (LOG_STORE_FORMAT_BUF_MAX / 4U)];
+    char text[LOG_STORE_FORMAT_BUF_MAX];
+    while (pos != head) {
+        const uint32_t idx = pos % LOG_STORE_RTC_WORDS;
+        const uint32_t hdr = copy[idx];
+        if (LOG_REC_KIND(hdr) == LOG_REC_PAD) {
+            pos += LOG_STORE_RTC_WORDS - idx;
+            continue;
+        }
+        const uint32_t *src = &copy[idx];
+        pos += LOG_REC_LEN(hdr);
+        if (LOG_REC_KIND(hdr) == LOG_REC_TEXT) {
+            rtc_write(src, LOG_REC_LEN(hdr), rtc_record_crc(hdr, src, LOG_REC_LEN(hdr)));
+            continue;
+        }
+        text[0] = '\0';
+        (void)format_binary_record(src, text, sizeof(text), 0U);
+        const uint32_t len = make_text_record(record, LOG_STORE_HDR_WORDS + (LOG_STORE_FORMAT_BUF_MAX / 4U), text,
+                                              (hdr & LOG_REC_EOL) != 0U, src[2]);
+        rtc_write(record, len, rtc_record_crc(record[0], record, len));
+    }
+    free(copy);
+}
+#endif
+
+// Runs inside esp_restart(): the last staged lines are moved into the ring before anything is persisted.
+static void log_store_shutdown_handler(void)
+{
+    if (s_log_store.drain_task != NULL) {
+        vTaskSuspend(s_log_store.drain_task);
+    }
+    drain_staging(true);
+    if (s_log_store.shutdown_cb != NULL) {
+        s_log_store.shutdown_cb();
+    }
+#if MACRO_LOG_STORE_RTC_ENABLED
+    rtc_textify();
+#endif
+}
+
+static void reverse_ids(log_store_entry_t *entries, size_t from, size_t to)
+{
+    while (from + 1U < to) {
+        const uint32_t tmp = entries[from].id;
+        entries[from++].id = entries[--to].id;
+        entries[to].id = tmp;
+    }
 }
 
 esp_err_t log_store_init(void)
@@ -160,14 +1474,33 @@ esp_err_t log_store_init(void)
         return ESP_OK;
     }
 
-    memset(&s_log_store, 0, sizeof(s_log_store));
-    s_log_store.lock = xSemaphoreCreateRecursiveMutex();
-    if (s_log_store.lock == NULL) {
+    s_log_store.head_pos = 0U;
+    s_log_store.tail_pos = 0U;
+    s_log_store.records = 0U;
+    s_log_store.next_id = 0U;
+    s_log_store.time_synced = is_wall_time_valid();
+    // The generated table holds a single {NULL} row when log_store.rate_limits is empty.
+    for (size_t i = 0; i < sizeof(g_log_store_rate_limits) / sizeof(g_log_store_rate_limits[0]); ++i) {
+        const macro_log_rate_limit_t *limit = &g_log_store_rate_limits[i];
+        if (limit->tag != NULL) {
+            (void)log_store_set_rate_limit(limit->tag, limit->per_sec, limit->burst);
+        }
+    }
+#if MACRO_LOG_STORE_RTC_ENABLED
+    rtc_import();
+#endif
+    (void)esp_register_shutdown_handler(log_store_shutdown_handler);
+    if (xTaskCreate(log_drain_task,
+                    "log_drain",
+                    LOG_STORE_DRAIN_TASK_STACK,
+                    NULL,
+                    LOG_STORE_DRAIN_TASK_PRIO,
+                    &s_log_store.drain_task) != pdPASS) {
         return ESP_ERR_NO_MEM;
     }
-    s_log_store.time_synced = is_wall_time_valid();
-    s_log_store.prev_vprintf = esp_log_set_vprintf(log_store_vprintf);
     s_log_store.initialized = true;
+    s_log_store.prev_vprintf = esp_log_set_vprintf(log_store_vprintf);
+    (void)bench_register(&s_bench_log_append);
     return ESP_OK;
 }
 
@@ -181,39 +1514,283 @@ bool log_store_is_time_synced(void)
     return s_log_store.time_synced || is_wall_time_valid();
 }
 
+void log_store_get_stats(log_store_stats_t *out_stats)
+{
+    if (out_stats == NULL) {
+        return;
+    }
+    memset(out_stats, 0, sizeof(*out_stats));
+    portENTER_CRITICAL(&s_log_store.lock);
+    out_stats->records = s_log_store.records;
+    out_stats->dropped = s_log_store.dropped_total;
+    out_stats->collapsed = s_log_store.collapsed_total;
+    out_stats->rate_limited = s_log_store.rate_limited_total;
+    out_stats->last_id = s_log_store.next_id;
+    out_stats->replay_last_id = s_log_store.replay_last_id;
+    out_stats->ring_used_bytes = (uint32_t)(s_log_store.head_pos - s_log_store.tail_pos) * sizeof(uint32_t);
+    portEXIT_CRITICAL(&s_log_store.lock);
+    for (uint32_t core = 0; core < portNUM_PROCESSORS; ++core) {
+        const log_staging_t *st = &s_log_store.staging[core];
+        // Drops not yet folded in by the drain task.
+        out_stats->dropped += __atomic_load_n(&st->dropped, __ATOMIC_RELAXED);
+        const uint32_t peak = __atomic_load_n(&st->peak_words, __ATOMIC_RELAXED) * sizeof(uint32_t);
+        if (peak > out_stats->staging_peak_bytes) {
+            out_stats->staging_peak_bytes = peak;
+        }
+    }
+}
+
+// out_entries[i].id holds the start of line i as a word offset from base_pos; entry i is rendered in place.
+static size_t format_selected(log_store_entry_t *out_entries, size_t count, uint64_t base_pos, uint64_t end_pos)
+{
+    size_t produced = 0;
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t line_pos = base_pos + out_entries[i].id;
+        if (format_line(&line_pos, end_pos, &out_entries[produced]) && out_entries[produced].line[0] != '\0') {
+            produced++;
+        }
+    }
+    return produced;
+}
+
 size_t log_store_copy_recent(log_store_entry_t *out_entries, size_t out_cap, size_t limit)
 {
     if (!s_log_store.initialized || out_entries == NULL || out_cap == 0U) {
         return 0U;
     }
 
-    if (s_log_store.lock != NULL) {
-        (void)xSemaphoreTakeRecursive(s_log_store.lock, portMAX_DELAY);
+    size_t wanted = limit;
+    if (wanted == 0U || wanted > out_cap) {
+        wanted = out_cap;
     }
 
-    const size_t available = s_log_store.count;
-    size_t wanted = limit;
-    if (wanted == 0U || wanted > available) {
-        wanted = available;
+    portENTER_CRITICAL(&s_log_store.lock);
+    uint64_t pos = s_log_store.tail_pos;
+    const uint64_t end_pos = s_log_store.head_pos;
+    portEXIT_CRITICAL(&s_log_store.lock);
+
+    // Pass 1: remember where the last `wanted` lines start (header reads only, no formatting).
+    // out_entries[].id temporarily holds each start as a word offset from base_pos.
+    uint32_t hdr[LOG_STORE_HDR_WORDS];
+    size_t lines = 0;
+    bool at_line_start = true;
+    const uint64_t base_pos = pos;
+    while (ring_read_record(&pos, end_pos, hdr, LOG_STORE_HDR_WORDS)) {
+        if (at_line_start) {
+            out_entries[lines % wanted].id = (uint32_t)(pos - LOG_REC_LEN(hdr[0]) - base_pos);
+            lines++;
+        }
+        at_line_start = (hdr[0] & LOG_REC_EOL) != 0U;
     }
-    if (wanted > out_cap) {
-        wanted = out_cap;
+
+    const size_t count = (lines < wanted) ? lines : wanted;
+    if (lines > wanted) {
+        // Rotate the circular start list so the oldest selected line comes first.
+        const size_t first = lines % wanted;
+        reverse_ids(out_entries, 0U, first);
+        reverse_ids(out_entries, first, wanted);
+        reverse_ids(out_entries, 0U, wanted);
     }
 
-    size_t start = 0U;
-    if (available > wanted) {
-        start = (s_log_store.head + LOG_STORE_MAX_ENTRIES - wanted) % LOG_STORE_MAX_ENTRIES;
-    } else {
-        start = (s_log_store.head + LOG_STORE_MAX_ENTRIES - available) % LOG_STORE_MAX_ENTRIES;
+    // Pass 2: format only the selected lines.
+    return format_selected(out_entries, count, base_pos, end_pos);
+}
+
+size_t log_store_copy_since(uint32_t after_id, log_store_entry_t *out_entries, size_t out_cap)
+{
+    if (!s_log_store.initialized || out_entries == NULL || out_cap == 0U) {
+        return 0U;
+    }
+
+    portENTER_CRITICAL(&s_log_store.lock);
+    uint64_t pos = s_log_store.tail_pos;
+    const uint64_t end_pos = s_log_store.head_pos;
+    portEXIT_CRITICAL(&s_log_store.lock);
+
+    uint32_t hdr[LOG_STORE_HDR_WORDS];
+    size_t count = 0;
+    bool at_line_start = true;
+    const uint64_t base_pos = pos;
+    while (count < out_cap && ring_read_record(&pos, end_pos, hdr, LOG_STORE_HDR_WORDS)) {
+        if (at_line_start && (int32_t)(hdr[1] - after_id) > 0) {
+            out_entries[count++].id = (uint32_t)(pos - LOG_REC_LEN(hdr[0]) - base_pos);
+        }
+        at_line_start = (hdr[0] & LOG_REC_EOL) != 0U;
+    }
+    return format_selected(out_entries, count, base_pos, end_pos);
+}
+
+bool log_store_line_matches(const char *line, const log_store_filter_t *filter)
+{
+    if (filter_is_empty(filter)) {
+        return true;
+    }
+    if (line == NULL) {
+        return false;
+    }
+    // Skip the "[+N ms] " prefix added by format_line.
+    const char *p = line;
+    if (p[0] == '[') {
+        const char *close = strstr(p, "] ");
+        if (close != NULL) {
+            p = close + 2;
+        }
+    }
+    char level = '\0';
+    const char *tag = NULL;
+    size_t tag_len = 0;
+    const bool known = text_level_tag(p, &level, &tag, &tag_len);
+    return filter_accepts(filter, known, level, tag, tag_len);
+}
+
+// Filter decision from the first record of the line at line_pos. Kept out of log_store_visit_since() so
+// that unfiltered visits (the archive flush, also run from the esp_restart() hook) need no record buffer.
+static bool line_filter_accepts(uint64_t line_pos, uint64_t end_pos, const log_store_filter_t *filter, bool *out_known)
+{
+    uint32_t record[LOG_STORE_RECORD_MAX_WORDS];
+    uint64_t pos = line_pos;
+    *out_known = false;
+    if (!ring_read_record(&pos, end_pos, record, LOG_STORE_RECORD_MAX_WORDS) || (pos - LOG_REC_LEN(record[0])) != line_pos) {
+        return true;
+    }
+    char level = '\0';
+    const char *tag = NULL;
+    size_t tag_len = 0;
+    *out_known = (LOG_REC_KIND(record[0]) == LOG_REC_TEXT)
+        ? text_level_tag((const char *)&record[LOG_STORE_HDR_WORDS], &level, &tag, &tag_len)
+        : binary_level_tag(record, &level, &tag, &tag_len);
+    return !*out_known || filter_accepts(filter, true, level, tag, tag_len);
+}
+
+size_t log_store_visit_since(log_store_cursor_t *cursor, const log_store_filter_t *filter, log_store_line_cb_t cb, void *ctx)
+{
+    if (!s_log_store.initialized || cursor == NULL || cb == NULL) {
+        return 0U;
+    }
+
+    portENTER_CRITICAL(&s_log_store.lock);
+    const uint64_t tail_pos = s_log_store.tail_pos;
+    const uint64_t end_pos = s_log_store.head_pos;
+    portEXIT_CRITICAL(&s_log_store.lock);
+
+    // Resume at the end of the last visited line unless it has been overwritten since.
+    uint64_t pos = (cursor->pos >= tail_pos && cursor->pos <= end_pos) ? cursor->pos : tail_pos;
+    const bool filtered = !filter_is_empty(filter);
+    uint32_t hdr[LOG_STORE_HDR_WORDS];
+    log_store_entry_t entry;
+    size_t delivered = 0;
+
+    while (ring_read_record(&pos, end_pos, hdr, LOG_STORE_HDR_WORDS)) {
+        const uint64_t line_pos = pos - LOG_REC_LEN(hdr[0]);
+        const uint32_t id = hdr[1];
+        uint64_t line_end = pos;
+        bool eol = (hdr[0] & LOG_REC_EOL) != 0U;
+        while (!eol && ring_read_record(&line_end, end_pos, hdr, LOG_STORE_HDR_WORDS)) {
+            eol = (hdr[0] & LOG_REC_EOL) != 0U;
+        }
+
+        if ((int32_t)(id - cursor->last_id) > 0) {
+            // Decide from the first record when its layout is known; otherwise match the rendered text.
+            bool known = false;
+            bool wanted = !filtered || line_filter_accepts(line_pos, end_pos, filter, &known);
+            uint64_t format_pos = line_pos;
+            if (wanted && format_line(&format_pos, end_pos, &entry) && entry.line[0] != '\0') {
+                if (filtered && !known) {
+                    wanted = log_store_line_matches(entry.line, filter);
+                }
+                if (wanted) {
+                    if (!cb(&entry, ctx)) {
+                        break;
+                    }
+                    delivered++;
+                }
+            }
+            cursor->last_id = id;
+        }
+        cursor->pos = line_end;
+        pos = line_end;
     }
+    return delivered;
+}
+
+void log_store_set_shutdown_callback(log_store_shutdown_cb_t cb)
+{
+    s_log_store.shutdown_cb = cb;
+}
 
-    for (size_t i = 0; i < wanted; ++i) {
-        const size_t src_idx = (start + i) % LOG_STORE_MAX_ENTRIES;
-        out_entries[i] = s_log_store.entries[src_idx];
+esp_err_t log_store_set_rate_limit(const char *tag, uint32_t per_sec, uint32_t burst)
+{
+    if (tag == NULL || tag[0] == '\0' || strlen(tag) >= sizeof(s_log_store.rate[0].tag) ||
+        per_sec > LOG_STORE_RATE_MAX_PER_SEC || burst > UINT16_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (burst == 0U) {
+        burst = 1U;
     }
 
-    if (s_log_store.lock != NULL) {
-        (void)xSemaphoreGiveRecursive(s_log_store.lock);
+    esp_err_t err = ESP_OK;
+    portENTER_CRITICAL(&s_log_store.lock);
+    log_rate_slot_t *slot = NULL;
+    log_rate_slot_t *free_slot = NULL;
+    for (uint32_t i = 0; i < LOG_STORE_RATE_SLOTS; ++i) {
+        log_rate_slot_t *candidate = &s_log_store.rate[i];
+        if (candidate->interval != 0U && strcmp(candidate->tag, tag) == 0) {
+            slot = candidate;
+        } else if (candidate->interval == 0U && free_slot == NULL) {
+            free_slot = candidate;
+        }
+    }
+    if (slot == NULL && per_sec > 0U) {
+        slot = free_slot;
+        if (slot == NULL) {
+            err = ESP_ERR_NO_MEM;
+        } else {
+            s_log_store.rate_active++;
+        }
+    } else if (slot != NULL && per_sec == 0U) {
+        s_log_store.rate_active--;
     }
-    return wanted;
+
+    if (slot != NULL) {
+        // Producers ignore the slot while interval is 0, so the tag is never read half-written.
+        __atomic_store_n(&slot->interval, 0U, __ATOMIC_RELEASE);
+        if (per_sec > 0U) {
+            const uint32_t interval = (1000U * LOG_STORE_RATE_TICKS_PER_MS) / per_sec;
+            strlcpy(slot->tag, tag, sizeof(slot->tag));
+            slot->per_sec = (uint16_t)per_sec;
+            slot->burst = (uint16_t)burst;
+            slot->tolerance = interval * (burst - 1U);
+            slot->tat = rate_now();
+            __atomic_store_n(&slot->interval, interval, __ATOMIC_RELEASE);
+        }
+    }
+    portEXIT_CRITICAL(&s_log_store.lock);
+    return err;
+}
+
+size_t log_store_get_rate_limits(log_store_rate_limit_t *out_limits, size_t out_cap)
+{
+    size_t count = 0;
+    if (out_limits == NULL) {
+        return 0U;
+    }
+    portENTER_CRITICAL(&s_log_store.lock);
+    for (uint32_t i = 0; i < LOG_STORE_RATE_SLOTS && count < out_cap; ++i) {
+        const log_rate_slot_t *slot = &s_log_store.rate[i];
+        if (slot->interval == 0U) {
+            continue;
+        }
+        log_store_rate_limit_t *out = &out_limits[count++];
+        strlcpy(out->tag, slot->tag, sizeof(out->tag));
+        out->per_sec = slot->per_sec;
+        out->burst = slot->burst;
+        out->suppressed = slot->suppressed_total + __atomic_load_n(&slot->suppressed, __ATOMIC_RELAXED);
+    }
+    portEXIT_CRITICAL(&s_log_store.lock);
+    return count;
+}
+
+void log_store_set_commit_callback(log_store_commit_cb_t cb)
+{
+    s_log_store.commit_cb = cb;
 }
@@ -11,7 +11,58 @@ typedef struct {
     char line[192];
 } log_store_entry_t;
 
+typedef struct {
+    uint32_t records;
+    uint32_t ring_used_bytes;
+    uint32_t dropped;             // records lost because a per-core staging ring was full
+    uint32_t staging_peak_bytes;  // highest staging fill seen on any core
+    uint32_t last_id;             // id of the newest line in the ring
+    uint32_t replay_last_id;      // id of the last line replayed from RTC memory at boot (0 = none)
+    uint32_t collapsed;           // repeats of the previous line counted instead of stored
+    uint32_t rate_limited;        // lines suppressed by per-tag rate limits (reported so far)
+} log_store_stats_t;
+
+typedef struct {
+    char tag[24];
+    uint16_t per_sec;
+    uint16_t burst;
+    uint32_t suppressed;  // since boot
+} log_store_rate_limit_t;
+
+// Level letters rank E < W < I < D < V; lines without an ESP_LOG prefix count as level I with no tag.
+typedef struct {
+    char max_level;  // '\0' = any level
+    char tag[24];    // exact tag match; "" = any tag
+} log_store_filter_t;
+
+// Reader position. Start with {.last_id = N} to get lines newer than N; pos is maintained internally.
+typedef struct {
+    uint32_t last_id;
+    uint64_t pos;
+} log_store_cursor_t;
+
+// Return false to stop; the line is then delivered again on the next visit.
+typedef bool (*log_store_line_cb_t)(const log_store_entry_t *entry, void *ctx);
+typedef void (*log_store_shutdown_cb_t)(void);
+typedef void (*log_store_commit_cb_t)(void);
+
 esp_err_t log_store_init(void);
 void log_store_mark_time_synced(void);
 bool log_store_is_time_synced(void);
+// Lines become visible after the drain task moves them out of staging (log_store.drain_period_ms).
 size_t log_store_copy_recent(log_store_entry_t *out_entries, size_t out_cap, size_t limit);
+// Oldest-first lines with id > after_id, up to out_cap.
+size_t log_store_copy_since(uint32_t after_id, log_store_entry_t *out_entries, size_t out_cap);
+// Formats lines newer than cursor one at a time into a stack buffer and hands them to cb, oldest first.
+// Lines rejected by filter are skipped before formatting where the record allows it.
+size_t log_store_visit_since(log_store_cursor_t *cursor, const log_store_filter_t *filter, log_store_line_cb_t cb, void *ctx);
+bool log_store_line_matches(const char *line, const log_store_filter_t *filter);
+void log_store_get_stats(log_store_stats_t *out_stats);
+// Called once from the esp_restart() hook after staged lines have reached the ring.
+void log_store_set_shutdown_callback(log_store_shutdown_cb_t cb);
+// Token bucket for ESP_LOGx lines with this tag: per_sec sustained (1..1000), burst lines at once.
+// per_sec 0 removes the limit. ESP_ERR_NO_MEM when all 8 slots are taken.
+esp_err_t log_store_set_rate_limit(const char *tag, uint32_t per_sec, uint32_t burst);
+size_t log_store_get_rate_limits(log_store_rate_limit_t *out_limits, size_t out_cap);
+// Called from the drain task after new lines have reached the ring.
+void log_store_set_commit_callback(log_store_commit_cb_t cb);
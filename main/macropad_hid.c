@@ -18,12 +18,14 @@
 
 #include "keymap_config.h"
 
+#include "bench.h"
 #include "macropad_hid.h"
 
 #define TAG "MACROPAD_USB"
 
 #define KEY_COUNT MACRO_KEY_COUNT
 #define HID_REPORT_RETRY_MS 50
+#define CDC_LINE_MAX 64
 
 enum {
     REPORT_ID_KEYBOARD = 1,
@@ -80,6 +82,9 @@ static const char *s_string_descriptor[] = {
 };
 
 static bool s_hid_enabled = true;
+static macropad_cdc_line_cb_t s_cdc_line_cb;
+static char s_cdc_line[CDC_LINE_MAX];
+static size_t s_cdc_line_len;
 
 uint8_t const *tud_hid_descriptor_report_cb(uint8_t instance)
 {
@@ -139,6 +144,74 @@ static inline const macro_action_config_t *active_key_cfg(size_t idx, uint8_t ac
     return &g_macro_keymap_layers[active_layer][idx];
 }
 
+static void build_keyboard_keycodes(const bool *key_pressed, uint8_t active_layer, uint8_t keycodes[6])
+{
+    size_t report_index = 0;
+    for (size_t i = 0; i < KEY_COUNT && report_index < 6; ++i) {
+        const macro_action_config_t *cfg = active_key_cfg(i, active_layer);
+        if (key_pressed[i] && cfg->type == MACRO_ACTION_KEYBOARD) {
+            keycodes[report_index++] = (uint8_t)cfg->usage;
+        }
+    }
+}
+
+typedef struct {
+    bool pressed[KEY_COUNT];
+    volatile uint8_t sink;
+} bench_keyboard_ctx_t;
+
+static bench_keyboard_ctx_t s_bench_keyboard;
+
+// Chord of every other key on layer 1.
+static void bench_keyboard_setup(void *ctx)
+{
+    bench_keyboard_ctx_t *b = (bench_keyboard_ctx_t *)ctx;
+    for (size_t i = 0; i < KEY_COUNT; ++i) {
+        b->pressed[i] = (i % 2U) == 0U;
+    }
+}
+
+static void bench_keyboard_run(void *ctx)
+{
+    bench_keyboard_ctx_t *b = (bench_keyboard_ctx_t *)ctx;
+    uint8_t keycodes[6] = {0};
+    build_keyboard_keycodes(b->pressed, 0, keycodes);
+    b->sink = keycodes[0];
+}
+
+static const bench_case_t s_bench_keyboard_report = {
+    .name = "keyboard_report_build",
+    .run = bench_keyboard_run,
+    .setup = bench_keyboard_setup,
+    .ctx = &s_bench_keyboard,
+};
+
+// Console input: nobody reads stdin, so the CDC RX FIFO is drained here and split into lines.
+static void cdc_rx_callback(int itf, cdcacm_event_t *event)
+{
+    (void)event;
+    uint8_t buf[64];
+    size_t rx_size = 0;
+    if (tinyusb_cdcacm_read((tinyusb_cdcacm_itf_t)itf, buf, sizeof(buf), &rx_size) != ESP_OK) {
+        return;
+    }
+    for (size_t i = 0; i < rx_size; ++i) {
+        const char c = (char)buf[i];
+        if (c == '\r' || c == '\n') {
+            if (s_cdc_line_len > 0U) {
+                s_cdc_line[s_cdc_line_len] = '\0';
+                s_cdc_line_len = 0;
+                const macropad_cdc_line_cb_t cb = s_cdc_line_cb;
+                if (cb != NULL) {
+                    cb(s_cdc_line);
+                }
+            }
+        } else if (s_cdc_line_len < (sizeof(s_cdc_line) - 1U)) {
+            s_cdc_line[s_cdc_line_len++] = c;
+        }
+    }
+}
+
 esp_err_t macropad_usb_init_mode(bool enable_hid_keyboard)
 {
     esp_err_t err = ESP_OK;
@@ -167,6 +240,7 @@ esp_err_t macropad_usb_init_mode(bool enable_hid_keyboard)
 #if CONFIG_TINYUSB_CDC_ENABLED
     tinyusb_config_cdcacm_t acm_cfg = {
         .cdc_port = TINYUSB_CDC_ACM_0,
+        .callback_rx = cdc_rx_callback,
     };
     err = tinyusb_cdcacm_init(&acm_cfg);
     if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
@@ -183,6 +257,7 @@ esp_err_t macropad_usb_init_mode(bool enable_hid_keyboard)
     ESP_LOGI(TAG,
              "TinyUSB started (CDC%s), console redirected to CDC",
              s_hid_enabled ? " + HID" : " only");
+    (void)bench_register(&s_bench_keyboard_report);
     return ESP_OK;
 }
 
@@ -191,10 +266,10 @@ esp_err_t macropad_usb_init(void)
     return macropad_usb_init_mode(true);
 }
 
-void macropad_send_consumer_report(uint16_t usage)
+esp_err_t macropad_send_consumer_report(uint16_t usage)
 {
     if (usage == 0) {
-        return;
+        return ESP_ERR_INVALID_ARG;
     }
     if (!hid_enabled_and_ready()) {
         ESP_LOGW(TAG,
@@ -203,13 +278,13 @@ void macropad_send_consumer_report(uint16_t usage)
                  s_hid_enabled,
                  tud_mounted(),
                  tud_hid_ready());
-        return;
+        return ESP_ERR_INVALID_STATE;
     }
 
     const TickType_t timeout_ticks = pdMS_TO_TICKS(HID_REPORT_RETRY_MS);
     if (!hid_send_report_retry(REPORT_ID_CONSUMER, &usage, sizeof(usage), timeout_ticks)) {
         ESP_LOGW(TAG, "Consumer press report timeout usage=0x%X", usage);
-        return;
+        return ESP_ERR_TIMEOUT;
     }
 
     vTaskDelay(pdMS_TO_TICKS(12));
@@ -217,13 +292,15 @@ void macropad_send_consumer_report(uint16_t usage)
     const uint16_t release = 0;
     if (!hid_send_report_retry(REPORT_ID_CONSUMER, &release, sizeof(release), timeout_ticks)) {
         ESP_LOGW(TAG, "Consumer release report timeout");
+        return ESP_ERR_TIMEOUT;
     }
+    return ESP_OK;
 }
 
-void macropad_send_keyboard_report(const bool *key_pressed, uint8_t active_layer)
+esp_err_t macropad_send_keyboard_report(const bool *key_pressed, uint8_t active_layer)
 {
     if (key_pressed == NULL) {
-        return;
+        return ESP_ERR_INVALID_ARG;
     }
 
     if (!hid_enabled_and_ready()) {
@@ -232,18 +309,11 @@ void macropad_send_keyboard_report(const bool *key_pressed, uint8_t active_layer
                  s_hid_enabled,
                  tud_mounted(),
                  tud_hid_ready());
-        return;
+        return ESP_ERR_INVALID_STATE;
     }
 
     uint8_t keycodes[6] = {0};
-    size_t report_index = 0;
-
-    for (size_t i = 0; i < KEY_COUNT && report_index < 6; ++i) {
-        const macro_action_config_t *cfg = active_key_cfg(i, active_layer);
-        if (key_pressed[i] && cfg->type == MACRO_ACTION_KEYBOARD) {
-            keycodes[report_index++] = (uint8_t)cfg->usage;
-        }
-    }
+    build_keyboard_keycodes(key_pressed, active_layer, keycodes);
 
     const TickType_t timeout_ticks = pdMS_TO_TICKS(HID_REPORT_RETRY_MS);
     const TickType_t start = xTaskGetTickCount();
@@ -257,7 +327,9 @@ void macropad_send_keyboard_report(const bool *key_pressed, uint8_t active_layer
     }
     if (!sent) {
         ESP_LOGW(TAG, "Keyboard report timeout");
+        return ESP_ERR_TIMEOUT;
     }
+    return ESP_OK;
 }
 
 bool macropad_usb_hid_enabled(void)
@@ -279,3 +351,8 @@ bool macropad_usb_cdc_connected(void)
 {
     return tud_cdc_connected();
 }
+
+void macropad_usb_set_cdc_line_handler(macropad_cdc_line_cb_t cb)
+{
+    s_cdc_line_cb = cb;
+}
@@ -5,11 +5,15 @@
 
 #include "esp_err.h"
 
+// Called from the TinyUSB task with one console line (CR/LF stripped); must not block.
+typedef void (*macropad_cdc_line_cb_t)(const char *line);
+
 esp_err_t macropad_usb_init_mode(bool enable_hid_keyboard);
 esp_err_t macropad_usb_init(void);
-void macropad_send_consumer_report(uint16_t usage);
-void macropad_send_keyboard_report(const bool *key_pressed, uint8_t active_layer);
+esp_err_t macropad_send_consumer_report(uint16_t usage);
+esp_err_t macropad_send_keyboard_report(const bool *key_pressed, uint8_t active_layer);
 bool macropad_usb_hid_enabled(void);
 bool macropad_usb_mounted(void);
 bool macropad_usb_hid_ready(void);
 bool macropad_usb_cdc_connected(void);
+void macropad_usb_set_cdc_line_handler(macropad_cdc_line_cb_t cb);
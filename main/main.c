@@ -16,21 +16,26 @@
 #include "esp_netif.h"
 #include "esp_sntp.h"
 #include "esp_system.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
 
-#include "led_strip.h"
-
 #include "keymap_config.h"
 #include "sdkconfig.h"
 
+#include "bench.h"
 #include "buzzer.h"
 #include "hid_transport.h"
 #include "home_assistant.h"
+#include "led_effects.h"
+#include "log_archive.h"
 #include "log_store.h"
+#include "metrics.h"
 #include "oled.h"
 #include "oled_animation_assets.h"
 #include "ota_manager.h"
+#include "profiler.h"
 #include "touch_slider.h"
+#include "trace_buffer.h"
 #include "wifi_portal.h"
 #include "web_service.h"
 
@@ -45,8 +50,6 @@
 #define EC11_GPIO_B GPIO_NUM_5
 #define EC11_GPIO_BUTTON GPIO_NUM_6
 
-#define LED_STRIP_GPIO GPIO_NUM_38
-#define LED_STRIP_COUNT 15
 #define LED_STATUS_DEBOUNCE_MS 120
 #define CDC_LOG_GATE_TIMEOUT_MS 2500
 #define SNTP_START_DELAY_MS 1200
@@ -77,9 +80,6 @@ static bool s_encoder_single_pending = false;
 static TickType_t s_encoder_single_due_tick = 0;
 
 static pcnt_unit_handle_t s_pcnt_unit;
-static led_strip_handle_t s_led_strip;
-static uint8_t s_led_last_frame[LED_STRIP_COUNT][3];
-static bool s_led_frame_valid = false;
 static debounce_state_t s_usb_mounted_db;
 static debounce_state_t s_usb_hid_ready_db;
 
@@ -263,103 +263,31 @@ static void set_active_layer(uint8_t layer)
     hid_transport_send_keyboard_report(s_key_pressed, s_active_layer);
 }
 
-static uint8_t apply_brightness(uint8_t value, uint8_t brightness)
-{
-    return (uint8_t)((uint16_t)value * brightness / 255U);
-}
-
-static inline uint8_t dim_indicator(uint8_t value)
-{
-    return apply_brightness(value, MACRO_LED_INDICATOR_BRIGHTNESS);
-}
-
-static inline uint8_t dim_key(uint8_t value)
-{
-    return apply_brightness(value, MACRO_LED_KEY_BRIGHTNESS);
-}
-
-static esp_err_t update_key_leds(void)
+static void update_led_input(void)
 {
-    if (s_led_strip == NULL) {
-        return ESP_OK;
-    }
-
+    PROF_SCOPE(PROF_SCOPE_LED_UPDATE);
     const TickType_t now = xTaskGetTickCount();
     const TickType_t status_debounce_ticks = pdMS_TO_TICKS(LED_STATUS_DEBOUNCE_MS);
-    const TickType_t led_off_timeout_ticks = pdMS_TO_TICKS((uint32_t)MACRO_LED_OFF_TIMEOUT_SEC * 1000U);
-    const bool leds_off_by_idle =
-        (led_off_timeout_ticks > 0) &&
-        ((now - s_last_user_activity_tick) >= led_off_timeout_ticks);
-    hid_transport_status_t hid_status = {0};
-    (void)hid_transport_get_status(&hid_status);
-    const bool mounted_state = hid_status.usb_mounted;
-    const bool link_ready_state = (hid_status.mode == HID_MODE_USB) ? hid_status.usb_hid_ready : hid_status.ble_connected;
+    bool mounted_state = false;
+    bool link_ready_state = false;
+    hid_transport_get_link_flags(&mounted_state, &link_ready_state);
     (void)debounce_update(&s_usb_mounted_db, mounted_state, now, status_debounce_ticks);
     (void)debounce_update(&s_usb_hid_ready_db, link_ready_state, now, status_debounce_ticks);
 
-    const macro_rgb_t *layer_color = &g_layer_backlight_color[s_active_layer];
-    const uint8_t layer_a_r = layer_color->r;
-    const uint8_t layer_a_g = layer_color->g;
-    const uint8_t layer_a_b = layer_color->b;
-    const uint8_t key_dim_r = (uint8_t)(((uint16_t)layer_color->r * MACRO_LAYER_KEY_DIM_SCALE) / 255U);
-    const uint8_t key_dim_g = (uint8_t)(((uint16_t)layer_color->g * MACRO_LAYER_KEY_DIM_SCALE) / 255U);
-    const uint8_t key_dim_b = (uint8_t)(((uint16_t)layer_color->b * MACRO_LAYER_KEY_DIM_SCALE) / 255U);
-    const uint8_t key_active_r = (uint8_t)(((uint16_t)layer_color->r * MACRO_LAYER_KEY_ACTIVE_SCALE) / 255U);
-    const uint8_t key_active_g = (uint8_t)(((uint16_t)layer_color->g * MACRO_LAYER_KEY_ACTIVE_SCALE) / 255U);
-    const uint8_t key_active_b = (uint8_t)(((uint16_t)layer_color->b * MACRO_LAYER_KEY_ACTIVE_SCALE) / 255U);
-    uint8_t frame[LED_STRIP_COUNT][3] = {0};
-
-    if (!leds_off_by_idle) {
-        if (s_usb_mounted_db.stable_level) {
-            frame[0][0] = dim_indicator(0);
-            frame[0][1] = dim_indicator(40);
-            frame[0][2] = dim_indicator(0);
-        }
-        if (s_usb_hid_ready_db.stable_level) {
-            frame[1][0] = dim_indicator(0);
-            frame[1][1] = dim_indicator(0);
-            frame[1][2] = dim_indicator(40);
-        }
-        frame[2][0] = dim_indicator(layer_a_r);
-        frame[2][1] = dim_indicator(layer_a_g);
-        frame[2][2] = dim_indicator(layer_a_b);
-
-        for (size_t i = 0; i < KEY_COUNT; ++i) {
-            const macro_action_config_t *cfg = active_key_cfg(i);
-            if (cfg->led_index >= LED_STRIP_COUNT) {
-                continue;
-            }
-
-            frame[cfg->led_index][0] = dim_key(key_dim_r);
-            frame[cfg->led_index][1] = dim_key(key_dim_g);
-            frame[cfg->led_index][2] = dim_key(key_dim_b);
-
-            if (s_key_pressed[i]) {
-                frame[cfg->led_index][0] = dim_key(key_active_r);
-                frame[cfg->led_index][1] = dim_key(key_active_g);
-                frame[cfg->led_index][2] = dim_key(key_active_b);
-            }
-        }
-    }
-
-    if (s_led_frame_valid && memcmp(frame, s_led_last_frame, sizeof(frame)) == 0) {
-        return ESP_OK;
-    }
-
-    for (size_t i = 0; i < LED_STRIP_COUNT; ++i) {
-        if (!s_led_frame_valid || memcmp(frame[i], s_led_last_frame[i], sizeof(frame[i])) != 0) {
-            ESP_RETURN_ON_ERROR(led_strip_set_pixel(s_led_strip,
-                                                    i,
-                                                    frame[i][0],
-                                                    frame[i][1],
-                                                    frame[i][2]),
-                                TAG, "set led %u failed", (unsigned)i);
+    // Rendering, fades and the RMT refresh run on the LED effects task.
+    led_effects_input_t input = {
+        .key_mask = 0,
+        .layer = s_active_layer,
+        .mounted = s_usb_mounted_db.stable_level,
+        .link_ready = s_usb_hid_ready_db.stable_level,
+        .last_activity_tick = s_last_user_activity_tick,
+    };
+    for (size_t i = 0; i < KEY_COUNT; ++i) {
+        if (s_key_pressed[i]) {
+            input.key_mask |= (uint16_t)(1U << i);
         }
     }
-
-    memcpy(s_led_last_frame, frame, sizeof(frame));
-    s_led_frame_valid = true;
-    return led_strip_refresh(s_led_strip);
+    led_effects_set_input(&input);
 }
 
 static bool debounce_update(debounce_state_t *state,
@@ -380,6 +308,46 @@ static bool debounce_update(debounce_state_t *state,
     return false;
 }
 
+typedef struct {
+    debounce_state_t keys[KEY_COUNT];
+    TickType_t now;
+} bench_debounce_ctx_t;
+
+static bench_debounce_ctx_t s_bench_debounce;
+
+// One debounce pass over every key. Raw levels flip every 8 calls with a short window, so the
+// samples mix steady keys, transitions and accepted edges.
+static void bench_debounce_run(void *ctx)
+{
+    bench_debounce_ctx_t *b = (bench_debounce_ctx_t *)ctx;
+    const TickType_t now = ++b->now;
+    for (size_t i = 0; i < KEY_COUNT; ++i) {
+        const bool raw = (((now >> 3) + i) & 1U) != 0U;
+        (void)debounce_update(&b->keys[i], raw, now, 4U);
+    }
+}
+
+static const bench_case_t s_bench_debounce_case = {
+    .name = "debounce",
+    .run = bench_debounce_run,
+    .ctx = &s_bench_debounce,
+};
+
+// CDC console commands, one per line.
+static void cdc_command_handler(const char *line)
+{
+    if (strcmp(line, "bench") == 0) {
+        const esp_err_t err = bench_start_background_run();
+        if (err == ESP_OK) {
+            ESP_LOGI(TAG, "bench: running, results follow");
+        } else {
+            ESP_LOGW(TAG, "bench: %s", (err == ESP_ERR_INVALID_STATE) ? "already running" : esp_err_to_name(err));
+        }
+        return;
+    }
+    ESP_LOGI(TAG, "Unknown command '%s' (available: bench)", line);
+}
+
 static void sntp_ip_event_handler(void *arg,
                                   esp_event_base_t event_base,
                                   int32_t event_id,
@@ -543,34 +511,21 @@ static esp_err_t init_encoder(void)
     return ESP_OK;
 }
 
-static esp_err_t init_led_strip(void)
+static esp_err_t init_led_feedback(void)
 {
-    const led_strip_config_t strip_cfg = {
-        .strip_gpio_num = LED_STRIP_GPIO,
-        .max_leds = LED_STRIP_COUNT,
-        .led_model = LED_MODEL_SK6812,
-        .flags.invert_out = false,
-    };
-    const led_strip_rmt_config_t rmt_cfg = {
-        .resolution_hz = 10 * 1000 * 1000,
-        .flags.with_dma = false,
-    };
-    ESP_ERROR_CHECK(led_strip_new_rmt_device(&strip_cfg, &rmt_cfg, &s_led_strip));
-
     const TickType_t now = xTaskGetTickCount();
-    hid_transport_status_t hid_status = {0};
-    (void)hid_transport_get_status(&hid_status);
-    const bool mounted = hid_status.usb_mounted;
-    const bool hid_ready = (hid_status.mode == HID_MODE_USB) ? hid_status.usb_hid_ready : hid_status.ble_connected;
+    bool mounted = false;
+    bool hid_ready = false;
+    hid_transport_get_link_flags(&mounted, &hid_ready);
     s_usb_mounted_db.stable_level = mounted;
     s_usb_mounted_db.last_raw = mounted;
     s_usb_mounted_db.last_transition_tick = now;
     s_usb_hid_ready_db.stable_level = hid_ready;
     s_usb_hid_ready_db.last_raw = hid_ready;
     s_usb_hid_ready_db.last_transition_tick = now;
-    s_led_frame_valid = false;
 
-    return update_key_leds();
+    update_led_input();
+    return led_effects_init();
 }
 
 static esp_err_t web_control_set_layer(uint8_t layer_index)
@@ -617,6 +572,51 @@ static esp_err_t web_control_clear_ble_bond(void)
     return hid_transport_clear_bond();
 }
 
+// Debounces every key and dispatches edges; returns true when the keyboard report must be resent.
+static bool scan_keys(TickType_t now, TickType_t debounce_ticks)
+{
+    PROF_SCOPE(PROF_SCOPE_KEY_SCAN);
+    bool keyboard_state_changed = false;
+
+    for (size_t i = 0; i < KEY_COUNT; ++i) {
+        const macro_action_config_t *scan_cfg = scan_key_cfg(i);
+        const macro_action_config_t *active_cfg = active_key_cfg(i);
+        const bool raw_pressed = is_pressed(scan_cfg);
+        if (debounce_update(&s_key_db[i], raw_pressed, now, debounce_ticks)) {
+            s_key_pressed[i] = s_key_db[i].stable_level;
+            if (s_key_pressed[i]) {
+                mark_user_activity(now);
+                buzzer_play_keypress();
+            }
+
+            APP_LOGI("L%u Key[%u:%s] %s (gpio=%d type=%d usage=0x%X)",
+                     (unsigned)s_active_layer + 1,
+                     (unsigned)i,
+                     active_cfg->name,
+                     s_key_pressed[i] ? "pressed" : "released",
+                     scan_cfg->gpio,
+                     (int)active_cfg->type,
+                     active_cfg->usage);
+            home_assistant_notify_key_event(s_active_layer,
+                                            (uint8_t)i,
+                                            s_key_pressed[i],
+                                            active_cfg->usage,
+                                            active_cfg->name);
+            web_service_record_key_event((uint8_t)i,
+                                         s_key_pressed[i],
+                                         active_cfg->usage,
+                                         active_cfg->name);
+
+            if (active_cfg->type == MACRO_ACTION_KEYBOARD) {
+                keyboard_state_changed = true;
+            } else if (active_cfg->type == MACRO_ACTION_CONSUMER && s_key_pressed[i]) {
+                send_consumer_report_with_activity(active_cfg->usage);
+            }
+        }
+    }
+    return keyboard_state_changed;
+}
+
 static void input_task(void *arg)
 {
     (void)arg;
@@ -626,6 +626,8 @@ static void input_task(void *arg)
     TickType_t last_heartbeat = xTaskGetTickCount();
 
     while (1) {
+        const int64_t loop_start_us = esp_timer_get_time();
+        trace_buffer_begin(TRACE_SPAN_SCAN);
         const TickType_t now = xTaskGetTickCount();
         if (!s_reset_reason_late_logged && cdc_log_ready()) {
             APP_LOGI("Boot reset reason (late): %s (%d)",
@@ -634,44 +636,7 @@ static void input_task(void *arg)
             s_reset_reason_late_logged = true;
         }
         sntp_start_if_pending(now);
-        bool keyboard_state_changed = false;
-
-        for (size_t i = 0; i < KEY_COUNT; ++i) {
-            const macro_action_config_t *scan_cfg = scan_key_cfg(i);
-            const macro_action_config_t *active_cfg = active_key_cfg(i);
-            const bool raw_pressed = is_pressed(scan_cfg);
-            if (debounce_update(&s_key_db[i], raw_pressed, now, debounce_ticks)) {
-                s_key_pressed[i] = s_key_db[i].stable_level;
-                if (s_key_pressed[i]) {
-                    mark_user_activity(now);
-                    buzzer_play_keypress();
-                }
-
-                APP_LOGI("L%u Key[%u:%s] %s (gpio=%d type=%d usage=0x%X)",
-                         (unsigned)s_active_layer + 1,
-                         (unsigned)i,
-                         active_cfg->name,
-                         s_key_pressed[i] ? "pressed" : "released",
-                         scan_cfg->gpio,
-                         (int)active_cfg->type,
-                         active_cfg->usage);
-                home_assistant_notify_key_event(s_active_layer,
-                                                (uint8_t)i,
-                                                s_key_pressed[i],
-                                                active_cfg->usage,
-                                                active_cfg->name);
-                web_service_record_key_event((uint8_t)i,
-                                             s_key_pressed[i],
-                                             active_cfg->usage,
-                                             active_cfg->name);
-
-                if (active_cfg->type == MACRO_ACTION_KEYBOARD) {
-                    keyboard_state_changed = true;
-                } else if (active_cfg->type == MACRO_ACTION_CONSUMER && s_key_pressed[i]) {
-                    send_consumer_report_with_activity(active_cfg->usage);
-                }
-            }
-        }
+        const bool keyboard_state_changed = scan_keys(now, debounce_ticks);
 
         if (keyboard_state_changed) {
             hid_transport_send_keyboard_report(s_key_pressed, s_active_layer);
@@ -804,12 +769,8 @@ static void input_task(void *arg)
             }
         }
 
-        esp_err_t led_err = update_key_leds();
-        if (led_err != ESP_OK) {
-            ESP_LOGE(TAG, "LED update failed: %s", esp_err_to_name(led_err));
-        }
+        update_led_input();
 
-        buzzer_update(now);
         hid_transport_poll(now);
         ota_manager_poll(now);
         wifi_portal_poll();
@@ -835,8 +796,19 @@ static void input_task(void *arg)
             APP_LOGI("task stack watermark input_task=%u words (~%u bytes free)",
                      (unsigned)stack_hw,
                      (unsigned)(stack_hw * sizeof(StackType_t)));
+            led_effects_stats_t led_stats = {0};
+            led_effects_get_stats(&led_stats);
+            APP_LOGI("led frames rendered=%lu refreshed=%lu overruns=%lu last=%luus max=%luus degraded=%d",
+                     (unsigned long)led_stats.frames_rendered,
+                     (unsigned long)led_stats.refreshes,
+                     (unsigned long)led_stats.budget_overruns,
+                     (unsigned long)led_stats.last_frame_us,
+                     (unsigned long)led_stats.max_frame_us,
+                     led_stats.degraded);
         }
 
+        metrics_observe_us(METRIC_HIST_SCAN_LOOP, (uint32_t)(esp_timer_get_time() - loop_start_us));
+        trace_buffer_end(TRACE_SPAN_SCAN);
         vTaskDelay(pdMS_TO_TICKS(SCAN_INTERVAL_MS));
     }
 }
@@ -1015,11 +987,13 @@ void app_main(void)
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "hid_transport_init failed: %s", esp_err_to_name(err));
     }
+    hid_transport_set_cdc_line_handler(cdc_command_handler);
 
     err = init_keys();
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "init_keys failed: %s", esp_err_to_name(err));
     }
+    (void)bench_register(&s_bench_debounce_case);
     err = touch_slider_init();
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "touch_slider_init failed: %s", esp_err_to_name(err));
@@ -1028,9 +1002,9 @@ void app_main(void)
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "init_encoder failed: %s", esp_err_to_name(err));
     }
-    err = init_led_strip();
+    err = init_led_feedback();
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "init_led_strip failed: %s", esp_err_to_name(err));
+        ESP_LOGE(TAG, "init_led_feedback failed: %s", esp_err_to_name(err));
     }
     err = buzzer_init();
     if (err != ESP_OK) {
@@ -1046,6 +1020,14 @@ void app_main(void)
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "ota_manager_init failed: %s", esp_err_to_name(err));
     }
+    err = log_archive_init();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "log_archive_init failed: %s", esp_err_to_name(err));
+    }
+    err = profiler_init();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "profiler_init failed: %s", esp_err_to_name(err));
+    }
     if (oled_ready) {
         err = oled_set_brightness_percent(MACRO_OLED_DEFAULT_BRIGHTNESS_PERCENT);
         if (err != ESP_OK) {
@@ -0,0 +1,288 @@
+#include "metrics.h"
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_system.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define METRICS_MAX_BUCKETS 10U
+
+typedef enum {
+    METRIC_TYPE_COUNTER = 0,
+    METRIC_TYPE_GAUGE,
+} metric_type_t;
+
+typedef struct {
+    const char *name;
+    const char *help;
+    const char *labels;  // pre-rendered label pairs without braces, or NULL
+    metric_type_t type;
+} metric_desc_t;
+
+typedef struct {
+    const char *name;
+    const char *help;
+    uint32_t bounds_us[METRICS_MAX_BUCKETS];
+    uint8_t bucket_count;
+} metric_hist_desc_t;
+
+typedef struct {
+    atomic_uint buckets[METRICS_MAX_BUCKETS + 1U];  // last slot is +Inf
+    _Atomic uint64_t sum_us;  // 64-bit: a 32-bit microsecond sum wraps after ~71 minutes
+} metric_hist_t;
+
+static const metric_desc_t s_desc[METRIC_COUNT] = {
+    [METRIC_HID_REPORTS_USB_SENT] = {
+        "macropad_hid_reports_total", "HID reports handed to a transport.",
+        "transport=\"usb\",result=\"sent\"", METRIC_TYPE_COUNTER},
+    [METRIC_HID_REPORTS_USB_FAILED] = {
+        "macropad_hid_reports_total", "HID reports handed to a transport.",
+        "transport=\"usb\",result=\"failed\"", METRIC_TYPE_COUNTER},
+    [METRIC_HID_REPORTS_BLE_SENT] = {
+        "macropad_hid_reports_total", "HID reports handed to a transport.",
+        "transport=\"ble\",result=\"sent\"", METRIC_TYPE_COUNTER},
+    [METRIC_HID_REPORTS_BLE_FAILED] = {
+        "macropad_hid_reports_total", "HID reports handed to a transport.",
+        "transport=\"ble\",result=\"failed\"", METRIC_TYPE_COUNTER},
+    [METRIC_HID_CONSUMER_INFLIGHT] = {
+        "macropad_hid_consumer_inflight", "Consumer reports currently being sent (press plus release).",
+        NULL, METRIC_TYPE_GAUGE},
+    [METRIC_HA_QUEUE_DEPTH] = {
+        "macropad_ha_queue_depth", "Home Assistant events waiting for the worker.",
+        NULL, METRIC_TYPE_GAUGE},
+    [METRIC_HA_POST_FAILURES] = {
+        "macropad_ha_post_failures_total", "Home Assistant POSTs that failed or were rejected.",
+        NULL, METRIC_TYPE_COUNTER},
+    [METRIC_HA_CONNECTS] = {
+        "macropad_ha_connects_total", "Home Assistant connections opened (TCP connect plus TLS handshake for https).",
+        NULL, METRIC_TYPE_COUNTER},
+    [METRIC_HA_EVENTS_COALESCED] = {
+        "macropad_ha_events_coalesced_total", "Home Assistant events merged into one already queued.",
+        NULL, METRIC_TYPE_COUNTER},
+    [METRIC_HA_EVENTS_DROPPED] = {
+        "macropad_ha_events_dropped_total", "Home Assistant events dropped on a full queue.",
+        NULL, METRIC_TYPE_COUNTER},
+    [METRIC_OLED_FLUSH_BYTES] = {
+        "macropad_oled_flush_bytes_total", "Framebuffer bytes written to the OLED.",
+        NULL, METRIC_TYPE_COUNTER},
+    [METRIC_OLED_FLUSH_FAILURES] = {
+        "macropad_oled_flush_failures_total", "OLED flushes aborted by an I2C error.",
+        NULL, METRIC_TYPE_COUNTER},
+};
+
+static const metric_hist_desc_t s_hist_desc[METRIC_HIST_COUNT] = {
+    [METRIC_HIST_SCAN_LOOP] = {
+        "macropad_scan_loop_seconds", "Input scan loop work per iteration, excluding the scan delay.",
+        {100U, 250U, 500U, 1000U, 2500U, 5000U, 10000U, 25000U, 50000U}, 9U},
+    [METRIC_HIST_OLED_FLUSH] = {
+        "macropad_oled_flush_seconds", "Full OLED framebuffer flush time.",
+        {5000U, 10000U, 20000U, 30000U, 50000U, 100000U}, 6U},
+    [METRIC_HIST_HA_POST] = {
+        "macropad_ha_post_seconds", "Home Assistant POST round trip, failures included.",
+        {10000U, 25000U, 50000U, 100000U, 250000U, 500000U, 1000000U, 2500000U, 5000000U}, 9U},
+    [METRIC_HIST_HA_GET] = {
+        "macropad_ha_get_seconds", "Home Assistant state poll round trip, failures included.",
+        {10000U, 25000U, 50000U, 100000U, 250000U, 500000U, 1000000U, 2500000U, 5000000U}, 9U},
+};
+
+// Stacks are sampled by name at scrape time; tasks that are not running are skipped.
+static const char *const s_stack_tasks[] = {
+    "input_task", "display_task", "ha_worker", "ha_ws", "mqtt_task", "led_fx", "log_archive",
+    "log_drain", "ota_worker", "profiler", "web_stream", "wifi_portal_dns", "httpd",
+};
+
+static atomic_uint s_values[METRIC_COUNT];
+static metric_hist_t s_hist[METRIC_HIST_COUNT];
+
+void metrics_inc(metric_id_t id)
+{
+    metrics_add(id, 1U);
+}
+
+void metrics_dec(metric_id_t id)
+{
+    if ((unsigned)id < METRIC_COUNT) {
+        atomic_fetch_sub_explicit(&s_values[id], 1U, memory_order_relaxed);
+    }
+}
+
+void metrics_add(metric_id_t id, uint32_t value)
+{
+    if ((unsigned)id < METRIC_COUNT) {
+        atomic_fetch_add_explicit(&s_values[id], value, memory_order_relaxed);
+    }
+}
+
+void metrics_set(metric_id_t id, uint32_t value)
+{
+    if ((unsigned)id < METRIC_COUNT) {
+        atomic_store_explicit(&s_values[id], value, memory_order_relaxed);
+    }
+}
+
+void metrics_observe_us(metric_hist_id_t id, uint32_t us)
+{
+    if ((unsigned)id >= METRIC_HIST_COUNT) {
+        return;
+    }
+    const metric_hist_desc_t *desc = &s_hist_desc[id];
+    size_t slot = 0;
+    while (slot < desc->bucket_count && us > desc->bounds_us[slot]) {
+        ++slot;
+    }
+    atomic_fetch_add_explicit(&s_hist[id].buckets[slot], 1U, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s_hist[id].sum_us, (uint64_t)us, memory_order_relaxed);
+}
+
+typedef struct {
+    char *buf;
+    size_t cap;
+    size_t len;
+    metrics_flush_fn_t flush;
+    void *ctx;
+    esp_err_t err;
+} metrics_out_t;
+
+static bool out_drain(metrics_out_t *out)
+{
+    if (out->len > 0U && out->err == ESP_OK) {
+        out->err = out->flush(out->ctx, out->buf, out->len);
+    }
+    out->len = 0U;
+    return out->err == ESP_OK;
+}
+
+static void out_printf(metrics_out_t *out, const char *fmt, ...)
+{
+    for (int attempt = 0; attempt < 2 && out->err == ESP_OK; ++attempt) {
+        va_list ap;
+        va_start(ap, fmt);
+        const int n = vsnprintf(&out->buf[out->len], out->cap - out->len, fmt, ap);
+        va_end(ap);
+        if (n < 0) {
+            out->err = ESP_FAIL;
+            return;
+        }
+        if ((size_t)n < out->cap - out->len) {
+            out->len += (size_t)n;
+            return;
+        }
+        // Line did not fit: push what is buffered and retry once into the empty buffer.
+        if (out->len == 0U) {
+            out->err = ESP_ERR_INVALID_SIZE;
+            return;
+        }
+        (void)out_drain(out);
+    }
+}
+
+static void out_family(metrics_out_t *out, const char *name, const char *help, const char *type)
+{
+    // Separate lines so each fits the 128-byte minimum buffer on its own.
+    out_printf(out, "# HELP %s %s\n", name, help);
+    out_printf(out, "# TYPE %s %s\n", name, type);
+}
+
+// Exposition values are seconds; keep the microsecond precision without floating point.
+static void out_seconds(metrics_out_t *out, const char *prefix, uint64_t us, const char *suffix)
+{
+    out_printf(out, "%s%" PRIu64 ".%06" PRIu32 "%s", prefix, us / 1000000U, (uint32_t)(us % 1000000U), suffix);
+}
+
+static void render_values(metrics_out_t *out)
+{
+    const char *last_name = NULL;
+    for (size_t i = 0; i < METRIC_COUNT; ++i) {
+        const metric_desc_t *desc = &s_desc[i];
+        if (last_name == NULL || strcmp(last_name, desc->name) != 0) {
+            out_family(out, desc->name, desc->help,
+                       desc->type == METRIC_TYPE_COUNTER ? "counter" : "gauge");
+            last_name = desc->name;
+        }
+        const uint32_t value = atomic_load_explicit(&s_values[i], memory_order_relaxed);
+        if (desc->labels != NULL) {
+            out_printf(out, "%s{%s} %" PRIu32 "\n", desc->name, desc->labels, value);
+        } else {
+            out_printf(out, "%s %" PRIu32 "\n", desc->name, value);
+        }
+    }
+}
+
+static void render_histograms(metrics_out_t *out)
+{
+    for (size_t i = 0; i < METRIC_HIST_COUNT; ++i) {
+        const metric_hist_desc_t *desc = &s_hist_desc[i];
+        out_family(out, desc->name, desc->help, "histogram");
+
+        // _count is the +Inf total so the series stays self-consistent even when an
+        // observation lands between the bucket and sum loads.
+        uint32_t cumulative = 0;
+        char prefix[64];
+        for (size_t b = 0; b < desc->bucket_count; ++b) {
+            cumulative += atomic_load_explicit(&s_hist[i].buckets[b], memory_order_relaxed);
+            (void)snprintf(prefix, sizeof(prefix), "%s_bucket{le=\"", desc->name);
+            char suffix[24];
+            (void)snprintf(suffix, sizeof(suffix), "\"} %" PRIu32 "\n", cumulative);
+            out_seconds(out, prefix, desc->bounds_us[b], suffix);
+        }
+        cumulative += atomic_load_explicit(&s_hist[i].buckets[desc->bucket_count], memory_order_relaxed);
+        out_printf(out, "%s_bucket{le=\"+Inf\"} %" PRIu32 "\n", desc->name, cumulative);
+        (void)snprintf(prefix, sizeof(prefix), "%s_sum ", desc->name);
+        out_seconds(out, prefix, atomic_load_explicit(&s_hist[i].sum_us, memory_order_relaxed), "\n");
+        out_printf(out, "%s_count %" PRIu32 "\n", desc->name, cumulative);
+    }
+}
+
+static void render_sampled(metrics_out_t *out)
+{
+    out_family(out, "macropad_heap_free_bytes", "Current free heap.", "gauge");
+    out_printf(out, "macropad_heap_free_bytes %" PRIu32 "\n", esp_get_free_heap_size());
+    out_family(out, "macropad_heap_min_free_bytes", "Lowest free heap since boot.", "gauge");
+    out_printf(out, "macropad_heap_min_free_bytes %" PRIu32 "\n", esp_get_minimum_free_heap_size());
+
+    out_family(out, "macropad_task_stack_high_water_bytes", "Smallest stack headroom seen per task.", "gauge");
+    for (size_t i = 0; i < sizeof(s_stack_tasks) / sizeof(s_stack_tasks[0]); ++i) {
+        TaskHandle_t task = xTaskGetHandle(s_stack_tasks[i]);
+        if (task == NULL) {
+            continue;
+        }
+        const UBaseType_t hw = uxTaskGetStackHighWaterMark(task);
+        out_printf(out, "macropad_task_stack_high_water_bytes{task=\"%s\"} %u\n",
+                   s_stack_tasks[i],
+                   (unsigned)(hw * sizeof(StackType_t)));
+    }
+
+    wifi_ap_record_t ap = {0};
+    if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+        out_family(out, "macropad_wifi_rssi_dbm", "Signal strength of the associated access point.", "gauge");
+        out_printf(out, "macropad_wifi_rssi_dbm %d\n", (int)ap.rssi);
+    }
+}
+
+esp_err_t metrics_render(char *buf, size_t cap, metrics_flush_fn_t flush, void *ctx)
+{
+    if (buf == NULL || cap < 128U || flush == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    metrics_out_t out = {
+        .buf = buf,
+        .cap = cap,
+        .len = 0,
+        .flush = flush,
+        .ctx = ctx,
+        .err = ESP_OK,
+    };
+    render_values(&out);
+    render_histograms(&out);
+    render_sampled(&out);
+    (void)out_drain(&out);
+    return out.err;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+// Counters and gauges. Order matches the descriptor table in metrics.c; series that share a
+// name must stay adjacent so the exposition emits one HELP/TYPE block per family.
+typedef enum {
+    METRIC_HID_REPORTS_USB_SENT = 0,
+    METRIC_HID_REPORTS_USB_FAILED,
+    METRIC_HID_REPORTS_BLE_SENT,
+    METRIC_HID_REPORTS_BLE_FAILED,
+    METRIC_HID_CONSUMER_INFLIGHT,
+    METRIC_HA_QUEUE_DEPTH,
+    METRIC_HA_POST_FAILURES,
+    METRIC_HA_CONNECTS,
+    METRIC_HA_EVENTS_COALESCED,
+    METRIC_HA_EVENTS_DROPPED,
+    METRIC_OLED_FLUSH_BYTES,
+    METRIC_OLED_FLUSH_FAILURES,
+    METRIC_COUNT,
+} metric_id_t;
+
+// Fixed-bucket latency histograms, observed in microseconds and exported in seconds.
+typedef enum {
+    METRIC_HIST_SCAN_LOOP = 0,
+    METRIC_HIST_OLED_FLUSH,
+    METRIC_HIST_HA_POST,
+    METRIC_HIST_HA_GET,
+    METRIC_HIST_COUNT,
+} metric_hist_id_t;
+
+// Write path: relaxed atomics only, safe from any task and never blocks.
+void metrics_inc(metric_id_t id);
+void metrics_dec(metric_id_t id);
+void metrics_add(metric_id_t id, uint32_t value);
+void metrics_set(metric_id_t id, uint32_t value);
+void metrics_observe_us(metric_hist_id_t id, uint32_t us);
+
+typedef esp_err_t (*metrics_flush_fn_t)(void *ctx, const char *data, size_t len);
+
+// Renders every series in text exposition format (version 0.0.4) through buf, calling flush
+// whenever it fills and once at the end. Heap, task stack and Wi-Fi RSSI gauges are sampled
+// here rather than on the write path.
+esp_err_t metrics_render(char *buf, size_t cap, metrics_flush_fn_t flush, void *ctx);
@@ -0,0 +1,242 @@
+#include "net_breaker.h"
+
+#include <inttypes.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+
+#define TAG "NET_BREAKER"
+
+#define NET_BREAKER_MAX_LEVEL 16U
+
+struct net_breaker {
+    const char *name;
+    net_breaker_config_t cfg;
+    net_breaker_state_t state;
+    uint8_t failures;
+    uint8_t backoff_level;
+    bool probe_in_flight;
+    int64_t retry_at_us;
+    uint32_t opens;
+    uint32_t rejected;
+};
+
+static net_breaker_t s_breakers[NET_BREAKER_MAX];
+static size_t s_breaker_count;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static volatile uint32_t s_version;
+
+// base << level capped at max, then "equal jitter": half fixed, half random, so devices that lost
+// the same server at the same moment do not come back in lockstep.
+static uint32_t backoff_delay_ms(const net_breaker_t *b)
+{
+    uint32_t delay = b->cfg.max_delay_ms;
+    if (b->backoff_level < 31U && (b->cfg.base_delay_ms >> (31U - b->backoff_level)) == 0U) {
+        const uint32_t scaled = b->cfg.base_delay_ms << b->backoff_level;
+        if (scaled < delay) {
+            delay = scaled;
+        }
+    }
+    const uint32_t half = delay / 2U;
+    return half + (esp_random() % (delay - half + 1U));
+}
+
+static void open_locked(net_breaker_t *b, int64_t now_us, uint32_t delay_ms)
+{
+    b->state = NET_BREAKER_OPEN;
+    b->probe_in_flight = false;
+    b->retry_at_us = now_us + (int64_t)delay_ms * 1000;
+    b->opens++;
+    s_version++;
+}
+
+net_breaker_t *net_breaker_create(const char *name, const net_breaker_config_t *cfg)
+{
+    if (cfg == NULL) {
+        return NULL;
+    }
+    net_breaker_t *b = NULL;
+    portENTER_CRITICAL(&s_lock);
+    if (s_breaker_count < NET_BREAKER_MAX) {
+        b = &s_breakers[s_breaker_count++];
+        memset(b, 0, sizeof(*b));
+        b->name = name;
+        b->cfg = *cfg;
+        if (b->cfg.failure_threshold == 0U) {
+            b->cfg.failure_threshold = 1U;
+        }
+        if (b->cfg.base_delay_ms == 0U) {
+            b->cfg.base_delay_ms = 1U;
+        }
+        if (b->cfg.max_delay_ms < b->cfg.base_delay_ms) {
+            b->cfg.max_delay_ms = b->cfg.base_delay_ms;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (b == NULL) {
+        ESP_LOGW(TAG, "No slot left for breaker %s", name);
+    }
+    return b;
+}
+
+bool net_breaker_allow(net_breaker_t *b)
+{
+    if (b == NULL) {
+        return true;
+    }
+    const int64_t now_us = esp_timer_get_time();
+    bool allowed = false;
+    bool probing = false;
+    portENTER_CRITICAL(&s_lock);
+    if (b->state == NET_BREAKER_CLOSED) {
+        allowed = true;
+    } else if (b->state == NET_BREAKER_OPEN && now_us >= b->retry_at_us) {
+        b->state = NET_BREAKER_HALF_OPEN;
+        b->probe_in_flight = true;
+        s_version++;
+        allowed = true;
+        probing = true;
+    } else if (b->state == NET_BREAKER_HALF_OPEN && !b->probe_in_flight) {
+        b->probe_in_flight = true;
+        allowed = true;
+        probing = true;
+    } else {
+        b->rejected++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (probing) {
+        ESP_LOGI(TAG, "%s: probing", b->name);
+    }
+    return allowed;
+}
+
+bool net_breaker_ready(net_breaker_t *b)
+{
+    if (b == NULL) {
+        return true;
+    }
+    const int64_t now_us = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    const bool ready = (b->state == NET_BREAKER_CLOSED) ||
+                       (b->state == NET_BREAKER_OPEN && now_us >= b->retry_at_us) ||
+                       (b->state == NET_BREAKER_HALF_OPEN && !b->probe_in_flight);
+    portEXIT_CRITICAL(&s_lock);
+    return ready;
+}
+
+void net_breaker_record(net_breaker_t *b, bool success)
+{
+    if (b == NULL) {
+        return;
+    }
+    const int64_t now_us = esp_timer_get_time();
+    net_breaker_state_t before;
+    uint32_t delay_ms = 0;
+    uint8_t failures;
+    portENTER_CRITICAL(&s_lock);
+    before = b->state;
+    if (success) {
+        b->failures = 0;
+        b->backoff_level = 0;
+        b->probe_in_flight = false;
+        if (b->state != NET_BREAKER_CLOSED) {
+            b->state = NET_BREAKER_CLOSED;
+            s_version++;
+        }
+    } else {
+        if (b->failures < UINT8_MAX) {
+            b->failures++;
+        }
+        if (b->state == NET_BREAKER_HALF_OPEN) {
+            if (b->backoff_level < NET_BREAKER_MAX_LEVEL) {
+                b->backoff_level++;
+            }
+            delay_ms = backoff_delay_ms(b);
+            open_locked(b, now_us, delay_ms);
+        } else if (b->state == NET_BREAKER_CLOSED && b->failures >= b->cfg.failure_threshold) {
+            delay_ms = backoff_delay_ms(b);
+            open_locked(b, now_us, delay_ms);
+        }
+        // Already open: a request that started before the breaker tripped; nothing to add.
+    }
+    failures = b->failures;
+    const net_breaker_state_t after = b->state;
+    portEXIT_CRITICAL(&s_lock);
+
+    if (after == before) {
+        return;
+    }
+    if (after == NET_BREAKER_CLOSED) {
+        ESP_LOGI(TAG, "%s: closed, peer reachable again", b->name);
+    } else {
+        ESP_LOGW(TAG, "%s: open after %u failures, next probe in %" PRIu32 " ms",
+                 b->name, (unsigned)failures, delay_ms);
+    }
+}
+
+static void info_locked(const net_breaker_t *b, int64_t now_us, net_breaker_info_t *out)
+{
+    out->name = b->name;
+    out->state = b->state;
+    out->failures = b->failures;
+    out->backoff_level = b->backoff_level;
+    out->retry_in_ms = 0;
+    if (b->state == NET_BREAKER_OPEN && b->retry_at_us > now_us) {
+        out->retry_in_ms = (uint32_t)((b->retry_at_us - now_us + 999) / 1000);
+    }
+    out->opens = b->opens;
+    out->rejected = b->rejected;
+}
+
+void net_breaker_get_info(net_breaker_t *b, net_breaker_info_t *out)
+{
+    if (out == NULL) {
+        return;
+    }
+    memset(out, 0, sizeof(*out));
+    if (b == NULL) {
+        return;
+    }
+    const int64_t now_us = esp_timer_get_time();
+    portENTER_CRITICAL(&s_lock);
+    info_locked(b, now_us, out);
+    portEXIT_CRITICAL(&s_lock);
+}
+
+size_t net_breaker_snapshot(net_breaker_info_t *out, size_t max)
+{
+    if (out == NULL) {
+        return 0;
+    }
+    const int64_t now_us = esp_timer_get_time();
+    size_t n = 0;
+    portENTER_CRITICAL(&s_lock);
+    for (; n < s_breaker_count && n < max; ++n) {
+        info_locked(&s_breakers[n], now_us, &out[n]);
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return n;
+}
+
+uint32_t net_breaker_version(void)
+{
+    return s_version;
+}
+
+const char *net_breaker_state_name(net_breaker_state_t state)
+{
+    switch (state) {
+    case NET_BREAKER_CLOSED:
+        return "closed";
+    case NET_BREAKER_OPEN:
+        return "open";
+    case NET_BREAKER_HALF_OPEN:
+        return "half_open";
+    default:
+        return "unknown";
+    }
+}
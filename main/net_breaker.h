@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define NET_BREAKER_MAX 4U
+
+typedef enum {
+    NET_BREAKER_CLOSED = 0,  // requests flow; consecutive failures are counted
+    NET_BREAKER_OPEN,        // requests are rejected until the backoff delay runs out
+    NET_BREAKER_HALF_OPEN,   // one probe request is in flight; its outcome closes or reopens
+} net_breaker_state_t;
+
+typedef struct {
+    uint8_t failure_threshold;   // consecutive failures that open the breaker
+    uint32_t base_delay_ms;      // first open period; doubles after every failed probe
+    uint32_t max_delay_ms;
+} net_breaker_config_t;
+
+typedef struct {
+    const char *name;
+    net_breaker_state_t state;
+    uint8_t failures;            // consecutive
+    uint8_t backoff_level;       // failed probes since the breaker last closed
+    uint32_t retry_in_ms;        // until the next probe may go out; 0 unless open
+    uint32_t opens;              // since boot
+    uint32_t rejected;           // requests refused while open, since boot
+} net_breaker_info_t;
+
+typedef struct net_breaker net_breaker_t;
+
+// Takes one of NET_BREAKER_MAX static slots; NULL when they are used up. Call once per user at init.
+net_breaker_t *net_breaker_create(const char *name, const net_breaker_config_t *cfg);
+// Asks to send a request. Once the open period has run out this claims the single half-open probe.
+// Every true must be followed by net_breaker_record(). A NULL breaker always allows.
+bool net_breaker_allow(net_breaker_t *b);
+// Like net_breaker_allow() without claiming anything, for callers deciding whether to try at all.
+bool net_breaker_ready(net_breaker_t *b);
+// success = the peer answered (any non-5xx HTTP status); transport errors and 5xx are failures.
+void net_breaker_record(net_breaker_t *b, bool success);
+void net_breaker_get_info(net_breaker_t *b, net_breaker_info_t *out);
+// Fills out with every created breaker in creation order; returns the count.
+size_t net_breaker_snapshot(net_breaker_info_t *out, size_t max);
+// Bumped on every state transition of any breaker; lock-free, for cheap change checks.
+uint32_t net_breaker_version(void);
+const char *net_breaker_state_name(net_breaker_state_t state);
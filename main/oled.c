@@ -7,9 +7,17 @@
 #include "driver/i2c_master.h"
 
 #include "esp_check.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 
+#include "bench.h"
 #include "keymap_config.h"
+#include "metrics.h"
 #include "oled.h"
+#include "profiler.h"
+#include "trace_buffer.h"
 
 #define TAG "MACROPAD"
 
@@ -21,6 +29,9 @@
 typedef struct {
     i2c_master_bus_handle_t bus;
     i2c_master_dev_handle_t dev;
+    // Held for a whole frame or panel command by the oled_render_*/oled_set_* entry points, and by
+    // the bench cases for their whole run, so neither sees the other's half-drawn framebuffer.
+    SemaphoreHandle_t lock;
     uint8_t fb[OLED_WIDTH * OLED_HEIGHT / 8];
     bool display_enabled;
     bool inverted;
@@ -30,11 +41,26 @@ typedef struct {
 static oled_state_t s_oled = {
     .bus = NULL,
     .dev = NULL,
+    .lock = NULL,
     .display_enabled = true,
     .inverted = false,
     .brightness_percent = 100,
 };
 
+static void oled_lock(void)
+{
+    if (s_oled.lock != NULL) {
+        (void)xSemaphoreTake(s_oled.lock, portMAX_DELAY);
+    }
+}
+
+static void oled_unlock(void)
+{
+    if (s_oled.lock != NULL) {
+        (void)xSemaphoreGive(s_oled.lock);
+    }
+}
+
 static esp_err_t oled_send_cmd(uint8_t cmd)
 {
     uint8_t payload[2] = {0x00, cmd};
@@ -231,9 +257,19 @@ esp_err_t oled_draw_text_utf8(int x, int y, const char *utf8, const oled_font_t
 
 esp_err_t oled_present(void)
 {
+    PROF_SCOPE(PROF_SCOPE_OLED_FLUSH);
+    TRACE_SPAN(TRACE_SPAN_OLED_FLUSH);
+    const int64_t start_us = esp_timer_get_time();
     for (uint8_t page = 0; page < (OLED_HEIGHT / 8); ++page) {
-        ESP_RETURN_ON_ERROR(oled_send_page(page, &s_oled.fb[page * OLED_WIDTH]), TAG, "flush page %u failed", page);
+        const esp_err_t err = oled_send_page(page, &s_oled.fb[page * OLED_WIDTH]);
+        if (err != ESP_OK) {
+            metrics_inc(METRIC_OLED_FLUSH_FAILURES);
+            ESP_LOGE(TAG, "flush page %u failed", page);
+            return err;
+        }
+        metrics_add(METRIC_OLED_FLUSH_BYTES, OLED_WIDTH);
     }
+    metrics_observe_us(METRIC_HIST_OLED_FLUSH, (uint32_t)(esp_timer_get_time() - start_us));
     return ESP_OK;
 }
 
@@ -242,6 +278,7 @@ esp_err_t oled_render_animation_frame_centered(const oled_animation_t *anim,
                                                int8_t shift_x,
                                                int8_t shift_y)
 {
+    PROF_SCOPE(PROF_SCOPE_OLED_RENDER);
     if (anim == NULL || anim->frames == NULL || anim->frame_count == 0U) {
         return ESP_ERR_INVALID_ARG;
     }
@@ -257,9 +294,12 @@ esp_err_t oled_render_animation_frame_centered(const oled_animation_t *anim,
     const int x = ((OLED_WIDTH - (int)anim->width) / 2) + (int)shift_x;
     const int y = ((OLED_HEIGHT - (int)anim->height) / 2) + (int)shift_y;
 
+    oled_lock();
     oled_clear_buffer();
     oled_draw_bitmap_mono(x, y, anim->width, anim->height, frame->bitmap, anim->bit_packed);
-    return oled_present();
+    const esp_err_t err = oled_present();
+    oled_unlock();
+    return err;
 }
 
 typedef struct {
@@ -454,6 +494,70 @@ static void oled_draw_clock(const struct tm *timeinfo, int8_t shift_x, int8_t sh
     }
 }
 
+typedef struct {
+    uint8_t saved_fb[OLED_WIDTH * OLED_HEIGHT / 8];
+    struct tm tm;
+} bench_oled_ctx_t;
+
+static bench_oled_ctx_t s_bench_oled = {
+    .tm = {.tm_year = 2025 - 1900, .tm_hour = 23, .tm_min = 58, .tm_sec = 48},
+};
+
+// The framebuffer belongs to display_task: hold the display lock for the whole case (display_task
+// waits out the run) and put its last frame back before letting go.
+static void bench_oled_setup(void *ctx)
+{
+    oled_lock();
+    memcpy(((bench_oled_ctx_t *)ctx)->saved_fb, s_oled.fb, sizeof(s_oled.fb));
+}
+
+static void bench_oled_teardown(void *ctx)
+{
+    memcpy(s_oled.fb, ((const bench_oled_ctx_t *)ctx)->saved_fb, sizeof(s_oled.fb));
+    oled_unlock();
+}
+
+static void bench_oled_flush_setup(void *ctx)
+{
+    (void)ctx;
+    oled_lock();
+}
+
+static void bench_oled_flush_teardown(void *ctx)
+{
+    (void)ctx;
+    oled_unlock();
+}
+
+static void bench_oled_clock_run(void *ctx)
+{
+    oled_clear_buffer();
+    oled_draw_clock(&((const bench_oled_ctx_t *)ctx)->tm, 0, 0);
+}
+
+// Pushes whatever display_task last drew; I2C waits make this a blocking case.
+static void bench_oled_flush_run(void *ctx)
+{
+    (void)ctx;
+    (void)oled_present();
+}
+
+static const bench_case_t s_bench_oled_clock = {
+    .name = "oled_clock_render",
+    .run = bench_oled_clock_run,
+    .setup = bench_oled_setup,
+    .teardown = bench_oled_teardown,
+    .ctx = &s_bench_oled,
+};
+
+static const bench_case_t s_bench_oled_flush = {
+    .name = "oled_flush",
+    .run = bench_oled_flush_run,
+    .setup = bench_oled_flush_setup,
+    .teardown = bench_oled_flush_teardown,
+    .flags = BENCH_FLAG_BLOCKING,
+};
+
 esp_err_t oled_init(void)
 {
     uint32_t oled_i2c_hz = (uint32_t)MACRO_OLED_I2C_SCL_HZ;
@@ -463,6 +567,11 @@ esp_err_t oled_init(void)
         oled_i2c_hz = 1000000U;
     }
 
+    if (s_oled.lock == NULL) {
+        s_oled.lock = xSemaphoreCreateMutex();
+        ESP_RETURN_ON_FALSE(s_oled.lock != NULL, ESP_ERR_NO_MEM, TAG, "oled lock alloc failed");
+    }
+
     const i2c_master_bus_config_t bus_cfg = {
         .i2c_port = OLED_I2C_PORT,
         .sda_io_num = OLED_SDA_GPIO,
@@ -493,7 +602,10 @@ esp_err_t oled_init(void)
 
     oled_clear_buffer();
     ESP_RETURN_ON_ERROR(oled_present(), TAG, "oled initial flush failed");
-    return oled_set_brightness_percent(100U);
+    ESP_RETURN_ON_ERROR(oled_set_brightness_percent(100U), TAG, "oled brightness failed");
+    (void)bench_register(&s_bench_oled_clock);
+    (void)bench_register(&s_bench_oled_flush);
+    return ESP_OK;
 }
 
 esp_err_t oled_set_brightness_percent(uint8_t percent)
@@ -502,35 +614,56 @@ esp_err_t oled_set_brightness_percent(uint8_t percent)
         percent = 100U;
     }
     const uint8_t contrast = oled_percent_to_contrast(percent);
-    ESP_RETURN_ON_ERROR(oled_send_cmd(0x81), TAG, "set contrast cmd failed");
-    ESP_RETURN_ON_ERROR(oled_send_cmd(contrast), TAG, "set contrast value failed");
-    s_oled.brightness_percent = percent;
+    oled_lock();
+    esp_err_t err = oled_send_cmd(0x81);
+    if (err == ESP_OK) {
+        err = oled_send_cmd(contrast);
+    }
+    if (err == ESP_OK) {
+        s_oled.brightness_percent = percent;
+    }
+    oled_unlock();
+    ESP_RETURN_ON_ERROR(err, TAG, "set contrast failed");
     return ESP_OK;
 }
 
 esp_err_t oled_set_display_enabled(bool enabled)
 {
-    ESP_RETURN_ON_ERROR(oled_send_cmd(enabled ? 0xAF : 0xAE), TAG, "set display power failed");
-    s_oled.display_enabled = enabled;
+    oled_lock();
+    const esp_err_t err = oled_send_cmd(enabled ? 0xAF : 0xAE);
+    if (err == ESP_OK) {
+        s_oled.display_enabled = enabled;
+    }
+    oled_unlock();
+    ESP_RETURN_ON_ERROR(err, TAG, "set display power failed");
     return ESP_OK;
 }
 
 esp_err_t oled_set_inverted(bool inverted)
 {
-    ESP_RETURN_ON_ERROR(oled_send_cmd(inverted ? 0xA7 : 0xA6), TAG, "set display invert failed");
-    s_oled.inverted = inverted;
+    oled_lock();
+    const esp_err_t err = oled_send_cmd(inverted ? 0xA7 : 0xA6);
+    if (err == ESP_OK) {
+        s_oled.inverted = inverted;
+    }
+    oled_unlock();
+    ESP_RETURN_ON_ERROR(err, TAG, "set display invert failed");
     return ESP_OK;
 }
 
 esp_err_t oled_render_clock(const struct tm *timeinfo, int8_t shift_x, int8_t shift_y)
 {
+    PROF_SCOPE(PROF_SCOPE_OLED_RENDER);
     if (timeinfo == NULL) {
         return ESP_ERR_INVALID_ARG;
     }
 
+    oled_lock();
     oled_clear_buffer();
     oled_draw_clock(timeinfo, shift_x, shift_y);
-    return oled_present();
+    const esp_err_t err = oled_present();
+    oled_unlock();
+    return err;
 }
 
 esp_err_t oled_render_clock_with_status(const struct tm *timeinfo,
@@ -538,16 +671,20 @@ esp_err_t oled_render_clock_with_status(const struct tm *timeinfo,
                                         int8_t shift_x,
                                         int8_t shift_y)
 {
+    PROF_SCOPE(PROF_SCOPE_OLED_RENDER);
     if (timeinfo == NULL) {
         return ESP_ERR_INVALID_ARG;
     }
 
+    oled_lock();
     oled_clear_buffer();
     oled_draw_clock(timeinfo, shift_x, (int8_t)(shift_y + 8));
     if (status_text != NULL && status_text[0] != '\0') {
         oled_draw_text_tiny(2 + shift_x, 2 + shift_y, status_text, 30);
     }
-    return oled_present();
+    const esp_err_t err = oled_present();
+    oled_unlock();
+    return err;
 }
 
 esp_err_t oled_render_text_lines(const char *line0,
@@ -557,6 +694,8 @@ esp_err_t oled_render_text_lines(const char *line0,
                                  int8_t shift_x,
                                  int8_t shift_y)
 {
+    PROF_SCOPE(PROF_SCOPE_OLED_RENDER);
+    oled_lock();
     oled_clear_buffer();
     if (line0 != NULL && line0[0] != '\0') {
         oled_draw_text_tiny(2 + shift_x, 2 + shift_y, line0, 30);
@@ -570,5 +709,7 @@ esp_err_t oled_render_text_lines(const char *line0,
     if (line3 != NULL && line3[0] != '\0') {
         oled_draw_text_tiny(2 + shift_x, 38 + shift_y, line3, 30);
     }
-    return oled_present();
+    const esp_err_t err = oled_present();
+    oled_unlock();
+    return err;
 }
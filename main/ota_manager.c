@@ -10,13 +10,16 @@
 #include "esp_check.h"
 #include "esp_crt_bundle.h"
 #include "esp_heap_caps.h"
+#include "esp_http_client.h"
 #include "esp_https_ota.h"
 #include "esp_log.h"
 #include "esp_ota_ops.h"
 #include "esp_system.h"
 
 #include "keymap_config.h"
+#include "net_breaker.h"
 #include "sdkconfig.h"
+#include "trace_buffer.h"
 
 #define TAG "OTA_MANAGER"
 
@@ -50,6 +53,12 @@ typedef struct {
     uint8_t download_percent;
     char current_url[OTA_URL_MAX];
     char last_error[OTA_ERROR_MAX];
+    char breaker_url[OTA_URL_MAX];   // URL whose transport failures opened the breaker
+    net_breaker_t *breaker;
+    // Bumped on state/error/percent changes; read without the lock.
+    volatile uint32_t status_version;
+    // Status line of the last response the download saw (0 = none); only the worker touches it.
+    int http_status;
 } ota_manager_context_t;
 
 static ota_manager_context_t s_ota = {0};
@@ -68,8 +77,15 @@ static inline void ota_unlock(void)
     }
 }
 
+static void ota_set_state_locked(ota_manager_state_t state)
+{
+    s_ota.state = state;
+    s_ota.status_version++;
+}
+
 static void ota_set_error_locked(const char *error_text)
 {
+    s_ota.status_version++;
     if (error_text != NULL) {
         strlcpy(s_ota.last_error, error_text, sizeof(s_ota.last_error));
     } else {
@@ -79,6 +95,7 @@ static void ota_set_error_locked(const char *error_text)
 
 static void ota_set_error_name_locked(esp_err_t err)
 {
+    s_ota.status_version++;
     strlcpy(s_ota.last_error, esp_err_to_name(err), sizeof(s_ota.last_error));
 }
 
@@ -88,6 +105,7 @@ static void ota_reset_download_progress_locked(void)
     s_ota.download_read_bytes = 0U;
     s_ota.download_percent = 0U;
     s_ota.download_start_tick = 0;
+    s_ota.status_version++;
 }
 
 static void ota_update_download_progress_locked(uint32_t read_bytes, uint32_t total_bytes, TickType_t now)
@@ -98,14 +116,16 @@ static void ota_update_download_progress_locked(uint32_t read_bytes, uint32_t to
         s_ota.download_start_tick = now;
     }
 
+    uint32_t pct = 0U;
     if (total_bytes > 0U) {
-        uint32_t pct = (read_bytes * 100U) / total_bytes;
+        pct = (read_bytes * 100U) / total_bytes;
         if (pct > 100U) {
             pct = 100U;
         }
+    }
+    if (s_ota.download_percent != (uint8_t)pct) {
         s_ota.download_percent = (uint8_t)pct;
-    } else {
-        s_ota.download_percent = 0U;
+        s_ota.status_version++;
     }
 }
 
@@ -181,51 +201,70 @@ const char *ota_manager_state_name(ota_manager_state_t state)
     }
 }
 
-static void ota_worker_task(void *arg)
+// One esp_https_ota_perform() call reads and writes one chunk of the image.
+static esp_err_t ota_perform_chunk(esp_https_ota_handle_t ota_handle)
 {
-    char url[OTA_URL_MAX] = {0};
-    (void)arg;
+    TRACE_SPAN(TRACE_SPAN_OTA_CHUNK);
+    return esp_https_ota_perform(ota_handle);
+}
 
-    ota_lock();
-    strlcpy(url, s_ota.current_url, sizeof(url));
-    ota_reset_download_progress_locked();
-    ota_unlock();
+// esp_https_ota_begin() frees its handle on a non-200 reply, so the status is caught here instead.
+static esp_err_t ota_http_event_handler(esp_http_client_event_t *evt)
+{
+    if (evt->event_id == HTTP_EVENT_ON_HEADER) {
+        s_ota.http_status = esp_http_client_get_status_code(evt->client);
+    }
+    return ESP_OK;
+}
 
-    const bool is_https = ota_url_is_https(url);
-    esp_http_client_config_t http_cfg = {
-        .url = url,
-        .timeout_ms = CONFIG_MACROPAD_OTA_HTTP_TIMEOUT_MS,
-        .keep_alive_enable = true,
-    };
-    if (is_https && !MACRO_OTA_SKIP_CERT_VERIFY) {
-        http_cfg.crt_bundle_attach = esp_crt_bundle_attach;
-    } else if (is_https && MACRO_OTA_SKIP_CERT_VERIFY) {
-        http_cfg.skip_cert_common_name_check = true;
-        ESP_LOGW(TAG, "OTA HTTPS certificate verification is DISABLED by config");
-    } else if (ota_url_is_http(url)) {
-        ESP_LOGW(TAG, "OTA over plain HTTP is enabled by config (insecure)");
+// Errors that may clear up on their own: no connection, timeouts, a dropped stream, a 5xx. A 4xx
+// (missing image, no access) is the server's final answer, and image validation, flash and memory
+// errors are not retried either.
+static bool ota_error_is_transport(esp_err_t err, int http_status)
+{
+    if (http_status >= 400 && http_status < 500) {
+        return false;
     }
-    esp_https_ota_config_t ota_cfg = {
-        .http_config = &http_cfg,
-    };
+    return err == ESP_FAIL || err == ESP_ERR_TIMEOUT ||
+           (err >= ESP_ERR_HTTP_BASE && err < ESP_ERR_HTTP_BASE + 0x100);
+}
 
-    ESP_LOGI(TAG, "Starting OTA from: %s", url);
+// Explicit pause between attempts: the breaker alone lets retries straight through while it is
+// still closed (failure_threshold > 1).
+static uint32_t ota_retry_delay_ms(uint32_t attempt)
+{
+    uint32_t delay_ms = (uint32_t)MACRO_OTA_BREAKER_BASE_DELAY_MS;
+    for (uint32_t i = 1U; i < attempt && delay_ms < (uint32_t)MACRO_OTA_BREAKER_MAX_DELAY_MS; ++i) {
+        delay_ms *= 2U;
+    }
+    return (delay_ms < (uint32_t)MACRO_OTA_BREAKER_MAX_DELAY_MS) ? delay_ms : (uint32_t)MACRO_OTA_BREAKER_MAX_DELAY_MS;
+}
+
+static void ota_set_failure_locked(esp_err_t err, int http_status)
+{
+    if (http_status >= 400) {
+        char text[24];
+        (void)snprintf(text, sizeof(text), "HTTP %d", http_status);
+        ota_set_error_locked(text);
+    } else {
+        ota_set_error_name_locked(err);
+    }
+}
+
+// One full download from a fresh connection; the image is written but not activated on failure.
+static esp_err_t ota_download_once(const esp_https_ota_config_t *ota_cfg)
+{
     esp_https_ota_handle_t ota_handle = NULL;
-    esp_err_t err = esp_https_ota_begin(&ota_cfg, &ota_handle);
+    s_ota.http_status = 0;
+    esp_err_t err = esp_https_ota_begin(ota_cfg, &ota_handle);
     if (err != ESP_OK) {
-        ota_lock();
-        s_ota.state = OTA_MANAGER_STATE_DOWNLOAD_FAILED;
-        ota_set_error_name_locked(err);
-        s_ota.worker_task = NULL;
-        ota_unlock();
-        ESP_LOGE(TAG, "OTA begin failed: %s", esp_err_to_name(err));
-        vTaskDelete(NULL);
-        return;
+        ESP_LOGE(TAG, "OTA begin failed: %s (HTTP %d)", esp_err_to_name(err), s_ota.http_status);
+        return err;
     }
 
     uint8_t next_pct_log = OTA_PROGRESS_LOG_STEP_PERCENT;
     TickType_t last_log_tick = 0;
-    while ((err = esp_https_ota_perform(ota_handle)) == ESP_ERR_HTTPS_OTA_IN_PROGRESS) {
+    while ((err = ota_perform_chunk(ota_handle)) == ESP_ERR_HTTPS_OTA_IN_PROGRESS) {
         const int read_int = esp_https_ota_get_image_len_read(ota_handle);
         const int total_int = esp_https_ota_get_image_size(ota_handle);
         const uint32_t read_bytes = (read_int > 0) ? (uint32_t)read_int : 0U;
@@ -266,11 +305,75 @@ static void ota_worker_task(void *arg)
     } else {
         (void)esp_https_ota_abort(ota_handle);
     }
+    return err;
+}
+
+static void ota_worker_task(void *arg)
+{
+    char url[OTA_URL_MAX] = {0};
+    (void)arg;
+
+    ota_lock();
+    strlcpy(url, s_ota.current_url, sizeof(url));
+    ota_reset_download_progress_locked();
+    ota_unlock();
+
+    const bool is_https = ota_url_is_https(url);
+    esp_http_client_config_t http_cfg = {
+        .url = url,
+        .timeout_ms = CONFIG_MACROPAD_OTA_HTTP_TIMEOUT_MS,
+        .keep_alive_enable = true,
+        .event_handler = ota_http_event_handler,
+    };
+    if (is_https && !MACRO_OTA_SKIP_CERT_VERIFY) {
+        http_cfg.crt_bundle_attach = esp_crt_bundle_attach;
+    } else if (is_https && MACRO_OTA_SKIP_CERT_VERIFY) {
+        http_cfg.skip_cert_common_name_check = true;
+        ESP_LOGW(TAG, "OTA HTTPS certificate verification is DISABLED by config");
+    } else if (ota_url_is_http(url)) {
+        ESP_LOGW(TAG, "OTA over plain HTTP is enabled by config (insecure)");
+    }
+    esp_https_ota_config_t ota_cfg = {
+        .http_config = &http_cfg,
+    };
+
+    ESP_LOGI(TAG, "Starting OTA from: %s", url);
+    // A manual start always gets its first attempt; this claims the probe when the backoff has run out.
+    (void)net_breaker_allow(s_ota.breaker);
+    esp_err_t err = ESP_FAIL;
+    bool transport_error = false;
+    for (uint32_t attempt = 1U;; ++attempt) {
+        err = ota_download_once(&ota_cfg);
+        // Only transport errors count against the server; a 4xx or a rejected image means it answered.
+        transport_error = (err != ESP_OK) && ota_error_is_transport(err, s_ota.http_status);
+        net_breaker_record(s_ota.breaker, !transport_error);
+        if (err == ESP_OK || !transport_error || attempt >= (uint32_t)MACRO_OTA_DOWNLOAD_ATTEMPTS) {
+            break;
+        }
+
+        ota_lock();
+        ota_set_failure_locked(err, s_ota.http_status);
+        ota_reset_download_progress_locked();
+        ota_unlock();
+        net_breaker_info_t info;
+        net_breaker_get_info(s_ota.breaker, &info);
+        const uint32_t delay_ms = ota_retry_delay_ms(attempt);
+        ESP_LOGW(TAG, "OTA attempt %" PRIu32 "/%d failed (%s); retrying in %" PRIu32 " ms",
+                 attempt, (int)MACRO_OTA_DOWNLOAD_ATTEMPTS, esp_err_to_name(err),
+                 (info.retry_in_ms > delay_ms) ? info.retry_in_ms : delay_ms);
+        vTaskDelay(pdMS_TO_TICKS(delay_ms));
+        // Then sleep through whatever is left of the breaker's jittered backoff and claim its probe.
+        while (!net_breaker_allow(s_ota.breaker)) {
+            net_breaker_get_info(s_ota.breaker, &info);
+            vTaskDelay(pdMS_TO_TICKS((info.retry_in_ms > 0U) ? info.retry_in_ms : 100U));
+        }
+    }
 
     if (err == ESP_OK) {
         ota_lock();
-        s_ota.state = OTA_MANAGER_STATE_REBOOTING;
+        ota_set_state_locked(OTA_MANAGER_STATE_REBOOTING);
         s_ota.worker_task = NULL;
+        s_ota.breaker_url[0] = '\0';
         ota_set_error_locked(NULL);
         ota_update_download_progress_locked(s_ota.download_total_bytes,
                                             s_ota.download_total_bytes,
@@ -283,17 +386,18 @@ static void ota_worker_task(void *arg)
     }
 
     ota_lock();
-    s_ota.state = OTA_MANAGER_STATE_DOWNLOAD_FAILED;
-    ota_set_error_name_locked(err);
+    ota_set_state_locked(OTA_MANAGER_STATE_DOWNLOAD_FAILED);
+    ota_set_failure_locked(err, s_ota.http_status);
     s_ota.worker_task = NULL;
+    strlcpy(s_ota.breaker_url, transport_error ? url : "", sizeof(s_ota.breaker_url));
     ota_unlock();
-    ESP_LOGE(TAG, "OTA download failed: %s", esp_err_to_name(err));
+    ESP_LOGE(TAG, "OTA download failed: %s (HTTP %d)", esp_err_to_name(err), s_ota.http_status);
     vTaskDelete(NULL);
 }
 
 static void ota_enter_wait_confirm(TickType_t now)
 {
-    s_ota.state = OTA_MANAGER_STATE_WAITING_CONFIRM;
+    ota_set_state_locked(OTA_MANAGER_STATE_WAITING_CONFIRM);
     s_ota.self_check_due_tick = 0;
     s_ota.self_check_retry_count = 0;
     s_ota.confirm_start_tick = now;
@@ -361,13 +465,19 @@ esp_err_t ota_manager_init(void)
     s_ota.initialized = true;
 
     if (!MACRO_OTA_ENABLED) {
-        s_ota.state = OTA_MANAGER_STATE_DISABLED;
+        ota_set_state_locked(OTA_MANAGER_STATE_DISABLED);
         ESP_LOGI(TAG, "disabled by config");
         return ESP_OK;
     }
 
-    s_ota.state = OTA_MANAGER_STATE_READY;
+    ota_set_state_locked(OTA_MANAGER_STATE_READY);
     ota_reset_download_progress_locked();
+    const net_breaker_config_t breaker_cfg = {
+        .failure_threshold = MACRO_OTA_BREAKER_FAILURE_THRESHOLD,
+        .base_delay_ms = MACRO_OTA_BREAKER_BASE_DELAY_MS,
+        .max_delay_ms = MACRO_OTA_BREAKER_MAX_DELAY_MS,
+    };
+    s_ota.breaker = net_breaker_create("ota", &breaker_cfg);
     const esp_partition_t *running = esp_ota_get_running_partition();
     if (running != NULL) {
         esp_ota_img_states_t state = ESP_OTA_IMG_UNDEFINED;
@@ -382,7 +492,7 @@ esp_err_t ota_manager_init(void)
         if (state_err == ESP_OK && state == ESP_OTA_IMG_PENDING_VERIFY) {
             const TickType_t now = xTaskGetTickCount();
             s_ota.pending_verify = true;
-            s_ota.state = OTA_MANAGER_STATE_SELF_CHECK_RUNNING;
+            ota_set_state_locked(OTA_MANAGER_STATE_SELF_CHECK_RUNNING);
             s_ota.self_check_start_tick = now;
             s_ota.self_check_due_tick = now + pdMS_TO_TICKS((uint32_t)MACRO_OTA_SELF_CHECK_DURATION_MS);
             s_ota.self_check_retry_count = 0;
@@ -440,7 +550,7 @@ void ota_manager_poll(TickType_t now)
     } else if (s_ota.state == OTA_MANAGER_STATE_WAITING_CONFIRM &&
                s_ota.confirm_deadline_tick != 0 &&
                now >= s_ota.confirm_deadline_tick) {
-        s_ota.state = OTA_MANAGER_STATE_ROLLBACK_REBOOTING;
+        ota_set_state_locked(OTA_MANAGER_STATE_ROLLBACK_REBOOTING);
         ota_set_error_locked("confirm timeout");
         ota_unlock();
         ESP_LOGE(TAG, "OTA confirmation timeout; rolling back");
@@ -452,7 +562,7 @@ void ota_manager_poll(TickType_t now)
     } else if (s_ota.state == OTA_MANAGER_STATE_CONFIRMED) {
         const TickType_t elapsed = now - s_ota.confirm_success_tick;
         if (elapsed >= pdMS_TO_TICKS(OTA_CONFIRM_BANNER_MS)) {
-            s_ota.state = OTA_MANAGER_STATE_READY;
+            ota_set_state_locked(OTA_MANAGER_STATE_READY);
             s_ota.confirm_start_tick = 0;
             s_ota.confirm_deadline_tick = 0;
             s_ota.confirm_success_tick = 0;
@@ -503,9 +613,14 @@ esp_err_t ota_manager_start_update(const char *url)
         ota_unlock();
         return ESP_ERR_INVALID_STATE;
     }
+    // The server behind this URL just failed; a different URL is tried right away.
+    if (strcmp(chosen_url, s_ota.breaker_url) == 0 && !net_breaker_ready(s_ota.breaker)) {
+        ota_unlock();
+        return ESP_ERR_NOT_ALLOWED;
+    }
 
     strlcpy(s_ota.current_url, chosen_url, sizeof(s_ota.current_url));
-    s_ota.state = OTA_MANAGER_STATE_DOWNLOADING;
+    ota_set_state_locked(OTA_MANAGER_STATE_DOWNLOADING);
     s_ota.confirm_start_tick = 0;
     s_ota.confirm_deadline_tick = 0;
     s_ota.confirm_success_tick = 0;
@@ -516,7 +631,7 @@ esp_err_t ota_manager_start_update(const char *url)
 
     if (xTaskCreate(ota_worker_task, "ota_worker", OTA_TASK_STACK, NULL, 5, &s_ota.worker_task) != pdPASS) {
         s_ota.worker_task = NULL;
-        s_ota.state = OTA_MANAGER_STATE_DOWNLOAD_FAILED;
+        ota_set_state_locked(OTA_MANAGER_STATE_DOWNLOAD_FAILED);
         ota_set_error_locked("task create failed");
         ota_unlock();
         return ESP_ERR_NO_MEM;
@@ -539,14 +654,14 @@ bool ota_manager_handle_encoder_taps(uint8_t taps)
         if (taps == (uint8_t)MACRO_OTA_CONFIRM_TAP_COUNT) {
             const esp_err_t err = esp_ota_mark_app_valid_cancel_rollback();
             if (err == ESP_OK) {
-                s_ota.state = OTA_MANAGER_STATE_CONFIRMED;
+                ota_set_state_locked(OTA_MANAGER_STATE_CONFIRMED);
                 s_ota.pending_verify = false;
                 s_ota.confirm_success_tick = xTaskGetTickCount();
                 s_ota.confirm_deadline_tick = 0;
                 ota_set_error_locked(NULL);
                 ESP_LOGI(TAG, "OTA image confirmed by EC11 tap x%u", (unsigned)taps);
             } else {
-                s_ota.state = OTA_MANAGER_STATE_ROLLBACK_REBOOTING;
+                ota_set_state_locked(OTA_MANAGER_STATE_ROLLBACK_REBOOTING);
                 ota_set_error_name_locked(err);
                 ota_unlock();
                 ESP_LOGE(TAG, "OTA confirm failed: %s; rebooting for rollback", esp_err_to_name(err));
@@ -564,6 +679,11 @@ bool ota_manager_handle_encoder_taps(uint8_t taps)
     return consumed;
 }
 
+uint32_t ota_manager_status_version(void)
+{
+    return s_ota.status_version;
+}
+
 void ota_manager_get_status(ota_manager_status_t *out_status)
 {
     if (out_status == NULL) {
@@ -45,6 +45,8 @@ esp_err_t ota_manager_start_update(const char *url);
 bool ota_manager_handle_encoder_taps(uint8_t taps);
 
 void ota_manager_get_status(ota_manager_status_t *out_status);
+// Changes whenever state, error text or download percent changes; lock-free, for cheap change checks.
+uint32_t ota_manager_status_version(void);
 const char *ota_manager_state_name(ota_manager_state_t state);
 
 bool ota_manager_get_oled_lines(char *line0,
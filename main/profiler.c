@@ -0,0 +1,332 @@
+#include "profiler.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+
+#define TAG "PROFILER"
+
+#define PROFILER_TASK_STACK 3072
+#define PROFILER_TASK_PRIO 1
+#define PROFILER_SAMPLE_MS 1000U
+// One sample per second; the ring holds window_sec + 1 samples so the oldest one is the window start.
+#define PROFILER_RING ((uint32_t)MACRO_PROFILER_WINDOW_SEC + 1U)
+#define PROFILER_HAS_RUNTIME_STATS (CONFIG_FREERTOS_USE_TRACE_FACILITY && CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS)
+
+typedef struct {
+    atomic_uint calls;
+    _Atomic uint64_t cycles;  // a 32-bit total wraps in under 18 s at 240 MHz, well inside the window
+    atomic_uint max_cycles;   // since the last sample
+} prof_scope_counter_t;
+
+typedef struct {
+    uint32_t calls;
+    uint64_t cycles;
+    uint32_t max_cycles;
+} prof_scope_sample_t;
+
+typedef struct {
+    bool used;
+    UBaseType_t task_number;
+    uint32_t first_sample;   // first sample the task was seen in
+    uint32_t runtime[PROFILER_RING];
+} prof_task_slot_t;
+
+typedef struct {
+    bool initialized;
+    SemaphoreHandle_t lock;
+    TaskHandle_t task;
+    TaskHandle_t idle[2];
+    uint32_t seq;            // index of the next sample
+    uint32_t total[PROFILER_RING];
+    int64_t sample_us[PROFILER_RING];
+    prof_task_slot_t slots[PROFILER_MAX_TASKS];
+    prof_scope_sample_t scope_ring[PROFILER_RING][PROF_SCOPE_COUNT];
+    profiler_report_t report;
+} profiler_state_t;
+
+static const char *const s_scope_names[PROF_SCOPE_COUNT] = {
+    [PROF_SCOPE_KEY_SCAN] = "key_scan",
+    [PROF_SCOPE_TOUCH_UPDATE] = "touch_update",
+    [PROF_SCOPE_LED_UPDATE] = "led_update",
+    [PROF_SCOPE_LED_RENDER] = "led_render",
+    [PROF_SCOPE_OLED_RENDER] = "oled_render",
+    [PROF_SCOPE_OLED_FLUSH] = "oled_flush",
+};
+
+static prof_scope_counter_t s_scopes[PROF_SCOPE_COUNT];
+static profiler_state_t s_prof;
+#if PROFILER_HAS_RUNTIME_STATS
+static TaskStatus_t s_status[PROFILER_MAX_TASKS];  // sampler task only
+#endif
+
+void profiler_scope_end(prof_scope_t *scope)
+{
+    const uint32_t cycles = (uint32_t)esp_cpu_get_cycle_count() - scope->start_cycles;
+    // Cycle counters are per core; a task that migrated mid-scope has no meaningful delta.
+    if (scope->id >= PROF_SCOPE_COUNT || (int8_t)esp_cpu_get_core_id() != scope->core) {
+        return;
+    }
+
+    prof_scope_counter_t *c = &s_scopes[scope->id];
+    atomic_fetch_add_explicit(&c->calls, 1U, memory_order_relaxed);
+    atomic_fetch_add_explicit(&c->cycles, (uint64_t)cycles, memory_order_relaxed);
+    unsigned prev = atomic_load_explicit(&c->max_cycles, memory_order_relaxed);
+    while (cycles > prev &&
+           !atomic_compare_exchange_weak_explicit(&c->max_cycles, &prev, cycles,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+const char *profiler_scope_name(uint8_t id)
+{
+    return (id < PROF_SCOPE_COUNT) ? s_scope_names[id] : "unknown";
+}
+
+static inline uint32_t cycles_to_us(uint64_t cycles)
+{
+    return (uint32_t)(cycles / (uint32_t)CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+}
+
+static uint16_t permille(uint32_t part, uint32_t whole)
+{
+    if (whole == 0U) {
+        return 0;
+    }
+    const uint64_t p = ((uint64_t)part * 1000U) / whole;
+    return (uint16_t)((p > 1000U) ? 1000U : p);
+}
+
+static int task_stat_cmp(const void *a, const void *b)
+{
+    const profiler_task_stat_t *ta = (const profiler_task_stat_t *)a;
+    const profiler_task_stat_t *tb = (const profiler_task_stat_t *)b;
+    if (ta->runtime_us != tb->runtime_us) {
+        return (ta->runtime_us < tb->runtime_us) ? 1 : -1;
+    }
+    return strcmp(ta->name, tb->name);
+}
+
+static int scope_stat_cmp(const void *a, const void *b)
+{
+    const profiler_scope_stat_t *sa = (const profiler_scope_stat_t *)a;
+    const profiler_scope_stat_t *sb = (const profiler_scope_stat_t *)b;
+    if (sa->total_us != sb->total_us) {
+        return (sa->total_us < sb->total_us) ? 1 : -1;
+    }
+    return (int)sa->id - (int)sb->id;
+}
+
+static void sample_scopes(uint32_t now_slot)
+{
+    for (size_t i = 0; i < PROF_SCOPE_COUNT; ++i) {
+        prof_scope_sample_t *out = &s_prof.scope_ring[now_slot][i];
+        out->calls = atomic_load_explicit(&s_scopes[i].calls, memory_order_relaxed);
+        out->cycles = atomic_load_explicit(&s_scopes[i].cycles, memory_order_relaxed);
+        out->max_cycles = atomic_exchange_explicit(&s_scopes[i].max_cycles, 0U, memory_order_relaxed);
+    }
+}
+
+static void build_scope_report(profiler_report_t *rep, uint32_t oldest, uint32_t newest)
+{
+    profiler_scope_stat_t all[PROF_SCOPE_COUNT];
+    size_t count = 0;
+    const uint32_t old_slot = oldest % PROFILER_RING;
+    const uint32_t new_slot = newest % PROFILER_RING;
+
+    for (size_t i = 0; i < PROF_SCOPE_COUNT; ++i) {
+        const uint32_t calls = s_prof.scope_ring[new_slot][i].calls - s_prof.scope_ring[old_slot][i].calls;
+        if (calls == 0U) {
+            continue;
+        }
+        uint32_t max_cycles = 0;
+        for (uint32_t s = oldest + 1U; s <= newest; ++s) {
+            const uint32_t m = s_prof.scope_ring[s % PROFILER_RING][i].max_cycles;
+            if (m > max_cycles) {
+                max_cycles = m;
+            }
+        }
+        const uint64_t cycles = s_prof.scope_ring[new_slot][i].cycles - s_prof.scope_ring[old_slot][i].cycles;
+        all[count++] = (profiler_scope_stat_t){
+            .id = (uint8_t)i,
+            .calls = calls,
+            .total_us = cycles_to_us(cycles),
+            .avg_us = cycles_to_us(cycles / calls),
+            .max_us = cycles_to_us(max_cycles),
+        };
+    }
+
+    qsort(all, count, sizeof(all[0]), scope_stat_cmp);
+    if (count > (size_t)MACRO_PROFILER_TOP_SCOPES) {
+        count = (size_t)MACRO_PROFILER_TOP_SCOPES;
+    }
+    memcpy(rep->scopes, all, count * sizeof(all[0]));
+    rep->scope_count = (uint8_t)count;
+}
+
+#if PROFILER_HAS_RUNTIME_STATS
+static prof_task_slot_t *task_slot(UBaseType_t task_number, uint32_t seq)
+{
+    prof_task_slot_t *free_slot = NULL;
+    for (size_t i = 0; i < PROFILER_MAX_TASKS; ++i) {
+        prof_task_slot_t *slot = &s_prof.slots[i];
+        if (slot->used && slot->task_number == task_number) {
+            return slot;
+        }
+        if (!slot->used && free_slot == NULL) {
+            free_slot = slot;
+        }
+    }
+    if (free_slot != NULL) {
+        memset(free_slot, 0, sizeof(*free_slot));
+        free_slot->used = true;
+        free_slot->task_number = task_number;
+        free_slot->first_sample = seq;
+    }
+    return free_slot;
+}
+
+// Fills rep->tasks and the per-core busy figures; returns false when the task table overflowed.
+static bool sample_tasks(profiler_report_t *rep, uint32_t seq, uint32_t oldest)
+{
+    uint32_t total = 0;
+    const UBaseType_t n = uxTaskGetSystemState(s_status, PROFILER_MAX_TASKS, &total);
+    if (n == 0U) {
+        return false;
+    }
+
+    const uint32_t now_slot = seq % PROFILER_RING;
+    s_prof.total[now_slot] = total;
+    bool seen[PROFILER_MAX_TASKS] = {0};
+    uint8_t count = 0;
+
+    for (UBaseType_t i = 0; i < n; ++i) {
+        const TaskStatus_t *st = &s_status[i];
+        prof_task_slot_t *slot = task_slot(st->xTaskNumber, seq);
+        if (slot == NULL) {
+            continue;
+        }
+        seen[slot - s_prof.slots] = true;
+        slot->runtime[now_slot] = (uint32_t)st->ulRunTimeCounter;
+
+        // A task born inside the window is measured from its first sample.
+        const uint32_t start = (slot->first_sample > oldest) ? slot->first_sample : oldest;
+        const uint32_t start_slot = start % PROFILER_RING;
+        const uint32_t task_delta = slot->runtime[now_slot] - slot->runtime[start_slot];
+        const uint32_t total_delta = total - s_prof.total[start_slot];
+
+        profiler_task_stat_t *out = &rep->tasks[count++];
+        memset(out, 0, sizeof(*out));
+        strlcpy(out->name, st->pcTaskName, sizeof(out->name));
+#if CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID
+        out->core = (st->xCoreID == tskNO_AFFINITY) ? -1 : (int8_t)st->xCoreID;
+#else
+        out->core = -1;
+#endif
+        out->priority = (uint8_t)st->uxCurrentPriority;
+        out->runtime_us = task_delta;
+        out->cpu_permille = permille(task_delta, total_delta);
+        out->stack_free_bytes = (uint32_t)st->usStackHighWaterMark * sizeof(StackType_t);
+
+        for (size_t core = 0; core < 2U; ++core) {
+            if (st->xHandle == s_prof.idle[core]) {
+                rep->core_busy_permille[core] = (uint16_t)(1000U - out->cpu_permille);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < PROFILER_MAX_TASKS; ++i) {
+        if (!seen[i]) {
+            s_prof.slots[i].used = false;
+        }
+    }
+
+    qsort(rep->tasks, count, sizeof(rep->tasks[0]), task_stat_cmp);
+    rep->task_count = count;
+    return true;
+}
+#endif
+
+static void profiler_sample(void)
+{
+    // The report is rebuilt in place; readers copy it under the same lock.
+    xSemaphoreTake(s_prof.lock, portMAX_DELAY);
+    const uint32_t seq = s_prof.seq;
+    const uint32_t oldest = (seq >= PROFILER_RING - 1U) ? seq - (PROFILER_RING - 1U) : 0U;
+    const uint32_t now_slot = seq % PROFILER_RING;
+    profiler_report_t *rep = &s_prof.report;
+
+    s_prof.sample_us[now_slot] = esp_timer_get_time();
+    sample_scopes(now_slot);
+    rep->samples = seq + 1U;
+    rep->window_ms = (uint32_t)((s_prof.sample_us[now_slot] - s_prof.sample_us[oldest % PROFILER_RING]) / 1000);
+#if PROFILER_HAS_RUNTIME_STATS
+    rep->runtime_stats = true;
+    if (!sample_tasks(rep, seq, oldest)) {
+        ESP_LOGW(TAG, "More than %u tasks; task stats skipped", (unsigned)PROFILER_MAX_TASKS);
+    }
+#endif
+    build_scope_report(rep, oldest, seq);
+    s_prof.seq = seq + 1U;
+    xSemaphoreGive(s_prof.lock);
+}
+
+static void profiler_task(void *arg)
+{
+    (void)arg;
+    TickType_t last_wake = xTaskGetTickCount();
+    while (true) {
+        profiler_sample();
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(PROFILER_SAMPLE_MS));
+    }
+}
+
+esp_err_t profiler_init(void)
+{
+    if (!MACRO_PROFILER_ENABLED || s_prof.initialized) {
+        return ESP_OK;
+    }
+
+    s_prof.lock = xSemaphoreCreateMutex();
+    if (s_prof.lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_prof.idle[0] = xTaskGetIdleTaskHandleForCore(0);
+    s_prof.idle[1] = (portNUM_PROCESSORS > 1) ? xTaskGetIdleTaskHandleForCore(1) : NULL;
+    if (xTaskCreate(profiler_task, "profiler", PROFILER_TASK_STACK, NULL, PROFILER_TASK_PRIO, &s_prof.task) != pdPASS) {
+        vSemaphoreDelete(s_prof.lock);
+        s_prof.lock = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    s_prof.initialized = true;
+    if (!PROFILER_HAS_RUNTIME_STATS) {
+        ESP_LOGW(TAG, "FreeRTOS run-time stats disabled; only scopes are reported");
+    }
+    return ESP_OK;
+}
+
+esp_err_t profiler_get_report(profiler_report_t *out)
+{
+    if (out == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!MACRO_PROFILER_ENABLED) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (!s_prof.initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(s_prof.lock, portMAX_DELAY);
+    memcpy(out, &s_prof.report, sizeof(*out));
+    xSemaphoreGive(s_prof.lock);
+    return ESP_OK;
+}
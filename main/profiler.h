@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_cpu.h"
+#include "esp_err.h"
+
+#include "keymap_config.h"
+
+// Hot paths measured with PROF_SCOPE. Scopes nest and are inclusive: oled_render contains oled_flush.
+typedef enum {
+    PROF_SCOPE_KEY_SCAN = 0,
+    PROF_SCOPE_TOUCH_UPDATE,
+    PROF_SCOPE_LED_UPDATE,
+    PROF_SCOPE_LED_RENDER,
+    PROF_SCOPE_OLED_RENDER,
+    PROF_SCOPE_OLED_FLUSH,
+    PROF_SCOPE_COUNT,
+} prof_scope_id_t;
+
+#define PROFILER_MAX_TASKS 40U
+
+typedef struct {
+    uint8_t id;
+    int8_t core;             // esp_cpu_get_core_id() at entry; the sample is dropped if the task migrated
+    uint32_t start_cycles;
+} prof_scope_t;
+
+// Cycle-count a block until the end of the enclosing scope (GCC cleanup attribute). Compiles away
+// when profiler.enabled is false.
+#if MACRO_PROFILER_ENABLED
+#define PROF_SCOPE_CONCAT_(a, b) a##b
+#define PROF_SCOPE_CONCAT(a, b) PROF_SCOPE_CONCAT_(a, b)
+#define PROF_SCOPE(scope_id)                                                                \
+    prof_scope_t PROF_SCOPE_CONCAT(prof_scope_, __LINE__)                                   \
+        __attribute__((cleanup(profiler_scope_end))) = profiler_scope_begin(scope_id)
+#else
+#define PROF_SCOPE(scope_id) do { } while (0)
+#endif
+
+static inline prof_scope_t profiler_scope_begin(prof_scope_id_t id)
+{
+    const prof_scope_t scope = {
+        .id = (uint8_t)id,
+        .core = (int8_t)esp_cpu_get_core_id(),
+        .start_cycles = (uint32_t)esp_cpu_get_cycle_count(),
+    };
+    return scope;
+}
+
+void profiler_scope_end(prof_scope_t *scope);
+
+typedef struct {
+    char name[16];
+    int8_t core;             // pinned core, -1 for tasks free to run on either
+    uint8_t priority;
+    uint16_t cpu_permille;   // share of one core over the window
+    uint32_t runtime_us;     // run time inside the window
+    uint32_t stack_free_bytes;
+} profiler_task_stat_t;
+
+typedef struct {
+    uint8_t id;
+    uint32_t calls;
+    uint32_t total_us;
+    uint32_t avg_us;
+    uint32_t max_us;
+} profiler_scope_stat_t;
+
+typedef struct {
+    bool runtime_stats;      // false when FreeRTOS run-time stats are compiled out
+    uint32_t window_ms;      // actual span covered (shorter right after boot)
+    uint32_t samples;
+    uint16_t core_busy_permille[2];
+    uint8_t task_count;
+    uint8_t scope_count;     // top scopes by total time, hottest first
+    profiler_task_stat_t tasks[PROFILER_MAX_TASKS];
+    profiler_scope_stat_t scopes[PROF_SCOPE_COUNT];
+} profiler_report_t;
+
+esp_err_t profiler_init(void);
+const char *profiler_scope_name(uint8_t id);
+// Copies the report computed at the last sample.
+esp_err_t profiler_get_report(profiler_report_t *out);
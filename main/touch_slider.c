@@ -10,7 +10,9 @@
 
 #include "tusb.h"
 
+#include "bench.h"
 #include "keymap_config.h"
+#include "profiler.h"
 
 #include "touch_slider.h"
 
@@ -37,34 +39,40 @@ typedef enum {
     TOUCH_SIDE_RIGHT,
 } touch_side_t;
 
-static uint32_t s_touch_left_baseline = 0;
-static uint32_t s_touch_right_baseline = 0;
-static bool s_touch_left_active = false;
-static bool s_touch_right_active = false;
-static touch_side_t s_touch_start_side = TOUCH_SIDE_NONE;
-static TickType_t s_touch_start_tick = 0;
-static bool s_touch_gesture_fired = false;
-static bool s_touch_session_active = false;
-static bool s_touch_seen_left = false;
-static bool s_touch_seen_right = false;
-static TickType_t s_touch_seen_left_tick = 0;
-static TickType_t s_touch_seen_right_tick = 0;
-static TickType_t s_touch_both_seen_tick = 0;
-static TickType_t s_touch_opposite_dominant_tick = 0;
-static TickType_t s_touch_start_dominant_tick = 0;
-static TickType_t s_touch_last_gesture_tick = 0;
-static int32_t s_touch_balance_filtered = 0;
-static int32_t s_touch_balance_origin = 0;
-static uint32_t s_touch_left_idle_noise = 0;
-static uint32_t s_touch_right_idle_noise = 0;
-static bool s_touch_hold_active = false;
-static touch_side_t s_touch_hold_side = TOUCH_SIDE_NONE;
-static uint16_t s_touch_hold_usage = 0;
-static TickType_t s_touch_hold_next_tick = 0;
+// Everything the slider state machine carries between scans, grouped so a bench run can
+// snapshot and restore it.
+typedef struct {
+    uint32_t left_baseline;
+    uint32_t right_baseline;
+    bool left_active;
+    bool right_active;
+    touch_side_t start_side;
+    TickType_t start_tick;
+    bool gesture_fired;
+    bool session_active;
+    bool seen_left;
+    bool seen_right;
+    TickType_t seen_left_tick;
+    TickType_t seen_right_tick;
+    TickType_t both_seen_tick;
+    TickType_t opposite_dominant_tick;
+    TickType_t start_dominant_tick;
+    TickType_t last_gesture_tick;
+    int32_t balance_filtered;
+    int32_t balance_origin;
+    uint32_t left_idle_noise;
+    uint32_t right_idle_noise;
+    bool hold_active;
+    touch_side_t hold_side;
+    uint16_t hold_usage;
+    TickType_t hold_next_tick;
 #if MACRO_TOUCH_DEBUG_LOG_ENABLE
-static TickType_t s_touch_last_debug_tick = 0;
+    TickType_t last_debug_tick;
 #endif
-static TickType_t s_touch_last_sensor_active_tick = 0;
+    TickType_t last_sensor_active_tick;
+} touch_state_t;
+
+static touch_state_t s_touch;
 
 static bool touch_is_active(uint32_t raw, uint32_t baseline, bool was_active)
 {
@@ -132,24 +140,24 @@ static void touch_log_debug(TickType_t now,
                             touch_side_t dominant_side)
 {
     const TickType_t interval_ticks = pdMS_TO_TICKS(MACRO_TOUCH_DEBUG_LOG_INTERVAL_MS);
-    if ((now - s_touch_last_debug_tick) < interval_ticks) {
+    if ((now - s_touch.last_debug_tick) < interval_ticks) {
         return;
     }
     if (!touch_log_ready()) {
         return;
     }
-    s_touch_last_debug_tick = now;
+    s_touch.last_debug_tick = now;
 
     TOUCH_LOGI(
              "Touch dbg rawL=%lu rawR=%lu baseL=%lu baseR=%lu dLr=%lu dRr=%lu nL=%lu nR=%lu dL=%lu dR=%lu tot=%lu bal=%ld dom=%s eng=%d frz=%d lNow=%d rNow=%d sess=%d seenL=%d seenR=%d start=%s fired=%d flt=%ld org=%ld trv=%ld",
              (unsigned long)left_raw,
              (unsigned long)right_raw,
-             (unsigned long)s_touch_left_baseline,
-             (unsigned long)s_touch_right_baseline,
+             (unsigned long)s_touch.left_baseline,
+             (unsigned long)s_touch.right_baseline,
              (unsigned long)left_delta_raw,
              (unsigned long)right_delta_raw,
-             (unsigned long)s_touch_left_idle_noise,
-             (unsigned long)s_touch_right_idle_noise,
+             (unsigned long)s_touch.left_idle_noise,
+             (unsigned long)s_touch.right_idle_noise,
              (unsigned long)left_delta,
              (unsigned long)right_delta,
              (unsigned long)total_delta,
@@ -159,14 +167,14 @@ static void touch_log_debug(TickType_t now,
              baseline_freeze,
              left_now,
              right_now,
-             s_touch_session_active,
-             s_touch_seen_left,
-             s_touch_seen_right,
-             touch_side_to_str(s_touch_start_side),
-             s_touch_gesture_fired,
+             s_touch.session_active,
+             s_touch.seen_left,
+             s_touch.seen_right,
+             touch_side_to_str(s_touch.start_side),
+             s_touch.gesture_fired,
              (long)balance_filtered,
-             (long)s_touch_balance_origin,
-             (long)(balance_filtered - s_touch_balance_origin));
+             (long)s_touch.balance_origin,
+             (long)(balance_filtered - s_touch.balance_origin));
 }
 #else
 static inline void touch_log_debug(TickType_t now,
@@ -235,41 +243,37 @@ esp_err_t touch_slider_init(void)
         vTaskDelay(pdMS_TO_TICKS(10));
     }
 
-    s_touch_left_baseline = (uint32_t)(left_sum / samples);
-    s_touch_right_baseline = (uint32_t)(right_sum / samples);
+    s_touch.left_baseline = (uint32_t)(left_sum / samples);
+    s_touch.right_baseline = (uint32_t)(right_sum / samples);
     TOUCH_LOGI("Touch baseline left=%lu right=%lu",
-               (unsigned long)s_touch_left_baseline,
-               (unsigned long)s_touch_right_baseline);
+               (unsigned long)s_touch.left_baseline,
+               (unsigned long)s_touch.right_baseline);
+    (void)bench_register(&s_bench_touch_step);
     return ESP_OK;
 }
 
-void touch_slider_update(TickType_t now,
-                         uint8_t active_layer,
-                         touch_consumer_send_fn send_consumer,
-                         touch_gesture_notify_fn notify_gesture)
+static void touch_slider_step(TickType_t now,
+                              uint32_t left_raw,
+                              uint32_t right_raw,
+                              uint8_t active_layer,
+                              touch_consumer_send_fn send_consumer,
+                              touch_gesture_notify_fn notify_gesture)
 {
-    uint32_t left_raw = 0;
-    uint32_t right_raw = 0;
-    if (touch_pad_read_raw_data(TOUCH_LEFT_PAD, &left_raw) != ESP_OK ||
-        touch_pad_read_raw_data(TOUCH_RIGHT_PAD, &right_raw) != ESP_OK) {
-        return;
-    }
-
-    const bool left_now = touch_is_active(left_raw, s_touch_left_baseline, s_touch_left_active);
-    const bool right_now = touch_is_active(right_raw, s_touch_right_baseline, s_touch_right_active);
+    const bool left_now = touch_is_active(left_raw, s_touch.left_baseline, s_touch.left_active);
+    const bool right_now = touch_is_active(right_raw, s_touch.right_baseline, s_touch.right_active);
     uint32_t left_log_raw = left_raw;
     uint32_t right_log_raw = right_raw;
-    uint32_t left_delta_raw = touch_delta(left_raw, s_touch_left_baseline);
-    uint32_t right_delta_raw = touch_delta(right_raw, s_touch_right_baseline);
+    uint32_t left_delta_raw = touch_delta(left_raw, s_touch.left_baseline);
+    uint32_t right_delta_raw = touch_delta(right_raw, s_touch.right_baseline);
 
     const uint32_t raw_max = (left_delta_raw > right_delta_raw) ? left_delta_raw : right_delta_raw;
-    if (!s_touch_session_active && raw_max < MACRO_TOUCH_IDLE_NOISE_MAX_DELTA) {
-        s_touch_left_idle_noise = ((s_touch_left_idle_noise * 31U) + left_delta_raw) / 32U;
-        s_touch_right_idle_noise = ((s_touch_right_idle_noise * 31U) + right_delta_raw) / 32U;
+    if (!s_touch.session_active && raw_max < MACRO_TOUCH_IDLE_NOISE_MAX_DELTA) {
+        s_touch.left_idle_noise = ((s_touch.left_idle_noise * 31U) + left_delta_raw) / 32U;
+        s_touch.right_idle_noise = ((s_touch.right_idle_noise * 31U) + right_delta_raw) / 32U;
     }
 
-    uint32_t left_delta = touch_apply_noise_comp(left_delta_raw, s_touch_left_idle_noise);
-    uint32_t right_delta = touch_apply_noise_comp(right_delta_raw, s_touch_right_idle_noise);
+    uint32_t left_delta = touch_apply_noise_comp(left_delta_raw, s_touch.left_idle_noise);
+    uint32_t right_delta = touch_apply_noise_comp(right_delta_raw, s_touch.right_idle_noise);
     if (MACRO_TOUCH_SWAP_SIDES) {
         const uint32_t tmp_raw = left_log_raw;
         left_log_raw = right_log_raw;
@@ -286,19 +290,19 @@ void touch_slider_update(TickType_t now,
                                (max_delta >= MACRO_TOUCH_CONTACT_MIN_SIDE_DELTA);
     const bool touch_sensor_active = left_now || right_now;
     if (touch_sensor_active) {
-        s_touch_last_sensor_active_tick = now;
+        s_touch.last_sensor_active_tick = now;
     }
     const TickType_t sensor_idle_reset_ticks = pdMS_TO_TICKS(180);
     const TickType_t sensor_activity_ref_tick =
-        (s_touch_last_sensor_active_tick != 0) ? s_touch_last_sensor_active_tick : s_touch_start_tick;
+        (s_touch.last_sensor_active_tick != 0) ? s_touch.last_sensor_active_tick : s_touch.start_tick;
     const bool session_sensor_idle_too_long =
-        s_touch_session_active &&
+        s_touch.session_active &&
         !touch_sensor_active &&
         (sensor_activity_ref_tick != 0) &&
         ((now - sensor_activity_ref_tick) >= sensor_idle_reset_ticks);
     const bool touch_engaged_effective =
         touch_engaged &&
-        (touch_sensor_active || (s_touch_session_active && !session_sensor_idle_too_long));
+        (touch_sensor_active || (s_touch.session_active && !session_sensor_idle_too_long));
     const int32_t balance = (int32_t)right_delta - (int32_t)left_delta;
     const TickType_t min_swipe_ticks = pdMS_TO_TICKS(MACRO_TOUCH_MIN_SWIPE_MS);
     const TickType_t both_seen_hold_ticks = pdMS_TO_TICKS(MACRO_TOUCH_BOTH_SIDES_HOLD_MS);
@@ -312,28 +316,28 @@ void touch_slider_update(TickType_t now,
                                  (max_delta >= MACRO_TOUCH_BASELINE_FREEZE_SIDE_DELTA) ||
                                  left_now || right_now;
     if (!baseline_freeze) {
-        touch_update_baseline(&s_touch_left_baseline, left_raw);
-        touch_update_baseline(&s_touch_right_baseline, right_raw);
+        touch_update_baseline(&s_touch.left_baseline, left_raw);
+        touch_update_baseline(&s_touch.right_baseline, right_raw);
     }
 
     if (!touch_engaged_effective) {
-        s_touch_session_active = false;
-        s_touch_seen_left = false;
-        s_touch_seen_right = false;
-        s_touch_seen_left_tick = 0;
-        s_touch_seen_right_tick = 0;
-        s_touch_both_seen_tick = 0;
-        s_touch_last_sensor_active_tick = 0;
-        s_touch_opposite_dominant_tick = 0;
-        s_touch_start_dominant_tick = 0;
-        s_touch_start_side = TOUCH_SIDE_NONE;
-        s_touch_start_tick = 0;
-        s_touch_gesture_fired = false;
-        s_touch_balance_filtered = 0;
-        s_touch_balance_origin = 0;
-        s_touch_hold_active = false;
-        s_touch_hold_side = TOUCH_SIDE_NONE;
-        s_touch_hold_usage = 0;
+        s_touch.session_active = false;
+        s_touch.seen_left = false;
+        s_touch.seen_right = false;
+        s_touch.seen_left_tick = 0;
+        s_touch.seen_right_tick = 0;
+        s_touch.both_seen_tick = 0;
+        s_touch.last_sensor_active_tick = 0;
+        s_touch.opposite_dominant_tick = 0;
+        s_touch.start_dominant_tick = 0;
+        s_touch.start_side = TOUCH_SIDE_NONE;
+        s_touch.start_tick = 0;
+        s_touch.gesture_fired = false;
+        s_touch.balance_filtered = 0;
+        s_touch.balance_origin = 0;
+        s_touch.hold_active = false;
+        s_touch.hold_side = TOUCH_SIDE_NONE;
+        s_touch.hold_usage = 0;
     } else {
         const TickType_t seq_min_ticks = pdMS_TO_TICKS(MACRO_TOUCH_SIDE_SEQUENCE_MIN_MS);
         const TickType_t seq_reorder_max_ticks = pdMS_TO_TICKS(MACRO_TOUCH_GESTURE_WINDOW_MS);
@@ -344,145 +348,145 @@ void touch_slider_update(TickType_t now,
                                     (((uint64_t)right_delta * 100ULL) >=
                                      ((uint64_t)left_delta * (uint64_t)MACRO_TOUCH_SWIPE_SIDE_RELATIVE_PERCENT));
 
-        if (left_seen_now && !s_touch_seen_left) {
-            s_touch_seen_left = true;
-            s_touch_seen_left_tick = now;
+        if (left_seen_now && !s_touch.seen_left) {
+            s_touch.seen_left = true;
+            s_touch.seen_left_tick = now;
         }
-        if (right_seen_now && !s_touch_seen_right) {
-            s_touch_seen_right = true;
-            s_touch_seen_right_tick = now;
+        if (right_seen_now && !s_touch.seen_right) {
+            s_touch.seen_right = true;
+            s_touch.seen_right_tick = now;
         }
-        if (s_touch_seen_left && s_touch_seen_right && s_touch_both_seen_tick == 0) {
-            s_touch_both_seen_tick = now;
+        if (s_touch.seen_left && s_touch.seen_right && s_touch.both_seen_tick == 0) {
+            s_touch.both_seen_tick = now;
         }
 
-        if (!s_touch_session_active) {
-            s_touch_session_active = true;
-            s_touch_balance_filtered = balance;
-            s_touch_balance_origin = balance;
-            balance_filtered_for_log = s_touch_balance_filtered;
-            s_touch_start_tick = now;
-            s_touch_opposite_dominant_tick = 0;
-            s_touch_start_dominant_tick = 0;
-            if (s_touch_seen_left && !s_touch_seen_right) {
-                s_touch_start_side = TOUCH_SIDE_LEFT;
-            } else if (s_touch_seen_right && !s_touch_seen_left) {
-                s_touch_start_side = TOUCH_SIDE_RIGHT;
+        if (!s_touch.session_active) {
+            s_touch.session_active = true;
+            s_touch.balance_filtered = balance;
+            s_touch.balance_origin = balance;
+            balance_filtered_for_log = s_touch.balance_filtered;
+            s_touch.start_tick = now;
+            s_touch.opposite_dominant_tick = 0;
+            s_touch.start_dominant_tick = 0;
+            if (s_touch.seen_left && !s_touch.seen_right) {
+                s_touch.start_side = TOUCH_SIDE_LEFT;
+            } else if (s_touch.seen_right && !s_touch.seen_left) {
+                s_touch.start_side = TOUCH_SIDE_RIGHT;
             } else if (dominant_side != TOUCH_SIDE_NONE) {
-                s_touch_start_side = dominant_side;
+                s_touch.start_side = dominant_side;
             } else {
-                s_touch_start_side = TOUCH_SIDE_NONE;
+                s_touch.start_side = TOUCH_SIDE_NONE;
             }
-            if (s_touch_start_side != TOUCH_SIDE_NONE) {
-                s_touch_start_dominant_tick = now;
+            if (s_touch.start_side != TOUCH_SIDE_NONE) {
+                s_touch.start_dominant_tick = now;
             }
-            if (s_touch_seen_left && s_touch_seen_right) {
+            if (s_touch.seen_left && s_touch.seen_right) {
                 const TickType_t tick_diff =
-                    (s_touch_seen_left_tick > s_touch_seen_right_tick)
-                        ? (s_touch_seen_left_tick - s_touch_seen_right_tick)
-                        : (s_touch_seen_right_tick - s_touch_seen_left_tick);
+                    (s_touch.seen_left_tick > s_touch.seen_right_tick)
+                        ? (s_touch.seen_left_tick - s_touch.seen_right_tick)
+                        : (s_touch.seen_right_tick - s_touch.seen_left_tick);
                 if (tick_diff <= seq_reorder_max_ticks) {
-                    if ((s_touch_start_side == TOUCH_SIDE_LEFT) &&
-                        (s_touch_seen_right_tick <= s_touch_seen_left_tick)) {
-                        s_touch_seen_right_tick = s_touch_seen_left_tick + seq_min_ticks;
-                    } else if ((s_touch_start_side == TOUCH_SIDE_RIGHT) &&
-                               (s_touch_seen_left_tick <= s_touch_seen_right_tick)) {
-                        s_touch_seen_left_tick = s_touch_seen_right_tick + seq_min_ticks;
+                    if ((s_touch.start_side == TOUCH_SIDE_LEFT) &&
+                        (s_touch.seen_right_tick <= s_touch.seen_left_tick)) {
+                        s_touch.seen_right_tick = s_touch.seen_left_tick + seq_min_ticks;
+                    } else if ((s_touch.start_side == TOUCH_SIDE_RIGHT) &&
+                               (s_touch.seen_left_tick <= s_touch.seen_right_tick)) {
+                        s_touch.seen_left_tick = s_touch.seen_right_tick + seq_min_ticks;
                     }
                 }
             }
-            s_touch_gesture_fired = false;
-        } else if (!s_touch_gesture_fired) {
-            if (s_touch_start_side == TOUCH_SIDE_NONE) {
-                if (s_touch_seen_left && !s_touch_seen_right) {
-                    s_touch_start_side = TOUCH_SIDE_LEFT;
-                } else if (s_touch_seen_right && !s_touch_seen_left) {
-                    s_touch_start_side = TOUCH_SIDE_RIGHT;
-                } else if (s_touch_seen_left && s_touch_seen_right &&
-                           (s_touch_seen_left_tick + seq_min_ticks) <= s_touch_seen_right_tick) {
-                    s_touch_start_side = TOUCH_SIDE_LEFT;
-                } else if (s_touch_seen_left && s_touch_seen_right &&
-                           (s_touch_seen_right_tick + seq_min_ticks) <= s_touch_seen_left_tick) {
-                    s_touch_start_side = TOUCH_SIDE_RIGHT;
+            s_touch.gesture_fired = false;
+        } else if (!s_touch.gesture_fired) {
+            if (s_touch.start_side == TOUCH_SIDE_NONE) {
+                if (s_touch.seen_left && !s_touch.seen_right) {
+                    s_touch.start_side = TOUCH_SIDE_LEFT;
+                } else if (s_touch.seen_right && !s_touch.seen_left) {
+                    s_touch.start_side = TOUCH_SIDE_RIGHT;
+                } else if (s_touch.seen_left && s_touch.seen_right &&
+                           (s_touch.seen_left_tick + seq_min_ticks) <= s_touch.seen_right_tick) {
+                    s_touch.start_side = TOUCH_SIDE_LEFT;
+                } else if (s_touch.seen_left && s_touch.seen_right &&
+                           (s_touch.seen_right_tick + seq_min_ticks) <= s_touch.seen_left_tick) {
+                    s_touch.start_side = TOUCH_SIDE_RIGHT;
                 }
-                if (s_touch_start_side != TOUCH_SIDE_NONE && s_touch_start_dominant_tick == 0) {
-                    s_touch_start_dominant_tick = now;
+                if (s_touch.start_side != TOUCH_SIDE_NONE && s_touch.start_dominant_tick == 0) {
+                    s_touch.start_dominant_tick = now;
                 }
-                if (s_touch_seen_left && s_touch_seen_right) {
+                if (s_touch.seen_left && s_touch.seen_right) {
                     const TickType_t tick_diff =
-                        (s_touch_seen_left_tick > s_touch_seen_right_tick)
-                            ? (s_touch_seen_left_tick - s_touch_seen_right_tick)
-                            : (s_touch_seen_right_tick - s_touch_seen_left_tick);
+                        (s_touch.seen_left_tick > s_touch.seen_right_tick)
+                            ? (s_touch.seen_left_tick - s_touch.seen_right_tick)
+                            : (s_touch.seen_right_tick - s_touch.seen_left_tick);
                     if (tick_diff <= seq_reorder_max_ticks) {
-                        if ((s_touch_start_side == TOUCH_SIDE_LEFT) &&
-                            (s_touch_seen_right_tick <= s_touch_seen_left_tick)) {
-                            s_touch_seen_right_tick = s_touch_seen_left_tick + seq_min_ticks;
-                        } else if ((s_touch_start_side == TOUCH_SIDE_RIGHT) &&
-                                   (s_touch_seen_left_tick <= s_touch_seen_right_tick)) {
-                            s_touch_seen_left_tick = s_touch_seen_right_tick + seq_min_ticks;
+                        if ((s_touch.start_side == TOUCH_SIDE_LEFT) &&
+                            (s_touch.seen_right_tick <= s_touch.seen_left_tick)) {
+                            s_touch.seen_right_tick = s_touch.seen_left_tick + seq_min_ticks;
+                        } else if ((s_touch.start_side == TOUCH_SIDE_RIGHT) &&
+                                   (s_touch.seen_left_tick <= s_touch.seen_right_tick)) {
+                            s_touch.seen_left_tick = s_touch.seen_right_tick + seq_min_ticks;
                         }
                     }
                 }
             }
 
-            s_touch_balance_filtered = ((s_touch_balance_filtered * 3) + balance) / 4;
-            balance_filtered_for_log = s_touch_balance_filtered;
-            const touch_side_t dominant_filtered = touch_dominant_side_from_balance(s_touch_balance_filtered);
+            s_touch.balance_filtered = ((s_touch.balance_filtered * 3) + balance) / 4;
+            balance_filtered_for_log = s_touch.balance_filtered;
+            const touch_side_t dominant_filtered = touch_dominant_side_from_balance(s_touch.balance_filtered);
             dominant_side = dominant_filtered;
-            const bool sequence_l2r = s_touch_seen_left && s_touch_seen_right &&
-                                      (s_touch_seen_right_tick > s_touch_seen_left_tick) &&
-                                      ((s_touch_seen_right_tick - s_touch_seen_left_tick) >= seq_min_ticks);
-            const bool sequence_r2l = s_touch_seen_left && s_touch_seen_right &&
-                                      (s_touch_seen_left_tick > s_touch_seen_right_tick) &&
-                                      ((s_touch_seen_left_tick - s_touch_seen_right_tick) >= seq_min_ticks);
-
-            if (s_touch_start_side != TOUCH_SIDE_NONE && s_touch_start_dominant_tick == 0) {
+            const bool sequence_l2r = s_touch.seen_left && s_touch.seen_right &&
+                                      (s_touch.seen_right_tick > s_touch.seen_left_tick) &&
+                                      ((s_touch.seen_right_tick - s_touch.seen_left_tick) >= seq_min_ticks);
+            const bool sequence_r2l = s_touch.seen_left && s_touch.seen_right &&
+                                      (s_touch.seen_left_tick > s_touch.seen_right_tick) &&
+                                      ((s_touch.seen_left_tick - s_touch.seen_right_tick) >= seq_min_ticks);
+
+            if (s_touch.start_side != TOUCH_SIDE_NONE && s_touch.start_dominant_tick == 0) {
                 const bool start_is_dominant =
-                    ((s_touch_start_side == TOUCH_SIDE_LEFT) && (dominant_filtered == TOUCH_SIDE_LEFT)) ||
-                    ((s_touch_start_side == TOUCH_SIDE_RIGHT) && (dominant_filtered == TOUCH_SIDE_RIGHT));
+                    ((s_touch.start_side == TOUCH_SIDE_LEFT) && (dominant_filtered == TOUCH_SIDE_LEFT)) ||
+                    ((s_touch.start_side == TOUCH_SIDE_RIGHT) && (dominant_filtered == TOUCH_SIDE_RIGHT));
                 if (start_is_dominant) {
-                    s_touch_start_dominant_tick = now;
+                    s_touch.start_dominant_tick = now;
                 }
             }
 
             const bool opposite_dominant =
-                ((s_touch_start_side == TOUCH_SIDE_LEFT) && (dominant_filtered == TOUCH_SIDE_RIGHT)) ||
-                ((s_touch_start_side == TOUCH_SIDE_RIGHT) && (dominant_filtered == TOUCH_SIDE_LEFT));
+                ((s_touch.start_side == TOUCH_SIDE_LEFT) && (dominant_filtered == TOUCH_SIDE_RIGHT)) ||
+                ((s_touch.start_side == TOUCH_SIDE_RIGHT) && (dominant_filtered == TOUCH_SIDE_LEFT));
             if (opposite_dominant) {
-                if (s_touch_opposite_dominant_tick == 0) {
-                    s_touch_opposite_dominant_tick = now;
+                if (s_touch.opposite_dominant_tick == 0) {
+                    s_touch.opposite_dominant_tick = now;
                 }
             } else {
-                s_touch_opposite_dominant_tick = 0;
+                s_touch.opposite_dominant_tick = 0;
             }
 
             const TickType_t start_dom_min_ticks = pdMS_TO_TICKS(MACRO_TOUCH_START_DOMINANT_MIN_MS);
             bool start_side_stable =
-                (s_touch_start_side == TOUCH_SIDE_NONE) ||
-                ((s_touch_start_dominant_tick != 0) &&
-                 ((now - s_touch_start_dominant_tick) >= start_dom_min_ticks));
+                (s_touch.start_side == TOUCH_SIDE_NONE) ||
+                ((s_touch.start_dominant_tick != 0) &&
+                 ((now - s_touch.start_dominant_tick) >= start_dom_min_ticks));
 
             if (!start_side_stable &&
-                (s_touch_start_side != TOUCH_SIDE_NONE) &&
-                (s_touch_opposite_dominant_tick != 0) &&
-                ((now - s_touch_opposite_dominant_tick) >= start_dom_min_ticks) &&
+                (s_touch.start_side != TOUCH_SIDE_NONE) &&
+                (s_touch.opposite_dominant_tick != 0) &&
+                ((now - s_touch.opposite_dominant_tick) >= start_dom_min_ticks) &&
                 ((dominant_filtered == TOUCH_SIDE_LEFT) || (dominant_filtered == TOUCH_SIDE_RIGHT))) {
-                s_touch_start_side = dominant_filtered;
-                s_touch_start_dominant_tick = now;
-                s_touch_opposite_dominant_tick = 0;
+                s_touch.start_side = dominant_filtered;
+                s_touch.start_dominant_tick = now;
+                s_touch.opposite_dominant_tick = 0;
 
-                if (s_touch_seen_left && s_touch_seen_right) {
+                if (s_touch.seen_left && s_touch.seen_right) {
                     const TickType_t tick_diff =
-                        (s_touch_seen_left_tick > s_touch_seen_right_tick)
-                            ? (s_touch_seen_left_tick - s_touch_seen_right_tick)
-                            : (s_touch_seen_right_tick - s_touch_seen_left_tick);
+                        (s_touch.seen_left_tick > s_touch.seen_right_tick)
+                            ? (s_touch.seen_left_tick - s_touch.seen_right_tick)
+                            : (s_touch.seen_right_tick - s_touch.seen_left_tick);
                     if (tick_diff <= seq_reorder_max_ticks) {
-                        if ((s_touch_start_side == TOUCH_SIDE_LEFT) &&
-                            (s_touch_seen_right_tick <= s_touch_seen_left_tick)) {
-                            s_touch_seen_right_tick = s_touch_seen_left_tick + seq_min_ticks;
-                        } else if ((s_touch_start_side == TOUCH_SIDE_RIGHT) &&
-                                   (s_touch_seen_left_tick <= s_touch_seen_right_tick)) {
-                            s_touch_seen_left_tick = s_touch_seen_right_tick + seq_min_ticks;
+                        if ((s_touch.start_side == TOUCH_SIDE_LEFT) &&
+                            (s_touch.seen_right_tick <= s_touch.seen_left_tick)) {
+                            s_touch.seen_right_tick = s_touch.seen_left_tick + seq_min_ticks;
+                        } else if ((s_touch.start_side == TOUCH_SIDE_RIGHT) &&
+                                   (s_touch.seen_left_tick <= s_touch.seen_right_tick)) {
+                            s_touch.seen_left_tick = s_touch.seen_right_tick + seq_min_ticks;
                         }
                     }
                 }
@@ -490,47 +494,47 @@ void touch_slider_update(TickType_t now,
                 start_side_stable = false;
             }
 
-            const int32_t filtered_travel = s_touch_balance_filtered - s_touch_balance_origin;
+            const int32_t filtered_travel = s_touch.balance_filtered - s_touch.balance_origin;
             const bool travel_l2r = filtered_travel >= (int32_t)MACRO_TOUCH_GESTURE_TRAVEL_DELTA;
             const bool travel_r2l = filtered_travel <= -(int32_t)MACRO_TOUCH_GESTURE_TRAVEL_DELTA;
             const bool opposite_hold_ready =
-                (s_touch_opposite_dominant_tick != 0) &&
-                ((now - s_touch_opposite_dominant_tick) >= seq_min_ticks);
+                (s_touch.opposite_dominant_tick != 0) &&
+                ((now - s_touch.opposite_dominant_tick) >= seq_min_ticks);
 
             const bool crossed_l2r =
                 (((sequence_l2r) ||
-                  ((s_touch_start_side == TOUCH_SIDE_LEFT) && opposite_hold_ready && travel_l2r)) &&
+                  ((s_touch.start_side == TOUCH_SIDE_LEFT) && opposite_hold_ready && travel_l2r)) &&
                  (dominant_filtered == TOUCH_SIDE_RIGHT) && start_side_stable &&
-                 ((s_touch_start_side == TOUCH_SIDE_LEFT) || (s_touch_start_side == TOUCH_SIDE_NONE)));
+                 ((s_touch.start_side == TOUCH_SIDE_LEFT) || (s_touch.start_side == TOUCH_SIDE_NONE)));
 
             const bool crossed_r2l =
                 (((sequence_r2l) ||
-                  ((s_touch_start_side == TOUCH_SIDE_RIGHT) && opposite_hold_ready && travel_r2l)) &&
+                  ((s_touch.start_side == TOUCH_SIDE_RIGHT) && opposite_hold_ready && travel_r2l)) &&
                  (dominant_filtered == TOUCH_SIDE_LEFT) && start_side_stable &&
-                 ((s_touch_start_side == TOUCH_SIDE_RIGHT) || (s_touch_start_side == TOUCH_SIDE_NONE)));
+                 ((s_touch.start_side == TOUCH_SIDE_RIGHT) || (s_touch.start_side == TOUCH_SIDE_NONE)));
             const bool crossed = crossed_l2r || crossed_r2l;
-            const bool both_sides_ready = s_touch_seen_left && s_touch_seen_right;
+            const bool both_sides_ready = s_touch.seen_left && s_touch.seen_right;
             const bool can_fire = (!MACRO_TOUCH_REQUIRE_BOTH_SIDES) || both_sides_ready;
             const bool both_sides_hold_ready =
                 (!MACRO_TOUCH_REQUIRE_BOTH_SIDES) ||
-                ((s_touch_both_seen_tick != 0) &&
-                 ((now - s_touch_both_seen_tick) >= both_seen_hold_ticks));
-            const bool long_enough = (now - s_touch_start_tick) >= min_swipe_ticks;
+                ((s_touch.both_seen_tick != 0) &&
+                 ((now - s_touch.both_seen_tick) >= both_seen_hold_ticks));
+            const bool long_enough = (now - s_touch.start_tick) >= min_swipe_ticks;
 
             if (can_fire && both_sides_hold_ready && long_enough && crossed &&
-                (now - s_touch_last_gesture_tick) > min_interval_ticks) {
+                (now - s_touch.last_gesture_tick) > min_interval_ticks) {
                 uint16_t usage = 0;
                 const char *gesture = "";
                 bool hold_repeat = false;
                 touch_side_t hold_side = TOUCH_SIDE_NONE;
                 if (crossed_l2r) {
-                    s_touch_start_side = TOUCH_SIDE_LEFT;
+                    s_touch.start_side = TOUCH_SIDE_LEFT;
                     usage = touch_cfg->right_usage;
                     gesture = "L->R";
                     hold_repeat = touch_cfg->right_hold_repeat;
                     hold_side = TOUCH_SIDE_RIGHT;
                 } else if (crossed_r2l) {
-                    s_touch_start_side = TOUCH_SIDE_RIGHT;
+                    s_touch.start_side = TOUCH_SIDE_RIGHT;
                     usage = touch_cfg->left_usage;
                     gesture = "R->L";
                     hold_repeat = touch_cfg->left_hold_repeat;
@@ -555,41 +559,41 @@ void touch_slider_update(TickType_t now,
                     }
 
                     if (hold_repeat && touch_cfg->hold_repeat_ms > 0) {
-                        s_touch_hold_active = true;
-                        s_touch_hold_side = hold_side;
-                        s_touch_hold_usage = usage;
-                        s_touch_hold_next_tick = now + pdMS_TO_TICKS(touch_cfg->hold_start_ms);
+                        s_touch.hold_active = true;
+                        s_touch.hold_side = hold_side;
+                        s_touch.hold_usage = usage;
+                        s_touch.hold_next_tick = now + pdMS_TO_TICKS(touch_cfg->hold_start_ms);
                     } else {
-                        s_touch_hold_active = false;
-                        s_touch_hold_side = TOUCH_SIDE_NONE;
-                        s_touch_hold_usage = 0;
+                        s_touch.hold_active = false;
+                        s_touch.hold_side = TOUCH_SIDE_NONE;
+                        s_touch.hold_usage = 0;
                     }
-                    s_touch_last_gesture_tick = now;
-                    s_touch_gesture_fired = true;
+                    s_touch.last_gesture_tick = now;
+                    s_touch.gesture_fired = true;
                 }
             }
         } else {
-            balance_filtered_for_log = s_touch_balance_filtered;
-            dominant_side = touch_dominant_side_from_balance(s_touch_balance_filtered);
+            balance_filtered_for_log = s_touch.balance_filtered;
+            dominant_side = touch_dominant_side_from_balance(s_touch.balance_filtered);
         }
     }
 
-    if (s_touch_hold_active) {
-        const bool hold_side_active = touch_engaged_effective && (dominant_side == s_touch_hold_side);
+    if (s_touch.hold_active) {
+        const bool hold_side_active = touch_engaged_effective && (dominant_side == s_touch.hold_side);
         if (!hold_side_active) {
-            s_touch_hold_active = false;
-            s_touch_hold_side = TOUCH_SIDE_NONE;
-            s_touch_hold_usage = 0;
-        } else if (now >= s_touch_hold_next_tick) {
-            if (s_touch_hold_usage != 0) {
+            s_touch.hold_active = false;
+            s_touch.hold_side = TOUCH_SIDE_NONE;
+            s_touch.hold_usage = 0;
+        } else if (now >= s_touch.hold_next_tick) {
+            if (s_touch.hold_usage != 0) {
                 TOUCH_LOGI("Touch hold repeat (L%u) usage=0x%X",
                            (unsigned)active_layer + 1,
-                           s_touch_hold_usage);
+                           s_touch.hold_usage);
                 if (send_consumer != NULL) {
-                    send_consumer(s_touch_hold_usage);
+                    send_consumer(s_touch.hold_usage);
                 }
             }
-            s_touch_hold_next_tick = now + pdMS_TO_TICKS(touch_cfg->hold_repeat_ms);
+            s_touch.hold_next_tick = now + pdMS_TO_TICKS(touch_cfg->hold_repeat_ms);
         }
     }
 
@@ -609,6 +613,64 @@ void touch_slider_update(TickType_t now,
                     right_now,
                     dominant_side);
 
-    s_touch_left_active = left_now;
-    s_touch_right_active = right_now;
+    s_touch.left_active = left_now;
+    s_touch.right_active = right_now;
 }
+
+void touch_slider_update(TickType_t now,
+                         uint8_t active_layer,
+                         touch_consumer_send_fn send_consumer,
+                         touch_gesture_notify_fn notify_gesture)
+{
+    PROF_SCOPE(PROF_SCOPE_TOUCH_UPDATE);
+    uint32_t left_raw = 0;
+    uint32_t right_raw = 0;
+    if (touch_pad_read_raw_data(TOUCH_LEFT_PAD, &left_raw) != ESP_OK ||
+        touch_pad_read_raw_data(TOUCH_RIGHT_PAD, &right_raw) != ESP_OK) {
+        return;
+    }
+    touch_slider_step(now, left_raw, right_raw, active_layer, send_consumer, notify_gesture);
+}
+
+typedef struct {
+    touch_state_t saved;
+    TickType_t now;
+} bench_touch_ctx_t;
+
+static bench_touch_ctx_t s_bench_touch;
+
+// The live state is swapped out around every sample so the slider resumes exactly where it was.
+static void bench_touch_before(void *ctx)
+{
+    bench_touch_ctx_t *b = (bench_touch_ctx_t *)ctx;
+    b->saved = s_touch;
+    b->now = xTaskGetTickCount();
+#if MACRO_TOUCH_DEBUG_LOG_ENABLE
+    s_touch.last_debug_tick = b->now;
+#endif
+}
+
+// One idle scan: raw readings a few counts off baseline, no contact, baseline tracking active.
+static void bench_touch_run(void *ctx)
+{
+    const bench_touch_ctx_t *b = (const bench_touch_ctx_t *)ctx;
+    touch_slider_step(b->now,
+                      b->saved.left_baseline + 8U,
+                      b->saved.right_baseline + 8U,
+                      0,
+                      NULL,
+                      NULL);
+}
+
+static void bench_touch_after(void *ctx)
+{
+    s_touch = ((const bench_touch_ctx_t *)ctx)->saved;
+}
+
+static const bench_case_t s_bench_touch_step = {
+    .name = "touch_step",
+    .run = bench_touch_run,
+    .before = bench_touch_before,
+    .after = bench_touch_after,
+    .ctx = &s_bench_touch,
+};
@@ -0,0 +1,350 @@
+#include "trace_buffer.h"
+
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_attr.h"
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+
+#include "keymap_config.h"
+#include "trace_hooks.h"
+
+#define TAG "TRACE"
+
+#define TRACE_MAX_TASKS 48U
+// Hooks that read the armed flag just before disarm may still be writing; give them this long.
+#define TRACE_SETTLE_MS 10U
+
+#define TRACE_PID_CPU 1U
+#define TRACE_PID_APP 2U
+
+typedef enum {
+    TRACE_REC_SWITCH_IN = 0,
+    TRACE_REC_SWITCH_OUT,
+    TRACE_REC_SPAN_BEGIN,
+    TRACE_REC_SPAN_END,
+} trace_rec_type_t;
+
+typedef struct {
+    uint32_t ts_us;          // since arm
+    uint32_t task;           // TaskHandle_t of the running task
+    uint8_t type;
+    uint8_t core;
+    uint8_t span;            // trace_span_id_t for span records
+    uint8_t reserved;
+} trace_rec_t;
+
+typedef struct {
+    trace_rec_t *records;    // MACRO_TRACE_BUFFER_RECORDS entries, internal RAM
+    atomic_uint head;        // total records reserved since arm
+    int64_t arm_us;
+    int64_t stop_us;
+} trace_state_t;
+
+typedef struct {
+    uint32_t handle;
+    char name[configMAX_TASK_NAME_LEN];
+    uint8_t depth;           // open app spans
+    bool has_spans;          // gets a thread on the app track
+} trace_task_t;
+
+typedef struct {
+    trace_task_t tasks[TRACE_MAX_TASKS];
+    uint32_t task_count;
+    uint32_t running[2];     // task shown on each core track, 0 when idle in the trace
+    uint32_t last_ts;
+} trace_dump_t;
+
+static const char *const s_span_names[TRACE_SPAN_COUNT] = {
+    [TRACE_SPAN_SCAN] = "scan",
+    [TRACE_SPAN_HID_SEND] = "hid_send",
+    [TRACE_SPAN_OLED_FLUSH] = "oled_flush",
+    [TRACE_SPAN_HA_POST] = "ha_post",
+    [TRACE_SPAN_OTA_CHUNK] = "ota_chunk",
+};
+
+volatile unsigned g_trace_buffer_armed;
+static trace_state_t s_trace;
+
+// Runs inside the scheduler, possibly with the flash cache disabled: IRAM/DRAM only.
+static void IRAM_ATTR trace_put(trace_rec_type_t type, uint8_t span)
+{
+    trace_rec_t *records = s_trace.records;
+    if (records == NULL) {
+        return;
+    }
+    const uint32_t ts = (uint32_t)(esp_timer_get_time() - s_trace.arm_us);
+    const uint32_t idx = atomic_fetch_add_explicit(&s_trace.head, 1U, memory_order_relaxed);
+    trace_rec_t *rec = &records[idx % (uint32_t)MACRO_TRACE_BUFFER_RECORDS];
+    rec->ts_us = ts;
+    rec->task = (uint32_t)(uintptr_t)xTaskGetCurrentTaskHandle();
+    rec->type = (uint8_t)type;
+    rec->core = (uint8_t)esp_cpu_get_core_id();
+    rec->span = span;
+}
+
+void IRAM_ATTR trace_buffer_on_switch_in(void)
+{
+    trace_put(TRACE_REC_SWITCH_IN, 0U);
+}
+
+void IRAM_ATTR trace_buffer_on_switch_out(void)
+{
+    trace_put(TRACE_REC_SWITCH_OUT, 0U);
+}
+
+void trace_buffer_record_span(trace_span_id_t id, bool begin)
+{
+    if ((unsigned)id < TRACE_SPAN_COUNT) {
+        trace_put(begin ? TRACE_REC_SPAN_BEGIN : TRACE_REC_SPAN_END, (uint8_t)id);
+    }
+}
+
+esp_err_t trace_buffer_arm(void)
+{
+    if (!MACRO_TRACE_ENABLED) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (s_trace.records == NULL) {
+        s_trace.records = heap_caps_calloc(MACRO_TRACE_BUFFER_RECORDS, sizeof(trace_rec_t),
+                                           MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (s_trace.records == NULL) {
+            ESP_LOGW(TAG, "No internal RAM for %u trace records", (unsigned)MACRO_TRACE_BUFFER_RECORDS);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    trace_buffer_disarm();
+    atomic_store_explicit(&s_trace.head, 0U, memory_order_relaxed);
+    s_trace.arm_us = esp_timer_get_time();
+    s_trace.stop_us = 0;
+    atomic_thread_fence(memory_order_release);
+    g_trace_buffer_armed = 1U;
+    ESP_LOGI(TAG, "Trace armed (%u records)", (unsigned)MACRO_TRACE_BUFFER_RECORDS);
+    return ESP_OK;
+}
+
+void trace_buffer_disarm(void)
+{
+    if (!g_trace_buffer_armed) {
+        return;
+    }
+    g_trace_buffer_armed = 0U;
+    s_trace.stop_us = esp_timer_get_time();
+    vTaskDelay(pdMS_TO_TICKS(TRACE_SETTLE_MS) + 1U);
+}
+
+void trace_buffer_get_status(trace_buffer_status_t *out)
+{
+    if (out == NULL) {
+        return;
+    }
+    const uint32_t head = atomic_load_explicit(&s_trace.head, memory_order_relaxed);
+    const uint32_t cap = MACRO_TRACE_BUFFER_RECORDS;
+    const bool armed = g_trace_buffer_armed != 0U;
+    const int64_t end_us = armed ? esp_timer_get_time() : s_trace.stop_us;
+
+    memset(out, 0, sizeof(*out));
+    out->armed = armed;
+    out->allocated = s_trace.records != NULL;
+    out->capacity = cap;
+    out->records = head < cap ? head : cap;
+    out->overwritten = head > cap ? head - cap : 0U;
+    out->elapsed_ms = (s_trace.arm_us != 0 && end_us > s_trace.arm_us)
+                          ? (uint32_t)((end_us - s_trace.arm_us) / 1000)
+                          : 0U;
+}
+
+static trace_task_t *dump_task(trace_dump_t *d, uint32_t handle)
+{
+    for (uint32_t i = 0; i < d->task_count; ++i) {
+        if (d->tasks[i].handle == handle) {
+            return &d->tasks[i];
+        }
+    }
+    if (d->task_count >= TRACE_MAX_TASKS) {
+        return NULL;
+    }
+    trace_task_t *t = &d->tasks[d->task_count++];
+    t->handle = handle;
+    (void)snprintf(t->name, sizeof(t->name), "task@%08" PRIx32, handle);
+    return t;
+}
+
+// Names come from the live task list; tasks deleted since the capture keep their handle as name.
+static void dump_name_tasks(trace_dump_t *d)
+{
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY
+    const UBaseType_t cap = uxTaskGetNumberOfTasks() + 4U;
+    TaskStatus_t *status = calloc(cap, sizeof(TaskStatus_t));
+    if (status == NULL) {
+        return;
+    }
+    const UBaseType_t n = uxTaskGetSystemState(status, cap, NULL);
+    for (UBaseType_t i = 0; i < n; ++i) {
+        const uint32_t handle = (uint32_t)(uintptr_t)status[i].xHandle;
+        for (uint32_t t = 0; t < d->task_count; ++t) {
+            if (d->tasks[t].handle == handle) {
+                strlcpy(d->tasks[t].name, status[i].pcTaskName, sizeof(d->tasks[t].name));
+                break;
+            }
+        }
+    }
+    free(status);
+#else
+    (void)d;
+#endif
+}
+
+static void write_meta(json_writer_t *w, const char *kind, uint32_t pid, int32_t tid, const char *name)
+{
+    json_writer_obj_begin(w);
+    json_writer_kv_str(w, "name", kind);
+    json_writer_kv_str(w, "ph", "M");
+    json_writer_kv_u32(w, "pid", pid);
+    if (tid >= 0) {
+        json_writer_kv_i32(w, "tid", tid);
+    }
+    json_writer_key(w, "args");
+    json_writer_obj_begin(w);
+    json_writer_kv_str(w, "name", name);
+    json_writer_obj_end(w);
+    json_writer_obj_end(w);
+}
+
+static void write_event(json_writer_t *w, const char *ph, const char *name, uint32_t ts, uint32_t pid, uint32_t tid)
+{
+    json_writer_obj_begin(w);
+    if (name != NULL) {
+        json_writer_kv_str(w, "name", name);
+    }
+    json_writer_kv_str(w, "ph", ph);
+    json_writer_kv_u32(w, "ts", ts);
+    json_writer_kv_u32(w, "pid", pid);
+    json_writer_kv_u32(w, "tid", tid);
+    json_writer_obj_end(w);
+}
+
+static void dump_record(json_writer_t *w, trace_dump_t *d, const trace_rec_t *rec)
+{
+    trace_task_t *task = dump_task(d, rec->task);
+    const uint32_t core = rec->core > 1U ? 1U : rec->core;
+    d->last_ts = rec->ts_us;
+
+    switch ((trace_rec_type_t)rec->type) {
+    case TRACE_REC_SWITCH_IN:
+        // A switch-out lost to wrap-around or a racing writer would leave the slice open.
+        if (d->running[core] != 0U) {
+            write_event(w, "E", NULL, rec->ts_us, TRACE_PID_CPU, core);
+        }
+        write_event(w, "B", task != NULL ? task->name : "task", rec->ts_us, TRACE_PID_CPU, core);
+        d->running[core] = rec->task;
+        break;
+    case TRACE_REC_SWITCH_OUT:
+        if (d->running[core] == rec->task) {
+            write_event(w, "E", NULL, rec->ts_us, TRACE_PID_CPU, core);
+            d->running[core] = 0U;
+        }
+        break;
+    case TRACE_REC_SPAN_BEGIN:
+        if (task != NULL && rec->span < TRACE_SPAN_COUNT) {
+            write_event(w, "B", s_span_names[rec->span], rec->ts_us, TRACE_PID_APP, (uint32_t)(task - d->tasks) + 1U);
+            ++task->depth;
+        }
+        break;
+    case TRACE_REC_SPAN_END:
+        // Spans that began before the trace was armed have no begin record.
+        if (task != NULL && task->depth > 0U) {
+            write_event(w, "E", NULL, rec->ts_us, TRACE_PID_APP, (uint32_t)(task - d->tasks) + 1U);
+            --task->depth;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+esp_err_t trace_buffer_write_chrome_json(json_writer_t *w)
+{
+    if (w == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_trace.records == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    trace_buffer_disarm();
+
+    trace_dump_t *d = calloc(1, sizeof(*d));
+    if (d == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    trace_buffer_status_t status;
+    trace_buffer_get_status(&status);
+    const uint32_t head = atomic_load_explicit(&s_trace.head, memory_order_relaxed);
+    const uint32_t first = head - status.records;
+
+    for (uint32_t i = first; i != head; ++i) {
+        const trace_rec_t *rec = &s_trace.records[i % status.capacity];
+        trace_task_t *task = dump_task(d, rec->task);
+        if (task != NULL && rec->type == TRACE_REC_SPAN_BEGIN) {
+            task->has_spans = true;
+        }
+    }
+    dump_name_tasks(d);
+
+    json_writer_obj_begin(w);
+    json_writer_key(w, "traceEvents");
+    json_writer_arr_begin(w);
+
+    write_meta(w, "process_name", TRACE_PID_CPU, -1, "Scheduler");
+    write_meta(w, "thread_name", TRACE_PID_CPU, 0, "core 0");
+    write_meta(w, "thread_name", TRACE_PID_CPU, 1, "core 1");
+    write_meta(w, "process_name", TRACE_PID_APP, -1, "App spans");
+    for (uint32_t t = 0; t < d->task_count; ++t) {
+        if (d->tasks[t].has_spans) {
+            write_meta(w, "thread_name", TRACE_PID_APP, (int32_t)t + 1, d->tasks[t].name);
+        }
+    }
+
+    for (uint32_t i = first; i != head && w->err == ESP_OK; ++i) {
+        dump_record(w, d, &s_trace.records[i % status.capacity]);
+    }
+
+    // Close whatever was still open when the capture stopped.
+    for (uint32_t core = 0; core < 2U; ++core) {
+        if (d->running[core] != 0U) {
+            write_event(w, "E", NULL, d->last_ts, TRACE_PID_CPU, core);
+        }
+    }
+    for (uint32_t t = 0; t < d->task_count; ++t) {
+        while (d->tasks[t].depth > 0U) {
+            write_event(w, "E", NULL, d->last_ts, TRACE_PID_APP, t + 1U);
+            --d->tasks[t].depth;
+        }
+    }
+
+    json_writer_arr_end(w);
+    json_writer_kv_str(w, "displayTimeUnit", "ms");
+    json_writer_key(w, "otherData");
+    json_writer_obj_begin(w);
+    json_writer_kv_u32(w, "records", status.records);
+    json_writer_kv_u32(w, "overwritten", status.overwritten);
+    json_writer_kv_u32(w, "capacity", status.capacity);
+    json_writer_kv_u32(w, "elapsed_ms", status.elapsed_ms);
+    json_writer_obj_end(w);
+    json_writer_obj_end(w);
+
+    free(d);
+    return w->err;
+}
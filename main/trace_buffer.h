@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "json_writer.h"
+
+// Application spans shown next to the scheduler track. Begin/end must come from the same task.
+typedef enum {
+    TRACE_SPAN_SCAN = 0,
+    TRACE_SPAN_HID_SEND,
+    TRACE_SPAN_OLED_FLUSH,
+    TRACE_SPAN_HA_POST,
+    TRACE_SPAN_OTA_CHUNK,
+    TRACE_SPAN_COUNT,
+} trace_span_id_t;
+
+// Also declared in trace_hooks.h, which cannot include this header.
+extern volatile unsigned g_trace_buffer_armed;
+
+void trace_buffer_record_span(trace_span_id_t id, bool begin);
+
+static inline void trace_buffer_begin(trace_span_id_t id)
+{
+    if (g_trace_buffer_armed) {
+        trace_buffer_record_span(id, true);
+    }
+}
+
+static inline void trace_buffer_end(trace_span_id_t id)
+{
+    if (g_trace_buffer_armed) {
+        trace_buffer_record_span(id, false);
+    }
+}
+
+typedef struct {
+    uint8_t id;
+} trace_span_t;
+
+static inline trace_span_t trace_span_enter(trace_span_id_t id)
+{
+    trace_buffer_begin(id);
+    return (trace_span_t){.id = (uint8_t)id};
+}
+
+static inline void trace_span_exit(trace_span_t *span)
+{
+    trace_buffer_end((trace_span_id_t)span->id);
+}
+
+// Begin/end span for the rest of the enclosing block.
+#define TRACE_SPAN_CONCAT_(a, b) a##b
+#define TRACE_SPAN_CONCAT(a, b) TRACE_SPAN_CONCAT_(a, b)
+#define TRACE_SPAN(span_id)                                                                 \
+    trace_span_t TRACE_SPAN_CONCAT(trace_span_, __LINE__)                                   \
+        __attribute__((cleanup(trace_span_exit))) = trace_span_enter(span_id)
+
+typedef struct {
+    bool armed;
+    bool allocated;
+    uint32_t capacity;       // records
+    uint32_t records;        // held in the buffer
+    uint32_t overwritten;    // older records lost to wrap-around
+    uint32_t elapsed_ms;     // since arm (frozen at disarm)
+} trace_buffer_status_t;
+
+// Clears the buffer and starts recording; the record ring is allocated on first use.
+esp_err_t trace_buffer_arm(void);
+void trace_buffer_disarm(void);
+void trace_buffer_get_status(trace_buffer_status_t *out);
+// Disarms and writes the buffer as Chrome Trace Event JSON (one object, opens in Perfetto).
+esp_err_t trace_buffer_write_chrome_json(json_writer_t *w);
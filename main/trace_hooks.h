@@ -0,0 +1,24 @@
+#pragma once
+
+// Pre-included into the FreeRTOS kernel sources (see the top-level CMakeLists.txt) so every context
+// switch reaches trace_buffer.c. It is seen before FreeRTOS.h, so it must not include anything.
+// While the trace is disarmed a switch costs one load and branch.
+
+extern volatile unsigned g_trace_buffer_armed;
+
+void trace_buffer_on_switch_in(void);
+void trace_buffer_on_switch_out(void);
+
+#define traceTASK_SWITCHED_IN()               \
+    do {                                      \
+        if (g_trace_buffer_armed) {           \
+            trace_buffer_on_switch_in();      \
+        }                                     \
+    } while (0)
+
+#define traceTASK_SWITCHED_OUT()              \
+    do {                                      \
+        if (g_trace_buffer_armed) {           \
+            trace_buffer_on_switch_out();     \
+        }                                     \
+    } while (0)
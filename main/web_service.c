@@ -13,27 +13,52 @@
 #include "esp_check.h"
 #include "esp_http_server.h"
 #include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
 
 #include "mbedtls/base64.h"
 
+#include "bench.h"
 #include "buzzer.h"
+#include "ha_spool.h"
+#include "home_assistant.h"
+#include "json_reader.h"
+#include "json_writer.h"
 #include "keymap_config.h"
+#include "log_archive.h"
 #include "log_store.h"
+#include "metrics.h"
+#include "net_breaker.h"
 #include "ota_manager.h"
+#include "profiler.h"
+#include "trace_buffer.h"
 #include "sdkconfig.h"
 #include "wifi_portal.h"
 
 #define TAG "WEB_SERVICE"
 
 #define WEB_SERVICE_BODY_MAX 512
+#define WEB_SERVICE_BODY_TOKENS 32U
 #define WEB_SERVICE_JSON_BUF 2048
+#define WEB_SERVICE_JSON_CHUNK_BUF 512U
+#define WEB_SERVICE_ETAG_MAX 24U
 #define WEB_SERVICE_RETRY_MS 2000
 #define WEB_SERVICE_HEADER_MAX 256
 #define WEB_SERVICE_BASIC_EXPECTED_MAX 320
 #define WEB_SERVICE_LOGS_DEFAULT_LIMIT 40U
 #define WEB_SERVICE_LOGS_MAX_LIMIT 80U
 #define WEB_SERVICE_LOGS_CHUNK_BUF 512U
-#define WEB_SERVICE_ROUTE_COUNT 22U
+#define WEB_SERVICE_STREAM_CHUNK_BUF 1024U
+#define WEB_SERVICE_QUERY_MAX 128U
+#define WEB_SERVICE_LOG_STREAM_KEEPALIVE_MS 15000U
+#define WEB_SERVICE_STREAM_TASK_STACK 4096U
+#define WEB_SERVICE_STREAM_TASK_PRIO 2U
+#define WEB_SERVICE_STATE_STREAM_POLL_MS 500U
+// stream_lock only covers slot bookkeeping; handlers give up with 503 rather than wait longer.
+#define WEB_SERVICE_STREAM_LOCK_MS 100U
+#define WEB_SERVICE_STREAM_CLOSE_POLL_MS 20U
+#define WEB_SERVICE_LOG_RATE_LIMITS_MAX 8U
+#define WEB_SERVICE_ROUTE_COUNT 39U
 #define WEB_SERVICE_MIN_URI_HANDLERS (WEB_SERVICE_ROUTE_COUNT + 2U)
 #define WEB_SERVICE_START_STABLE_MS 4000U
 #define WEB_SERVICE_MIN_STACK_SIZE 8192U
@@ -62,6 +87,68 @@ typedef struct {
     TickType_t tick;
 } web_service_swipe_event_t;
 
+// Server-Sent Events client handed off from the HTTP worker with httpd_req_async_handler_begin().
+// While busy, stream_task owns the slot and sends to it without stream_lock; a close requested
+// meanwhile sets closing and is carried out when that send returns.
+typedef struct {
+    httpd_req_t *req;
+    bool busy;
+    bool closing;
+    bool started;            // headers and the retry hint went out
+    log_store_cursor_t cursor;
+    log_store_filter_t filter;
+    TickType_t last_send_tick;
+} web_service_log_stream_t;
+
+typedef struct {
+    httpd_req_t *req;
+    bool busy;
+    bool closing;
+    bool snapshot_sent;      // also covers headers and the retry hint
+    TickType_t last_send_tick;
+} web_service_state_stream_t;
+
+// Groups of /api/v1/state/stream delta events.
+#define WEB_STATE_LAYER (1U << 0)
+#define WEB_STATE_BUZZER (1U << 1)
+#define WEB_STATE_KEY (1U << 2)
+#define WEB_STATE_ENCODER (1U << 3)
+#define WEB_STATE_SWIPE (1U << 4)
+#define WEB_STATE_HID (1U << 5)
+#define WEB_STATE_OTA (1U << 6)
+#define WEB_STATE_BREAKERS (1U << 7)
+#define WEB_STATE_ALL 0xFFU
+
+typedef struct {
+    uint8_t layer;
+    bool buzzer_enabled;
+    web_service_key_event_t key;
+    web_service_encoder_event_t encoder;
+    web_service_swipe_event_t swipe;
+    hid_transport_status_t hid;
+    ota_manager_status_t ota;
+    net_breaker_info_t breakers[NET_BREAKER_MAX];
+    uint8_t breaker_count;
+} web_service_state_snapshot_t;
+
+// Responses rendered through json_writer; their cost is reported by /api/v1/health.
+typedef enum {
+    WEB_RENDER_STATE = 0,
+    WEB_RENDER_OTA,
+    WEB_RENDER_HEALTH,
+    WEB_RENDER_PROFILE,
+    WEB_RENDER_TRACE,
+    WEB_RENDER_BENCH,
+    WEB_RENDER_COUNT,
+} web_service_render_t;
+
+typedef struct {
+    uint32_t requests;
+    uint32_t last_us;  // handler CPU time, socket sends excluded
+    uint32_t max_us;
+    uint32_t last_bytes;
+} web_service_render_stat_t;
+
 typedef struct {
     bool initialized;
     bool running;
@@ -82,6 +169,23 @@ typedef struct {
     bool auth_basic_enabled;
     char api_key[WEB_SERVICE_HEADER_MAX];
     char basic_auth_expected[WEB_SERVICE_BASIC_EXPECTED_MAX];
+    // Guards the log_streams/state_streams slots; never held across a socket send.
+    SemaphoreHandle_t stream_lock;
+    TaskHandle_t stream_task;
+    volatile uint32_t log_stream_clients;
+    volatile uint32_t state_stream_clients;
+    web_service_log_stream_t log_streams[MACRO_WEB_SERVICE_LOG_STREAM_MAX_CLIENTS];
+    web_service_state_stream_t state_streams[MACRO_WEB_SERVICE_STATE_STREAM_MAX_CLIENTS];
+    web_service_render_stat_t render_stats[WEB_RENDER_COUNT];
+    // ETag of /state and /system/ota. Bumped by the record hooks; HID/OTA/breaker/buzzer changes are
+    // folded in from their lock-free counters when a request arrives.
+    uint32_t state_version;
+    // Random per boot, so a tag kept across a reboot or OTA never matches the restarted counter.
+    uint32_t etag_epoch;
+    uint32_t seen_hid_version;
+    uint32_t seen_ota_version;
+    uint32_t seen_breaker_version;
+    bool seen_buzzer_enabled;
 } web_service_state_t;
 
 static web_service_state_t s_ws = {0};
@@ -166,149 +270,149 @@ static void json_escape_copy(char *dst, size_t dst_size, const char *src)
     dst[w] = '\0';
 }
 
-static bool parse_json_int(const char *json, const char *key, int *out)
+static const char *hid_mode_to_str(hid_mode_t mode)
 {
-    if (json == NULL || key == NULL || out == NULL) {
-        return false;
-    }
+    return (mode == HID_MODE_BLE) ? "ble" : "usb";
+}
 
-    char token[48] = {0};
-    (void)snprintf(token, sizeof(token), "\"%s\"", key);
-    const char *p = strstr(json, token);
-    if (p == NULL) {
+static bool parse_hid_mode(const char *value, hid_mode_t *out_mode)
+{
+    if (value == NULL || out_mode == NULL) {
         return false;
     }
-    p = strchr(p, ':');
-    if (p == NULL) {
-        return false;
+    if (strcmp(value, "usb") == 0) {
+        *out_mode = HID_MODE_USB;
+        return true;
     }
-    ++p;
-    while (*p != '\0' && isspace((int)(unsigned char)*p)) {
-        ++p;
+    if (strcmp(value, "ble") == 0) {
+        *out_mode = HID_MODE_BLE;
+        return true;
     }
+    return false;
+}
 
-    char *end = NULL;
-    long v = strtol(p, &end, 10);
-    if (end == p) {
-        return false;
+// cache_control is no-store except on ETag routes: no-cache there, so clients keep the body and revalidate.
+static void http_set_json_headers(httpd_req_t *req, const char *status, const char *cache_control)
+{
+    httpd_resp_set_status(req, status);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", cache_control);
+    if (MACRO_WEB_SERVICE_CORS_ENABLED) {
+        httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+        httpd_resp_set_hdr(req, "Access-Control-Allow-Headers", "Content-Type,Authorization,X-API-Key,If-None-Match");
+        httpd_resp_set_hdr(req, "Access-Control-Allow-Methods", "GET,POST,OPTIONS");
     }
-    *out = (int)v;
-    return true;
 }
 
-static bool parse_json_bool(const char *json, const char *key, bool *out)
+static esp_err_t http_send_json(httpd_req_t *req, const char *status, const char *json)
 {
-    if (json == NULL || key == NULL || out == NULL) {
-        return false;
+    if (req == NULL || status == NULL || json == NULL) {
+        return ESP_ERR_INVALID_ARG;
     }
 
-    char token[48] = {0};
-    (void)snprintf(token, sizeof(token), "\"%s\"", key);
-    const char *p = strstr(json, token);
-    if (p == NULL) {
-        return false;
-    }
-    p = strchr(p, ':');
-    if (p == NULL) {
-        return false;
-    }
-    ++p;
-    while (*p != '\0' && isspace((int)(unsigned char)*p)) {
-        ++p;
-    }
+    http_set_json_headers(req, status, "no-store");
+    return httpd_resp_sendstr(req, json);
+}
 
-    if (strncmp(p, "true", 4) == 0) {
-        *out = true;
-        return true;
-    }
-    if (strncmp(p, "false", 5) == 0) {
-        *out = false;
-        return true;
-    }
-    if (*p == '1') {
-        *out = true;
-        return true;
-    }
-    if (*p == '0') {
-        *out = false;
-        return true;
-    }
-    return false;
+// Chunked JSON response. Time spent inside httpd_resp_send_chunk() is tracked separately so the
+// recorded render time is the handler's own CPU cost rather than the client's receive speed.
+typedef struct {
+    httpd_req_t *req;
+    int64_t start_us;
+    int64_t send_us;
+    json_writer_t writer;
+    char buf[WEB_SERVICE_JSON_CHUNK_BUF];
+} json_response_t;
+
+static esp_err_t json_response_flush(void *ctx, const char *data, size_t len)
+{
+    json_response_t *resp = (json_response_t *)ctx;
+    const int64_t t0 = esp_timer_get_time();
+    const esp_err_t err = httpd_resp_send_chunk(resp->req, data, (ssize_t)len);
+    resp->send_us += esp_timer_get_time() - t0;
+    return err;
 }
 
-static bool parse_json_string(const char *json, const char *key, char *out, size_t out_size)
+static json_writer_t *json_response_begin(json_response_t *resp, httpd_req_t *req, const char *status, const char *etag)
 {
-    if (json == NULL || key == NULL || out == NULL || out_size == 0U) {
-        return false;
-    }
-    out[0] = '\0';
+    resp->req = req;
+    resp->start_us = esp_timer_get_time();
+    resp->send_us = 0;
+    http_set_json_headers(req, status, (etag != NULL) ? "no-cache" : "no-store");
+    if (etag != NULL) {
+        httpd_resp_set_hdr(req, "ETag", etag);
+    }
+    json_writer_init(&resp->writer, resp->buf, sizeof(resp->buf), json_response_flush, resp);
+    return &resp->writer;
+}
 
-    char token[48] = {0};
-    (void)snprintf(token, sizeof(token), "\"%s\"", key);
-    const char *p = strstr(json, token);
-    if (p == NULL) {
-        return false;
-    }
-    p = strchr(p, ':');
-    if (p == NULL) {
-        return false;
-    }
-    ++p;
-    while (*p != '\0' && isspace((int)(unsigned char)*p)) {
-        ++p;
-    }
-    if (*p != '"') {
-        return false;
+static esp_err_t json_response_end(json_response_t *resp, web_service_render_t kind)
+{
+    const esp_err_t err = json_writer_finish(&resp->writer);
+    const int64_t cpu_us = esp_timer_get_time() - resp->start_us - resp->send_us;
+
+    web_service_lock();
+    web_service_render_stat_t *stat = &s_ws.render_stats[kind];
+    ++stat->requests;
+    stat->last_us = (cpu_us > 0) ? (uint32_t)cpu_us : 0U;
+    if (stat->last_us > stat->max_us) {
+        stat->max_us = stat->last_us;
     }
-    ++p;
+    stat->last_bytes = (uint32_t)resp->writer.total;
+    web_service_unlock();
 
-    size_t w = 0;
-    while (*p != '\0' && *p != '"' && (w + 1U) < out_size) {
-        if (*p == '\\' && p[1] != '\0') {
-            ++p;
-        }
-        out[w++] = *p++;
+    if (err != ESP_OK) {
+        // Headers and part of the body are already out; all that is left is to drop the connection.
+        ESP_LOGW(TAG, "JSON response aborted: %s", esp_err_to_name(err));
+        return ESP_FAIL;
     }
-    out[w] = '\0';
-    return true;
+    return httpd_resp_send_chunk(resp->req, NULL, 0);
 }
 
-static const char *hid_mode_to_str(hid_mode_t mode)
+static uint32_t state_version_current(void)
 {
-    return (mode == HID_MODE_BLE) ? "ble" : "usb";
+    const uint32_t hid_version = hid_transport_status_version();
+    const uint32_t ota_version = ota_manager_status_version();
+    const uint32_t breaker_version = net_breaker_version();
+    const bool buzzer_enabled = buzzer_is_enabled();
+
+    web_service_lock();
+    if (hid_version != s_ws.seen_hid_version || ota_version != s_ws.seen_ota_version ||
+        breaker_version != s_ws.seen_breaker_version || buzzer_enabled != s_ws.seen_buzzer_enabled) {
+        s_ws.seen_hid_version = hid_version;
+        s_ws.seen_ota_version = ota_version;
+        s_ws.seen_breaker_version = breaker_version;
+        s_ws.seen_buzzer_enabled = buzzer_enabled;
+        s_ws.state_version++;
+    }
+    const uint32_t version = s_ws.state_version;
+    web_service_unlock();
+    return version;
 }
 
-static bool parse_hid_mode(const char *value, hid_mode_t *out_mode)
+// Writes the current ETag into etag and returns true when If-None-Match already names it.
+static bool http_etag_matches(httpd_req_t *req, char *etag, size_t etag_size)
 {
-    if (value == NULL || out_mode == NULL) {
+    (void)snprintf(etag, etag_size, "\"%08" PRIx32 "-%" PRIu32 "\"", s_ws.etag_epoch, state_version_current());
+
+    char header[64] = {0};
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", header, sizeof(header)) != ESP_OK) {
         return false;
     }
-    if (strcmp(value, "usb") == 0) {
-        *out_mode = HID_MODE_USB;
-        return true;
-    }
-    if (strcmp(value, "ble") == 0) {
-        *out_mode = HID_MODE_BLE;
-        return true;
-    }
-    return false;
+    return strcmp(header, "*") == 0 || strstr(header, etag) != NULL;
 }
 
-static esp_err_t http_send_json(httpd_req_t *req, const char *status, const char *json)
+static esp_err_t http_send_not_modified(httpd_req_t *req, const char *etag)
 {
-    if (req == NULL || status == NULL || json == NULL) {
-        return ESP_ERR_INVALID_ARG;
-    }
-
-    httpd_resp_set_status(req, status);
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    httpd_resp_set_status(req, "304 Not Modified");
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
     if (MACRO_WEB_SERVICE_CORS_ENABLED) {
         httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
-        httpd_resp_set_hdr(req, "Access-Control-Allow-Headers", "Content-Type,Authorization,X-API-Key");
+        httpd_resp_set_hdr(req, "Access-Control-Allow-Headers", "Content-Type,Authorization,X-API-Key,If-None-Match");
         httpd_resp_set_hdr(req, "Access-Control-Allow-Methods", "GET,POST,OPTIONS");
     }
-    return httpd_resp_sendstr(req, json);
+    return httpd_resp_send(req, NULL, 0);
 }
 
 static esp_err_t http_send_options_ok(httpd_req_t *req)
@@ -320,7 +424,7 @@ static esp_err_t http_send_options_ok(httpd_req_t *req)
     httpd_resp_set_status(req, "204 No Content");
     if (MACRO_WEB_SERVICE_CORS_ENABLED) {
         httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
-        httpd_resp_set_hdr(req, "Access-Control-Allow-Headers", "Content-Type,Authorization,X-API-Key");
+        httpd_resp_set_hdr(req, "Access-Control-Allow-Headers", "Content-Type,Authorization,X-API-Key,If-None-Match");
         httpd_resp_set_hdr(req, "Access-Control-Allow-Methods", "GET,POST,OPTIONS");
     }
     return httpd_resp_send(req, NULL, 0);
@@ -351,6 +455,29 @@ static esp_err_t http_read_body(httpd_req_t *req, char *buf, size_t buf_size)
     return ESP_OK;
 }
 
+typedef struct {
+    char body[WEB_SERVICE_BODY_MAX];
+    json_tok_t toks[WEB_SERVICE_BODY_TOKENS];
+    json_doc_t doc;
+} web_service_json_body_t;
+
+// Reads and tokenizes a request body once; an empty body yields a document without fields.
+static esp_err_t http_read_json_body(httpd_req_t *req, web_service_json_body_t *in)
+{
+    esp_err_t err = http_read_body(req, in->body, sizeof(in->body));
+    if (err != ESP_OK) {
+        return err;
+    }
+    const size_t len = strlen(in->body);
+    if (len == 0U) {
+        in->doc.json = in->body;
+        in->doc.toks = in->toks;
+        in->doc.count = 0;
+        return ESP_OK;
+    }
+    return json_reader_parse(&in->doc, in->body, len, in->toks, WEB_SERVICE_BODY_TOKENS);
+}
+
 static bool http_get_header_copy(httpd_req_t *req, const char *name, char *out, size_t out_size)
 {
     if (req == NULL || name == NULL || out == NULL || out_size == 0U) {
@@ -362,216 +489,1064 @@ static bool http_get_header_copy(httpd_req_t *req, const char *name, char *out,
     if (len == 0U || len >= out_size) {
         return false;
     }
-    return httpd_req_get_hdr_value_str(req, name, out, out_size) == ESP_OK;
+    return httpd_req_get_hdr_value_str(req, name, out, out_size) == ESP_OK;
+}
+
+static bool web_auth_api_key_match(httpd_req_t *req)
+{
+    char header_value[WEB_SERVICE_HEADER_MAX] = {0};
+    if (!http_get_header_copy(req, "X-API-Key", header_value, sizeof(header_value))) {
+        return false;
+    }
+    return strcmp(header_value, s_ws.api_key) == 0;
+}
+
+static bool web_auth_basic_match(httpd_req_t *req)
+{
+    char auth_header[WEB_SERVICE_HEADER_MAX] = {0};
+    if (!http_get_header_copy(req, "Authorization", auth_header, sizeof(auth_header))) {
+        return false;
+    }
+    return strcmp(auth_header, s_ws.basic_auth_expected) == 0;
+}
+
+static esp_err_t web_auth_guard(httpd_req_t *req)
+{
+    bool api_key_enabled = false;
+    bool basic_enabled = false;
+    web_service_lock();
+    api_key_enabled = s_ws.auth_api_key_enabled;
+    basic_enabled = s_ws.auth_basic_enabled;
+    web_service_unlock();
+
+    if (!api_key_enabled && !basic_enabled) {
+        return ESP_OK;
+    }
+
+    bool authorized = false;
+    if (api_key_enabled && web_auth_api_key_match(req)) {
+        authorized = true;
+    }
+    if (basic_enabled && web_auth_basic_match(req)) {
+        authorized = true;
+    }
+    if (authorized) {
+        return ESP_OK;
+    }
+
+    if (basic_enabled) {
+        httpd_resp_set_hdr(req, "WWW-Authenticate", "Basic realm=\"ESP32 MacroPad\"");
+    }
+    return http_send_json(req, "401 Unauthorized", "{\"ok\":false,\"error\":\"unauthorized\"}");
+}
+
+static void write_ota_status(json_writer_t *w, const ota_manager_status_t *ota)
+{
+    json_writer_key(w, "ota");
+    json_writer_obj_begin(w);
+    json_writer_kv_bool(w, "enabled", ota->enabled);
+    json_writer_kv_str(w, "state", ota_manager_state_name(ota->state));
+    json_writer_kv_bool(w, "pending_verify", ota->pending_verify);
+    json_writer_kv_u32(w, "confirm_tap_count", ota->confirm_tap_count);
+    json_writer_kv_u32(w, "self_check_duration_ms", ota->self_check_duration_ms);
+    json_writer_kv_u32(w, "self_check_elapsed_ms", ota->self_check_elapsed_ms);
+    json_writer_kv_u32(w, "confirm_timeout_ms", ota->confirm_timeout_ms);
+    json_writer_kv_u32(w, "confirm_remaining_ms", ota->confirm_remaining_ms);
+    json_writer_kv_u32(w, "self_check_free_heap", ota->self_check_free_heap_bytes);
+    json_writer_kv_u32(w, "download_total_bytes", ota->download_total_bytes);
+    json_writer_kv_u32(w, "download_read_bytes", ota->download_read_bytes);
+    json_writer_kv_u32(w, "download_elapsed_ms", ota->download_elapsed_ms);
+    json_writer_kv_u32(w, "download_percent", ota->download_percent);
+    json_writer_kv_str(w, "current_url", ota->current_url);
+    json_writer_kv_str(w, "last_error", ota->last_error);
+    json_writer_obj_end(w);
+}
+
+static void write_breakers(json_writer_t *w, const net_breaker_info_t *breakers, size_t count)
+{
+    json_writer_key(w, "breakers");
+    json_writer_obj_begin(w);
+    for (size_t i = 0; i < count; ++i) {
+        const net_breaker_info_t *b = &breakers[i];
+        json_writer_key(w, b->name);
+        json_writer_obj_begin(w);
+        json_writer_kv_str(w, "state", net_breaker_state_name(b->state));
+        json_writer_kv_u32(w, "failures", b->failures);
+        json_writer_kv_u32(w, "backoff_level", b->backoff_level);
+        json_writer_kv_u32(w, "retry_in_ms", b->retry_in_ms);
+        json_writer_kv_u32(w, "opens", b->opens);
+        json_writer_kv_u32(w, "rejected", b->rejected);
+        json_writer_obj_end(w);
+    }
+    json_writer_obj_end(w);
+}
+
+// Field writers shared by /api/v1/state and /api/v1/state/stream; callers open and close the object.
+static void write_key_fields(json_writer_t *w, const web_service_key_event_t *key)
+{
+    json_writer_kv_bool(w, "valid", key->valid);
+    json_writer_kv_u32(w, "index", key->key_index);
+    json_writer_kv_bool(w, "pressed", key->pressed);
+    json_writer_kv_u32(w, "usage", key->usage);
+    json_writer_kv_str(w, "name", key->name);
+}
+
+static void write_encoder_fields(json_writer_t *w, const web_service_encoder_event_t *encoder)
+{
+    json_writer_kv_bool(w, "valid", encoder->valid);
+    json_writer_kv_i32(w, "steps", encoder->steps);
+    json_writer_kv_u32(w, "usage", encoder->usage);
+}
+
+static void write_swipe_fields(json_writer_t *w, const web_service_swipe_event_t *swipe)
+{
+    json_writer_kv_bool(w, "valid", swipe->valid);
+    json_writer_kv_u32(w, "layer_index", swipe->layer_index);
+    json_writer_kv_bool(w, "left_to_right", swipe->left_to_right);
+    json_writer_kv_u32(w, "usage", swipe->usage);
+}
+
+static void write_hid_fields(json_writer_t *w, const hid_transport_status_t *hid)
+{
+    json_writer_kv_str(w, "keyboard_mode", hid_mode_to_str(hid->mode));
+    json_writer_kv_bool(w, "mode_switch_pending", hid->mode_switch_pending);
+    json_writer_kv_str(w, "mode_switch_target", hid_mode_to_str(hid->mode_switch_target));
+    json_writer_kv_bool(w, "usb_mounted", hid->usb_mounted);
+    json_writer_kv_bool(w, "usb_hid_ready", hid->usb_hid_ready);
+    json_writer_kv_bool(w, "ble_connected", hid->ble_connected);
+    json_writer_kv_bool(w, "ble_bonded", hid->ble_bonded);
+    json_writer_kv_bool(w, "ble_pairing_active", hid->ble_pairing_window_active);
+    json_writer_kv_u32(w, "ble_pairing_remaining_ms", hid->ble_pairing_remaining_ms);
+    json_writer_kv_str(w, "ble_peer_addr", hid->ble_peer_addr);
+}
+
+static esp_err_t health_get_handler(httpd_req_t *req)
+{
+    static const char *const render_names[WEB_RENDER_COUNT] = {"state", "ota", "health", "profile", "trace", "bench"};
+    esp_err_t auth = web_auth_guard(req);
+    if (auth != ESP_OK) {
+        return auth;
+    }
+
+    // No ETag: uptime and the counters below change on every request, a 304 would hand back stale ones.
+    web_service_render_stat_t render[WEB_RENDER_COUNT];
+    web_service_lock();
+    memcpy(render, s_ws.render_stats, sizeof(render));
+    web_service_unlock();
+    home_assistant_stats_t ha;
+    home_assistant_get_stats(&ha);
+    ha_spool_stats_t spool;
+    ha_spool_get_stats(&spool);
+
+    json_response_t resp;
+    json_writer_t *w = json_response_begin(&resp, req, "200 OK", NULL);
+    json_writer_obj_begin(w);
+    json_writer_kv_bool(w, "ok", true);
+    json_writer_kv_str(w, "service", "macropad-web");
+    json_writer_kv_u32(w, "uptime_ms", (uint32_t)pdTICKS_TO_MS(xTaskGetTickCount() - s_ws.boot_tick));
+    json_writer_kv_bool(w, "wifi_connected", wifi_portal_is_connected());
+    json_writer_kv_bool(w, "portal_active", wifi_portal_is_active());
+    json_writer_kv_bool(w, "control_enabled", MACRO_WEB_SERVICE_CONTROL_ENABLED);
+    json_writer_kv_bool(w, "running", s_ws.running);
+    json_writer_key(w, "home_assistant");
+    json_writer_obj_begin(w);
+    json_writer_kv_bool(w, "enabled", ha.enabled);
+    json_writer_kv_bool(w, "connected", ha.connected);
+    json_writer_kv_u32(w, "connects", ha.connects);
+    json_writer_kv_u32(w, "requests", ha.requests);
+    json_writer_kv_u32(w, "failures", ha.failures);
+    json_writer_kv_u32(w, "last_request_us", ha.last_request_us);
+    json_writer_kv_u32(w, "max_request_us", ha.max_request_us);
+    json_writer_kv_str(w, "transport",
+                       MACRO_HA_TRANSPORT_MQTT ? "mqtt" : (MACRO_HA_TRANSPORT_WEBSOCKET ? "websocket" : "rest"));
+    json_writer_kv_bool(w, "ws_authenticated", ha.ws_authenticated);
+    json_writer_kv_bool(w, "ws_subscribed", ha.ws_subscribed);
+    json_writer_kv_u32(w, "ws_connects", ha.ws_connects);
+    json_writer_kv_u32(w, "ws_updates", ha.ws_updates);
+    json_writer_kv_bool(w, "mqtt_connected", ha.mqtt_connected);
+    json_writer_kv_u32(w, "mqtt_connects", ha.mqtt_connects);
+    json_writer_kv_u32(w, "mqtt_published", ha.mqtt_published);
+    json_writer_kv_u32(w, "mqtt_updates", ha.mqtt_updates);
+    json_writer_kv_u32(w, "coalesced", ha.coalesced);
+    json_writer_kv_u32(w, "dropped", ha.dropped);
+    json_writer_kv_u32(w, "batches", ha.batches);
+    json_writer_key(w, "spool");
+    json_writer_obj_begin(w);
+    json_writer_kv_bool(w, "mounted", spool.mounted);
+    json_writer_kv_u32(w, "pending", spool.pending);
+    json_writer_kv_u32(w, "spooled", spool.spooled);
+    json_writer_kv_u32(w, "drained", spool.drained);
+    json_writer_kv_u32(w, "expired", spool.expired);
+    json_writer_kv_u32(w, "overwritten", spool.overwritten);
+    json_writer_obj_end(w);
+    json_writer_obj_end(w);
+    json_writer_key(w, "render");
+    json_writer_obj_begin(w);
+    for (size_t i = 0; i < WEB_RENDER_COUNT; ++i) {
+        json_writer_key(w, render_names[i]);
+        json_writer_obj_begin(w);
+        json_writer_kv_u32(w, "requests", render[i].requests);
+        json_writer_kv_u32(w, "last_us", render[i].last_us);
+        json_writer_kv_u32(w, "max_us", render[i].max_us);
+        json_writer_kv_u32(w, "last_bytes", render[i].last_bytes);
+        json_writer_obj_end(w);
+    }
+    json_writer_obj_end(w);
+    json_writer_obj_end(w);
+    return json_response_end(&resp, WEB_RENDER_HEALTH);
+}
+
+static esp_err_t metrics_flush_chunk(void *ctx, const char *data, size_t len)
+{
+    return httpd_resp_send_chunk((httpd_req_t *)ctx, data, (ssize_t)len);
+}
+
+static esp_err_t metrics_get_handler(httpd_req_t *req)
+{
+    esp_err_t auth = web_auth_guard(req);
+    if (auth != ESP_OK) {
+        return auth;
+    }
+
+    char buf[WEB_SERVICE_JSON_CHUNK_BUF];
+    httpd_resp_set_status(req, "200 OK");
+    httpd_resp_set_type(req, "text/plain; version=0.0.4; charset=utf-8");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    const esp_err_t err = metrics_render(buf, sizeof(buf), metrics_flush_chunk, req);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Metrics response aborted: %s", esp_err_to_name(err));
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+static esp_err_t options_handler(httpd_req_t *req)
+{
+    return http_send_options_ok(req);
+}
+
+static bool query_value(httpd_req_t *req, const char *key, char *out, size_t out_size)
+{
+    char query[WEB_SERVICE_QUERY_MAX] = {0};
+    const size_t query_len = httpd_req_get_url_query_len(req);
+    if (query_len == 0U || query_len >= sizeof(query) ||
+        httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK) {
+        return false;
+    }
+    return httpd_query_key_value(query, key, out, out_size) == ESP_OK;
+}
+
+static bool query_u32_value(httpd_req_t *req, const char *key, uint32_t *out_value)
+{
+    char value[16] = {0};
+    if (!query_value(req, key, value, sizeof(value))) {
+        return false;
+    }
+    char *end = NULL;
+    const unsigned long parsed = strtoul(value, &end, 10);
+    if (end == value || *end != '\0') {
+        return false;
+    }
+    *out_value = (uint32_t)parsed;
+    return true;
+}
+
+static uint32_t query_u32(httpd_req_t *req, const char *key, uint32_t fallback)
+{
+    uint32_t value = fallback;
+    return query_u32_value(req, key, &value) ? value : fallback;
+}
+
+static size_t logs_limit_from_query(httpd_req_t *req)
+{
+    const uint32_t parsed = query_u32(req, "limit", 0U);
+    if (parsed == 0U) {
+        return WEB_SERVICE_LOGS_DEFAULT_LIMIT;
+    }
+    return (parsed > WEB_SERVICE_LOGS_MAX_LIMIT) ? WEB_SERVICE_LOGS_MAX_LIMIT : (size_t)parsed;
+}
+
+// level takes E/W/I/D/V or a level name (only the first letter counts); false for an unknown level.
+static bool logs_filter_from_query(httpd_req_t *req, log_store_filter_t *out_filter)
+{
+    memset(out_filter, 0, sizeof(*out_filter));
+    char level[12] = {0};
+    if (query_value(req, "level", level, sizeof(level)) && level[0] != '\0') {
+        const char c = (char)toupper((unsigned char)level[0]);
+        if (strchr("EWIDV", c) == NULL) {
+            return false;
+        }
+        out_filter->max_level = c;
+    }
+    if (!query_value(req, "tag", out_filter->tag, sizeof(out_filter->tag))) {
+        out_filter->tag[0] = '\0';
+    }
+    return true;
+}
+
+// Ids restart at boot; a cursor from before a reboot starts over from the oldest line.
+static uint32_t logs_clamp_since_id(uint32_t since_id, uint32_t last_id)
+{
+    return ((int32_t)(since_id - last_id) > 0) ? 0U : since_id;
+}
+
+// Buffers small writes into WEB_SERVICE_STREAM_CHUNK_BUF sized HTTP chunks.
+typedef struct {
+    httpd_req_t *req;
+    uint32_t limit;  // 0 = unlimited
+    uint32_t count;
+    bool failed;
+    size_t used;
+    char buf[WEB_SERVICE_STREAM_CHUNK_BUF];
+} chunk_stream_t;
+
+static bool chunk_stream_flush(chunk_stream_t *stream)
+{
+    if (stream->used > 0U && httpd_resp_send_chunk(stream->req, stream->buf, (ssize_t)stream->used) != ESP_OK) {
+        stream->failed = true;
+        return false;
+    }
+    stream->used = 0U;
+    return true;
+}
+
+static bool chunk_stream_write(chunk_stream_t *stream, const char *data, size_t len)
+{
+    while (len > 0U) {
+        if (stream->failed || (stream->used == sizeof(stream->buf) && !chunk_stream_flush(stream))) {
+            return false;
+        }
+        const size_t room = sizeof(stream->buf) - stream->used;
+        const size_t n = (len < room) ? len : room;
+        memcpy(&stream->buf[stream->used], data, n);
+        stream->used += n;
+        data += n;
+        len -= n;
+    }
+    return !stream->failed;
+}
+
+static bool chunk_stream_full(const chunk_stream_t *stream)
+{
+    return stream->limit > 0U && stream->count >= stream->limit;
+}
+
+static bool logs_json_entry(chunk_stream_t *stream, const log_store_entry_t *entry)
+{
+    char escaped[(sizeof(entry->line) * 2U) + 8U] = {0};
+    json_escape_copy(escaped, sizeof(escaped), entry->line);
+
+    char head[40];
+    const int n = snprintf(head,
+                           sizeof(head),
+                           "%s{\"id\":%" PRIu32 ",\"line\":\"",
+                           (stream->count == 0U) ? "" : ",\n",
+                           entry->id);
+    stream->count++;
+    return n > 0 && chunk_stream_write(stream, head, (size_t)n) &&
+           chunk_stream_write(stream, escaped, strlen(escaped)) && chunk_stream_write(stream, "\"}\n", 3U);
+}
+
+static bool logs_json_visit(const log_store_entry_t *entry, void *ctx)
+{
+    chunk_stream_t *stream = (chunk_stream_t *)ctx;
+    // Stop before the entry so the returned last_id does not skip it.
+    return !chunk_stream_full(stream) && logs_json_entry(stream, entry);
+}
+
+static esp_err_t logs_get_handler(httpd_req_t *req)
+{
+    esp_err_t auth = web_auth_guard(req);
+    if (auth != ESP_OK) {
+        return auth;
+    }
+
+    log_store_filter_t filter;
+    if (!logs_filter_from_query(req, &filter)) {
+        return http_send_json(req, "400 Bad Request", "{\"ok\":false,\"error\":\"invalid level\"}");
+    }
+    uint32_t since_id = 0U;
+    const bool has_since = query_u32_value(req, "since_id", &since_id);
+    const size_t limit = logs_limit_from_query(req);
+
+    chunk_stream_t *stream = calloc(1, sizeof(*stream));
+    // Without a cursor the newest lines are picked first, which needs the staging array.
+    log_store_entry_t *entries = has_since ? NULL : calloc(limit, sizeof(log_store_entry_t));
+    if (stream == NULL || (!has_since && entries == NULL)) {
+        free(stream);
+        free(entries);
+        return http_send_json(req, "500 Internal Server Error", "{\"ok\":false,\"error\":\"oom\"}");
+    }
+    stream->req = req;
+    stream->limit = (uint32_t)limit;
+
+    log_store_stats_t log_stats = {0};
+    log_store_get_stats(&log_stats);
+    const size_t count = has_since ? 0U : log_store_copy_recent(entries, limit, limit);
+    const bool time_synced = log_store_is_time_synced();
+    log_archive_stats_t archive_stats = {0};
+    log_archive_get_stats(&archive_stats);
+
+    httpd_resp_set_status(req, "200 OK");
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    if (MACRO_WEB_SERVICE_CORS_ENABLED) {
+        httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+        httpd_resp_set_hdr(req, "Access-Control-Allow-Headers", "Content-Type,Authorization,X-API-Key,If-None-Match");
+        httpd_resp_set_hdr(req, "Access-Control-Allow-Methods", "GET,POST,OPTIONS");
+    }
+
+    char head[WEB_SERVICE_LOGS_CHUNK_BUF] = {0};
+    int n = snprintf(head,
+                     sizeof(head),
+                     "{\n\"ok\":true,\n\"time_synced\":%s,\n\"dropped\":%" PRIu32 ",\n"
+                     "\"collapsed\":%" PRIu32 ",\n\"rate_limited\":%" PRIu32 ",\n"
+                     "\"archive\":{\"mounted\":%s,\"first_seq\":%" PRIu32 ",\"next_seq\":%" PRIu32
+                     ",\"sectors_used\":%" PRIu32 ",\"sector_count\":%" PRIu32 ",\"raw_bytes\":%" PRIu32
+                     ",\"stored_bytes\":%" PRIu32 ",\"lines_missed\":%" PRIu32 ",\"max_erase_count\":%" PRIu32 "},\n",
+                     time_synced ? "true" : "false",
+                     log_stats.dropped,
+                     log_stats.collapsed,
+                     log_stats.rate_limited,
+                     archive_stats.mounted ? "true" : "false",
+                     archive_stats.first_seq,
+                     archive_stats.next_seq,
+                     archive_stats.sectors_used,
+                     archive_stats.sector_count,
+                     archive_stats.raw_bytes,
+                     archive_stats.stored_bytes,
+                     archive_stats.lines_missed,
+                     archive_stats.max_erase_count);
+    bool ok = n > 0 && (size_t)n < sizeof(head) && chunk_stream_write(stream, head, (size_t)n);
+
+    log_store_rate_limit_t limits[WEB_SERVICE_LOG_RATE_LIMITS_MAX];
+    const size_t limit_count = log_store_get_rate_limits(limits, WEB_SERVICE_LOG_RATE_LIMITS_MAX);
+    ok = ok && chunk_stream_write(stream, "\"rate_limits\":[", 15U);
+    for (size_t i = 0; ok && i < limit_count; ++i) {
+        char tag_json[(sizeof(limits[i].tag) * 2U) + 8U] = {0};
+        json_escape_copy(tag_json, sizeof(tag_json), limits[i].tag);
+        n = snprintf(head,
+                     sizeof(head),
+                     "%s{\"tag\":\"%s\",\"per_sec\":%u,\"burst\":%u,\"suppressed\":%" PRIu32 "}",
+                     (i == 0U) ? "" : ",",
+                     tag_json,
+                     (unsigned)limits[i].per_sec,
+                     (unsigned)limits[i].burst,
+                     limits[i].suppressed);
+        ok = n > 0 && (size_t)n < sizeof(head) && chunk_stream_write(stream, head, (size_t)n);
+    }
+    ok = ok && chunk_stream_write(stream, "],\n\"entries\":[\n", 16U);
+
+    log_store_cursor_t cursor = {.last_id = has_since ? logs_clamp_since_id(since_id, log_stats.last_id) : log_stats.last_id};
+    if (ok && has_since) {
+        // Lines are rendered one at a time straight from the ring into the response.
+        (void)log_store_visit_since(&cursor, &filter, logs_json_visit, stream);
+        ok = !stream->failed;
+    }
+    for (size_t i = 0; ok && i < count; ++i) {
+        if ((int32_t)(entries[i].id - cursor.last_id) > 0) {
+            cursor.last_id = entries[i].id;
+        }
+        if (log_store_line_matches(entries[i].line, &filter)) {
+            ok = logs_json_entry(stream, &entries[i]);
+        }
+    }
+    free(entries);
+
+    if (ok) {
+        n = snprintf(head,
+                     sizeof(head),
+                     "],\n\"count\":%" PRIu32 ",\n\"last_id\":%" PRIu32 "\n}\n",
+                     stream->count,
+                     cursor.last_id);
+        ok = n > 0 && (size_t)n < sizeof(head) && chunk_stream_write(stream, head, (size_t)n) &&
+             chunk_stream_flush(stream);
+    }
+    free(stream);
+    if (!ok || httpd_resp_send_chunk(req, NULL, 0) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    web_service_mark_user_activity();
+    return ESP_OK;
+}
+
+// log_store keeps line breaks inside a message; SSE ends a field at CR or LF, so every segment of
+// the line gets its own data: field (the client joins them back with '\n').
+static bool log_stream_visit(const log_store_entry_t *entry, void *ctx)
+{
+    chunk_stream_t *stream = (chunk_stream_t *)ctx;
+    char head[24];
+    const int n = snprintf(head, sizeof(head), "id: %" PRIu32 "\n", entry->id);
+    stream->count++;
+    if (n <= 0 || !chunk_stream_write(stream, head, (size_t)n)) {
+        return false;
+    }
+    const char *seg = entry->line;
+    while (true) {
+        const size_t len = strcspn(seg, "\r\n");
+        if (!chunk_stream_write(stream, "data: ", 6U) || !chunk_stream_write(stream, seg, len) ||
+            !chunk_stream_write(stream, "\n", 1U)) {
+            return false;
+        }
+        seg += len;
+        if (*seg == '\0') {
+            break;
+        }
+        seg += (seg[0] == '\r' && seg[1] == '\n') ? 2U : 1U;
+    }
+    return chunk_stream_write(stream, "\n", 1U);
+}
+
+static void log_stream_close_locked(web_service_log_stream_t *client)
+{
+    (void)httpd_req_async_handler_complete(client->req);
+    client->req = NULL;
+    client->closing = false;
+    s_ws.log_stream_clients--;
+}
+
+// Runs on stream_task without stream_lock (the client is busy); false when the client went away.
+static bool log_stream_pump(web_service_log_stream_t *client, chunk_stream_t *stream, TickType_t now)
+{
+    stream->req = client->req;
+    stream->count = 0U;
+    stream->used = 0U;
+    stream->failed = false;
+    if (!client->started) {
+        (void)chunk_stream_write(stream, "retry: 2000\n\n", 13U);
+        client->started = true;
+    }
+    (void)log_store_visit_since(&client->cursor, &client->filter, log_stream_visit, stream);
+    if (stream->count == 0U && (now - client->last_send_tick) >= pdMS_TO_TICKS(WEB_SERVICE_LOG_STREAM_KEEPALIVE_MS)) {
+        // SSE comment; also notices clients that went away without closing.
+        (void)chunk_stream_write(stream, ": keepalive\n\n", 13U);
+    }
+    const bool wrote = stream->used > 0U;
+    if (stream->failed || !chunk_stream_flush(stream)) {
+        return false;
+    }
+    if (wrote) {
+        client->last_send_tick = now;
+    }
+    return true;
+}
+
+static void state_snapshot_read(web_service_state_snapshot_t *snap)
+{
+    web_service_lock();
+    snap->layer = s_ws.active_layer;
+    snap->key = s_ws.last_key;
+    snap->encoder = s_ws.last_encoder;
+    snap->swipe = s_ws.last_swipe;
+    web_service_unlock();
+    snap->buzzer_enabled = buzzer_is_enabled();
+    (void)hid_transport_get_status(&snap->hid);
+    ota_manager_get_status(&snap->ota);
+    snap->breaker_count = (uint8_t)net_breaker_snapshot(snap->breakers, NET_BREAKER_MAX);
+}
+
+// Counters that run on their own (pairing countdown, download bytes, timers) only ride along
+// with a change of the fields compared here, so an idle device sends nothing.
+static uint32_t state_snapshot_diff(const web_service_state_snapshot_t *a, const web_service_state_snapshot_t *b)
+{
+    uint32_t mask = 0U;
+    if (a->layer != b->layer) {
+        mask |= WEB_STATE_LAYER;
+    }
+    if (a->buzzer_enabled != b->buzzer_enabled) {
+        mask |= WEB_STATE_BUZZER;
+    }
+    if (a->key.valid != b->key.valid || a->key.tick != b->key.tick || a->key.key_index != b->key.key_index ||
+        a->key.pressed != b->key.pressed) {
+        mask |= WEB_STATE_KEY;
+    }
+    if (a->encoder.valid != b->encoder.valid || a->encoder.tick != b->encoder.tick ||
+        a->encoder.steps != b->encoder.steps) {
+        mask |= WEB_STATE_ENCODER;
+    }
+    if (a->swipe.valid != b->swipe.valid || a->swipe.tick != b->swipe.tick) {
+        mask |= WEB_STATE_SWIPE;
+    }
+    if (a->hid.mode != b->hid.mode || a->hid.mode_switch_pending != b->hid.mode_switch_pending ||
+        a->hid.mode_switch_target != b->hid.mode_switch_target || a->hid.usb_mounted != b->hid.usb_mounted ||
+        a->hid.usb_hid_ready != b->hid.usb_hid_ready || a->hid.ble_connected != b->hid.ble_connected ||
+        a->hid.ble_bonded != b->hid.ble_bonded ||
+        a->hid.ble_pairing_window_active != b->hid.ble_pairing_window_active ||
+        strcmp(a->hid.ble_peer_addr, b->hid.ble_peer_addr) != 0) {
+        mask |= WEB_STATE_HID;
+    }
+    if (a->ota.enabled != b->ota.enabled || a->ota.state != b->ota.state ||
+        a->ota.pending_verify != b->ota.pending_verify || a->ota.confirm_tap_count != b->ota.confirm_tap_count ||
+        a->ota.download_percent != b->ota.download_percent || strcmp(a->ota.last_error, b->ota.last_error) != 0) {
+        mask |= WEB_STATE_OTA;
+    }
+    if (a->breaker_count != b->breaker_count) {
+        mask |= WEB_STATE_BREAKERS;
+    }
+    for (uint8_t i = 0; i < a->breaker_count && i < b->breaker_count; ++i) {
+        if (a->breakers[i].state != b->breakers[i].state ||
+            a->breakers[i].backoff_level != b->breakers[i].backoff_level) {
+            mask |= WEB_STATE_BREAKERS;
+        }
+    }
+    return mask;
+}
+
+static void write_state_groups(json_writer_t *w, const web_service_state_snapshot_t *snap, uint32_t mask)
+{
+    json_writer_obj_begin(w);
+    if ((mask & WEB_STATE_LAYER) != 0U) {
+        json_writer_kv_u32(w, "layer_index", snap->layer);
+        json_writer_kv_u32(w, "layer", (uint32_t)snap->layer + 1U);
+    }
+    if ((mask & WEB_STATE_BUZZER) != 0U) {
+        json_writer_kv_bool(w, "buzzer_enabled", snap->buzzer_enabled);
+    }
+    if ((mask & WEB_STATE_KEY) != 0U) {
+        json_writer_key(w, "last_key");
+        json_writer_obj_begin(w);
+        write_key_fields(w, &snap->key);
+        json_writer_obj_end(w);
+    }
+    if ((mask & WEB_STATE_ENCODER) != 0U) {
+        json_writer_key(w, "last_encoder");
+        json_writer_obj_begin(w);
+        write_encoder_fields(w, &snap->encoder);
+        json_writer_obj_end(w);
+    }
+    if ((mask & WEB_STATE_SWIPE) != 0U) {
+        json_writer_key(w, "last_swipe");
+        json_writer_obj_begin(w);
+        write_swipe_fields(w, &snap->swipe);
+        json_writer_obj_end(w);
+    }
+    if ((mask & WEB_STATE_HID) != 0U) {
+        json_writer_key(w, "hid");
+        json_writer_obj_begin(w);
+        write_hid_fields(w, &snap->hid);
+        json_writer_obj_end(w);
+    }
+    if ((mask & WEB_STATE_OTA) != 0U) {
+        write_ota_status(w, &snap->ota);
+    }
+    if ((mask & WEB_STATE_BREAKERS) != 0U) {
+        write_breakers(w, snap->breakers, snap->breaker_count);
+    }
+    json_writer_obj_end(w);
+}
+
+typedef struct {
+    web_service_state_snapshot_t snap;
+    char buf[256];
+    size_t bytes;
+} bench_state_ctx_t;
+
+static bench_state_ctx_t s_bench_state;
+
+static esp_err_t bench_state_discard(void *ctx, const char *data, size_t len)
+{
+    (void)data;
+    ((bench_state_ctx_t *)ctx)->bytes += len;
+    return ESP_OK;
+}
+
+// Reading the snapshot takes the service lock, so it happens once per run outside the timed window.
+static void bench_state_setup(void *ctx)
+{
+    state_snapshot_read(&((bench_state_ctx_t *)ctx)->snap);
+}
+
+// Full state document as the SSE snapshot sends it; output goes to a discarding flush.
+static void bench_state_run(void *ctx)
+{
+    bench_state_ctx_t *b = (bench_state_ctx_t *)ctx;
+    json_writer_t w;
+    json_writer_init(&w, b->buf, sizeof(b->buf), bench_state_discard, b);
+    write_state_groups(&w, &b->snap, WEB_STATE_ALL);
+    (void)json_writer_finish(&w);
+}
+
+static const bench_case_t s_bench_state_encode = {
+    .name = "json_state_encode",
+    .run = bench_state_run,
+    .setup = bench_state_setup,
+    .ctx = &s_bench_state,
+};
+
+static esp_err_t state_stream_flush(void *ctx, const char *data, size_t len)
+{
+    return chunk_stream_write((chunk_stream_t *)ctx, data, len) ? ESP_OK : ESP_FAIL;
+}
+
+static void state_stream_close_locked(web_service_state_stream_t *client)
+{
+    (void)httpd_req_async_handler_complete(client->req);
+    client->req = NULL;
+    client->closing = false;
+    s_ws.state_stream_clients--;
+}
+
+// Runs on stream_task without stream_lock (the client is busy); false when the client went away.
+static bool state_stream_pump(web_service_state_stream_t *client,
+                              chunk_stream_t *stream,
+                              const web_service_state_snapshot_t *snap,
+                              uint32_t mask,
+                              uint32_t rev,
+                              TickType_t now)
+{
+    static char json_buf[128];
+
+    stream->req = client->req;
+    stream->count = 0U;
+    stream->used = 0U;
+    stream->failed = false;
+    if (!client->snapshot_sent) {
+        (void)chunk_stream_write(stream, "retry: 2000\n\n", 13U);
+    }
+    if (!client->snapshot_sent || mask != 0U) {
+        char head[48];
+        const int n = snprintf(head,
+                               sizeof(head),
+                               "event: %s\nid: %" PRIu32 "\ndata: ",
+                               client->snapshot_sent ? "delta" : "snapshot",
+                               rev);
+        json_writer_t w;
+        json_writer_init(&w, json_buf, sizeof(json_buf), state_stream_flush, stream);
+        write_state_groups(&w, snap, client->snapshot_sent ? mask : WEB_STATE_ALL);
+        if (n <= 0 || !chunk_stream_write(stream, head, (size_t)n) || json_writer_finish(&w) != ESP_OK ||
+            !chunk_stream_write(stream, "\n\n", 2U)) {
+            stream->failed = true;
+        }
+        client->snapshot_sent = true;
+    } else if ((now - client->last_send_tick) >= pdMS_TO_TICKS(WEB_SERVICE_LOG_STREAM_KEEPALIVE_MS)) {
+        (void)chunk_stream_write(stream, ": keepalive\n\n", 13U);
+    }
+    const bool wrote = stream->used > 0U;
+    if (stream->failed || !chunk_stream_flush(stream)) {
+        return false;
+    }
+    if (wrote) {
+        client->last_send_tick = now;
+    }
+    return true;
+}
+
+// Serves both SSE endpoints. Log clients are woken by the log drain task, state clients by the
+// web_service_set_active_layer()/record_*() hooks; HID and OTA have no hooks and are polled
+// every WEB_SERVICE_STATE_STREAM_POLL_MS while a state client is connected.
+// Open clients are claimed under stream_lock, served without it, then released (or closed).
+static void stream_task(void *arg)
+{
+    (void)arg;
+    static chunk_stream_t stream;
+    static web_service_state_snapshot_t published;
+    static web_service_state_snapshot_t current;
+    uint32_t rev = 0U;
+
+    while (true) {
+        const uint32_t wait_ms = (s_ws.state_stream_clients > 0U) ? WEB_SERVICE_STATE_STREAM_POLL_MS
+                                                                 : WEB_SERVICE_LOG_STREAM_KEEPALIVE_MS;
+        (void)ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_ms));
+        const TickType_t now = xTaskGetTickCount();
+        uint32_t log_claimed = 0U;
+        uint32_t state_claimed = 0U;
+        uint32_t log_failed = 0U;
+        uint32_t state_failed = 0U;
+
+        (void)xSemaphoreTake(s_ws.stream_lock, portMAX_DELAY);
+        for (size_t i = 0; i < MACRO_WEB_SERVICE_LOG_STREAM_MAX_CLIENTS; ++i) {
+            if (s_ws.log_streams[i].req != NULL && !s_ws.log_streams[i].closing) {
+                s_ws.log_streams[i].busy = true;
+                log_claimed |= 1U << i;
+            }
+        }
+        for (size_t i = 0; i < MACRO_WEB_SERVICE_STATE_STREAM_MAX_CLIENTS; ++i) {
+            if (s_ws.state_streams[i].req != NULL && !s_ws.state_streams[i].closing) {
+                s_ws.state_streams[i].busy = true;
+                state_claimed |= 1U << i;
+            }
+        }
+        (void)xSemaphoreGive(s_ws.stream_lock);
+
+        for (size_t i = 0; i < MACRO_WEB_SERVICE_LOG_STREAM_MAX_CLIENTS; ++i) {
+            if ((log_claimed & (1U << i)) != 0U && !log_stream_pump(&s_ws.log_streams[i], &stream, now)) {
+                log_failed |= 1U << i;
+            }
+        }
+        if (state_claimed != 0U) {
+            state_snapshot_read(&current);
+            const uint32_t mask = state_snapshot_diff(&published, &current);
+            if (mask != 0U || rev == 0U) {
+                ++rev;
+                published = current;
+            }
+            for (size_t i = 0; i < MACRO_WEB_SERVICE_STATE_STREAM_MAX_CLIENTS; ++i) {
+                if ((state_claimed & (1U << i)) != 0U &&
+                    !state_stream_pump(&s_ws.state_streams[i], &stream, &current, mask, rev, now)) {
+                    state_failed |= 1U << i;
+                }
+            }
+        }
+
+        (void)xSemaphoreTake(s_ws.stream_lock, portMAX_DELAY);
+        for (size_t i = 0; i < MACRO_WEB_SERVICE_LOG_STREAM_MAX_CLIENTS; ++i) {
+            web_service_log_stream_t *client = &s_ws.log_streams[i];
+            if ((log_claimed & (1U << i)) == 0U) {
+                continue;
+            }
+            client->busy = false;
+            if ((log_failed & (1U << i)) != 0U || client->closing) {
+                log_stream_close_locked(client);
+                ESP_LOGI(TAG, "log stream client closed");
+            }
+        }
+        for (size_t i = 0; i < MACRO_WEB_SERVICE_STATE_STREAM_MAX_CLIENTS; ++i) {
+            web_service_state_stream_t *client = &s_ws.state_streams[i];
+            if ((state_claimed & (1U << i)) == 0U) {
+                continue;
+            }
+            client->busy = false;
+            if ((state_failed & (1U << i)) != 0U || client->closing) {
+                state_stream_close_locked(client);
+                ESP_LOGI(TAG, "state stream client closed");
+            }
+        }
+        (void)xSemaphoreGive(s_ws.stream_lock);
+    }
+}
+
+// Runs in the log drain task; wakes the stream task only while someone is listening.
+static void log_stream_on_commit(void)
+{
+    if (s_ws.stream_task != NULL && s_ws.log_stream_clients > 0U) {
+        (void)xTaskNotifyGive(s_ws.stream_task);
+    }
+}
+
+static void state_stream_notify(void)
+{
+    if (s_ws.stream_task != NULL && s_ws.state_stream_clients > 0U) {
+        (void)xTaskNotifyGive(s_ws.stream_task);
+    }
+}
+
+// Completes every stream request. Clients that stream_task is sending to are flagged and closed
+// by it when the send returns; this waits for that, since httpd_stop() must not race a send.
+static void stream_close_all(void)
+{
+    if (s_ws.stream_lock == NULL) {
+        return;
+    }
+    while (true) {
+        uint32_t busy = 0U;
+        (void)xSemaphoreTake(s_ws.stream_lock, portMAX_DELAY);
+        for (size_t i = 0; i < MACRO_WEB_SERVICE_LOG_STREAM_MAX_CLIENTS; ++i) {
+            web_service_log_stream_t *client = &s_ws.log_streams[i];
+            if (client->req != NULL && client->busy) {
+                client->closing = true;
+                ++busy;
+            } else if (client->req != NULL) {
+                log_stream_close_locked(client);
+            }
+        }
+        for (size_t i = 0; i < MACRO_WEB_SERVICE_STATE_STREAM_MAX_CLIENTS; ++i) {
+            web_service_state_stream_t *client = &s_ws.state_streams[i];
+            if (client->req != NULL && client->busy) {
+                client->closing = true;
+                ++busy;
+            } else if (client->req != NULL) {
+                state_stream_close_locked(client);
+            }
+        }
+        (void)xSemaphoreGive(s_ws.stream_lock);
+        if (busy == 0U) {
+            return;
+        }
+        vTaskDelay(pdMS_TO_TICKS(WEB_SERVICE_STREAM_CLOSE_POLL_MS));
+    }
 }
 
-static bool web_auth_api_key_match(httpd_req_t *req)
+// Takes the connection over from the HTTP worker and sets the SSE headers. Nothing is sent here:
+// the headers go out with stream_task's first chunk, so this is safe under stream_lock.
+static esp_err_t sse_begin(httpd_req_t *req, httpd_req_t **out_req)
 {
-    char header_value[WEB_SERVICE_HEADER_MAX] = {0};
-    if (!http_get_header_copy(req, "X-API-Key", header_value, sizeof(header_value))) {
-        return false;
+    httpd_req_t *async_req = NULL;
+    if (httpd_req_async_handler_begin(req, &async_req) != ESP_OK) {
+        return ESP_FAIL;
     }
-    return strcmp(header_value, s_ws.api_key) == 0;
+    httpd_resp_set_status(async_req, "200 OK");
+    httpd_resp_set_type(async_req, "text/event-stream");
+    httpd_resp_set_hdr(async_req, "Cache-Control", "no-store");
+    if (MACRO_WEB_SERVICE_CORS_ENABLED) {
+        httpd_resp_set_hdr(async_req, "Access-Control-Allow-Origin", "*");
+        httpd_resp_set_hdr(async_req, "Access-Control-Allow-Headers", "Content-Type,Authorization,X-API-Key,If-None-Match");
+        httpd_resp_set_hdr(async_req, "Access-Control-Allow-Methods", "GET,POST,OPTIONS");
+    }
+    *out_req = async_req;
+    return ESP_OK;
 }
 
-static bool web_auth_basic_match(httpd_req_t *req)
+static esp_err_t logs_stream_get_handler(httpd_req_t *req)
 {
-    char auth_header[WEB_SERVICE_HEADER_MAX] = {0};
-    if (!http_get_header_copy(req, "Authorization", auth_header, sizeof(auth_header))) {
-        return false;
+    esp_err_t auth = web_auth_guard(req);
+    if (auth != ESP_OK) {
+        return auth;
     }
-    return strcmp(auth_header, s_ws.basic_auth_expected) == 0;
-}
 
-static esp_err_t web_auth_guard(httpd_req_t *req)
-{
-    bool api_key_enabled = false;
-    bool basic_enabled = false;
-    web_service_lock();
-    api_key_enabled = s_ws.auth_api_key_enabled;
-    basic_enabled = s_ws.auth_basic_enabled;
-    web_service_unlock();
+    log_store_filter_t filter;
+    if (!logs_filter_from_query(req, &filter)) {
+        return http_send_json(req, "400 Bad Request", "{\"ok\":false,\"error\":\"invalid level\"}");
+    }
+    if (s_ws.stream_task == NULL) {
+        return http_send_json(req, "503 Service Unavailable", "{\"ok\":false,\"error\":\"stream_unavailable\"}");
+    }
 
-    if (!api_key_enabled && !basic_enabled) {
-        return ESP_OK;
+    // Without since_id the stream starts with the next new line; EventSource resends Last-Event-ID on reconnect.
+    log_store_stats_t log_stats = {0};
+    log_store_get_stats(&log_stats);
+    uint32_t since_id = log_stats.last_id;
+    char last_event_id[16] = {0};
+    if (!query_u32_value(req, "since_id", &since_id) &&
+        httpd_req_get_hdr_value_str(req, "Last-Event-ID", last_event_id, sizeof(last_event_id)) == ESP_OK) {
+        since_id = (uint32_t)strtoul(last_event_id, NULL, 10);
     }
+    since_id = logs_clamp_since_id(since_id, log_stats.last_id);
 
-    bool authorized = false;
-    if (api_key_enabled && web_auth_api_key_match(req)) {
-        authorized = true;
+    if (xSemaphoreTake(s_ws.stream_lock, pdMS_TO_TICKS(WEB_SERVICE_STREAM_LOCK_MS)) != pdTRUE) {
+        return http_send_json(req, "503 Service Unavailable", "{\"ok\":false,\"error\":\"stream_busy\"}");
     }
-    if (basic_enabled && web_auth_basic_match(req)) {
-        authorized = true;
+    web_service_log_stream_t *client = NULL;
+    for (size_t i = 0; i < MACRO_WEB_SERVICE_LOG_STREAM_MAX_CLIENTS && client == NULL; ++i) {
+        if (s_ws.log_streams[i].req == NULL) {
+            client = &s_ws.log_streams[i];
+        }
     }
-    if (authorized) {
-        return ESP_OK;
+    if (client == NULL) {
+        (void)xSemaphoreGive(s_ws.stream_lock);
+        return http_send_json(req, "503 Service Unavailable", "{\"ok\":false,\"error\":\"stream_busy\"}");
     }
 
-    if (basic_enabled) {
-        httpd_resp_set_hdr(req, "WWW-Authenticate", "Basic realm=\"ESP32 MacroPad\"");
+    // The connection is handed to stream_task; this worker returns right away.
+    httpd_req_t *async_req = NULL;
+    if (sse_begin(req, &async_req) != ESP_OK) {
+        (void)xSemaphoreGive(s_ws.stream_lock);
+        return http_send_json(req, "500 Internal Server Error", "{\"ok\":false,\"error\":\"stream_failed\"}");
     }
-    return http_send_json(req, "401 Unauthorized", "{\"ok\":false,\"error\":\"unauthorized\"}");
-}
 
-static int build_ota_status_json(char *dst, size_t dst_size)
-{
-    ota_manager_status_t ota = {0};
-    char ota_url_json[256] = {0};
-    char ota_error_json[128] = {0};
-
-    if (dst == NULL || dst_size == 0U) {
-        return -1;
-    }
+    client->req = async_req;
+    client->busy = false;
+    client->closing = false;
+    client->started = false;
+    client->cursor = (log_store_cursor_t){.last_id = since_id};
+    client->filter = filter;
+    client->last_send_tick = xTaskGetTickCount();
+    s_ws.log_stream_clients++;
+    (void)xSemaphoreGive(s_ws.stream_lock);
+    (void)xTaskNotifyGive(s_ws.stream_task);
 
-    ota_manager_get_status(&ota);
-    json_escape_copy(ota_url_json, sizeof(ota_url_json), ota.current_url);
-    json_escape_copy(ota_error_json, sizeof(ota_error_json), ota.last_error);
-
-    return snprintf(dst,
-                    dst_size,
-                    "\"ota\":{\"enabled\":%s,\"state\":\"%s\",\"pending_verify\":%s,"
-                    "\"confirm_tap_count\":%u,\"self_check_duration_ms\":%" PRIu32 ","
-                    "\"self_check_elapsed_ms\":%" PRIu32 ",\"confirm_timeout_ms\":%" PRIu32 ","
-                    "\"confirm_remaining_ms\":%" PRIu32 ",\"self_check_free_heap\":%" PRIu32 ","
-                    "\"download_total_bytes\":%" PRIu32 ",\"download_read_bytes\":%" PRIu32 ","
-                    "\"download_elapsed_ms\":%" PRIu32 ",\"download_percent\":%u,"
-                    "\"current_url\":\"%s\",\"last_error\":\"%s\"}",
-                    ota.enabled ? "true" : "false",
-                    ota_manager_state_name(ota.state),
-                    ota.pending_verify ? "true" : "false",
-                    (unsigned)ota.confirm_tap_count,
-                    ota.self_check_duration_ms,
-                    ota.self_check_elapsed_ms,
-                    ota.confirm_timeout_ms,
-                    ota.confirm_remaining_ms,
-                    ota.self_check_free_heap_bytes,
-                    ota.download_total_bytes,
-                    ota.download_read_bytes,
-                    ota.download_elapsed_ms,
-                    (unsigned)ota.download_percent,
-                    ota_url_json,
-                    ota_error_json);
+    web_service_mark_user_activity();
+    return ESP_OK;
 }
 
-static esp_err_t health_get_handler(httpd_req_t *req)
+static esp_err_t state_stream_get_handler(httpd_req_t *req)
 {
     esp_err_t auth = web_auth_guard(req);
     if (auth != ESP_OK) {
         return auth;
     }
-
-    char json[WEB_SERVICE_JSON_BUF] = {0};
-    const uint32_t uptime_ms = (uint32_t)(pdTICKS_TO_MS(xTaskGetTickCount() - s_ws.boot_tick));
-    const bool wifi_connected = wifi_portal_is_connected();
-    const bool portal_active = wifi_portal_is_active();
-    const int n = snprintf(json,
-                           sizeof(json),
-                           "{\"ok\":true,\"service\":\"macropad-web\",\"uptime_ms\":%" PRIu32
-                           ",\"wifi_connected\":%s,\"portal_active\":%s,"
-                           "\"control_enabled\":%s,\"running\":%s}",
-                           uptime_ms,
-                           wifi_connected ? "true" : "false",
-                           portal_active ? "true" : "false",
-                           MACRO_WEB_SERVICE_CONTROL_ENABLED ? "true" : "false",
-                           s_ws.running ? "true" : "false");
-    if (n <= 0 || (size_t)n >= sizeof(json)) {
-        return http_send_json(req, "500 Internal Server Error", "{\"ok\":false,\"error\":\"encode\"}");
+    if (s_ws.stream_task == NULL) {
+        return http_send_json(req, "503 Service Unavailable", "{\"ok\":false,\"error\":\"stream_unavailable\"}");
     }
-    return http_send_json(req, "200 OK", json);
-}
-
-static esp_err_t options_handler(httpd_req_t *req)
-{
-    return http_send_options_ok(req);
-}
 
-static size_t logs_limit_from_query(httpd_req_t *req)
-{
-    if (req == NULL) {
-        return WEB_SERVICE_LOGS_DEFAULT_LIMIT;
+    if (xSemaphoreTake(s_ws.stream_lock, pdMS_TO_TICKS(WEB_SERVICE_STREAM_LOCK_MS)) != pdTRUE) {
+        return http_send_json(req, "503 Service Unavailable", "{\"ok\":false,\"error\":\"stream_busy\"}");
     }
-
-    char query[64] = {0};
-    const size_t query_len = httpd_req_get_url_query_len(req);
-    if (query_len == 0U || query_len >= sizeof(query)) {
-        return WEB_SERVICE_LOGS_DEFAULT_LIMIT;
+    web_service_state_stream_t *client = NULL;
+    for (size_t i = 0; i < MACRO_WEB_SERVICE_STATE_STREAM_MAX_CLIENTS && client == NULL; ++i) {
+        if (s_ws.state_streams[i].req == NULL) {
+            client = &s_ws.state_streams[i];
+        }
     }
-    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK) {
-        return WEB_SERVICE_LOGS_DEFAULT_LIMIT;
+    if (client == NULL) {
+        (void)xSemaphoreGive(s_ws.stream_lock);
+        return http_send_json(req, "503 Service Unavailable", "{\"ok\":false,\"error\":\"stream_busy\"}");
     }
 
-    char value[16] = {0};
-    if (httpd_query_key_value(query, "limit", value, sizeof(value)) != ESP_OK) {
-        return WEB_SERVICE_LOGS_DEFAULT_LIMIT;
+    httpd_req_t *async_req = NULL;
+    if (sse_begin(req, &async_req) != ESP_OK) {
+        (void)xSemaphoreGive(s_ws.stream_lock);
+        return http_send_json(req, "500 Internal Server Error", "{\"ok\":false,\"error\":\"stream_failed\"}");
     }
 
-    char *end = NULL;
-    long parsed = strtol(value, &end, 10);
-    if (end == value || *end != '\0' || parsed <= 0L) {
-        return WEB_SERVICE_LOGS_DEFAULT_LIMIT;
-    }
-    if (parsed > (long)WEB_SERVICE_LOGS_MAX_LIMIT) {
-        parsed = (long)WEB_SERVICE_LOGS_MAX_LIMIT;
+    // Every connection starts with a full snapshot; reconnects need no Last-Event-ID handling.
+    client->req = async_req;
+    client->busy = false;
+    client->closing = false;
+    client->snapshot_sent = false;
+    client->last_send_tick = xTaskGetTickCount();
+    s_ws.state_stream_clients++;
+    (void)xSemaphoreGive(s_ws.stream_lock);
+    (void)xTaskNotifyGive(s_ws.stream_task);
+
+    web_service_mark_user_activity();
+    return ESP_OK;
+}
+
+static bool archive_stream_line(uint32_t seq, const char *line, size_t len, void *ctx)
+{
+    chunk_stream_t *stream = (chunk_stream_t *)ctx;
+    if (chunk_stream_full(stream)) {
+        return false;
     }
-    return (size_t)parsed;
+    char prefix[16];
+    const int n = snprintf(prefix, sizeof(prefix), "%" PRIu32 " ", seq);
+    stream->count++;
+    return n > 0 && chunk_stream_write(stream, prefix, (size_t)n) && chunk_stream_write(stream, line, len) &&
+           chunk_stream_write(stream, "\n", 1U);
 }
 
-static esp_err_t logs_get_handler(httpd_req_t *req)
+static esp_err_t logs_archive_get_handler(httpd_req_t *req)
 {
     esp_err_t auth = web_auth_guard(req);
     if (auth != ESP_OK) {
         return auth;
     }
 
-    const size_t limit = logs_limit_from_query(req);
-    log_store_entry_t *entries = calloc(limit, sizeof(log_store_entry_t));
-    if (entries == NULL) {
+    log_archive_stats_t stats = {0};
+    log_archive_get_stats(&stats);
+    if (!stats.mounted) {
+        return http_send_json(req, "503 Service Unavailable", "{\"ok\":false,\"error\":\"archive_unavailable\"}");
+    }
+
+    chunk_stream_t *stream = calloc(1, sizeof(*stream));
+    if (stream == NULL) {
         return http_send_json(req, "500 Internal Server Error", "{\"ok\":false,\"error\":\"oom\"}");
     }
-    const size_t count = log_store_copy_recent(entries, limit, limit);
-    const bool time_synced = log_store_is_time_synced();
+    stream->req = req;
+    stream->limit = query_u32(req, "limit", 0U);
+    const uint32_t since_seq = query_u32(req, "since_seq", 0U);
+    const uint32_t since_time = query_u32(req, "since_time", 0U);
+
+    // Push lines still only in RAM to flash so the download reaches the present.
+    log_archive_flush();
 
     httpd_resp_set_status(req, "200 OK");
-    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_type(req, "text/plain");
     httpd_resp_set_hdr(req, "Cache-Control", "no-store");
     if (MACRO_WEB_SERVICE_CORS_ENABLED) {
         httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
-        httpd_resp_set_hdr(req, "Access-Control-Allow-Headers", "Content-Type,Authorization,X-API-Key");
+        httpd_resp_set_hdr(req, "Access-Control-Allow-Headers", "Content-Type,Authorization,X-API-Key,If-None-Match");
         httpd_resp_set_hdr(req, "Access-Control-Allow-Methods", "GET,POST,OPTIONS");
     }
 
-    char chunk[WEB_SERVICE_LOGS_CHUNK_BUF] = {0};
-    int n = snprintf(chunk,
-                     sizeof(chunk),
-                     "{\n\"ok\":true,\n\"count\":%u,\n\"time_synced\":%s,\n\"entries\":[\n",
-                     (unsigned)count,
-                     time_synced ? "true" : "false");
-    if (n <= 0 || (size_t)n >= sizeof(chunk) || httpd_resp_send_chunk(req, chunk, (ssize_t)strlen(chunk)) != ESP_OK) {
-        free(entries);
-        return ESP_FAIL;
-    }
-
-    for (size_t i = 0; i < count; ++i) {
-        char escaped[(sizeof(entries[i].line) * 2U) + 8U] = {0};
-        json_escape_copy(escaped, sizeof(escaped), entries[i].line);
-
-        n = snprintf(chunk,
-                     sizeof(chunk),
-                     "%s{\"id\":%" PRIu32 ",\"line\":\"%s\"}\n",
-                     (i == 0U) ? "" : ",\n",
-                     entries[i].id,
-                     escaped);
-        if (n <= 0 || (size_t)n >= sizeof(chunk) || httpd_resp_send_chunk(req, chunk, (ssize_t)strlen(chunk)) != ESP_OK) {
-            free(entries);
-            return ESP_FAIL;
-        }
-    }
-
-    free(entries);
-    if (httpd_resp_send_chunk(req, "]\n}\n", 4) != ESP_OK) {
-        return ESP_FAIL;
+    const esp_err_t err = log_archive_read(since_seq, since_time, archive_stream_line, stream);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Archive read: %s", esp_err_to_name(err));
     }
-    if (httpd_resp_send_chunk(req, NULL, 0) != ESP_OK) {
+    const bool ok = !stream->failed && chunk_stream_flush(stream);
+    free(stream);
+    if (!ok || httpd_resp_send_chunk(req, NULL, 0) != ESP_OK) {
         return ESP_FAIL;
     }
 
@@ -586,10 +1561,14 @@ static esp_err_t state_get_handler(httpd_req_t *req)
         return auth;
     }
 
-    char json[WEB_SERVICE_JSON_BUF] = {0};
-    char ota_json[512] = {0};
-    char key_name_json[96] = {0};
+    char etag[WEB_SERVICE_ETAG_MAX];
+    if (http_etag_matches(req, etag, sizeof(etag))) {
+        return http_send_not_modified(req, etag);
+    }
+
     hid_transport_status_t hid = {0};
+    ota_manager_status_t ota = {0};
+    net_breaker_info_t breakers[NET_BREAKER_MAX];
 
     web_service_lock();
     const uint8_t active_layer = s_ws.active_layer;
@@ -600,72 +1579,46 @@ static esp_err_t state_get_handler(httpd_req_t *req)
     const web_service_swipe_event_t swipe_event = s_ws.last_swipe;
     web_service_unlock();
     (void)hid_transport_get_status(&hid);
+    ota_manager_get_status(&ota);
+    const size_t breaker_count = net_breaker_snapshot(breakers, NET_BREAKER_MAX);
 
-    json_escape_copy(key_name_json, sizeof(key_name_json), key_event.name);
     const uint32_t idle_ms = (uint32_t)pdTICKS_TO_MS(now - activity_tick);
     const uint32_t key_age_ms = key_event.valid ? (uint32_t)pdTICKS_TO_MS(now - key_event.tick) : 0U;
     const uint32_t encoder_age_ms = encoder_event.valid ? (uint32_t)pdTICKS_TO_MS(now - encoder_event.tick) : 0U;
     const uint32_t swipe_age_ms = swipe_event.valid ? (uint32_t)pdTICKS_TO_MS(now - swipe_event.tick) : 0U;
-    const int ota_n = build_ota_status_json(ota_json, sizeof(ota_json));
-    if (ota_n <= 0 || (size_t)ota_n >= sizeof(ota_json)) {
-        return http_send_json(req, "500 Internal Server Error", "{\"ok\":false,\"error\":\"ota encode\"}");
-    }
-
-    const int n = snprintf(
-        json,
-        sizeof(json),
-        "{\"ok\":true,"
-        "\"layer_index\":%u,\"layer\":%u,"
-        "\"buzzer_enabled\":%s,"
-        "\"idle_ms\":%" PRIu32 ","
-        "\"last_key\":{\"valid\":%s,\"index\":%u,\"pressed\":%s,\"usage\":%u,\"name\":\"%s\",\"age_ms\":%" PRIu32 "},"
-        "\"last_encoder\":{\"valid\":%s,\"steps\":%" PRId32 ",\"usage\":%u,\"age_ms\":%" PRIu32 "},"
-        "\"last_swipe\":{\"valid\":%s,\"layer_index\":%u,\"left_to_right\":%s,\"usage\":%u,\"age_ms\":%" PRIu32 "},"
-        "\"keyboard_mode\":\"%s\","
-        "\"mode_switch_pending\":%s,"
-        "\"mode_switch_target\":\"%s\","
-        "\"usb_mounted\":%s,"
-        "\"usb_hid_ready\":%s,"
-        "\"ble_connected\":%s,"
-        "\"ble_bonded\":%s,"
-        "\"ble_pairing_active\":%s,"
-        "\"ble_pairing_remaining_ms\":%" PRIu32 ","
-        "\"ble_peer_addr\":\"%s\","
-        "%s}",
-        (unsigned)active_layer,
-        (unsigned)active_layer + 1U,
-        buzzer_is_enabled() ? "true" : "false",
-        idle_ms,
-        key_event.valid ? "true" : "false",
-        (unsigned)key_event.key_index,
-        key_event.pressed ? "true" : "false",
-        (unsigned)key_event.usage,
-        key_name_json,
-        key_age_ms,
-        encoder_event.valid ? "true" : "false",
-        encoder_event.steps,
-        (unsigned)encoder_event.usage,
-        encoder_age_ms,
-        swipe_event.valid ? "true" : "false",
-        (unsigned)swipe_event.layer_index,
-        swipe_event.left_to_right ? "true" : "false",
-        (unsigned)swipe_event.usage,
-        swipe_age_ms,
-        hid_mode_to_str(hid.mode),
-        hid.mode_switch_pending ? "true" : "false",
-        hid_mode_to_str(hid.mode_switch_target),
-        hid.usb_mounted ? "true" : "false",
-        hid.usb_hid_ready ? "true" : "false",
-        hid.ble_connected ? "true" : "false",
-        hid.ble_bonded ? "true" : "false",
-        hid.ble_pairing_window_active ? "true" : "false",
-        hid.ble_pairing_remaining_ms,
-        hid.ble_peer_addr,
-        ota_json);
-    if (n <= 0 || (size_t)n >= sizeof(json)) {
-        return http_send_json(req, "500 Internal Server Error", "{\"ok\":false,\"error\":\"encode\"}");
-    }
-    return http_send_json(req, "200 OK", json);
+
+    json_response_t resp;
+    json_writer_t *w = json_response_begin(&resp, req, "200 OK", etag);
+    json_writer_obj_begin(w);
+    json_writer_kv_bool(w, "ok", true);
+    json_writer_kv_u32(w, "layer_index", active_layer);
+    json_writer_kv_u32(w, "layer", (uint32_t)active_layer + 1U);
+    json_writer_kv_bool(w, "buzzer_enabled", buzzer_is_enabled());
+    json_writer_kv_u32(w, "idle_ms", idle_ms);
+
+    json_writer_key(w, "last_key");
+    json_writer_obj_begin(w);
+    write_key_fields(w, &key_event);
+    json_writer_kv_u32(w, "age_ms", key_age_ms);
+    json_writer_obj_end(w);
+
+    json_writer_key(w, "last_encoder");
+    json_writer_obj_begin(w);
+    write_encoder_fields(w, &encoder_event);
+    json_writer_kv_u32(w, "age_ms", encoder_age_ms);
+    json_writer_obj_end(w);
+
+    json_writer_key(w, "last_swipe");
+    json_writer_obj_begin(w);
+    write_swipe_fields(w, &swipe_event);
+    json_writer_kv_u32(w, "age_ms", swipe_age_ms);
+    json_writer_obj_end(w);
+
+    write_hid_fields(w, &hid);
+    write_ota_status(w, &ota);
+    write_breakers(w, breakers, breaker_count);
+    json_writer_obj_end(w);
+    return json_response_end(&resp, WEB_RENDER_STATE);
 }
 
 static esp_err_t ota_get_handler(httpd_req_t *req)
@@ -675,19 +1628,21 @@ static esp_err_t ota_get_handler(httpd_req_t *req)
         return auth;
     }
 
-    char ota_json[512] = {0};
-    char json[WEB_SERVICE_JSON_BUF] = {0};
-    const int ota_n = build_ota_status_json(ota_json, sizeof(ota_json));
-    if (ota_n <= 0 || (size_t)ota_n >= sizeof(ota_json)) {
-        return http_send_json(req, "500 Internal Server Error", "{\"ok\":false,\"error\":\"ota encode\"}");
+    char etag[WEB_SERVICE_ETAG_MAX];
+    if (http_etag_matches(req, etag, sizeof(etag))) {
+        return http_send_not_modified(req, etag);
     }
 
-    const int n = snprintf(json, sizeof(json), "{\"ok\":true,%s}", ota_json);
-    if (n <= 0 || (size_t)n >= sizeof(json)) {
-        return http_send_json(req, "500 Internal Server Error", "{\"ok\":false,\"error\":\"encode\"}");
-    }
+    ota_manager_status_t ota = {0};
+    ota_manager_get_status(&ota);
 
-    return http_send_json(req, "200 OK", json);
+    json_response_t resp;
+    json_writer_t *w = json_response_begin(&resp, req, "200 OK", etag);
+    json_writer_obj_begin(w);
+    json_writer_kv_bool(w, "ok", true);
+    write_ota_status(w, &ota);
+    json_writer_obj_end(w);
+    return json_response_end(&resp, WEB_RENDER_OTA);
 }
 
 static esp_err_t ensure_control_ready(httpd_req_t *req)
@@ -719,16 +1674,18 @@ static esp_err_t ota_post_handler(httpd_req_t *req)
         return guard;
     }
 
-    char body[WEB_SERVICE_BODY_MAX] = {0};
-    if (http_read_body(req, body, sizeof(body)) != ESP_OK) {
+    web_service_json_body_t in;
+    if (http_read_json_body(req, &in) != ESP_OK) {
         return http_send_json(req, "400 Bad Request",
                               "{\"ok\":false,\"error\":\"invalid body\"}");
     }
 
     char url[WEB_SERVICE_HEADER_MAX] = {0};
-    const bool has_url = parse_json_string(body, "url", url, sizeof(url));
-
-    const esp_err_t err = ota_manager_start_update(has_url ? url : NULL);
+    const int url_tok = json_reader_find(&in.doc, 0, "url");
+    esp_err_t err = ESP_ERR_INVALID_ARG;
+    if (url_tok < 0 || json_reader_string(&in.doc, url_tok, url, sizeof(url))) {
+        err = ota_manager_start_update((url_tok >= 0) ? url : NULL);
+    }
     if (err == ESP_ERR_INVALID_ARG) {
         return http_send_json(req, "400 Bad Request",
                               "{\"ok\":false,\"error\":\"missing or invalid ota url\"}");
@@ -741,6 +1698,10 @@ static esp_err_t ota_post_handler(httpd_req_t *req)
         return http_send_json(req, "409 Conflict",
                               "{\"ok\":false,\"error\":\"ota busy or pending verify\"}");
     }
+    if (err == ESP_ERR_NOT_ALLOWED) {
+        return http_send_json(req, "503 Service Unavailable",
+                              "{\"ok\":false,\"error\":\"ota server unreachable; see breakers.ota.retry_in_ms\"}");
+    }
     if (err != ESP_OK) {
         return http_send_json(req, "500 Internal Server Error",
                               "{\"ok\":false,\"error\":\"ota start failed\"}");
@@ -750,6 +1711,51 @@ static esp_err_t ota_post_handler(httpd_req_t *req)
     return http_send_json(req, "202 Accepted", "{\"ok\":true,\"status\":\"started\"}");
 }
 
+static esp_err_t logs_rate_limit_post_handler(httpd_req_t *req)
+{
+    esp_err_t auth = web_auth_guard(req);
+    if (auth != ESP_OK) {
+        return auth;
+    }
+
+    esp_err_t guard = ensure_control_ready(req);
+    if (guard != ESP_OK) {
+        return guard;
+    }
+
+    web_service_json_body_t in;
+    if (http_read_json_body(req, &in) != ESP_OK) {
+        return http_send_json(req, "400 Bad Request",
+                              "{\"ok\":false,\"error\":\"invalid body\"}");
+    }
+
+    char tag[sizeof(((log_store_rate_limit_t *)0)->tag)] = {0};
+    int per_sec = 0;
+    if (!json_reader_get_string(&in.doc, "tag", tag, sizeof(tag)) || !json_reader_get_int(&in.doc, "per_sec", &per_sec)) {
+        return http_send_json(req, "400 Bad Request",
+                              "{\"ok\":false,\"error\":\"missing tag or per_sec\"}");
+    }
+    int burst = per_sec;
+    (void)json_reader_get_int(&in.doc, "burst", &burst);
+    if (per_sec < 0 || burst < 0) {
+        return http_send_json(req, "400 Bad Request",
+                              "{\"ok\":false,\"error\":\"per_sec/burst out of range\"}");
+    }
+
+    const esp_err_t err = log_store_set_rate_limit(tag, (uint32_t)per_sec, (uint32_t)burst);
+    if (err == ESP_ERR_INVALID_ARG) {
+        return http_send_json(req, "400 Bad Request",
+                              "{\"ok\":false,\"error\":\"per_sec/burst out of range\"}");
+    }
+    if (err == ESP_ERR_NO_MEM) {
+        return http_send_json(req, "409 Conflict",
+                              "{\"ok\":false,\"error\":\"rate limit slots full\"}");
+    }
+
+    web_service_mark_user_activity();
+    return http_send_json(req, "200 OK", "{\"ok\":true}");
+}
+
 static esp_err_t control_layer_post_handler(httpd_req_t *req)
 {
     esp_err_t auth = web_auth_guard(req);
@@ -762,14 +1768,14 @@ static esp_err_t control_layer_post_handler(httpd_req_t *req)
         return guard;
     }
 
-    char body[WEB_SERVICE_BODY_MAX] = {0};
-    if (http_read_body(req, body, sizeof(body)) != ESP_OK) {
+    web_service_json_body_t in;
+    if (http_read_json_body(req, &in) != ESP_OK) {
         return http_send_json(req, "400 Bad Request",
                               "{\"ok\":false,\"error\":\"invalid body\"}");
     }
 
     int layer_value = 0;
-    if (!parse_json_int(body, "layer", &layer_value)) {
+    if (!json_reader_get_int(&in.doc, "layer", &layer_value)) {
         return http_send_json(req, "400 Bad Request",
                               "{\"ok\":false,\"error\":\"missing layer\"}");
     }
@@ -810,14 +1816,14 @@ static esp_err_t control_buzzer_post_handler(httpd_req_t *req)
         return guard;
     }
 
-    char body[WEB_SERVICE_BODY_MAX] = {0};
-    if (http_read_body(req, body, sizeof(body)) != ESP_OK) {
+    web_service_json_body_t in;
+    if (http_read_json_body(req, &in) != ESP_OK) {
         return http_send_json(req, "400 Bad Request",
                               "{\"ok\":false,\"error\":\"invalid body\"}");
     }
 
     bool enabled = false;
-    if (!parse_json_bool(body, "enabled", &enabled)) {
+    if (!json_reader_get_bool(&in.doc, "enabled", &enabled)) {
         return http_send_json(req, "400 Bad Request",
                               "{\"ok\":false,\"error\":\"missing enabled\"}");
     }
@@ -852,14 +1858,14 @@ static esp_err_t control_consumer_post_handler(httpd_req_t *req)
         return guard;
     }
 
-    char body[WEB_SERVICE_BODY_MAX] = {0};
-    if (http_read_body(req, body, sizeof(body)) != ESP_OK) {
+    web_service_json_body_t in;
+    if (http_read_json_body(req, &in) != ESP_OK) {
         return http_send_json(req, "400 Bad Request",
                               "{\"ok\":false,\"error\":\"invalid body\"}");
     }
 
     int usage_value = 0;
-    if (!parse_json_int(body, "usage", &usage_value)) {
+    if (!json_reader_get_int(&in.doc, "usage", &usage_value)) {
         return http_send_json(req, "400 Bad Request",
                               "{\"ok\":false,\"error\":\"missing usage\"}");
     }
@@ -917,6 +1923,261 @@ static esp_err_t keyboard_mode_get_handler(httpd_req_t *req)
     return http_send_json(req, "200 OK", json);
 }
 
+// Percentages with one decimal, kept integral up to the last step.
+static void write_permille_pct(json_writer_t *w, const char *key, uint16_t permille)
+{
+    char pct[8];
+    (void)snprintf(pct, sizeof(pct), "%u.%u", (unsigned)(permille / 10U), (unsigned)(permille % 10U));
+    json_writer_key(w, key);
+    json_writer_raw(w, pct);
+}
+
+static esp_err_t profile_get_handler(httpd_req_t *req)
+{
+    esp_err_t auth = web_auth_guard(req);
+    if (auth != ESP_OK) {
+        return auth;
+    }
+
+    profiler_report_t *rep = calloc(1, sizeof(*rep));
+    if (rep == NULL) {
+        return http_send_json(req, "500 Internal Server Error", "{\"ok\":false,\"error\":\"no_mem\"}");
+    }
+    const esp_err_t err = profiler_get_report(rep);
+    if (err != ESP_OK) {
+        free(rep);
+        return http_send_json(req, "503 Service Unavailable", "{\"ok\":false,\"error\":\"profiler_unavailable\"}");
+    }
+
+    if (query_u32(req, "download", 0U) != 0U) {
+        httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"macropad-profile.json\"");
+    }
+
+    json_response_t resp;
+    json_writer_t *w = json_response_begin(&resp, req, "200 OK", NULL);
+    json_writer_obj_begin(w);
+    json_writer_kv_bool(w, "ok", true);
+    json_writer_kv_bool(w, "runtime_stats", rep->runtime_stats);
+    json_writer_kv_u32(w, "window_ms", rep->window_ms);
+    json_writer_kv_u32(w, "samples", rep->samples);
+    json_writer_key(w, "cores");
+    json_writer_arr_begin(w);
+    for (size_t core = 0; core < 2U; ++core) {
+        json_writer_obj_begin(w);
+        json_writer_kv_u32(w, "core", (uint32_t)core);
+        write_permille_pct(w, "busy_pct", rep->core_busy_permille[core]);
+        json_writer_obj_end(w);
+    }
+    json_writer_arr_end(w);
+    json_writer_key(w, "tasks");
+    json_writer_arr_begin(w);
+    for (size_t i = 0; i < rep->task_count; ++i) {
+        const profiler_task_stat_t *t = &rep->tasks[i];
+        json_writer_obj_begin(w);
+        json_writer_kv_str(w, "name", t->name);
+        json_writer_kv_i32(w, "core", t->core);
+        json_writer_kv_u32(w, "priority", t->priority);
+        write_permille_pct(w, "cpu_pct", t->cpu_permille);
+        json_writer_kv_u32(w, "runtime_us", t->runtime_us);
+        json_writer_kv_u32(w, "stack_free_bytes", t->stack_free_bytes);
+        json_writer_obj_end(w);
+    }
+    json_writer_arr_end(w);
+    json_writer_key(w, "scopes");
+    json_writer_arr_begin(w);
+    for (size_t i = 0; i < rep->scope_count; ++i) {
+        const profiler_scope_stat_t *sc = &rep->scopes[i];
+        json_writer_obj_begin(w);
+        json_writer_kv_str(w, "name", profiler_scope_name(sc->id));
+        json_writer_kv_u32(w, "calls", sc->calls);
+        json_writer_kv_u32(w, "total_us", sc->total_us);
+        json_writer_kv_u32(w, "avg_us", sc->avg_us);
+        json_writer_kv_u32(w, "max_us", sc->max_us);
+        json_writer_obj_end(w);
+    }
+    json_writer_arr_end(w);
+    json_writer_obj_end(w);
+    free(rep);
+    return json_response_end(&resp, WEB_RENDER_PROFILE);
+}
+
+static esp_err_t trace_send_status(httpd_req_t *req)
+{
+    trace_buffer_status_t st;
+    trace_buffer_get_status(&st);
+    char json[192];
+    (void)snprintf(json, sizeof(json),
+                   "{\"ok\":true,\"armed\":%s,\"records\":%" PRIu32 ",\"capacity\":%" PRIu32
+                   ",\"overwritten\":%" PRIu32 ",\"elapsed_ms\":%" PRIu32 "}",
+                   st.armed ? "true" : "false", st.records, st.capacity, st.overwritten, st.elapsed_ms);
+    return http_send_json(req, "200 OK", json);
+}
+
+static esp_err_t trace_post_handler(httpd_req_t *req)
+{
+    esp_err_t auth = web_auth_guard(req);
+    if (auth != ESP_OK) {
+        return auth;
+    }
+
+    esp_err_t guard = ensure_control_ready(req);
+    if (guard != ESP_OK) {
+        return guard;
+    }
+
+    web_service_json_body_t in;
+    if (http_read_json_body(req, &in) != ESP_OK) {
+        return http_send_json(req, "400 Bad Request",
+                              "{\"ok\":false,\"error\":\"invalid body\"}");
+    }
+
+    bool armed = false;
+    if (!json_reader_get_bool(&in.doc, "armed", &armed)) {
+        return http_send_json(req, "400 Bad Request",
+                              "{\"ok\":false,\"error\":\"missing armed\"}");
+    }
+
+    if (!armed) {
+        trace_buffer_disarm();
+        return trace_send_status(req);
+    }
+
+    const esp_err_t err = trace_buffer_arm();
+    if (err == ESP_ERR_NOT_SUPPORTED) {
+        return http_send_json(req, "503 Service Unavailable", "{\"ok\":false,\"error\":\"trace_unavailable\"}");
+    }
+    if (err != ESP_OK) {
+        return http_send_json(req, "500 Internal Server Error", "{\"ok\":false,\"error\":\"no_mem\"}");
+    }
+    return trace_send_status(req);
+}
+
+// Stops the capture and streams it as Chrome Trace Event JSON for ui.perfetto.dev / chrome://tracing.
+static esp_err_t trace_get_handler(httpd_req_t *req)
+{
+    esp_err_t auth = web_auth_guard(req);
+    if (auth != ESP_OK) {
+        return auth;
+    }
+
+    trace_buffer_status_t st;
+    trace_buffer_get_status(&st);
+    if (!MACRO_TRACE_ENABLED) {
+        return http_send_json(req, "503 Service Unavailable", "{\"ok\":false,\"error\":\"trace_unavailable\"}");
+    }
+    if (!st.allocated) {
+        return http_send_json(req, "409 Conflict", "{\"ok\":false,\"error\":\"trace_not_armed\"}");
+    }
+
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"macropad-trace.json\"");
+    json_response_t resp;
+    json_writer_t *w = json_response_begin(&resp, req, "200 OK", NULL);
+    (void)trace_buffer_write_chrome_json(w);
+    return json_response_end(&resp, WEB_RENDER_TRACE);
+}
+
+static void write_bench_report(json_writer_t *w, const bench_report_t *report)
+{
+    json_writer_obj_begin(w);
+    json_writer_kv_str(w, "app_version", report->app_version);
+    json_writer_kv_str(w, "elf_sha256", report->elf_sha);
+    json_writer_kv_u32(w, "cpu_mhz", report->cpu_mhz);
+    json_writer_kv_u32(w, "overhead_cycles", report->overhead_cycles);
+    json_writer_kv_u32(w, "unix_time", report->unix_time);
+    json_writer_key(w, "results");
+    json_writer_arr_begin(w);
+    for (uint8_t i = 0; i < report->count; ++i) {
+        const bench_result_t *r = &report->results[i];
+        json_writer_obj_begin(w);
+        json_writer_kv_str(w, "name", r->name);
+        json_writer_kv_bool(w, "quiesced", r->quiesced);
+        json_writer_kv_u32(w, "samples", r->samples);
+        json_writer_kv_u32(w, "min_cycles", r->min_cycles);
+        json_writer_kv_u32(w, "median_cycles", r->median_cycles);
+        json_writer_kv_u32(w, "p99_cycles", r->p99_cycles);
+        json_writer_kv_u32(w, "median_ns",
+                           (report->cpu_mhz != 0U) ? (uint32_t)(((uint64_t)r->median_cycles * 1000U) / report->cpu_mhz)
+                                                   : 0U);
+        json_writer_obj_end(w);
+    }
+    json_writer_arr_end(w);
+    json_writer_obj_end(w);
+}
+
+static esp_err_t bench_get_handler(httpd_req_t *req)
+{
+    esp_err_t auth = web_auth_guard(req);
+    if (auth != ESP_OK) {
+        return auth;
+    }
+    if (!MACRO_BENCH_ENABLED) {
+        return http_send_json(req, "503 Service Unavailable", "{\"ok\":false,\"error\":\"bench_unavailable\"}");
+    }
+
+    // last and previous, consecutive runs: run once on each firmware to compare an OTA update.
+    bench_report_t *last = calloc(2, sizeof(*last));
+    if (last == NULL) {
+        return http_send_json(req, "500 Internal Server Error", "{\"ok\":false,\"error\":\"no_mem\"}");
+    }
+    // Flag first, so running=false always comes with the report of the run that just finished.
+    const bool running = bench_is_running();
+    const bool have_last = bench_load_last(last) == ESP_OK;
+    bench_report_t *previous = &last[1];
+    const bool have_previous = have_last && bench_load_previous(previous) == ESP_OK;
+    if (!have_last && !running) {
+        free(last);
+        return http_send_json(req, "404 Not Found", "{\"ok\":false,\"error\":\"no_bench_result\"}");
+    }
+
+    json_response_t resp;
+    json_writer_t *w = json_response_begin(&resp, req, "200 OK", NULL);
+    json_writer_obj_begin(w);
+    json_writer_kv_bool(w, "ok", true);
+    json_writer_kv_bool(w, "running", running);
+    json_writer_key(w, "last");
+    if (have_last) {
+        write_bench_report(w, last);
+    } else {
+        json_writer_null(w);
+    }
+    json_writer_key(w, "previous");
+    if (have_previous) {
+        write_bench_report(w, previous);
+    } else {
+        json_writer_null(w);
+    }
+    json_writer_obj_end(w);
+    free(last);
+    return json_response_end(&resp, WEB_RENDER_BENCH);
+}
+
+// Queues a run on the bench task; the report replaces bench/last when it is done and is read back
+// with GET (running turns false).
+static esp_err_t bench_post_handler(httpd_req_t *req)
+{
+    esp_err_t auth = web_auth_guard(req);
+    if (auth != ESP_OK) {
+        return auth;
+    }
+
+    esp_err_t guard = ensure_control_ready(req);
+    if (guard != ESP_OK) {
+        return guard;
+    }
+
+    const esp_err_t err = bench_start_background_run();
+    if (err == ESP_ERR_NOT_SUPPORTED) {
+        return http_send_json(req, "503 Service Unavailable", "{\"ok\":false,\"error\":\"bench_unavailable\"}");
+    }
+    if (err == ESP_ERR_INVALID_STATE) {
+        return http_send_json(req, "409 Conflict", "{\"ok\":false,\"error\":\"bench_busy\"}");
+    }
+    if (err != ESP_OK) {
+        return http_send_json(req, "500 Internal Server Error", "{\"ok\":false,\"error\":\"bench_failed\"}");
+    }
+    return http_send_json(req, "202 Accepted", "{\"ok\":true,\"running\":true}");
+}
+
 static esp_err_t keyboard_mode_post_handler(httpd_req_t *req)
 {
     esp_err_t auth = web_auth_guard(req);
@@ -929,14 +2190,14 @@ static esp_err_t keyboard_mode_post_handler(httpd_req_t *req)
         return guard;
     }
 
-    char body[WEB_SERVICE_BODY_MAX] = {0};
-    if (http_read_body(req, body, sizeof(body)) != ESP_OK) {
+    web_service_json_body_t in;
+    if (http_read_json_body(req, &in) != ESP_OK) {
         return http_send_json(req, "400 Bad Request",
                               "{\"ok\":false,\"error\":\"invalid body\"}");
     }
 
     char mode_str[16] = {0};
-    if (!parse_json_string(body, "mode", mode_str, sizeof(mode_str))) {
+    if (!json_reader_get_string(&in.doc, "mode", mode_str, sizeof(mode_str))) {
         return http_send_json(req, "400 Bad Request",
                               "{\"ok\":false,\"error\":\"missing mode\"}");
     }
@@ -986,23 +2247,20 @@ static esp_err_t ble_pair_post_handler(httpd_req_t *req)
         return guard;
     }
 
-    char body[WEB_SERVICE_BODY_MAX] = {0};
-    const esp_err_t body_err = http_read_body(req, body, sizeof(body));
-    if (body_err != ESP_OK) {
+    web_service_json_body_t in;
+    if (http_read_json_body(req, &in) != ESP_OK) {
         return http_send_json(req, "400 Bad Request",
                               "{\"ok\":false,\"error\":\"invalid body\"}");
     }
 
     int timeout_sec = MACRO_BLUETOOTH_PAIRING_WINDOW_SEC;
-    if (body[0] != '\0') {
-        int parsed = 0;
-        if (parse_json_int(body, "timeout_sec", &parsed)) {
-            if (parsed < 0 || parsed > 3600) {
-                return http_send_json(req, "400 Bad Request",
-                                      "{\"ok\":false,\"error\":\"timeout out of range\"}");
-            }
-            timeout_sec = parsed;
+    int parsed = 0;
+    if (json_reader_get_int(&in.doc, "timeout_sec", &parsed)) {
+        if (parsed < 0 || parsed > 3600) {
+            return http_send_json(req, "400 Bad Request",
+                                  "{\"ok\":false,\"error\":\"timeout out of range\"}");
         }
+        timeout_sec = parsed;
     }
 
     web_service_lock();
@@ -1065,25 +2323,42 @@ static esp_err_t register_routes(httpd_handle_t server)
 {
     const httpd_uri_t routes[WEB_SERVICE_ROUTE_COUNT] = {
         {.uri = "/api/v1/health", .method = HTTP_GET, .handler = health_get_handler, .user_ctx = NULL},
+        {.uri = "/metrics", .method = HTTP_GET, .handler = metrics_get_handler, .user_ctx = NULL},
         {.uri = "/api/v1/state", .method = HTTP_GET, .handler = state_get_handler, .user_ctx = NULL},
+        {.uri = "/api/v1/state/stream", .method = HTTP_GET, .handler = state_stream_get_handler, .user_ctx = NULL},
         {.uri = "/api/v1/control/layer", .method = HTTP_POST, .handler = control_layer_post_handler, .user_ctx = NULL},
         {.uri = "/api/v1/control/buzzer", .method = HTTP_POST, .handler = control_buzzer_post_handler, .user_ctx = NULL},
         {.uri = "/api/v1/control/consumer", .method = HTTP_POST, .handler = control_consumer_post_handler, .user_ctx = NULL},
         {.uri = "/api/v1/system/ota", .method = HTTP_GET, .handler = ota_get_handler, .user_ctx = NULL},
         {.uri = "/api/v1/system/ota", .method = HTTP_POST, .handler = ota_post_handler, .user_ctx = NULL},
         {.uri = "/api/v1/system/logs", .method = HTTP_GET, .handler = logs_get_handler, .user_ctx = NULL},
+        {.uri = "/api/v1/system/logs/stream", .method = HTTP_GET, .handler = logs_stream_get_handler, .user_ctx = NULL},
+        {.uri = "/api/v1/system/logs/archive", .method = HTTP_GET, .handler = logs_archive_get_handler, .user_ctx = NULL},
+        {.uri = "/api/v1/system/logs/rate_limit", .method = HTTP_POST, .handler = logs_rate_limit_post_handler, .user_ctx = NULL},
         {.uri = "/api/v1/system/keyboard_mode", .method = HTTP_GET, .handler = keyboard_mode_get_handler, .user_ctx = NULL},
+        {.uri = "/api/v1/system/profile", .method = HTTP_GET, .handler = profile_get_handler, .user_ctx = NULL},
+        {.uri = "/api/v1/system/trace", .method = HTTP_GET, .handler = trace_get_handler, .user_ctx = NULL},
+        {.uri = "/api/v1/system/trace", .method = HTTP_POST, .handler = trace_post_handler, .user_ctx = NULL},
+        {.uri = "/api/v1/system/bench", .method = HTTP_GET, .handler = bench_get_handler, .user_ctx = NULL},
+        {.uri = "/api/v1/system/bench", .method = HTTP_POST, .handler = bench_post_handler, .user_ctx = NULL},
         {.uri = "/api/v1/system/keyboard_mode", .method = HTTP_POST, .handler = keyboard_mode_post_handler, .user_ctx = NULL},
         {.uri = "/api/v1/system/ble/pair", .method = HTTP_POST, .handler = ble_pair_post_handler, .user_ctx = NULL},
         {.uri = "/api/v1/system/ble/clear_bond", .method = HTTP_POST, .handler = ble_clear_bond_post_handler, .user_ctx = NULL},
         {.uri = "/api/v1/health", .method = HTTP_OPTIONS, .handler = options_handler, .user_ctx = NULL},
         {.uri = "/api/v1/state", .method = HTTP_OPTIONS, .handler = options_handler, .user_ctx = NULL},
+        {.uri = "/api/v1/state/stream", .method = HTTP_OPTIONS, .handler = options_handler, .user_ctx = NULL},
         {.uri = "/api/v1/control/layer", .method = HTTP_OPTIONS, .handler = options_handler, .user_ctx = NULL},
         {.uri = "/api/v1/control/buzzer", .method = HTTP_OPTIONS, .handler = options_handler, .user_ctx = NULL},
         {.uri = "/api/v1/control/consumer", .method = HTTP_OPTIONS, .handler = options_handler, .user_ctx = NULL},
         {.uri = "/api/v1/system/ota", .method = HTTP_OPTIONS, .handler = options_handler, .user_ctx = NULL},
         {.uri = "/api/v1/system/logs", .method = HTTP_OPTIONS, .handler = options_handler, .user_ctx = NULL},
+        {.uri = "/api/v1/system/logs/stream", .method = HTTP_OPTIONS, .handler = options_handler, .user_ctx = NULL},
+        {.uri = "/api/v1/system/logs/archive", .method = HTTP_OPTIONS, .handler = options_handler, .user_ctx = NULL},
+        {.uri = "/api/v1/system/logs/rate_limit", .method = HTTP_OPTIONS, .handler = options_handler, .user_ctx = NULL},
         {.uri = "/api/v1/system/keyboard_mode", .method = HTTP_OPTIONS, .handler = options_handler, .user_ctx = NULL},
+        {.uri = "/api/v1/system/profile", .method = HTTP_OPTIONS, .handler = options_handler, .user_ctx = NULL},
+        {.uri = "/api/v1/system/trace", .method = HTTP_OPTIONS, .handler = options_handler, .user_ctx = NULL},
+        {.uri = "/api/v1/system/bench", .method = HTTP_OPTIONS, .handler = options_handler, .user_ctx = NULL},
         {.uri = "/api/v1/system/ble/pair", .method = HTTP_OPTIONS, .handler = options_handler, .user_ctx = NULL},
         {.uri = "/api/v1/system/ble/clear_bond", .method = HTTP_OPTIONS, .handler = options_handler, .user_ctx = NULL},
     };
@@ -1161,6 +2436,8 @@ static esp_err_t web_service_stop_internal(void)
     s_ws.running = false;
     web_service_unlock();
 
+    // Async stream requests must be completed before the server goes away.
+    stream_close_all();
     if (server != NULL) {
         ESP_RETURN_ON_ERROR(httpd_stop(server), TAG, "httpd_stop failed");
     }
@@ -1235,11 +2512,28 @@ esp_err_t web_service_init(void)
     }
 
     s_ws.boot_tick = xTaskGetTickCount();
+    s_ws.etag_epoch = esp_random();
     s_ws.last_activity_tick = s_ws.boot_tick;
     s_ws.next_start_retry_tick = s_ws.boot_tick;
     s_ws.initialized = true;
     s_ws.active_layer = 0U;
     web_service_init_auth_config();
+    (void)bench_register(&s_bench_state_encode);
+
+    if (MACRO_WEB_SERVICE_ENABLED) {
+        s_ws.stream_lock = xSemaphoreCreateMutex();
+        if (s_ws.stream_lock == NULL ||
+            xTaskCreate(stream_task,
+                        "web_stream",
+                        WEB_SERVICE_STREAM_TASK_STACK,
+                        NULL,
+                        WEB_SERVICE_STREAM_TASK_PRIO,
+                        &s_ws.stream_task) != pdPASS) {
+            ESP_LOGW(TAG, "event streams unavailable");
+        } else {
+            log_store_set_commit_callback(log_stream_on_commit);
+        }
+    }
 
     ESP_LOGI(TAG,
              "ready enabled=%d port=%u control=%d api_key=%d basic=%d",
@@ -1274,7 +2568,9 @@ void web_service_poll(void)
     }
 
     const TickType_t now = xTaskGetTickCount();
-    const bool should_run = wifi_portal_is_connected() && !wifi_portal_is_active();
+    const bool wifi_connected = wifi_portal_is_connected();
+    const bool portal_active = wifi_portal_is_active();
+    const bool should_run = wifi_connected && !portal_active;
 
     if (should_run && !s_ws.prev_should_run) {
         s_ws.network_ready_tick = now;
@@ -1322,8 +2618,12 @@ void web_service_set_active_layer(uint8_t layer_index)
         return;
     }
     web_service_lock();
-    s_ws.active_layer = layer_index;
+    if (s_ws.active_layer != layer_index) {
+        s_ws.active_layer = layer_index;
+        s_ws.state_version++;
+    }
     web_service_unlock();
+    state_stream_notify();
 }
 
 void web_service_record_key_event(uint8_t key_index, bool pressed, uint16_t usage, const char *key_name)
@@ -1343,7 +2643,9 @@ void web_service_record_key_event(uint8_t key_index, bool pressed, uint16_t usag
     } else {
         s_ws.last_key.name[0] = '\0';
     }
+    s_ws.state_version++;
     web_service_unlock();
+    state_stream_notify();
 }
 
 void web_service_record_encoder_step(int32_t steps, uint16_t usage)
@@ -1356,7 +2658,9 @@ void web_service_record_encoder_step(int32_t steps, uint16_t usage)
     s_ws.last_encoder.steps = steps;
     s_ws.last_encoder.usage = usage;
     s_ws.last_encoder.tick = xTaskGetTickCount();
+    s_ws.state_version++;
     web_service_unlock();
+    state_stream_notify();
 }
 
 void web_service_record_touch_swipe(uint8_t layer_index, bool left_to_right, uint16_t usage)
@@ -1370,5 +2674,7 @@ void web_service_record_touch_swipe(uint8_t layer_index, bool left_to_right, uin
     s_ws.last_swipe.left_to_right = left_to_right;
     s_ws.last_swipe.usage = usage;
     s_ws.last_swipe.tick = xTaskGetTickCount();
+    s_ws.state_version++;
     web_service_unlock();
+    state_stream_notify();
 }
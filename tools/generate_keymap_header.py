@@ -31,11 +31,148 @@ def as_int(value: Any, field: str) -> int:
     return value
 
 
+def scale_u8(value: int, scale: int) -> int:
+    # Mirrors the firmware's uint16 integer math: value * scale / 255, truncated.
+    return (value * scale) // 255
+
+
+def as_rgb(value: Any, field: str) -> tuple[int, int, int]:
+    if not isinstance(value, dict):
+        raise ValueError(f"{field} must be a mapping with r/g/b")
+    rgb = tuple(as_int(value.get(ch), f"{field}.{ch}") for ch in ("r", "g", "b"))
+    for ch in rgb:
+        if ch < 0 or ch > 255:
+            raise ValueError(f"{field} channels must be 0..255")
+    return rgb  # type: ignore[return-value]
+
+
+def c_rgb(rgb: tuple[int, int, int]) -> str:
+    return f"{{{rgb[0]}, {rgb[1]}, {rgb[2]}}}"
+
+
+RTTTL_BASE_OCT4 = (262, 277, 294, 311, 330, 349, 370, 392, 415, 440, 466, 494)
+RTTTL_SEMITONE = {"c": 0, "d": 2, "e": 4, "f": 5, "g": 7, "a": 9, "b": 11}
+
+# Buzzer melody slots, in buzzer_melody_id_t order (main/buzzer.h).
+BUZZER_MELODY_SLOTS = (
+    ("startup", "buzzer.startup.rtttl"),
+    ("keypress", "buzzer.keypress.rtttl"),
+    ("layer1", "buzzer.layer_switch.layer1_rtttl"),
+    ("layer2", "buzzer.layer_switch.layer2_rtttl"),
+    ("layer3", "buzzer.layer_switch.layer3_rtttl"),
+    ("encoder_cw", "buzzer.encoder_step.cw_rtttl"),
+    ("encoder_ccw", "buzzer.encoder_step.ccw_rtttl"),
+    ("toggle_on", "buzzer.encoder_toggle.on_rtttl"),
+    ("toggle_off", "buzzer.encoder_toggle.off_rtttl"),
+)
+
+
+def _rtttl_u16(text: str, pos: int) -> tuple[int | None, int]:
+    start = pos
+    value = 0
+    while pos < len(text) and text[pos].isdigit():
+        value = min(value * 10 + int(text[pos]), 65535)
+        pos += 1
+    return (value if pos > start else None), pos
+
+
+def compile_rtttl(rtttl: str, note_gap_ms: int, field: str) -> list[tuple[int, int, int]]:
+    # Mirrors rtttl_parse_header()/rtttl_parse_next_tone()/queue_rtttl_tone() in main/buzzer.c.
+    parts = rtttl.split(":", 2)
+    if len(parts) != 3:
+        raise ValueError(f"{field}: RTTTL needs 'name:settings:notes'")
+    duration, octave, bpm = 4, 6, 140
+    for item in parts[1].split(","):
+        item = item.strip()
+        if not item or "=" not in item:
+            continue
+        key, raw = (x.strip() for x in item.split("=", 1))
+        # Exactly one letter before '=', like the C parser; "dur=4" is skipped, not read as d=4.
+        if len(key) != 1 or not ("a" <= key.lower() <= "z"):
+            continue
+        value, _ = _rtttl_u16(raw, 0)
+        if value is None:
+            raise ValueError(f"{field}: bad RTTTL setting '{item}'")
+        key = key.lower()
+        if key == "d" and value > 0:
+            duration = value
+        elif key == "o" and value <= 9:
+            octave = value
+        elif key == "b" and value > 0:
+            bpm = value
+
+    tones: list[tuple[int, int, int]] = []
+    for token in parts[2].split(","):
+        token = token.strip()
+        if not token:
+            continue
+        note_duration, pos = _rtttl_u16(token, 0)
+        if not note_duration:
+            note_duration = duration
+        if pos >= len(token):
+            break
+        note = token[pos].lower()
+        if note not in "abcdefgp":
+            continue
+        pos += 1
+        sharp = pos < len(token) and token[pos] == "#"
+        pos += 1 if sharp else 0
+        dots = 0
+        while pos < len(token) and token[pos] == ".":
+            dots += 1
+            pos += 1
+        note_octave, pos = _rtttl_u16(token, pos)
+        if note_octave is None or note_octave > 9:
+            note_octave = octave
+        while pos < len(token) and token[pos] == ".":
+            dots += 1
+            pos += 1
+
+        note_ms = (240000 // bpm) // note_duration
+        ext = note_ms // 2
+        while dots > 0 and ext > 0:
+            note_ms += ext
+            ext //= 2
+            dots -= 1
+        note_ms = min(max(note_ms, 1), 65535)
+
+        if note == "p":
+            tones.append((0, note_ms, 0))
+            continue
+        semitone = RTTTL_SEMITONE[note]
+        if sharp and semitone < 11:
+            semitone += 1
+        freq = RTTTL_BASE_OCT4[semitone]
+        freq = freq << (note_octave - 4) if note_octave > 4 else freq >> (4 - note_octave)
+        freq = min(max(freq, 1), 20000)
+        silence = 0
+        if note_gap_ms > 0 and note_ms > note_gap_ms + 1:
+            silence = note_gap_ms
+            note_ms -= note_gap_ms
+        tones.append((freq, note_ms, silence))
+    return tones
+
+
 def validate_count(items: list[Any], expected: int, field: str) -> None:
     if len(items) != expected:
         raise ValueError(f"{field} count mismatch: expected {expected}, got {len(items)}")
 
 
+def breaker_macros(prefix: str, block: dict[str, Any], field: str, threshold: int, base_ms: int, max_ms: int) -> list[str]:
+    threshold = as_int(block.get("failure_threshold", threshold), f"{field}.failure_threshold")
+    base_ms = as_int(block.get("base_delay_ms", base_ms), f"{field}.base_delay_ms")
+    max_ms = as_int(block.get("max_delay_ms", max_ms), f"{field}.max_delay_ms")
+    if not 1 <= threshold <= 20:
+        raise ValueError(f"{field}.failure_threshold must be 1..20")
+    if not 100 <= base_ms <= max_ms <= 3600000:
+        raise ValueError(f"{field} delays must satisfy 100 <= base_delay_ms <= max_delay_ms <= 3600000")
+    return [
+        f"#define {prefix}_BREAKER_FAILURE_THRESHOLD {threshold}",
+        f"#define {prefix}_BREAKER_BASE_DELAY_MS {base_ms}",
+        f"#define {prefix}_BREAKER_MAX_DELAY_MS {max_ms}",
+    ]
+
+
 def render_header(cfg: dict[str, Any]) -> str:
     counts = cfg["counts"]
     key_count = as_int(counts["key"], "counts.key")
@@ -96,6 +233,36 @@ def render_header(cfg: dict[str, Any]) -> str:
         "queue_size": 24,
         "worker_interval_ms": 30,
         "max_retry": 1,
+        "keep_alive": True,
+        "transport": "rest",
+        "mqtt": {
+            "topic_prefix": "macropad",
+            "discovery": True,
+            "discovery_prefix": "homeassistant",
+            "qos": 1,
+            "keepalive_sec": 30,
+            "outbox_limit_bytes": 8192,
+            "display_state_topic": "",
+            "statestream_prefix": "homeassistant",
+        },
+        "coalesce": True,
+        "batch": {
+            "max_events": 8,
+        },
+        "spool": {
+            "enabled": True,
+            "partition_label": "cfgstore",
+            "offset": 786432,
+            "size": 262144,
+            "max_age_sec": 86400,
+            "drain_per_sec": 5,
+            "flush_interval_ms": 2000,
+        },
+        "breaker": {
+            "failure_threshold": 3,
+            "base_delay_ms": 2000,
+            "max_delay_ms": 120000,
+        },
         "publish_layer_switch": True,
         "publish_key_event": False,
         "publish_encoder_step": False,
@@ -123,6 +290,40 @@ def render_header(cfg: dict[str, Any]) -> str:
         "send_timeout_sec": 5,
         "cors_enabled": True,
         "control_enabled": False,
+        "log_stream_max_clients": 2,
+        "state_stream_max_clients": 2,
+    })
+    log_store = cfg.get("log_store", {
+        "binary_enabled": True,
+        "ring_bytes": 46080,
+        "staging_bytes": 4096,
+        "drain_period_ms": 20,
+        "rtc_enabled": True,
+        "rtc_bytes": 4096,
+        "collapse": True,
+        "collapse_template": False,
+        "rate_limits": [],
+    })
+    log_archive = cfg.get("log_archive", {
+        "enabled": True,
+        "partition_label": "cfgstore",
+        "offset": 0,
+        "size": 786432,
+        "flush_interval_sec": 30,
+    })
+    profiler = cfg.get("profiler", {
+        "enabled": True,
+        "window_sec": 10,
+        "top_scopes": 5,
+    })
+    trace = cfg.get("trace", {
+        "enabled": True,
+        "buffer_records": 4096,
+    })
+    bench = cfg.get("bench", {
+        "enabled": True,
+        "samples": 200,
+        "blocking_samples": 20,
     })
     ota = cfg.get("ota", {
         "enabled": True,
@@ -132,6 +333,12 @@ def render_header(cfg: dict[str, Any]) -> str:
         "confirm_timeout_sec": 120,
         "self_check_duration_ms": 2000,
         "self_check_min_heap_bytes": 65536,
+        "download_attempts": 3,
+        "breaker": {
+            "failure_threshold": 1,
+            "base_delay_ms": 5000,
+            "max_delay_ms": 300000,
+        },
     })
     encoder_toggle = buzzer.get("encoder_toggle", {
         "enabled": False,
@@ -174,6 +381,12 @@ def render_header(cfg: dict[str, Any]) -> str:
     out.append("} macro_rgb_t;")
     out.append("")
     out.append("typedef struct {")
+    out.append("    macro_rgb_t indicator;")
+    out.append("    macro_rgb_t key_idle;")
+    out.append("    macro_rgb_t key_active;")
+    out.append("} macro_layer_led_palette_t;")
+    out.append("")
+    out.append("typedef struct {")
     out.append("    uint16_t button_single_usage;")
     out.append("    uint16_t cw_usage;")
     out.append("    uint16_t ccw_usage;")
@@ -188,6 +401,23 @@ def render_header(cfg: dict[str, Any]) -> str:
     out.append("    uint16_t hold_repeat_ms;")
     out.append("} macro_touch_layer_config_t;")
     out.append("")
+    out.append("typedef struct {")
+    out.append("    uint16_t frequency_hz;")
+    out.append("    uint16_t duration_ms;")
+    out.append("    uint16_t silence_ms;")
+    out.append("} macro_buzzer_tone_t;")
+    out.append("")
+    out.append("typedef struct {")
+    out.append("    const macro_buzzer_tone_t *tones;")
+    out.append("    uint16_t count;")
+    out.append("} macro_buzzer_melody_t;")
+    out.append("")
+    out.append("typedef struct {")
+    out.append("    const char *tag;")
+    out.append("    uint16_t per_sec;")
+    out.append("    uint16_t burst;")
+    out.append("} macro_log_rate_limit_t;")
+    out.append("")
     out.append(f"#define MACRO_KEY_COUNT {key_count}")
     out.append(f"#define MACRO_LAYER_COUNT {layer_count}")
     out.append("")
@@ -227,6 +457,38 @@ def render_header(cfg: dict[str, Any]) -> str:
     out.append(f"#define MACRO_LAYER_KEY_DIM_SCALE {as_int(led['layer_key_dim_scale'], 'led.layer_key_dim_scale')}")
     out.append(f"#define MACRO_LAYER_KEY_ACTIVE_SCALE {as_int(led['layer_key_active_scale'], 'led.layer_key_active_scale')}")
     out.append("")
+    indicator_brightness = as_int(led["indicator_brightness"], "led.indicator_brightness")
+    key_brightness = as_int(led["key_brightness"], "led.key_brightness")
+    dim_scale = as_int(led["layer_key_dim_scale"], "led.layer_key_dim_scale")
+    active_scale = as_int(led["layer_key_active_scale"], "led.layer_key_active_scale")
+    out.append("// Layer colors pre-scaled by led.* brightness/scale settings (final SK6812 channel values).")
+    out.append("static const macro_layer_led_palette_t g_layer_led_palette[MACRO_LAYER_COUNT] = {")
+    for idx, color in enumerate(colors):
+        rgb = as_rgb(color, f"layer_backlight_colors[{idx}]")
+        indicator = tuple(scale_u8(ch, indicator_brightness) for ch in rgb)
+        key_idle = tuple(scale_u8(scale_u8(ch, dim_scale), key_brightness) for ch in rgb)
+        key_active = tuple(scale_u8(scale_u8(ch, active_scale), key_brightness) for ch in rgb)
+        out.append(f"    {{{c_rgb(indicator)}, {c_rgb(key_idle)}, {c_rgb(key_active)}}},")
+    out.append("};")
+    out.append("")
+    mounted = as_rgb(led.get("status_mounted_color", {"r": 0, "g": 40, "b": 0}), "led.status_mounted_color")
+    link = as_rgb(led.get("status_link_color", {"r": 0, "g": 0, "b": 40}), "led.status_link_color")
+    out.append("static const macro_rgb_t g_led_status_mounted_color = "
+               f"{c_rgb(tuple(scale_u8(ch, indicator_brightness) for ch in mounted))};")
+    out.append("static const macro_rgb_t g_led_status_link_color = "
+               f"{c_rgb(tuple(scale_u8(ch, indicator_brightness) for ch in link))};")
+    out.append("")
+    effects = led.get("effects", {})
+    out.append(f"#define MACRO_LED_EFFECTS_ENABLED {c_bool(effects.get('enabled', True))}")
+    out.append(f"#define MACRO_LED_EFFECTS_FRAME_RATE_HZ {as_int(effects.get('frame_rate_hz', 50), 'led.effects.frame_rate_hz')}")
+    out.append(f"#define MACRO_LED_EFFECTS_FRAME_BUDGET_US {as_int(effects.get('frame_budget_us', 2000), 'led.effects.frame_budget_us')}")
+    out.append(f"#define MACRO_LED_EFFECTS_REACTIVE_FADE_MS {as_int(effects.get('reactive_fade_ms', 300), 'led.effects.reactive_fade_ms')}")
+    out.append(f"#define MACRO_LED_EFFECTS_LAYER_TRANSITION_MS {as_int(effects.get('layer_transition_ms', 250), 'led.effects.layer_transition_ms')}")
+    out.append(f"#define MACRO_LED_EFFECTS_BREATHING_ENABLED {c_bool(effects.get('breathing_enabled', True))}")
+    out.append(f"#define MACRO_LED_EFFECTS_BREATHING_AFTER_SEC {as_int(effects.get('breathing_after_sec', 30), 'led.effects.breathing_after_sec')}")
+    out.append(f"#define MACRO_LED_EFFECTS_BREATHING_PERIOD_MS {as_int(effects.get('breathing_period_ms', 4000), 'led.effects.breathing_period_ms')}")
+    out.append(f"#define MACRO_LED_EFFECTS_BREATHING_MIN_PERCENT {as_int(effects.get('breathing_min_percent', 20), 'led.effects.breathing_min_percent')}")
+    out.append("")
     out.append("static const macro_encoder_layer_config_t g_encoder_layer_config[MACRO_LAYER_COUNT] = {")
     for layer in encoder_layers:
         out.append(
@@ -316,6 +578,37 @@ def render_header(cfg: dict[str, Any]) -> str:
     out.append(f"#define MACRO_BUZZER_RTTTL_TOGGLE_ON {c_str(str(encoder_toggle['on_rtttl']))}")
     out.append(f"#define MACRO_BUZZER_RTTTL_TOGGLE_OFF {c_str(str(encoder_toggle['off_rtttl']))}")
     out.append("")
+    note_gap_ms = as_int(buzzer["rtttl_note_gap_ms"], "buzzer.rtttl_note_gap_ms")
+    melody_sources = {
+        "startup": buzzer["startup"]["rtttl"],
+        "keypress": buzzer["keypress"]["rtttl"],
+        "layer1": buzzer["layer_switch"]["layer1_rtttl"],
+        "layer2": buzzer["layer_switch"]["layer2_rtttl"],
+        "layer3": buzzer["layer_switch"]["layer3_rtttl"],
+        "encoder_cw": buzzer["encoder_step"]["cw_rtttl"],
+        "encoder_ccw": buzzer["encoder_step"]["ccw_rtttl"],
+        "toggle_on": encoder_toggle["on_rtttl"],
+        "toggle_off": encoder_toggle["off_rtttl"],
+    }
+    out.append("// RTTTL melodies compiled at build time: {frequency_hz (0 = rest), duration_ms, silence_ms}.")
+    out.append("// rtttl_note_gap_ms is already split off each note into silence_ms.")
+    melody_rows: list[str] = []
+    for slot, field in BUZZER_MELODY_SLOTS:
+        source = str(melody_sources[slot] or "")
+        tones = compile_rtttl(source, note_gap_ms, field) if source else []
+        if not tones:
+            melody_rows.append(f"    {{NULL, 0}}, // {slot}")
+            continue
+        out.append(f"static const macro_buzzer_tone_t g_buzzer_melody_{slot}[] = {{")
+        for freq, dur, silence in tones:
+            out.append(f"    {{{freq}, {dur}, {silence}}},")
+        out.append("};")
+        melody_rows.append(f"    {{g_buzzer_melody_{slot}, {len(tones)}}}, // {slot}")
+    out.append(f"#define MACRO_BUZZER_MELODY_COUNT {len(BUZZER_MELODY_SLOTS)}")
+    out.append("static const macro_buzzer_melody_t g_buzzer_melodies[MACRO_BUZZER_MELODY_COUNT] = {")
+    out.extend(melody_rows)
+    out.append("};")
+    out.append("")
     out.append(f"#define MACRO_HA_ENABLED {c_bool(ha['enabled'])}")
     out.append(f"#define MACRO_HA_DEVICE_NAME {c_str(str(ha['device_name']))}")
     out.append(f"#define MACRO_HA_EVENT_PREFIX {c_str(str(ha['event_prefix']))}")
@@ -323,6 +616,67 @@ def render_header(cfg: dict[str, Any]) -> str:
     out.append(f"#define MACRO_HA_QUEUE_SIZE {as_int(ha['queue_size'], 'home_assistant.queue_size')}")
     out.append(f"#define MACRO_HA_WORKER_INTERVAL_MS {as_int(ha['worker_interval_ms'], 'home_assistant.worker_interval_ms')}")
     out.append(f"#define MACRO_HA_MAX_RETRY {as_int(ha['max_retry'], 'home_assistant.max_retry')}")
+    out.append(f"#define MACRO_HA_KEEP_ALIVE {c_bool(ha.get('keep_alive', True))}")
+    ha_transport = str(ha.get("transport", "rest")).strip().lower()
+    if ha_transport not in ("rest", "websocket", "mqtt"):
+        raise ValueError("home_assistant.transport must be 'rest', 'websocket' or 'mqtt'")
+    out.append(f"#define MACRO_HA_TRANSPORT_WEBSOCKET {c_bool(ha_transport == 'websocket')}")
+    out.append(f"#define MACRO_HA_TRANSPORT_MQTT {c_bool(ha_transport == 'mqtt')}")
+    ha_mqtt = ha.get("mqtt", {})
+    mqtt_topics = {
+        "topic_prefix": str(ha_mqtt.get("topic_prefix", "macropad")),
+        "discovery_prefix": str(ha_mqtt.get("discovery_prefix", "homeassistant")),
+        "statestream_prefix": str(ha_mqtt.get("statestream_prefix", "homeassistant")),
+    }
+    for key, topic in mqtt_topics.items():
+        if not topic or topic.endswith("/") or "+" in topic or "#" in topic:
+            raise ValueError(f"home_assistant.mqtt.{key} must be a non-empty topic without wildcards or trailing '/'")
+    device_name = str(ha["device_name"])
+    if ha_transport == "mqtt" and not (device_name.isascii() and device_name.replace("_", "").replace("-", "").isalnum()):
+        raise ValueError("home_assistant.device_name must be [A-Za-z0-9_-] with transport 'mqtt' (topic and discovery id)")
+    mqtt_qos = as_int(ha_mqtt.get("qos", 1), "home_assistant.mqtt.qos")
+    if mqtt_qos not in (0, 1):
+        raise ValueError("home_assistant.mqtt.qos must be 0 or 1")
+    mqtt_outbox = as_int(ha_mqtt.get("outbox_limit_bytes", 8192), "home_assistant.mqtt.outbox_limit_bytes")
+    if not 1024 <= mqtt_outbox <= 65536:
+        raise ValueError("home_assistant.mqtt.outbox_limit_bytes must be 1024..65536")
+    out.append(f"#define MACRO_HA_MQTT_TOPIC_PREFIX {c_str(mqtt_topics['topic_prefix'])}")
+    out.append(f"#define MACRO_HA_MQTT_DISCOVERY {c_bool(ha_mqtt.get('discovery', True))}")
+    out.append(f"#define MACRO_HA_MQTT_DISCOVERY_PREFIX {c_str(mqtt_topics['discovery_prefix'])}")
+    out.append(f"#define MACRO_HA_MQTT_QOS {mqtt_qos}")
+    out.append(f"#define MACRO_HA_MQTT_KEEPALIVE_SEC {as_int(ha_mqtt.get('keepalive_sec', 30), 'home_assistant.mqtt.keepalive_sec')}")
+    out.append(f"#define MACRO_HA_MQTT_OUTBOX_LIMIT_BYTES {mqtt_outbox}")
+    out.append(f"#define MACRO_HA_MQTT_DISPLAY_STATE_TOPIC {c_str(str(ha_mqtt.get('display_state_topic', '')))}")
+    out.append(f"#define MACRO_HA_MQTT_STATESTREAM_PREFIX {c_str(mqtt_topics['statestream_prefix'])}")
+    out.append(f"#define MACRO_HA_COALESCE {c_bool(ha.get('coalesce', True))}")
+    ha_batch = ha.get("batch", {})
+    ha_batch_max = as_int(ha_batch.get("max_events", 8), "home_assistant.batch.max_events")
+    if not 1 <= ha_batch_max <= 16:
+        raise ValueError("home_assistant.batch.max_events must be 1..16")
+    out.append(f"#define MACRO_HA_BATCH_MAX_EVENTS {ha_batch_max}")
+    ha_spool = ha.get("spool", {})
+    spool_label = str(ha_spool.get("partition_label", "cfgstore"))
+    spool_offset = as_int(ha_spool.get("offset", 786432), "home_assistant.spool.offset")
+    spool_size = as_int(ha_spool.get("size", 262144), "home_assistant.spool.size")
+    if spool_offset % 4096 != 0 or spool_size % 4096 != 0 or not (8192 <= spool_size <= 256 * 4096):
+        raise ValueError("home_assistant.spool.offset/size must be multiples of 4096 and size must be 2..256 sectors")
+    archive_label = str(log_archive.get("partition_label", "cfgstore"))
+    archive_offset = as_int(log_archive.get("offset", 0), "log_archive.offset")
+    archive_end = archive_offset + as_int(log_archive.get("size", 786432), "log_archive.size")
+    if (ha_spool.get("enabled", True) and log_archive.get("enabled", True) and spool_label == archive_label
+            and spool_offset < archive_end and archive_offset < spool_offset + spool_size):
+        raise ValueError("home_assistant.spool region overlaps log_archive")
+    spool_drain = as_int(ha_spool.get("drain_per_sec", 5), "home_assistant.spool.drain_per_sec")
+    if not 1 <= spool_drain <= 50:
+        raise ValueError("home_assistant.spool.drain_per_sec must be 1..50")
+    out.append(f"#define MACRO_HA_SPOOL_ENABLED {c_bool(ha_spool.get('enabled', True))}")
+    out.append(f"#define MACRO_HA_SPOOL_PARTITION_LABEL {c_str(spool_label)}")
+    out.append(f"#define MACRO_HA_SPOOL_OFFSET {spool_offset}")
+    out.append(f"#define MACRO_HA_SPOOL_SIZE {spool_size}")
+    out.append(f"#define MACRO_HA_SPOOL_MAX_AGE_SEC {as_int(ha_spool.get('max_age_sec', 86400), 'home_assistant.spool.max_age_sec')}")
+    out.append(f"#define MACRO_HA_SPOOL_DRAIN_PER_SEC {spool_drain}")
+    out.append(f"#define MACRO_HA_SPOOL_FLUSH_INTERVAL_MS {as_int(ha_spool.get('flush_interval_ms', 2000), 'home_assistant.spool.flush_interval_ms')}")
+    out.extend(breaker_macros("MACRO_HA", ha.get("breaker", {}), "home_assistant.breaker", 3, 2000, 120000))
     out.append(f"#define MACRO_HA_PUBLISH_LAYER_SWITCH {c_bool(ha['publish_layer_switch'])}")
     out.append(f"#define MACRO_HA_PUBLISH_KEY_EVENT {c_bool(ha['publish_key_event'])}")
     out.append(f"#define MACRO_HA_PUBLISH_ENCODER_STEP {c_bool(ha['publish_encoder_step'])}")
@@ -347,6 +701,88 @@ def render_header(cfg: dict[str, Any]) -> str:
     out.append(f"#define MACRO_WEB_SERVICE_SEND_TIMEOUT_SEC {as_int(web_service.get('send_timeout_sec', 5), 'web_service.send_timeout_sec')}")
     out.append(f"#define MACRO_WEB_SERVICE_CORS_ENABLED {c_bool(web_service.get('cors_enabled', True))}")
     out.append(f"#define MACRO_WEB_SERVICE_CONTROL_ENABLED {c_bool(web_service.get('control_enabled', False))}")
+    log_stream_max_clients = as_int(web_service.get("log_stream_max_clients", 2), "web_service.log_stream_max_clients")
+    if log_stream_max_clients < 1 or log_stream_max_clients > 4:
+        raise ValueError("web_service.log_stream_max_clients must be 1..4")
+    out.append(f"#define MACRO_WEB_SERVICE_LOG_STREAM_MAX_CLIENTS {log_stream_max_clients}")
+    state_stream_max_clients = as_int(web_service.get("state_stream_max_clients", 2), "web_service.state_stream_max_clients")
+    if state_stream_max_clients < 1 or state_stream_max_clients > 4:
+        raise ValueError("web_service.state_stream_max_clients must be 1..4")
+    out.append(f"#define MACRO_WEB_SERVICE_STATE_STREAM_MAX_CLIENTS {state_stream_max_clients}")
+    out.append("")
+    log_ring_bytes = as_int(log_store.get("ring_bytes", 46080), "log_store.ring_bytes")
+    if log_ring_bytes < 2048 or log_ring_bytes % 4 != 0:
+        raise ValueError("log_store.ring_bytes must be a multiple of 4 and >= 2048")
+    out.append(f"#define MACRO_LOG_STORE_BINARY_ENABLED {c_bool(log_store.get('binary_enabled', True))}")
+    out.append(f"#define MACRO_LOG_STORE_RING_BYTES {log_ring_bytes}")
+    log_staging_bytes = as_int(log_store.get("staging_bytes", 4096), "log_store.staging_bytes")
+    if log_staging_bytes < 2048 or (log_staging_bytes & (log_staging_bytes - 1)) != 0:
+        raise ValueError("log_store.staging_bytes must be a power of two and >= 2048")
+    out.append(f"#define MACRO_LOG_STORE_STAGING_BYTES {log_staging_bytes}")
+    log_rtc_bytes = as_int(log_store.get("rtc_bytes", 4096), "log_store.rtc_bytes")
+    if log_rtc_bytes < 1024 or (log_rtc_bytes & (log_rtc_bytes - 1)) != 0:
+        raise ValueError("log_store.rtc_bytes must be a power of two and >= 1024")
+    out.append(f"#define MACRO_LOG_STORE_RTC_ENABLED {c_bool(log_store.get('rtc_enabled', True))}")
+    out.append(f"#define MACRO_LOG_STORE_RTC_BYTES {log_rtc_bytes}")
+    out.append(f"#define MACRO_LOG_STORE_DRAIN_PERIOD_MS {as_int(log_store.get('drain_period_ms', 20), 'log_store.drain_period_ms')}")
+    out.append(f"#define MACRO_LOG_STORE_COLLAPSE {c_bool(log_store.get('collapse', True))}")
+    out.append(f"#define MACRO_LOG_STORE_COLLAPSE_TEMPLATE {c_bool(log_store.get('collapse_template', False))}")
+    rate_limits = log_store.get("rate_limits", []) or []
+    if not isinstance(rate_limits, list) or len(rate_limits) > 8:
+        raise ValueError("log_store.rate_limits must be a list of at most 8 entries")
+    rate_rows: list[str] = []
+    for i, limit in enumerate(rate_limits):
+        field = f"log_store.rate_limits[{i}]"
+        if not isinstance(limit, dict):
+            raise ValueError(f"{field} must be a mapping with tag/per_sec/burst")
+        tag = str(limit.get("tag", ""))
+        per_sec = as_int(limit.get("per_sec", 0), f"{field}.per_sec")
+        burst = as_int(limit.get("burst", per_sec), f"{field}.burst")
+        if not tag or len(tag) > 23:
+            raise ValueError(f"{field}.tag must be 1..23 characters")
+        if not (1 <= per_sec <= 1000) or not (1 <= burst <= 65535):
+            raise ValueError(f"{field}: per_sec must be 1..1000 and burst 1..65535")
+        rate_rows.append(f"    {{{c_str(tag)}, {per_sec}, {burst}}},")
+    out.append(f"#define MACRO_LOG_STORE_RATE_LIMIT_COUNT {len(rate_rows)}")
+    out.append("static const macro_log_rate_limit_t g_log_store_rate_limits[] = {")
+    out.extend(rate_rows if rate_rows else ["    {NULL, 0, 0},"])
+    out.append("};")
+    out.append("")
+    archive_offset = as_int(log_archive.get("offset", 0), "log_archive.offset")
+    archive_size = as_int(log_archive.get("size", 786432), "log_archive.size")
+    if archive_offset % 4096 != 0 or archive_size % 4096 != 0 or not (8192 <= archive_size <= 256 * 4096):
+        raise ValueError("log_archive.offset/size must be multiples of 4096 and size must be 2..256 sectors")
+    out.append(f"#define MACRO_LOG_ARCHIVE_ENABLED {c_bool(log_archive.get('enabled', True))}")
+    out.append(f"#define MACRO_LOG_ARCHIVE_PARTITION_LABEL {c_str(str(log_archive.get('partition_label', 'cfgstore')))}")
+    out.append(f"#define MACRO_LOG_ARCHIVE_OFFSET {archive_offset}")
+    out.append(f"#define MACRO_LOG_ARCHIVE_SIZE {archive_size}")
+    out.append(f"#define MACRO_LOG_ARCHIVE_FLUSH_INTERVAL_SEC {as_int(log_archive.get('flush_interval_sec', 30), 'log_archive.flush_interval_sec')}")
+    out.append("")
+    profiler_window_sec = as_int(profiler.get("window_sec", 10), "profiler.window_sec")
+    if profiler_window_sec < 2 or profiler_window_sec > 60:
+        raise ValueError("profiler.window_sec must be 2..60")
+    profiler_top_scopes = as_int(profiler.get("top_scopes", 5), "profiler.top_scopes")
+    if profiler_top_scopes < 1 or profiler_top_scopes > 6:
+        raise ValueError("profiler.top_scopes must be 1..6")
+    out.append(f"#define MACRO_PROFILER_ENABLED {c_bool(profiler.get('enabled', True))}")
+    out.append(f"#define MACRO_PROFILER_WINDOW_SEC {profiler_window_sec}")
+    out.append(f"#define MACRO_PROFILER_TOP_SCOPES {profiler_top_scopes}")
+    out.append("")
+    trace_records = as_int(trace.get("buffer_records", 4096), "trace.buffer_records")
+    if trace_records < 256 or trace_records > 16384:
+        raise ValueError("trace.buffer_records must be 256..16384")
+    out.append(f"#define MACRO_TRACE_ENABLED {c_bool(trace.get('enabled', True))}")
+    out.append(f"#define MACRO_TRACE_BUFFER_RECORDS {trace_records}")
+    out.append("")
+    bench_samples = as_int(bench.get("samples", 200), "bench.samples")
+    if bench_samples < 16 or bench_samples > 2000:
+        raise ValueError("bench.samples must be 16..2000")
+    bench_blocking_samples = as_int(bench.get("blocking_samples", 20), "bench.blocking_samples")
+    if bench_blocking_samples < 4 or bench_blocking_samples > 200:
+        raise ValueError("bench.blocking_samples must be 4..200")
+    out.append(f"#define MACRO_BENCH_ENABLED {c_bool(bench.get('enabled', True))}")
+    out.append(f"#define MACRO_BENCH_SAMPLES {bench_samples}")
+    out.append(f"#define MACRO_BENCH_BLOCKING_SAMPLES {bench_blocking_samples}")
     out.append("")
     out.append(f"#define MACRO_OTA_ENABLED {c_bool(ota.get('enabled', True))}")
     out.append(f"#define MACRO_OTA_ALLOW_HTTP {c_bool(ota.get('allow_http', False))}")
@@ -355,6 +791,11 @@ def render_header(cfg: dict[str, Any]) -> str:
     out.append(f"#define MACRO_OTA_CONFIRM_TIMEOUT_SEC {as_int(ota.get('confirm_timeout_sec', 120), 'ota.confirm_timeout_sec')}")
     out.append(f"#define MACRO_OTA_SELF_CHECK_DURATION_MS {as_int(ota.get('self_check_duration_ms', 2000), 'ota.self_check_duration_ms')}")
     out.append(f"#define MACRO_OTA_SELF_CHECK_MIN_HEAP_BYTES {as_int(ota.get('self_check_min_heap_bytes', 65536), 'ota.self_check_min_heap_bytes')}")
+    ota_attempts = as_int(ota.get("download_attempts", 3), "ota.download_attempts")
+    if not 1 <= ota_attempts <= 10:
+        raise ValueError("ota.download_attempts must be 1..10")
+    out.append(f"#define MACRO_OTA_DOWNLOAD_ATTEMPTS {ota_attempts}")
+    out.extend(breaker_macros("MACRO_OTA", ota.get("breaker", {}), "ota.breaker", 1, 5000, 300000))
     out.append("")
     out.append(f"#define MACRO_TOUCH_TRIGGER_PERCENT {as_int(touch['trigger_percent'], 'touch.trigger_percent')}")
     out.append(f"#define MACRO_TOUCH_RELEASE_PERCENT {as_int(touch['release_percent'], 'touch.release_percent')}")
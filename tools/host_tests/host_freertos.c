@@ -0,0 +1,376 @@
+/*
+ * FreeRTOS and ESP-IDF system shims for the host test suites; see host_freertos.h.
+ */
+
+#include "host_freertos.h"
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_cpu.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/semphr.h"
+
+#define HOST_MAX_TASKS 64U
+
+struct host_task {
+    bool used;
+    bool created;            // runs on a pthread started by xTaskCreate
+    char name[configMAX_TASK_NAME_LEN];
+    UBaseType_t number;
+    UBaseType_t prio;
+    BaseType_t core;
+    uint32_t stack_free;
+    uint32_t runtime;
+    TaskFunction_t fn;
+    void *arg;
+    pthread_t thread;
+    sem_t go;
+    sem_t parked;
+};
+
+struct host_sem {
+    pthread_mutex_t mutex;
+};
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct host_task s_tasks[HOST_MAX_TASKS];
+static UBaseType_t s_next_number = 1U;
+static uint32_t s_total_runtime;
+static TaskHandle_t s_idle[2];
+static int64_t s_now_us = 1000000;
+static bool s_wifi_associated;
+static int8_t s_wifi_rssi;
+
+static __thread TaskHandle_t t_current;
+static __thread int t_core;
+static __thread uint32_t t_cycles;
+
+static struct host_task *task_alloc(const char *name, UBaseType_t prio, BaseType_t core, uint32_t stack_free)
+{
+    pthread_mutex_lock(&s_lock);
+    struct host_task *task = NULL;
+    for (size_t i = 0; i < HOST_MAX_TASKS; ++i) {
+        if (!s_tasks[i].used) {
+            task = &s_tasks[i];
+            break;
+        }
+    }
+    if (task != NULL) {
+        memset(task, 0, sizeof(*task));
+        task->used = true;
+        strlcpy(task->name, name, sizeof(task->name));
+        task->number = s_next_number++;
+        task->prio = prio;
+        task->core = core;
+        task->stack_free = stack_free;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return task;
+}
+
+TaskHandle_t host_task_add(const char *name, UBaseType_t prio, BaseType_t core, uint32_t stack_free_bytes)
+{
+    struct host_task *task = task_alloc(name, prio, core, stack_free_bytes);
+    if (task == NULL) {
+        fprintf(stderr, "host_freertos: task table full\n");
+        abort();
+    }
+    return task;
+}
+
+void host_task_remove(TaskHandle_t task)
+{
+    pthread_mutex_lock(&s_lock);
+    task->used = false;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_task_set_runtime(TaskHandle_t task, uint32_t runtime)
+{
+    pthread_mutex_lock(&s_lock);
+    task->runtime = runtime;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_set_total_runtime(uint32_t total)
+{
+    pthread_mutex_lock(&s_lock);
+    s_total_runtime = total;
+    pthread_mutex_unlock(&s_lock);
+}
+
+void host_set_idle_task(BaseType_t core, TaskHandle_t task)
+{
+    s_idle[core] = task;
+}
+
+void host_set_current_task(TaskHandle_t task)
+{
+    t_current = task;
+}
+
+void host_reset_tasks(void)
+{
+    pthread_mutex_lock(&s_lock);
+    for (size_t i = 0; i < HOST_MAX_TASKS; ++i) {
+        // Created tasks are parked on a pthread and stay in the table.
+        if (!s_tasks[i].created) {
+            s_tasks[i].used = false;
+        }
+    }
+    s_total_runtime = 0U;
+    s_idle[0] = NULL;
+    s_idle[1] = NULL;
+    pthread_mutex_unlock(&s_lock);
+}
+
+TaskHandle_t host_task_find(const char *name)
+{
+    return xTaskGetHandle(name);
+}
+
+void host_task_step(TaskHandle_t task)
+{
+    sem_post(&task->go);
+    while (sem_wait(&task->parked) != 0) {
+    }
+}
+
+void host_set_time_us(int64_t now_us)
+{
+    __atomic_store_n(&s_now_us, now_us, __ATOMIC_RELAXED);
+}
+
+void host_advance_time_us(int64_t delta_us)
+{
+    __atomic_fetch_add(&s_now_us, delta_us, __ATOMIC_RELAXED);
+}
+
+void host_cpu_set_core(int core)
+{
+    t_core = core;
+}
+
+void host_cpu_advance_cycles(uint32_t cycles)
+{
+    t_cycles += cycles;
+}
+
+void host_set_wifi_rssi(bool associated, int8_t rssi)
+{
+    s_wifi_associated = associated;
+    s_wifi_rssi = rssi;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return __atomic_load_n(&s_now_us, __ATOMIC_RELAXED);
+}
+
+int esp_cpu_get_core_id(void)
+{
+    return t_core;
+}
+
+uint32_t esp_cpu_get_cycle_count(void)
+{
+    return t_cycles;
+}
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *ap_info)
+{
+    if (!s_wifi_associated) {
+        return ESP_FAIL;
+    }
+    ap_info->rssi = s_wifi_rssi;
+    return ESP_OK;
+}
+
+// Parks a created task until the suite steps it; other threads just return.
+static void task_park(void)
+{
+    struct host_task *self = t_current;
+    if (self == NULL || !self->created) {
+        return;
+    }
+    sem_post(&self->parked);
+    while (sem_wait(&self->go) != 0) {
+    }
+}
+
+static void *task_thread(void *arg)
+{
+    struct host_task *task = arg;
+    t_current = task;
+    t_core = (task->core == tskNO_AFFINITY) ? 0 : (int)task->core;
+    while (sem_wait(&task->go) != 0) {
+    }
+    task->fn(task->arg);
+    task->used = false;
+    sem_post(&task->parked);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                                   UBaseType_t prio, TaskHandle_t *out, BaseType_t core)
+{
+    (void)stack;
+    struct host_task *task = task_alloc(name, prio, core, 1024U);
+    if (task == NULL) {
+        return pdFAIL;
+    }
+    task->created = true;
+    task->fn = fn;
+    task->arg = arg;
+    sem_init(&task->go, 0, 0);
+    sem_init(&task->parked, 0, 0);
+    if (pthread_create(&task->thread, NULL, task_thread, task) != 0) {
+        task->used = false;
+        return pdFAIL;
+    }
+    pthread_detach(task->thread);
+    if (out != NULL) {
+        *out = task;
+    }
+    // Run up to the first delay so the task's start-up work is done when this returns.
+    host_task_step(task);
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg, UBaseType_t prio,
+                       TaskHandle_t *out)
+{
+    return xTaskCreatePinnedToCore(fn, name, stack, arg, prio, out, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task == NULL || task == t_current) {
+        struct host_task *self = t_current;
+        self->used = false;
+        sem_post(&self->parked);
+        pthread_exit(NULL);
+    }
+    host_task_remove(task);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    (void)ticks;
+    task_park();
+}
+
+void vTaskDelayUntil(TickType_t *prev_wake, TickType_t increment)
+{
+    *prev_wake += increment;
+    task_park();
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(esp_timer_get_time() / 1000 / portTICK_PERIOD_MS);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return t_current;
+}
+
+TaskHandle_t xTaskGetHandle(const char *name)
+{
+    TaskHandle_t found = NULL;
+    pthread_mutex_lock(&s_lock);
+    for (size_t i = 0; i < HOST_MAX_TASKS && found == NULL; ++i) {
+        if (s_tasks[i].used && strcmp(s_tasks[i].name, name) == 0) {
+            found = &s_tasks[i];
+        }
+    }
+    pthread_mutex_unlock(&s_lock);
+    return found;
+}
+
+TaskHandle_t xTaskGetIdleTaskHandleForCore(BaseType_t core)
+{
+    return s_idle[core];
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    return task->stack_free / sizeof(StackType_t);
+}
+
+UBaseType_t uxTaskGetNumberOfTasks(void)
+{
+    UBaseType_t n = 0;
+    pthread_mutex_lock(&s_lock);
+    for (size_t i = 0; i < HOST_MAX_TASKS; ++i) {
+        n += s_tasks[i].used ? 1U : 0U;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return n;
+}
+
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *status, UBaseType_t cap, uint32_t *total_runtime)
+{
+    pthread_mutex_lock(&s_lock);
+    UBaseType_t n = 0;
+    for (size_t i = 0; i < HOST_MAX_TASKS; ++i) {
+        if (!s_tasks[i].used) {
+            continue;
+        }
+        if (n == cap) {
+            n = 0;  // like FreeRTOS: nothing is reported when the array is too small
+            break;
+        }
+        const struct host_task *task = &s_tasks[i];
+        status[n++] = (TaskStatus_t){
+            .xHandle = (TaskHandle_t)task,
+            .pcTaskName = task->name,
+            .xTaskNumber = task->number,
+            .eCurrentState = eReady,
+            .uxCurrentPriority = task->prio,
+            .uxBasePriority = task->prio,
+            .ulRunTimeCounter = task->runtime,
+            .usStackHighWaterMark = task->stack_free / sizeof(StackType_t),
+            .xCoreID = task->core,
+        };
+    }
+    if (total_runtime != NULL) {
+        *total_runtime = s_total_runtime;
+    }
+    pthread_mutex_unlock(&s_lock);
+    return n;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    struct host_sem *sem = calloc(1, sizeof(*sem));
+    if (sem != NULL) {
+        pthread_mutex_init(&sem->mutex, NULL);
+    }
+    return sem;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+    pthread_mutex_destroy(&sem->mutex);
+    free(sem);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    if (ticks == 0U) {
+        return pthread_mutex_trylock(&sem->mutex) == 0 ? pdTRUE : pdFALSE;
+    }
+    return pthread_mutex_lock(&sem->mutex) == 0 ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    return pthread_mutex_unlock(&sem->mutex) == 0 ? pdTRUE : pdFALSE;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+/*
+ * Test controls for the FreeRTOS/ESP-IDF shims in host_freertos.c.
+ *
+ * The task table is fake: suites add tasks with a name, priority, core and run-time counter and
+ * change them between samples. Tasks created by the module under test (xTaskCreate) run on a
+ * pthread that stops in every vTaskDelay/vTaskDelayUntil until host_task_step() lets it run one
+ * more loop iteration, so periodic work happens exactly when the suite asks for it.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "freertos/task.h"
+
+TaskHandle_t host_task_add(const char *name, UBaseType_t prio, BaseType_t core, uint32_t stack_free_bytes);
+void host_task_remove(TaskHandle_t task);
+void host_task_set_runtime(TaskHandle_t task, uint32_t runtime);
+void host_set_total_runtime(uint32_t total);
+void host_set_idle_task(BaseType_t core, TaskHandle_t task);
+// Task reported by xTaskGetCurrentTaskHandle() on the calling thread.
+void host_set_current_task(TaskHandle_t task);
+void host_reset_tasks(void);
+
+// Created tasks: the handle xTaskCreate returned for name, and one more loop iteration of it.
+TaskHandle_t host_task_find(const char *name);
+void host_task_step(TaskHandle_t task);
+
+void host_set_time_us(int64_t now_us);
+void host_advance_time_us(int64_t delta_us);
+
+// Fake CPU of the calling thread.
+void host_cpu_set_core(int core);
+void host_cpu_advance_cycles(uint32_t cycles);
+
+void host_set_wifi_rssi(bool associated, int8_t rssi);
@@ -0,0 +1,62 @@
+/*
+ * Entry point shared by every host test suite.
+ *
+ *   <suite> run               run the checks, non-zero exit on failure
+ *   <suite> bench [iters]     print timings
+ *
+ * Built and driven by tools/host_tests/host_tests.py.
+ */
+
+#include "host_test.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_ROUNDS 7
+
+int g_host_test_failures;
+
+uint64_t host_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    const double da = *(const double *)a;
+    const double db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+double host_bench(const char *name, host_bench_fn_t fn, uint32_t iterations)
+{
+    double samples[BENCH_ROUNDS];
+    for (int round = 0; round < BENCH_ROUNDS; ++round) {
+        const uint64_t start = host_now_ns();
+        for (uint32_t i = 0; i < iterations; ++i) {
+            fn(i);
+        }
+        samples[round] = (double)(host_now_ns() - start) / (double)iterations;
+    }
+    qsort(samples, BENCH_ROUNDS, sizeof(samples[0]), cmp_double);
+    printf("%-32s min %10.1f ns  median %10.1f ns\n", name, samples[0], samples[BENCH_ROUNDS / 2]);
+    return samples[BENCH_ROUNDS / 2];
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 2 && strcmp(argv[1], "run") == 0) {
+        const int failures = host_test_run();
+        return failures == 0 ? 0 : 1;
+    }
+    if (argc >= 2 && strcmp(argv[1], "bench") == 0) {
+        const long iterations = (argc >= 3) ? strtol(argv[2], NULL, 10) : 20000;
+        host_test_bench(iterations > 0 ? (uint32_t)iterations : 20000U);
+        return 0;
+    }
+    fprintf(stderr, "usage: %s run | bench [iterations]\n", argv[0]);
+    return 2;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+/*
+ * Shared helpers for the host test suites. Each suite is one translation unit with
+ *
+ *   int host_test_run(void);                    // returns the number of failed checks
+ *   void host_test_bench(uint32_t iterations);  // prints timings
+ *
+ * linked against host_test.c and the main/ sources listed in host_tests.py.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+extern int g_host_test_failures;
+
+#define CHECK(cond)                                                            \
+    do {                                                                       \
+        if (!(cond)) {                                                         \
+            fprintf(stderr, "FAIL  %s:%d: %s\n", __FILE__, __LINE__, #cond);   \
+            ++g_host_test_failures;                                            \
+        }                                                                      \
+    } while (0)
+
+#define CHECK_EQ_U(got, want)                                                                       \
+    do {                                                                                            \
+        const unsigned long long got_ = (unsigned long long)(got);                                  \
+        const unsigned long long want_ = (unsigned long long)(want);                                \
+        if (got_ != want_) {                                                                        \
+            fprintf(stderr, "FAIL  %s:%d: %s == %llu, want %llu\n", __FILE__, __LINE__, #got, got_, \
+                    want_);                                                                         \
+            ++g_host_test_failures;                                                                 \
+        }                                                                                           \
+    } while (0)
+
+typedef void (*host_bench_fn_t)(uint32_t i);
+
+uint64_t host_now_ns(void);
+
+// Runs fn iterations times per round over several rounds; prints and returns the median ns per call.
+double host_bench(const char *name, host_bench_fn_t fn, uint32_t iterations);
+
+int host_test_run(void);
+void host_test_bench(uint32_t iterations);
@@ -0,0 +1,174 @@
+#!/usr/bin/env python3
+"""Build firmware modules from main/ for the host and run their test suites.
+
+Commands:
+  run     build every selected suite with ASan/UBSan and run its checks
+  bench   build every selected suite with -O2 and print its timings
+  list    print the available suites
+
+Suites are selected by name (default: all), e.g. `host_tests.py run json_reader`.
+"""
+
+from __future__ import annotations
+
+import argparse
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+from dataclasses import dataclass, field
+from pathlib import Path
+
+TOOL_DIR = Path(__file__).resolve().parent
+REPO_ROOT = TOOL_DIR.parents[1]
+MAIN_DIR = REPO_ROOT / "main"
+
+
+@dataclass(frozen=True)
+class Suite:
+    name: str
+    # Files copied from main/ into the build dir; the .c files are compiled unchanged.
+    main_files: tuple[str, ...]
+    # Extra sources from this directory (test file, stubs).
+    tool_sources: tuple[str, ...]
+    # keymap_config.h defines the suite needs; a shim with only these is generated.
+    config_prefixes: tuple[str, ...] = ()
+    libs: tuple[str, ...] = field(default_factory=tuple)
+
+
+SUITES = {
+    s.name: s
+    for s in (
+        Suite(
+            name="json_reader",
+            main_files=("json_reader.c", "json_reader.h"),
+            tool_sources=("test_json_reader.c",),
+        ),
+        Suite(
+            name="metrics",
+            main_files=("metrics.c", "metrics.h"),
+            tool_sources=("test_metrics.c", "host_freertos.c"),
+            libs=("-lpthread",),
+        ),
+        Suite(
+            name="profiler",
+            main_files=("profiler.c", "profiler.h"),
+            tool_sources=("test_profiler.c", "host_freertos.c"),
+            config_prefixes=("MACRO_PROFILER_",),
+            libs=("-lpthread",),
+        ),
+        Suite(
+            name="trace_buffer",
+            main_files=(
+                "trace_buffer.c",
+                "trace_buffer.h",
+                "trace_hooks.h",
+                "json_writer.c",
+                "json_writer.h",
+                "json_reader.c",
+                "json_reader.h",
+            ),
+            tool_sources=("test_trace_buffer.c", "host_freertos.c"),
+            config_prefixes=("MACRO_TRACE_",),
+            libs=("-lpthread",),
+        ),
+    )
+}
+
+
+def write_config_shim(build_dir: Path, prefixes: tuple[str, ...]) -> None:
+    # The generated header pulls in IDF/TinyUSB types; the modules under test only need a few knobs.
+    if not prefixes:
+        return
+    src = (MAIN_DIR / "keymap_config.h").read_text(encoding="utf-8")
+    pattern = re.compile(r"#define (%s)\w* " % "|".join(re.escape(p) for p in prefixes))
+    defines = [line for line in src.splitlines() if pattern.match(line)]
+    if not defines:
+        raise RuntimeError(f"main/keymap_config.h has no {', '.join(prefixes)}* defines; regenerate it first")
+    body = "\n".join(["// Host shim generated by tools/host_tests/host_tests.py", "#pragma once", "", *defines, ""])
+    (build_dir / "keymap_config.h").write_text(body, encoding="utf-8")
+
+
+def build(suite: Suite, build_dir: Path, cc: str, flags: list[str]) -> Path:
+    build_dir.mkdir(parents=True, exist_ok=True)
+    # Stage the modules next to the config shim so their quoted includes resolve to it, not main/.
+    for name in suite.main_files:
+        shutil.copy2(MAIN_DIR / name, build_dir / name)
+    write_config_shim(build_dir, suite.config_prefixes)
+
+    exe = build_dir / f"test_{suite.name}"
+    sources = [build_dir / n for n in suite.main_files if n.endswith(".c")]
+    sources += [TOOL_DIR / n for n in suite.tool_sources]
+    sources.append(TOOL_DIR / "host_test.c")
+    cmd = [
+        cc,
+        "-std=gnu11",
+        *flags,
+        "-Wall",
+        "-Wextra",
+        "-Werror",
+        "-I",
+        str(build_dir),
+        "-I",
+        str(TOOL_DIR),
+        "-I",
+        str(TOOL_DIR / "shim"),
+        "-include",
+        str(TOOL_DIR / "shim" / "host_compat.h"),
+        *[str(s) for s in sources],
+        "-o",
+        str(exe),
+        *suite.libs,
+    ]
+    subprocess.run(cmd, check=True)
+    return exe
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("command", choices=["run", "bench", "list"])
+    parser.add_argument("suites", nargs="*", help="suite names (default: all)")
+    parser.add_argument("--cc", default="cc", help="host C compiler")
+    parser.add_argument("--iterations", type=int, default=20000, help="iterations per bench round")
+    parser.add_argument("--no-sanitize", action="store_true", help="build 'run' without ASan/UBSan")
+    parser.add_argument("--build-dir", type=Path, help="keep build artifacts here instead of a temp dir")
+    args = parser.parse_args()
+
+    if args.command == "list":
+        for name in SUITES:
+            print(name)
+        return 0
+
+    unknown = [n for n in args.suites if n not in SUITES]
+    if unknown:
+        parser.error(f"unknown suite(s): {', '.join(unknown)}")
+    selected = [SUITES[n] for n in (args.suites or SUITES)]
+
+    if args.command == "bench":
+        flags = ["-O2"]
+    elif args.no_sanitize:
+        flags = ["-O1", "-g"]
+    else:
+        flags = ["-O1", "-g", "-fno-omit-frame-pointer", "-fsanitize=address,undefined", "-fno-sanitize-recover"]
+
+    failed = []
+    with tempfile.TemporaryDirectory(prefix="host_tests_") as tmp:
+        root = args.build_dir or Path(tmp)
+        for suite in selected:
+            exe = build(suite, root / suite.name, args.cc, flags)
+            if args.command == "bench":
+                rc = subprocess.run([str(exe), "bench", str(args.iterations)]).returncode
+            else:
+                rc = subprocess.run([str(exe), "run"]).returncode
+                print(f"{'OK  ' if rc == 0 else 'FAIL'}  {suite.name}")
+            if rc != 0:
+                failed.append(suite.name)
+
+    if args.command == "run":
+        print(f"{len(failed)} suite(s) failed: {', '.join(failed)}" if failed else "all suites passed")
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
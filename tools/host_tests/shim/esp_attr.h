@@ -0,0 +1,6 @@
+#pragma once
+
+/* Host shim: placement attributes are meaningless on the host. */
+
+#define IRAM_ATTR
+#define DRAM_ATTR
@@ -0,0 +1,8 @@
+#pragma once
+
+/* Host shim: core id and cycle counter come from the calling thread's fake CPU (host_freertos.h). */
+
+#include <stdint.h>
+
+int esp_cpu_get_core_id(void);
+uint32_t esp_cpu_get_cycle_count(void);
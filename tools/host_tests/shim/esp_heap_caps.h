@@ -0,0 +1,22 @@
+#pragma once
+
+/* Host shim: capability-based allocation maps onto the C heap. */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define MALLOC_CAP_8BIT (1U << 2)
+#define MALLOC_CAP_INTERNAL (1U << 11)
+#define MALLOC_CAP_SPIRAM (1U << 10)
+
+static inline void *heap_caps_calloc(size_t n, size_t size, uint32_t caps)
+{
+    (void)caps;
+    return calloc(n, size);
+}
+
+static inline void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    (void)caps;
+    return malloc(size);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+/* Host shim: heap figures are fixed values the suites can assert on. */
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#define HOST_FREE_HEAP_SIZE 123456U
+#define HOST_MIN_FREE_HEAP_SIZE 65432U
+
+static inline uint32_t esp_get_free_heap_size(void)
+{
+    return HOST_FREE_HEAP_SIZE;
+}
+
+static inline uint32_t esp_get_minimum_free_heap_size(void)
+{
+    return HOST_MIN_FREE_HEAP_SIZE;
+}
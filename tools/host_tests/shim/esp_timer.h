@@ -0,0 +1,7 @@
+#pragma once
+
+/* Host shim: a fake clock the suites advance explicitly (host_freertos.h). */
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
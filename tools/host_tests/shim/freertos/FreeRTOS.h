@@ -0,0 +1,23 @@
+#pragma once
+
+/* Host shim: FreeRTOS types and constants as configured for ESP-IDF (dual core, 1 kHz tick). */
+
+#include <stdint.h>
+
+#include "sdkconfig.h"
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint8_t StackType_t;
+
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFFU)
+#define portNUM_PROCESSORS 2
+#define portTICK_PERIOD_MS (1000 / CONFIG_FREERTOS_HZ)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((uint64_t)(ms) * CONFIG_FREERTOS_HZ) / 1000U))
+#define pdTRUE ((BaseType_t)1)
+#define pdFALSE ((BaseType_t)0)
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define configMAX_TASK_NAME_LEN 16
+#define tskNO_AFFINITY ((BaseType_t)0x7FFFFFFF)
@@ -0,0 +1,19 @@
+#pragma once
+
+/* Host shim: force-included into every suite for newlib extensions glibc may lack. */
+
+#include <stddef.h>
+#include <string.h>
+
+static inline size_t host_strlcpy(char *dst, const char *src, size_t size)
+{
+    const size_t len = strlen(src);
+    if (size > 0U) {
+        const size_t n = (len < size - 1U) ? len : size - 1U;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+
+#define strlcpy host_strlcpy
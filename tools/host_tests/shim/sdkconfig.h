@@ -0,0 +1,9 @@
+#pragma once
+
+/* Host shim: the sdkconfig options the modules under test read. */
+
+#define CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ 240
+#define CONFIG_FREERTOS_HZ 1000
+#define CONFIG_FREERTOS_USE_TRACE_FACILITY 1
+#define CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS 1
+#define CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID 1
@@ -0,0 +1,301 @@
+/*
+ * Host tests for main/json_reader.c: strict rejection of malformed bodies, lookups restricted to
+ * root members, unescaping, deep nesting without recursion, and tokenize+lookup throughput.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "host_test.h"
+#include "json_reader.h"
+
+#define MAX_TOKS 32U
+#define DEEP_NESTING 10000U
+
+// The shape of a typical control request body: six root fields.
+static const char s_body[] =
+    "{\"layer\":2,\"enabled\":true,\"volume\":40,\"name\":\"Media\",\"url\":\"http://10.0.0.5/fw.bin\",\"slot\":3}";
+
+static esp_err_t parse(const char *json, json_doc_t *doc, json_tok_t *toks, size_t max_toks)
+{
+    return json_reader_parse(doc, json, strlen(json), toks, max_toks);
+}
+
+static void test_rejects_malformed(void)
+{
+    static const char *const bad[] = {
+        "",
+        "   ",
+        "{",
+        "}",
+        "[1,2",
+        "[1,2]]",
+        "{\"a\":1,}",
+        "[1,2,]",
+        "[,1]",
+        "{,}",
+        "{\"a\" 1}",
+        "{\"a\":}",
+        "{\"a\"}",
+        "{1:2}",
+        "{\"a\":1 \"b\":2}",
+        "{\"a\":[1}",
+        "[{\"a\":1]}",
+        "01",
+        "-01",
+        "[00]",
+        "1.",
+        ".5",
+        "1e",
+        "1e+",
+        "-",
+        "+1",
+        "0x10",
+        "tru",
+        "nul",
+        "truex",
+        "[true1]",
+        "\"\\x\"",
+        "\"\\u12\"",
+        "\"\\u12g4\"",
+        "\"abc",
+        "\"\\",
+        "\"tab\there\"",
+        "\"line\nbreak\"",
+        "{\"a\":1}x",
+        "{\"a\":1} {}",
+        "1 2",
+        "[1]:",
+        "'a'",
+        "{a:1}",
+    };
+    json_tok_t toks[MAX_TOKS];
+    json_doc_t doc;
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+        const esp_err_t err = parse(bad[i], &doc, toks, MAX_TOKS);
+        if (err != ESP_ERR_INVALID_ARG) {
+            fprintf(stderr, "FAIL  accepted malformed input #%zu: %s (err %d)\n", i, bad[i], err);
+            ++g_host_test_failures;
+        }
+    }
+
+    // Every proper prefix of a valid body is truncated and must be rejected.
+    for (size_t n = 0; n + 1U < sizeof(s_body) - 1U; ++n) {
+        char *copy = malloc(n + 1U);
+        memcpy(copy, s_body, n);  // exact-size heap copy so ASan sees any read past len
+        if (json_reader_parse(&doc, copy, n, toks, MAX_TOKS) != ESP_ERR_INVALID_ARG) {
+            fprintf(stderr, "FAIL  accepted truncated body of %zu bytes\n", n);
+            ++g_host_test_failures;
+        }
+        free(copy);
+    }
+}
+
+static void test_accepts_valid(void)
+{
+    static const char *const good[] = {
+        "0",
+        "-0",
+        "1.5e-3",
+        "-12E+2",
+        "true",
+        "null",
+        "\"\"",
+        "[]",
+        "{}",
+        " { \"a\" : [ 1 , { } , [ ] , \"x\" ] } ",
+        "\"\\\"\\\\\\/\\b\\f\\n\\r\\t\\u00e9\"",
+    };
+    json_tok_t toks[MAX_TOKS];
+    json_doc_t doc;
+    for (size_t i = 0; i < sizeof(good) / sizeof(good[0]); ++i) {
+        const esp_err_t err = parse(good[i], &doc, toks, MAX_TOKS);
+        if (err != ESP_OK) {
+            fprintf(stderr, "FAIL  rejected valid input #%zu: %s (err %d)\n", i, good[i], err);
+            ++g_host_test_failures;
+        }
+    }
+
+    CHECK(parse(s_body, &doc, toks, MAX_TOKS) == ESP_OK);
+    CHECK_EQ_U(doc.count, 13U);
+    CHECK_EQ_U(toks[0].size, 6U);
+    CHECK(parse(s_body, &doc, toks, 12U) == ESP_ERR_NO_MEM);
+}
+
+static void test_lookup(void)
+{
+    static const char json[] =
+        "{\"note\":\"\\\"layer\\\":9\",\"nested\":{\"layer\":8},\"list\":[{\"layer\":7}],"
+        "\"l\\u0061yer\":3,\"on\":1,\"off\":false,\"big\":2147483648,\"neg\":-2147483648,\"frac\":1.5}";
+    json_tok_t toks[MAX_TOKS];
+    json_doc_t doc;
+    CHECK(parse(json, &doc, toks, MAX_TOKS) == ESP_OK);
+
+    // Only root members match: not the quoted text in "note", not nested objects, escaped keys decode.
+    int v = 0;
+    CHECK(json_reader_get_int(&doc, "layer", &v) && v == 3);
+    CHECK(json_reader_get_int(&doc, "neg", &v) && v == -2147483647 - 1);
+    CHECK(!json_reader_get_int(&doc, "big", &v));
+    CHECK(!json_reader_get_int(&doc, "frac", &v));
+    CHECK(!json_reader_get_int(&doc, "note", &v));
+    CHECK(!json_reader_get_int(&doc, "missing", &v));
+    CHECK(json_reader_find(&doc, 0, "nested") > 0);
+    CHECK(json_reader_find(&doc, json_reader_find(&doc, 0, "nested"), "layer") > 0);
+
+    bool b = false;
+    CHECK(json_reader_get_bool(&doc, "on", &b) && b);
+    CHECK(json_reader_get_bool(&doc, "off", &b) && !b);
+    CHECK(!json_reader_get_bool(&doc, "layer", &b));
+
+    char s[16];
+    CHECK(json_reader_get_string(&doc, "note", s, sizeof(s)) && strcmp(s, "\"layer\":9") == 0);
+    CHECK(!json_reader_get_string(&doc, "note", s, 9U));  // rejected, not truncated
+    CHECK(json_reader_get_string(&doc, "note", s, 10U));
+}
+
+static void test_unescape(void)
+{
+    static const char json[] = "[\"\\u00e9\\u20ac\",\"\\ud83d\\ude00\",\"\\ud83d\",\"a\\u0000b\",\"\\/\\t\"]";
+    json_tok_t toks[MAX_TOKS];
+    json_doc_t doc;
+    CHECK(parse(json, &doc, toks, MAX_TOKS) == ESP_OK);
+
+    char s[16];
+    CHECK(json_reader_string(&doc, 1, s, sizeof(s)) && strcmp(s, "\xC3\xA9\xE2\x82\xAC") == 0);
+    CHECK(json_reader_string(&doc, 2, s, sizeof(s)) && strcmp(s, "\xF0\x9F\x98\x80") == 0);
+    CHECK(json_reader_string(&doc, 3, s, sizeof(s)) && strcmp(s, "?") == 0);  // lone surrogate
+    CHECK(!json_reader_string(&doc, 4, s, sizeof(s)));                          // embedded NUL
+    CHECK(json_reader_string(&doc, 5, s, sizeof(s)) && strcmp(s, "/\t") == 0);
+    CHECK(!json_reader_string(&doc, 2, s, 4U));  // 4-byte sequence needs 5 bytes with the NUL
+}
+
+static void test_deep_nesting(void)
+{
+    const size_t len = 2U * DEEP_NESTING;
+    char *json = malloc(len);
+    json_tok_t *toks = malloc(DEEP_NESTING * sizeof(*toks));
+    memset(json, '[', DEEP_NESTING);
+    memset(&json[DEEP_NESTING], ']', DEEP_NESTING);
+
+    json_doc_t doc;
+    CHECK(json_reader_parse(&doc, json, len, toks, DEEP_NESTING) == ESP_OK);
+    CHECK_EQ_U(doc.count, DEEP_NESTING);
+    CHECK_EQ_U(toks[DEEP_NESTING - 1U].parent, DEEP_NESTING - 2U);
+    CHECK_EQ_U(toks[0].end, len);
+
+    // One bracket short at either end.
+    CHECK(json_reader_parse(&doc, json, len - 1U, toks, DEEP_NESTING) == ESP_ERR_INVALID_ARG);
+    CHECK(json_reader_parse(&doc, &json[1], len - 1U, toks, DEEP_NESTING) == ESP_ERR_INVALID_ARG);
+    CHECK(json_reader_parse(&doc, json, len, toks, DEEP_NESTING - 1U) == ESP_ERR_NO_MEM);
+
+    free(toks);
+    free(json);
+}
+
+static void test_limits(void)
+{
+    json_tok_t toks[MAX_TOKS];
+    json_doc_t doc;
+    const size_t len = 0x10000U;
+    char *json = malloc(len);
+    memset(json, ' ', len);
+    json[0] = '0';
+    CHECK(json_reader_parse(&doc, json, len, toks, MAX_TOKS) == ESP_ERR_INVALID_ARG);
+    CHECK(json_reader_parse(&doc, json, 0xFFFEU, toks, MAX_TOKS) == ESP_OK);
+    free(json);
+
+    CHECK(json_reader_parse(NULL, "1", 1U, toks, MAX_TOKS) == ESP_ERR_INVALID_ARG);
+    CHECK(json_reader_parse(&doc, "1", 1U, toks, 0U) == ESP_ERR_NO_MEM);
+}
+
+// Every single-byte mutation of the body must either parse or be rejected, never read out of bounds.
+static void test_mutations(void)
+{
+    static const char alphabet[] = "{}[]:,\"\\ 0-1.eEtfnu\x01\x7f";
+    const size_t len = sizeof(s_body) - 1U;
+    char *copy = malloc(len);
+    json_tok_t toks[MAX_TOKS];
+    json_doc_t doc;
+    size_t accepted = 0;
+    for (size_t pos = 0; pos < len; ++pos) {
+        for (size_t a = 0; a < sizeof(alphabet) - 1U; ++a) {
+            memcpy(copy, s_body, len);
+            copy[pos] = alphabet[a];
+            const esp_err_t err = json_reader_parse(&doc, copy, len, toks, MAX_TOKS);
+            CHECK(err == ESP_OK || err == ESP_ERR_INVALID_ARG || err == ESP_ERR_NO_MEM);
+            if (err == ESP_OK) {
+                ++accepted;
+                char s[64];
+                int v = 0;
+                bool b = false;
+                (void)json_reader_get_string(&doc, "url", s, sizeof(s));
+                (void)json_reader_get_int(&doc, "layer", &v);
+                (void)json_reader_get_bool(&doc, "enabled", &b);
+            }
+        }
+    }
+    CHECK(accepted > 0U);
+    free(copy);
+}
+
+int host_test_run(void)
+{
+    test_rejects_malformed();
+    test_accepts_valid();
+    test_lookup();
+    test_unescape();
+    test_deep_nesting();
+    test_limits();
+    test_mutations();
+    return g_host_test_failures;
+}
+
+static volatile int s_bench_sink;
+
+static void bench_parse(uint32_t i)
+{
+    json_tok_t toks[MAX_TOKS];
+    json_doc_t doc;
+    s_bench_sink = (int)json_reader_parse(&doc, s_body, sizeof(s_body) - 1U, toks, MAX_TOKS) + (int)i;
+}
+
+static void bench_parse_lookup(uint32_t i)
+{
+    json_tok_t toks[MAX_TOKS];
+    json_doc_t doc;
+    (void)json_reader_parse(&doc, s_body, sizeof(s_body) - 1U, toks, MAX_TOKS);
+    int layer = 0;
+    int volume = 0;
+    int slot = 0;
+    bool enabled = false;
+    char name[16];
+    char url[64];
+    (void)json_reader_get_int(&doc, "layer", &layer);
+    (void)json_reader_get_bool(&doc, "enabled", &enabled);
+    (void)json_reader_get_int(&doc, "volume", &volume);
+    (void)json_reader_get_string(&doc, "name", name, sizeof(name));
+    (void)json_reader_get_string(&doc, "url", url, sizeof(url));
+    (void)json_reader_get_int(&doc, "slot", &slot);
+    s_bench_sink = layer + volume + slot + (int)enabled + name[0] + url[0] + (int)i;
+}
+
+static void bench_deep(uint32_t i)
+{
+    static char json[2U * 256U];
+    static json_tok_t toks[256];
+    if (json[0] != '[') {
+        memset(json, '[', 256U);
+        memset(&json[256], ']', 256U);
+    }
+    json_doc_t doc;
+    s_bench_sink = (int)json_reader_parse(&doc, json, sizeof(json), toks, 256U) + (int)i;
+}
+
+void host_test_bench(uint32_t iterations)
+{
+    printf("json_reader: %u iterations x 7 rounds, body %zu bytes\n", (unsigned)iterations, sizeof(s_body) - 1U);
+    const double parse_ns = host_bench("parse 6-field body", bench_parse, iterations);
+    (void)host_bench("parse + 6 lookups", bench_parse_lookup, iterations);
+    (void)host_bench("parse 256-deep array", bench_deep, iterations);
+    printf("tokenize throughput: %.1f MB/s\n", (double)(sizeof(s_body) - 1U) * 1000.0 / parse_ns);
+}
@@ -0,0 +1,285 @@
+/*
+ * Host tests for main/metrics.c: no increments lost under contention, exposition format (one
+ * HELP/TYPE block per family, cumulative buckets, _count equal to +Inf) at several buffer sizes,
+ * a histogram sum past 32 bits, and the cost of the write path.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_system.h"
+#include "host_freertos.h"
+#include "host_test.h"
+#include "metrics.h"
+
+#define WRITER_THREADS 4
+#define WRITER_UPDATES 100000U
+#define RENDER_MAX 16384U
+
+typedef struct {
+    char text[RENDER_MAX];
+    size_t len;
+    uint32_t flushes;
+    uint32_t fail_after;     // flush error after this many calls, 0 = never
+} render_sink_t;
+
+static esp_err_t sink_flush(void *ctx, const char *data, size_t len)
+{
+    render_sink_t *sink = ctx;
+    if (sink->fail_after != 0U && sink->flushes >= sink->fail_after) {
+        return ESP_FAIL;
+    }
+    ++sink->flushes;
+    if (sink->len + len >= sizeof(sink->text)) {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(&sink->text[sink->len], data, len);
+    sink->len += len;
+    sink->text[sink->len] = '\0';
+    return ESP_OK;
+}
+
+static esp_err_t render(render_sink_t *sink, size_t cap)
+{
+    memset(sink, 0, sizeof(*sink));
+    char *buf = malloc(cap);
+    const esp_err_t err = metrics_render(buf, cap, sink_flush, sink);
+    free(buf);
+    return err;
+}
+
+// Value of the first sample line that starts with series (name plus labels), or -1.
+static long long sample_value(const char *text, const char *series)
+{
+    const size_t n = strlen(series);
+    for (const char *line = text; line != NULL && *line != '\0';) {
+        if (strncmp(line, series, n) == 0 && line[n] == ' ') {
+            return strtoll(&line[n + 1], NULL, 10);
+        }
+        line = strchr(line, '\n');
+        line = (line != NULL) ? line + 1 : NULL;
+    }
+    return -1;
+}
+
+static void *writer_thread(void *arg)
+{
+    (void)arg;
+    for (uint32_t i = 0; i < WRITER_UPDATES; ++i) {
+        metrics_inc(METRIC_HA_CONNECTS);
+        metrics_add(METRIC_OLED_FLUSH_BYTES, 2U);
+        metrics_observe_us(METRIC_HIST_SCAN_LOOP, i % 60000U);
+    }
+    return NULL;
+}
+
+static void test_concurrent_updates(void)
+{
+    pthread_t threads[WRITER_THREADS];
+    for (int i = 0; i < WRITER_THREADS; ++i) {
+        CHECK(pthread_create(&threads[i], NULL, writer_thread, NULL) == 0);
+    }
+    // Render concurrently with the writers; the output must stay well-formed while values move.
+    render_sink_t *sink = malloc(sizeof(*sink));
+    for (int i = 0; i < 20; ++i) {
+        CHECK(render(sink, 512U) == ESP_OK);
+    }
+    for (int i = 0; i < WRITER_THREADS; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    CHECK(render(sink, 512U) == ESP_OK);
+    const unsigned long long total = (unsigned long long)WRITER_THREADS * WRITER_UPDATES;
+    CHECK_EQ_U(sample_value(sink->text, "macropad_ha_connects_total"), total);
+    CHECK_EQ_U(sample_value(sink->text, "macropad_oled_flush_bytes_total"), 2U * total);
+    CHECK_EQ_U(sample_value(sink->text, "macropad_scan_loop_seconds_count"), total);
+    CHECK_EQ_U(sample_value(sink->text, "macropad_scan_loop_seconds_bucket{le=\"+Inf\"}"), total);
+    free(sink);
+}
+
+static void test_gauges_and_labels(void)
+{
+    metrics_set(METRIC_HA_QUEUE_DEPTH, 7U);
+    metrics_inc(METRIC_HID_CONSUMER_INFLIGHT);
+    metrics_inc(METRIC_HID_CONSUMER_INFLIGHT);
+    metrics_dec(METRIC_HID_CONSUMER_INFLIGHT);
+    metrics_add(METRIC_HID_REPORTS_BLE_FAILED, 3U);
+    metrics_inc(METRIC_COUNT);  // out of range: ignored
+
+    render_sink_t *sink = malloc(sizeof(*sink));
+    CHECK(render(sink, 512U) == ESP_OK);
+    CHECK_EQ_U(sample_value(sink->text, "macropad_ha_queue_depth"), 7U);
+    CHECK_EQ_U(sample_value(sink->text, "macropad_hid_consumer_inflight"), 1U);
+    CHECK_EQ_U(sample_value(sink->text, "macropad_hid_reports_total{transport=\"ble\",result=\"failed\"}"), 3U);
+    CHECK_EQ_U(sample_value(sink->text, "macropad_heap_free_bytes"), HOST_FREE_HEAP_SIZE);
+    CHECK_EQ_U(sample_value(sink->text, "macropad_task_stack_high_water_bytes{task=\"display_task\"}"), 2048U);
+    CHECK(strstr(sink->text, "task=\"ha_worker\"") == NULL);  // not running: skipped
+    CHECK_EQ_U(sample_value(sink->text, "macropad_wifi_rssi_dbm"), (unsigned long long)-61);
+    free(sink);
+}
+
+static void test_histogram_buckets(void)
+{
+    // macropad_oled_flush_seconds bounds: 5, 10, 20, 30, 50, 100 ms.
+    static const uint32_t observations[] = {0U, 5000U, 5001U, 20000U, 99999U, 100000U, 100001U, 4000000000U};
+    for (size_t i = 0; i < sizeof(observations) / sizeof(observations[0]); ++i) {
+        metrics_observe_us(METRIC_HIST_OLED_FLUSH, observations[i]);
+    }
+
+    render_sink_t *sink = malloc(sizeof(*sink));
+    CHECK(render(sink, 512U) == ESP_OK);
+    CHECK_EQ_U(sample_value(sink->text, "macropad_oled_flush_seconds_bucket{le=\"0.005000\"}"), 2U);
+    CHECK_EQ_U(sample_value(sink->text, "macropad_oled_flush_seconds_bucket{le=\"0.010000\"}"), 3U);
+    CHECK_EQ_U(sample_value(sink->text, "macropad_oled_flush_seconds_bucket{le=\"0.030000\"}"), 4U);
+    CHECK_EQ_U(sample_value(sink->text, "macropad_oled_flush_seconds_bucket{le=\"0.100000\"}"), 6U);
+    CHECK_EQ_U(sample_value(sink->text, "macropad_oled_flush_seconds_bucket{le=\"+Inf\"}"), 8U);
+    CHECK_EQ_U(sample_value(sink->text, "macropad_oled_flush_seconds_count"), 8U);
+
+    // Every histogram: buckets never decrease and _count equals the +Inf bucket.
+    long long prev = -1;
+    bool in_hist = false;
+    for (char *line = strtok(sink->text, "\n"); line != NULL; line = strtok(NULL, "\n")) {
+        char *bucket = strstr(line, "_bucket{le=\"");
+        if (bucket != NULL) {
+            const long long v = strtoll(strrchr(line, ' ') + 1, NULL, 10);
+            CHECK(!in_hist || v >= prev);
+            prev = v;
+            in_hist = true;
+        } else if (in_hist && strstr(line, "_count ") != NULL) {
+            CHECK_EQ_U(strtoll(strrchr(line, ' ') + 1, NULL, 10), prev);
+            in_hist = false;
+        }
+    }
+    free(sink);
+}
+
+static void test_histogram_sum_past_32_bits(void)
+{
+    // 9000 s in microseconds is past UINT32_MAX; the sum must not wrap.
+    for (int i = 0; i < 3; ++i) {
+        metrics_observe_us(METRIC_HIST_HA_POST, 3000000000U);
+    }
+
+    render_sink_t *sink = malloc(sizeof(*sink));
+    CHECK(render(sink, 512U) == ESP_OK);
+    CHECK_EQ_U(sample_value(sink->text, "macropad_ha_post_seconds_sum"), 9000U);
+    CHECK_EQ_U(sample_value(sink->text, "macropad_ha_post_seconds_count"), 3U);
+    free(sink);
+}
+
+// One HELP and one TYPE line per family, immediately followed by that family's samples only.
+static void check_families(const char *text)
+{
+    char families[64][64];
+    size_t family_count = 0;
+    char current[64] = "";
+    char *copy = strdup(text);
+    for (char *line = strtok(copy, "\n"); line != NULL; line = strtok(NULL, "\n")) {
+        char name[64];
+        if (sscanf(line, "# TYPE %63s", name) == 1) {
+            for (size_t i = 0; i < family_count; ++i) {
+                if (strcmp(families[i], name) == 0) {
+                    fprintf(stderr, "FAIL  family %s has more than one TYPE line\n", name);
+                    ++g_host_test_failures;
+                }
+            }
+            if (family_count < 64U) {
+                strlcpy(families[family_count++], name, sizeof(families[0]));
+            }
+            strlcpy(current, name, sizeof(current));
+            continue;
+        }
+        if (line[0] == '#') {
+            CHECK(strncmp(line, "# HELP ", 7) == 0);
+            continue;
+        }
+        const size_t n = strlen(current);
+        CHECK(n > 0U && strncmp(line, current, n) == 0);
+        CHECK(strchr(line, ' ') != NULL);
+    }
+    free(copy);
+    CHECK(family_count >= 13U);
+}
+
+static void test_format_across_buffer_sizes(void)
+{
+    render_sink_t *reference = malloc(sizeof(*reference));
+    render_sink_t *sink = malloc(sizeof(*sink));
+    CHECK(render(reference, 4096U) == ESP_OK);
+    check_families(reference->text);
+
+    // Small buffers only change where the chunks split, never the text.
+    static const size_t caps[] = {256U, 300U, 512U, 1024U};
+    for (size_t i = 0; i < sizeof(caps) / sizeof(caps[0]); ++i) {
+        CHECK(render(sink, caps[i]) == ESP_OK);
+        CHECK(strcmp(sink->text, reference->text) == 0);
+        CHECK(sink->flushes >= reference->len / caps[i]);
+    }
+
+    // The documented minimum must hold every line the exposition can produce.
+    CHECK(render(sink, 128U) == ESP_OK);
+    CHECK(strcmp(sink->text, reference->text) == 0);
+
+    CHECK(render(sink, 127U) == ESP_ERR_INVALID_ARG);
+    CHECK(metrics_render(NULL, 512U, sink_flush, sink) == ESP_ERR_INVALID_ARG);
+
+    // A failed flush stops the render and is reported.
+    memset(sink, 0, sizeof(*sink));
+    sink->fail_after = 2U;
+    char buf[256];
+    CHECK(metrics_render(buf, sizeof(buf), sink_flush, sink) == ESP_FAIL);
+    CHECK_EQ_U(sink->flushes, 2U);
+
+    free(sink);
+    free(reference);
+}
+
+int host_test_run(void)
+{
+    host_task_add("display_task", 4U, 0, 2048U);
+    host_task_add("httpd", 5U, tskNO_AFFINITY, 3000U);
+    host_set_wifi_rssi(true, -61);
+
+    test_concurrent_updates();
+    test_gauges_and_labels();
+    test_histogram_buckets();
+    test_histogram_sum_past_32_bits();
+    test_format_across_buffer_sizes();
+    return g_host_test_failures;
+}
+
+static volatile uint32_t s_bench_sink;
+
+static void bench_inc(uint32_t i)
+{
+    metrics_inc(METRIC_HA_CONNECTS);
+    s_bench_sink = i;
+}
+
+static void bench_observe(uint32_t i)
+{
+    metrics_observe_us(METRIC_HIST_HA_POST, (i * 7919U) % 6000000U);
+}
+
+static esp_err_t bench_discard(void *ctx, const char *data, size_t len)
+{
+    (void)ctx;
+    s_bench_sink += (uint32_t)len + (uint32_t)data[0];
+    return ESP_OK;
+}
+
+static void bench_render(uint32_t i)
+{
+    char buf[512];
+    s_bench_sink += (uint32_t)metrics_render(buf, sizeof(buf), bench_discard, NULL) + i;
+}
+
+void host_test_bench(uint32_t iterations)
+{
+    host_task_add("display_task", 4U, 0, 2048U);
+    printf("metrics: %u iterations x 7 rounds\n", (unsigned)iterations);
+    (void)host_bench("metrics_inc", bench_inc, iterations);
+    (void)host_bench("metrics_observe_us", bench_observe, iterations);
+    (void)host_bench("metrics_render (512 B chunks)", bench_render, iterations / 100U + 1U);
+}
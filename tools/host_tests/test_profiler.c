@@ -0,0 +1,307 @@
+/*
+ * Host tests for main/profiler.c against the fake task table in host_freertos.c: per-task and
+ * per-core shares over the sliding window, tasks appearing and disappearing, and PROF_SCOPE
+ * accounting (migration, max ageing, top-N ordering, window totals past 32 bits).
+ */
+
+#include <string.h>
+
+#include "host_freertos.h"
+#include "host_test.h"
+#include "keymap_config.h"
+#include "profiler.h"
+#include "sdkconfig.h"
+
+#define SECOND_US 1000000U
+#define CYCLES_PER_US ((uint32_t)CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ)
+
+typedef struct {
+    TaskHandle_t handle;
+    uint32_t runtime;
+    uint32_t load_us;        // run time added per simulated second
+} fake_task_t;
+
+enum {
+    TASK_IDLE0 = 0,
+    TASK_IDLE1,
+    TASK_INPUT,
+    TASK_DISPLAY,
+    TASK_COUNT,
+};
+
+static fake_task_t s_tasks[TASK_COUNT];
+static uint32_t s_total;
+static TaskHandle_t s_profiler;
+
+// One simulated second: every task runs its load, then the profiler takes one sample.
+static void tick(void)
+{
+    s_total += SECOND_US;
+    host_set_total_runtime(s_total);
+    for (size_t i = 0; i < TASK_COUNT; ++i) {
+        if (s_tasks[i].handle != NULL) {
+            s_tasks[i].runtime += s_tasks[i].load_us;
+            host_task_set_runtime(s_tasks[i].handle, s_tasks[i].runtime);
+        }
+    }
+    host_advance_time_us(SECOND_US);
+    host_task_step(s_profiler);
+}
+
+// input_task shares core 0 with IDLE0, display_task core 1 with IDLE1; idle takes the rest.
+static void set_load(size_t task, uint32_t load_us)
+{
+    const size_t idle = (task == TASK_INPUT) ? TASK_IDLE0 : TASK_IDLE1;
+    s_tasks[task].load_us = load_us;
+    s_tasks[idle].load_us = SECOND_US - load_us;
+}
+
+static const profiler_task_stat_t *find_task(const profiler_report_t *rep, const char *name)
+{
+    for (size_t i = 0; i < rep->task_count; ++i) {
+        if (strcmp(rep->tasks[i].name, name) == 0) {
+            return &rep->tasks[i];
+        }
+    }
+    return NULL;
+}
+
+static const profiler_scope_stat_t *find_scope(const profiler_report_t *rep, prof_scope_id_t id)
+{
+    for (size_t i = 0; i < rep->scope_count; ++i) {
+        if (rep->scopes[i].id == id) {
+            return &rep->scopes[i];
+        }
+    }
+    return NULL;
+}
+
+static void timed_scope(prof_scope_id_t id, uint32_t us)
+{
+    PROF_SCOPE(id);
+    host_cpu_advance_cycles(us * CYCLES_PER_US);
+}
+
+static void test_task_shares(profiler_report_t *rep)
+{
+    // input_task on core 0 at 25 %, display_task on core 1 at 10 %.
+    set_load(TASK_INPUT, 250000U);
+    set_load(TASK_DISPLAY, 100000U);
+    for (uint32_t i = 0; i < MACRO_PROFILER_WINDOW_SEC + 2U; ++i) {
+        tick();
+    }
+    CHECK(profiler_get_report(rep) == ESP_OK);
+    CHECK(rep->runtime_stats);
+    CHECK_EQ_U(rep->window_ms, MACRO_PROFILER_WINDOW_SEC * 1000U);
+
+    const profiler_task_stat_t *input = find_task(rep, "input_task");
+    const profiler_task_stat_t *display = find_task(rep, "display_task");
+    CHECK(input != NULL && display != NULL);
+    if (input == NULL || display == NULL) {
+        return;
+    }
+    CHECK_EQ_U(input->cpu_permille, 250U);
+    CHECK_EQ_U(input->runtime_us, 250000U * MACRO_PROFILER_WINDOW_SEC);
+    CHECK_EQ_U(input->core, 0U);
+    CHECK_EQ_U(input->priority, 5U);
+    CHECK_EQ_U(input->stack_free_bytes, 1500U);
+    CHECK_EQ_U(display->cpu_permille, 100U);
+    CHECK_EQ_U(rep->core_busy_permille[0], 250U);
+    CHECK_EQ_U(rep->core_busy_permille[1], 100U);
+    // Sorted by run time: IDLE1 (90 %), IDLE0 (75 %), input_task, display_task.
+    CHECK(strcmp(rep->tasks[0].name, "IDLE1") == 0);
+    CHECK(strcmp(rep->tasks[1].name, "IDLE0") == 0);
+    CHECK(input < display);
+}
+
+static void test_spike_ages_out(profiler_report_t *rep)
+{
+    // One second at 90 %, then back to 10 %: visible for a window, then gone.
+    set_load(TASK_DISPLAY, 900000U);
+    tick();
+    set_load(TASK_DISPLAY, 100000U);
+    tick();
+    CHECK(profiler_get_report(rep) == ESP_OK);
+    const profiler_task_stat_t *display = find_task(rep, "display_task");
+    CHECK(display != NULL && display->cpu_permille == 180U);
+
+    for (uint32_t i = 0; i < MACRO_PROFILER_WINDOW_SEC; ++i) {
+        tick();
+    }
+    CHECK(profiler_get_report(rep) == ESP_OK);
+    display = find_task(rep, "display_task");
+    CHECK(display != NULL && display->cpu_permille == 100U);
+    CHECK_EQ_U(rep->core_busy_permille[1], 100U);
+}
+
+static void test_task_lifecycle(profiler_report_t *rep)
+{
+    // A task born inside the window is measured from its first sample, not from zero.
+    TaskHandle_t ota = host_task_add("ota_worker", 3U, tskNO_AFFINITY, 4096U);
+    host_task_set_runtime(ota, 5000000U);  // run time accumulated before the first sample
+    tick();
+    host_task_set_runtime(ota, 5500000U);
+    tick();
+    CHECK(profiler_get_report(rep) == ESP_OK);
+    const profiler_task_stat_t *stat = find_task(rep, "ota_worker");
+    CHECK(stat != NULL);
+    if (stat != NULL) {
+        CHECK_EQ_U(stat->runtime_us, 500000U);
+        CHECK_EQ_U(stat->cpu_permille, 500U);
+        CHECK(stat->core == -1);
+    }
+
+    // Deleted tasks leave the report and free their slot.
+    host_task_remove(ota);
+    tick();
+    CHECK(profiler_get_report(rep) == ESP_OK);
+    CHECK(find_task(rep, "ota_worker") == NULL);
+
+    // A new task that reuses the slot starts from its own first sample.
+    TaskHandle_t again = host_task_add("ota_worker", 3U, tskNO_AFFINITY, 4096U);
+    host_task_set_runtime(again, 100U);
+    tick();
+    CHECK(profiler_get_report(rep) == ESP_OK);
+    stat = find_task(rep, "ota_worker");
+    CHECK(stat != NULL && stat->runtime_us == 0U);
+    host_task_remove(again);
+    tick();
+}
+
+static void test_scopes(profiler_report_t *rep)
+{
+    host_cpu_set_core(0);
+    for (int i = 0; i < 4; ++i) {
+        timed_scope(PROF_SCOPE_KEY_SCAN, 100U);
+    }
+    timed_scope(PROF_SCOPE_OLED_FLUSH, 5000U);
+
+    // Migrated mid-scope: cycle counters of different cores cannot be subtracted, so it is dropped.
+    {
+        PROF_SCOPE(PROF_SCOPE_KEY_SCAN);
+        host_cpu_advance_cycles(1000000U);
+        host_cpu_set_core(1);
+    }
+    host_cpu_set_core(0);
+    tick();
+
+    CHECK(profiler_get_report(rep) == ESP_OK);
+    const profiler_scope_stat_t *scan = find_scope(rep, PROF_SCOPE_KEY_SCAN);
+    const profiler_scope_stat_t *flush = find_scope(rep, PROF_SCOPE_OLED_FLUSH);
+    CHECK(scan != NULL && flush != NULL);
+    if (scan == NULL || flush == NULL) {
+        return;
+    }
+    CHECK_EQ_U(scan->calls, 4U);
+    CHECK_EQ_U(scan->total_us, 400U);
+    CHECK_EQ_U(scan->avg_us, 100U);
+    CHECK_EQ_U(scan->max_us, 100U);
+    CHECK_EQ_U(flush->max_us, 5000U);
+    CHECK(rep->scopes[0].id == PROF_SCOPE_OLED_FLUSH);  // hottest first
+    CHECK(strcmp(profiler_scope_name(PROF_SCOPE_OLED_FLUSH), "oled_flush") == 0);
+    CHECK(strcmp(profiler_scope_name(PROF_SCOPE_COUNT), "unknown") == 0);
+
+    // Calls keep counting; the 5 ms maximum ages out with the sample that recorded it.
+    for (uint32_t i = 0; i < MACRO_PROFILER_WINDOW_SEC; ++i) {
+        timed_scope(PROF_SCOPE_OLED_FLUSH, 2000U);
+        tick();
+    }
+    CHECK(profiler_get_report(rep) == ESP_OK);
+    flush = find_scope(rep, PROF_SCOPE_OLED_FLUSH);
+    CHECK(flush != NULL && flush->max_us == 2000U && flush->calls == MACRO_PROFILER_WINDOW_SEC);
+    CHECK(find_scope(rep, PROF_SCOPE_KEY_SCAN) == NULL);  // no calls left in the window
+
+    // Only the top scopes by total time are reported.
+    for (uint32_t id = 0; id < PROF_SCOPE_COUNT; ++id) {
+        timed_scope((prof_scope_id_t)id, 10U * (id + 1U));
+    }
+    tick();
+    CHECK(profiler_get_report(rep) == ESP_OK);
+    const uint32_t want = (PROF_SCOPE_COUNT < MACRO_PROFILER_TOP_SCOPES) ? PROF_SCOPE_COUNT : MACRO_PROFILER_TOP_SCOPES;
+    CHECK_EQ_U(rep->scope_count, want);
+    for (size_t i = 1; i < rep->scope_count; ++i) {
+        CHECK(rep->scopes[i - 1].total_us >= rep->scopes[i].total_us);
+    }
+}
+
+static void test_scope_total_past_32_bits(profiler_report_t *rep)
+{
+    // Age out the scopes of the previous test.
+    for (uint32_t i = 0; i < MACRO_PROFILER_WINDOW_SEC; ++i) {
+        tick();
+    }
+
+    // 4 x 10 s is far more than 2^32 cycles; the window total must not wrap.
+    host_cpu_set_core(0);
+    for (int i = 0; i < 2; ++i) {
+        timed_scope(PROF_SCOPE_OLED_RENDER, 10U * SECOND_US);
+        timed_scope(PROF_SCOPE_OLED_RENDER, 10U * SECOND_US);
+        tick();
+    }
+    CHECK(profiler_get_report(rep) == ESP_OK);
+    const profiler_scope_stat_t *render = find_scope(rep, PROF_SCOPE_OLED_RENDER);
+    CHECK(render != NULL && render->calls == 4U);
+    if (render == NULL) {
+        return;
+    }
+    CHECK_EQ_U(render->total_us, 40U * SECOND_US);
+    CHECK_EQ_U(render->avg_us, 10U * SECOND_US);
+    CHECK_EQ_U(render->max_us, 10U * SECOND_US);
+}
+
+int host_test_run(void)
+{
+    static profiler_report_t rep;
+    CHECK(profiler_get_report(&rep) == ESP_ERR_INVALID_STATE);
+
+    s_tasks[TASK_IDLE0].handle = host_task_add("IDLE0", 0U, 0, 1000U);
+    s_tasks[TASK_IDLE1].handle = host_task_add("IDLE1", 0U, 1, 1000U);
+    s_tasks[TASK_INPUT].handle = host_task_add("input_task", 5U, 0, 1500U);
+    s_tasks[TASK_DISPLAY].handle = host_task_add("display_task", 4U, 1, 2000U);
+    host_set_idle_task(0, s_tasks[TASK_IDLE0].handle);
+    host_set_idle_task(1, s_tasks[TASK_IDLE1].handle);
+
+    CHECK(profiler_init() == ESP_OK);
+    CHECK(profiler_init() == ESP_OK);  // idempotent
+    s_profiler = host_task_find("profiler");
+    CHECK(s_profiler != NULL);
+    if (s_profiler == NULL) {
+        return g_host_test_failures;
+    }
+
+    test_task_shares(&rep);
+    test_spike_ages_out(&rep);
+    test_task_lifecycle(&rep);
+    test_scopes(&rep);
+    test_scope_total_past_32_bits(&rep);
+    CHECK(profiler_get_report(NULL) == ESP_ERR_INVALID_ARG);
+    return g_host_test_failures;
+}
+
+static volatile uint32_t s_bench_sink;
+
+static void bench_scope(uint32_t i)
+{
+    PROF_SCOPE(PROF_SCOPE_KEY_SCAN);
+    s_bench_sink = i;
+}
+
+static void bench_sample(uint32_t i)
+{
+    (void)i;
+    tick();
+}
+
+void host_test_bench(uint32_t iterations)
+{
+    for (size_t i = 0; i < TASK_COUNT; ++i) {
+        static const char *const names[TASK_COUNT] = {"IDLE0", "IDLE1", "input_task", "display_task"};
+        s_tasks[i].handle = host_task_add(names[i], 1U, (BaseType_t)(i & 1U), 1000U);
+    }
+    if (profiler_init() != ESP_OK || (s_profiler = host_task_find("profiler")) == NULL) {
+        return;
+    }
+    printf("profiler: %u iterations x 7 rounds\n", (unsigned)iterations);
+    (void)host_bench("PROF_SCOPE begin+end", bench_scope, iterations);
+    (void)host_bench("sample (5 tasks, incl. handoff)", bench_sample, iterations / 100U + 1U);
+}
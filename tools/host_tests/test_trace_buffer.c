@@ -0,0 +1,314 @@
+/*
+ * Host tests for main/trace_buffer.c: records written through the switch hooks and span macros,
+ * Chrome Trace Event output (valid JSON, balanced B/E per track, task names) and ring wrap-around.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_cpu.h"
+#include "host_freertos.h"
+#include "host_test.h"
+#include "json_reader.h"
+#include "json_writer.h"
+#include "keymap_config.h"
+#include "trace_buffer.h"
+#include "trace_hooks.h"
+
+#define DUMP_MAX (1024U * 1024U)
+#define DUMP_CHUNK 512U
+#define SMALL_TOKS 4096U
+#define WRAP_RECORDS 5000U
+#define MAX_TRACKS 64U
+
+typedef struct {
+    char *text;
+    size_t len;
+} dump_sink_t;
+
+typedef struct {
+    uint32_t pid;
+    uint32_t tid;
+    int depth;
+    uint32_t last_ts;
+} track_t;
+
+typedef struct {
+    track_t tracks[MAX_TRACKS];
+    size_t track_count;
+    uint32_t begins;
+    uint32_t ends;
+    bool unbalanced;
+    bool backwards;
+} balance_t;
+
+static esp_err_t sink_flush(void *ctx, const char *data, size_t len)
+{
+    dump_sink_t *sink = ctx;
+    if (sink->len + len >= DUMP_MAX) {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(&sink->text[sink->len], data, len);
+    sink->len += len;
+    sink->text[sink->len] = '\0';
+    return ESP_OK;
+}
+
+static esp_err_t dump(dump_sink_t *sink)
+{
+    sink->len = 0;
+    sink->text[0] = '\0';
+    char buf[DUMP_CHUNK];
+    json_writer_t w;
+    json_writer_init(&w, buf, sizeof(buf), sink_flush, sink);
+    const esp_err_t err = trace_buffer_write_chrome_json(&w);
+    const esp_err_t fin = json_writer_finish(&w);
+    return err != ESP_OK ? err : fin;
+}
+
+static void context_switch(int core, TaskHandle_t from, TaskHandle_t to)
+{
+    host_cpu_set_core(core);
+    host_advance_time_us(10);
+    if (from != NULL) {
+        host_set_current_task(from);
+        traceTASK_SWITCHED_OUT();
+    }
+    host_set_current_task(to);
+    traceTASK_SWITCHED_IN();
+}
+
+static track_t *track_for(balance_t *b, uint32_t pid, uint32_t tid)
+{
+    for (size_t i = 0; i < b->track_count; ++i) {
+        if (b->tracks[i].pid == pid && b->tracks[i].tid == tid) {
+            return &b->tracks[i];
+        }
+    }
+    if (b->track_count == MAX_TRACKS) {
+        return NULL;
+    }
+    track_t *t = &b->tracks[b->track_count++];
+    memset(t, 0, sizeof(*t));
+    t->pid = pid;
+    t->tid = tid;
+    return t;
+}
+
+// Walks the events as text (the wrapped dump is too large for json_reader) and checks that every
+// track opens and closes in order with non-decreasing timestamps.
+static void check_balance(const char *text, balance_t *b)
+{
+    memset(b, 0, sizeof(*b));
+    for (const char *p = strstr(text, "\"ph\":\""); p != NULL; p = strstr(p + 1, "\"ph\":\"")) {
+        const char ph = p[6];
+        if (ph != 'B' && ph != 'E') {
+            continue;
+        }
+        const char *end = strchr(p, '}');
+        const char *ts = strstr(p, "\"ts\":");
+        const char *pid = strstr(p, "\"pid\":");
+        const char *tid = strstr(p, "\"tid\":");
+        if (end == NULL || ts == NULL || pid == NULL || tid == NULL || ts > end || pid > end || tid > end) {
+            b->unbalanced = true;
+            return;
+        }
+        track_t *t = track_for(b, (uint32_t)strtoul(pid + 6, NULL, 10), (uint32_t)strtoul(tid + 6, NULL, 10));
+        if (t == NULL) {
+            b->unbalanced = true;
+            return;
+        }
+        const uint32_t when = (uint32_t)strtoul(ts + 5, NULL, 10);
+        b->backwards |= when < t->last_ts;
+        t->last_ts = when;
+        if (ph == 'B') {
+            ++t->depth;
+            ++b->begins;
+        } else {
+            b->unbalanced |= --t->depth < 0;
+            ++b->ends;
+        }
+    }
+    for (size_t i = 0; i < b->track_count; ++i) {
+        b->unbalanced |= b->tracks[i].depth != 0;
+    }
+}
+
+static int find_path(const json_doc_t *doc, const char *obj_key, const char *key)
+{
+    const int obj = json_reader_find(doc, 0, obj_key);
+    return (obj < 0) ? -1 : json_reader_find(doc, obj, key);
+}
+
+static void test_small_trace(dump_sink_t *sink)
+{
+    TaskHandle_t input = host_task_add("input_task", 5U, 0, 2048U);
+    TaskHandle_t display = host_task_add("display_task", 4U, 1, 2048U);
+    TaskHandle_t gone = host_task_add("short_lived", 3U, 0, 2048U);
+
+    // A span that began before arming: its end has no begin and must be dropped.
+    host_set_current_task(input);
+    trace_buffer_begin(TRACE_SPAN_SCAN);
+    CHECK(trace_buffer_arm() == ESP_OK);
+    trace_buffer_end(TRACE_SPAN_SCAN);
+
+    context_switch(0, NULL, input);
+    {
+        TRACE_SPAN(TRACE_SPAN_SCAN);
+        host_advance_time_us(50);
+        {
+            TRACE_SPAN(TRACE_SPAN_HID_SEND);
+            host_advance_time_us(20);
+        }
+    }
+    context_switch(1, NULL, display);
+    trace_buffer_begin(TRACE_SPAN_OLED_FLUSH);  // still open at dump time
+    context_switch(0, input, gone);
+    context_switch(0, gone, input);
+    // Two switch-ins without a switch-out in between (lost record): the first slice is closed.
+    context_switch(1, NULL, gone);
+    host_task_remove(gone);  // deleted before the dump: keeps its handle as name
+
+    trace_buffer_status_t status;
+    trace_buffer_get_status(&status);
+    CHECK(status.armed && status.allocated);
+    CHECK_EQ_U(status.capacity, MACRO_TRACE_BUFFER_RECORDS);
+    CHECK_EQ_U(status.records, 13U);
+    CHECK_EQ_U(status.overwritten, 0U);
+
+    CHECK(dump(sink) == ESP_OK);
+    trace_buffer_get_status(&status);
+    CHECK(!status.armed);  // the dump disarms
+
+    // Full grammar check with the firmware's own strict reader.
+    static json_tok_t toks[SMALL_TOKS];
+    json_doc_t doc;
+    CHECK(json_reader_parse(&doc, sink->text, sink->len, toks, SMALL_TOKS) == ESP_OK);
+    int v = 0;
+    CHECK(json_reader_int(&doc, find_path(&doc, "otherData", "records"), &v) && v == 13);
+    CHECK(json_reader_int(&doc, find_path(&doc, "otherData", "overwritten"), &v) && v == 0);
+    const int events = json_reader_find(&doc, 0, "traceEvents");
+    CHECK(events > 0 && toks[events].type == JSON_TOK_ARRAY);
+
+    balance_t b;
+    check_balance(sink->text, &b);
+    CHECK(!b.unbalanced);
+    CHECK(!b.backwards);
+    CHECK_EQ_U(b.begins, b.ends);
+    // Core slices: input x2, display, gone x2; app spans: scan, hid_send, oled_flush.
+    CHECK_EQ_U(b.begins, 8U);
+
+    CHECK(strstr(sink->text, "\"name\":\"input_task\"") != NULL);
+    CHECK(strstr(sink->text, "\"name\":\"display_task\"") != NULL);
+    CHECK(strstr(sink->text, "\"name\":\"short_lived\"") == NULL);
+    CHECK(strstr(sink->text, "\"name\":\"task@") != NULL);
+    CHECK(strstr(sink->text, "\"name\":\"hid_send\"") != NULL);
+
+    host_task_remove(input);
+    host_task_remove(display);
+}
+
+static void test_wrap(dump_sink_t *sink)
+{
+    TaskHandle_t a = host_task_add("task_a", 5U, 0, 2048U);
+    TaskHandle_t b = host_task_add("task_b", 5U, 0, 2048U);
+    CHECK(trace_buffer_arm() == ESP_OK);
+
+    // 5000 records: a/b alternate on core 0, and every a slice carries one span (in, B, E, out).
+    uint32_t records = 0;
+    bool on_a = true;
+    context_switch(0, NULL, a);
+    ++records;
+    while (records + 4U <= WRAP_RECORDS) {
+        if (on_a) {
+            trace_buffer_begin(TRACE_SPAN_HA_POST);
+            host_advance_time_us(5);
+            trace_buffer_end(TRACE_SPAN_HA_POST);
+            records += 2U;
+        }
+        context_switch(0, on_a ? a : b, on_a ? b : a);
+        records += 2U;
+        on_a = !on_a;
+    }
+    while (records < WRAP_RECORDS) {
+        trace_buffer_begin(TRACE_SPAN_HA_POST);
+        ++records;
+    }
+
+    trace_buffer_status_t status;
+    trace_buffer_get_status(&status);
+    CHECK_EQ_U(status.records, MACRO_TRACE_BUFFER_RECORDS);
+    CHECK_EQ_U(status.overwritten, WRAP_RECORDS - MACRO_TRACE_BUFFER_RECORDS);
+
+    CHECK(dump(sink) == ESP_OK);
+    balance_t bal;
+    check_balance(sink->text, &bal);
+    CHECK(!bal.unbalanced);
+    CHECK(!bal.backwards);
+    CHECK(bal.begins > MACRO_TRACE_BUFFER_RECORDS / 4U);
+    char expect[64];
+    (void)snprintf(expect, sizeof(expect), "\"overwritten\":%u", (unsigned)(WRAP_RECORDS - MACRO_TRACE_BUFFER_RECORDS));
+    CHECK(strstr(sink->text, expect) != NULL);
+
+    // Disarmed: the span helpers record nothing.
+    trace_buffer_get_status(&status);
+    trace_buffer_begin(TRACE_SPAN_SCAN);
+    {
+        TRACE_SPAN(TRACE_SPAN_OTA_CHUNK);
+    }
+    trace_buffer_status_t after;
+    trace_buffer_get_status(&after);
+    CHECK_EQ_U(after.records, status.records);
+    CHECK_EQ_U(after.overwritten, status.overwritten);
+
+    host_task_remove(a);
+    host_task_remove(b);
+}
+
+int host_test_run(void)
+{
+    dump_sink_t sink = {.text = malloc(DUMP_MAX), .len = 0};
+    char buf[DUMP_CHUNK];
+    json_writer_t w;
+    json_writer_init(&w, buf, sizeof(buf), sink_flush, &sink);
+    CHECK(trace_buffer_write_chrome_json(&w) == ESP_ERR_INVALID_STATE);  // never armed
+    CHECK(trace_buffer_write_chrome_json(NULL) == ESP_ERR_INVALID_ARG);
+
+    test_small_trace(&sink);
+    test_wrap(&sink);
+    free(sink.text);
+    return g_host_test_failures;
+}
+
+static volatile uint32_t s_bench_sink;
+
+static void bench_disarmed_switch(uint32_t i)
+{
+    traceTASK_SWITCHED_IN();
+    s_bench_sink = i;
+}
+
+static void bench_armed_switch(uint32_t i)
+{
+    trace_buffer_on_switch_in();
+    s_bench_sink = i;
+}
+
+static void bench_span(uint32_t i)
+{
+    TRACE_SPAN(TRACE_SPAN_SCAN);
+    s_bench_sink = i;
+}
+
+void host_test_bench(uint32_t iterations)
+{
+    host_set_current_task(host_task_add("bench", 1U, 0, 1024U));
+    printf("trace_buffer: %u iterations x 7 rounds\n", (unsigned)iterations);
+    (void)host_bench("switch hook, disarmed", bench_disarmed_switch, iterations);
+    if (trace_buffer_arm() != ESP_OK) {
+        return;
+    }
+    (void)host_bench("switch hook, armed", bench_armed_switch, iterations);
+    (void)host_bench("TRACE_SPAN begin+end, armed", bench_span, iterations);
+    trace_buffer_disarm();
+}
@@ -0,0 +1,89 @@
+/*
+ * No-op instrumentation and a single-thread display lock for the host build of main/oled.c. The
+ * real metrics, profiler, trace and bench headers are staged unchanged; only the functions oled.c
+ * calls are stubbed here.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "bench.h"
+#include "esp_timer.h"
+#include "freertos/semphr.h"
+#include "metrics.h"
+#include "profiler.h"
+#include "trace_buffer.h"
+
+volatile unsigned g_trace_buffer_armed;
+
+struct host_sem {
+    int depth;
+};
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    static struct host_sem sem;
+    return &sem;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    (void)ticks;
+    if (sem->depth++ != 0) {
+        fprintf(stderr, "display lock taken twice\n");
+        abort();
+    }
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    if (--sem->depth != 0) {
+        fprintf(stderr, "display lock given without take\n");
+        abort();
+    }
+    return pdTRUE;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((int64_t)ts.tv_sec * 1000000LL) + (ts.tv_nsec / 1000L);
+}
+
+void metrics_inc(metric_id_t id)
+{
+    (void)id;
+}
+
+void metrics_add(metric_id_t id, uint32_t value)
+{
+    (void)id;
+    (void)value;
+}
+
+void metrics_observe_us(metric_hist_id_t id, uint32_t us)
+{
+    (void)id;
+    (void)us;
+}
+
+void profiler_scope_end(prof_scope_t *scope)
+{
+    (void)scope;
+}
+
+void trace_buffer_record_span(trace_span_id_t id, bool begin)
+{
+    (void)id;
+    (void)begin;
+}
+
+esp_err_t bench_register(const bench_case_t *bench_case)
+{
+    (void)bench_case;
+    return ESP_OK;
+}
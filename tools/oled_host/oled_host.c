@@ -0,0 +1,371 @@
+/*
+ * Host harness for main/oled.c.
+ *
+ *   oled_host render <out_dir>     render every golden scene to <out_dir>/<scene>.pbm
+ *   oled_host bench [iterations]   time render primitives and full frames
+ *
+ * Built and driven by tools/oled_host/oled_host.py.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "keymap_config.h"
+#include "oled.h"
+#include "ssd1306_emu.h"
+
+#define ANIM_W 96
+#define ANIM_H 48
+#define ANIM_ROW_BYTES ((ANIM_W + 7) / 8)
+#define BENCH_ROUNDS 7
+
+static uint8_t s_anim_bits[2][ANIM_ROW_BYTES * ANIM_H];
+static oled_animation_frame_t s_anim_frames[2];
+static const oled_animation_t s_anim = {
+    .width = ANIM_W,
+    .height = ANIM_H,
+    .bit_packed = true,
+    .frame_count = 2,
+    .frames = s_anim_frames,
+};
+
+/* 5x7 row-packed glyphs for a handful of codepoints; everything else takes the fallback box path. */
+static const uint8_t s_glyph_a[7] = {0x70, 0x88, 0x88, 0xF8, 0x88, 0x88, 0x88};
+static const uint8_t s_glyph_b[7] = {0xF0, 0x88, 0x88, 0xF0, 0x88, 0x88, 0xF0};
+static const uint8_t s_glyph_ok[7] = {0x00, 0x08, 0x10, 0xA0, 0x40, 0x00, 0x00};
+
+static bool test_font_get_glyph(void *ctx, uint32_t codepoint, oled_glyph_t *out_glyph)
+{
+    (void)ctx;
+    const uint8_t *bitmap = NULL;
+    if (codepoint == 'A') {
+        bitmap = s_glyph_a;
+    } else if (codepoint == 'B') {
+        bitmap = s_glyph_b;
+    } else if (codepoint == 0x2713U) {
+        bitmap = s_glyph_ok;
+    }
+    if (bitmap == NULL) {
+        return false;
+    }
+
+    *out_glyph = (oled_glyph_t){
+        .width = 5,
+        .height = 7,
+        .x_offset = 0,
+        .y_offset = 1,
+        .advance_x = 6,
+        .bitmap = bitmap,
+        .bit_packed = true,
+    };
+    return true;
+}
+
+static const oled_font_t s_test_font = {
+    .get_glyph = test_font_get_glyph,
+    .ctx = NULL,
+    .line_height = 10,
+};
+
+static void anim_set(uint8_t *bits, int x, int y)
+{
+    bits[(y * ANIM_ROW_BYTES) + (x / 8)] |= (uint8_t)(0x80U >> (x & 0x7));
+}
+
+static void build_animation(void)
+{
+    memset(s_anim_bits, 0, sizeof(s_anim_bits));
+    for (int y = 0; y < ANIM_H; ++y) {
+        for (int x = 0; x < ANIM_W; ++x) {
+            const bool border = (x == 0 || y == 0 || x == ANIM_W - 1 || y == ANIM_H - 1);
+            if (border || ((x + y) % 7) == 0) {
+                anim_set(s_anim_bits[0], x, y);
+            }
+            if (border || (((x / 4) + (y / 4)) & 1) != 0) {
+                anim_set(s_anim_bits[1], x, y);
+            }
+        }
+    }
+    s_anim_frames[0] = (oled_animation_frame_t){.bitmap = s_anim_bits[0], .duration_ms = 220};
+    s_anim_frames[1] = (oled_animation_frame_t){.bitmap = s_anim_bits[1], .duration_ms = 220};
+}
+
+static struct tm make_time(int year, int hour, int min, int sec)
+{
+    struct tm t = {0};
+    t.tm_year = year - 1900;
+    t.tm_mon = 5;
+    t.tm_mday = 15;
+    t.tm_hour = hour;
+    t.tm_min = min;
+    t.tm_sec = sec;
+    return t;
+}
+
+static esp_err_t scene_clock_synced(void)
+{
+    const struct tm t = make_time(2025, 12, 34, 56);
+    return oled_render_clock(&t, 0, 0);
+}
+
+static esp_err_t scene_clock_unsynced(void)
+{
+    const struct tm t = make_time(1970, 0, 0, 7);
+    return oled_render_clock(&t, 0, 0);
+}
+
+static esp_err_t scene_clock_shifted(void)
+{
+    const struct tm t = make_time(2025, 9, 5, 30);
+    return oled_render_clock(&t, 2, -2);
+}
+
+static esp_err_t scene_clock_status(void)
+{
+    const struct tm t = make_time(2025, 23, 59, 58);
+    return oled_render_clock_with_status(&t, "TEMP: 23.6", 0, 0);
+}
+
+static esp_err_t scene_clock_status_shifted(void)
+{
+    const struct tm t = make_time(2025, 7, 8, 9);
+    return oled_render_clock_with_status(&t, "humidity: 41% - living/room_sensor", -1, 1);
+}
+
+static esp_err_t scene_text_lines(void)
+{
+    return oled_render_text_lines("WIFI SETUP", "AP: MACROPAD-1A2B", "IP 192.168.4.1", "WAIT 12S  2X CANCEL", 0, 0);
+}
+
+static esp_err_t scene_text_lines_ota(void)
+{
+    return oled_render_text_lines("OTA DOWNLOAD", "[#######-------] 50%", "512/1024 KB", "", 1, -1);
+}
+
+static esp_err_t scene_anim_frame0(void)
+{
+    return oled_render_animation_frame_centered(&s_anim, 0, 0, 0);
+}
+
+static esp_err_t scene_anim_frame1(void)
+{
+    return oled_render_animation_frame_centered(&s_anim, 1, 2, -1);
+}
+
+static esp_err_t scene_text_utf8(void)
+{
+    oled_clear_buffer();
+    esp_err_t err = oled_draw_text_utf8(2, 2, "AB BA \xE2\x9C\x93?", &s_test_font);
+    if (err == ESP_OK) {
+        err = oled_draw_text_utf8(2, 30, "A\xE4\xB8\xAD\xFF" "B", NULL);
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+    return oled_present();
+}
+
+typedef struct {
+    const char *name;
+    esp_err_t (*render)(void);
+} scene_t;
+
+static const scene_t s_scenes[] = {
+    {"clock_synced", scene_clock_synced},
+    {"clock_unsynced", scene_clock_unsynced},
+    {"clock_shifted", scene_clock_shifted},
+    {"clock_status", scene_clock_status},
+    {"clock_status_shifted", scene_clock_status_shifted},
+    {"text_lines", scene_text_lines},
+    {"text_lines_ota", scene_text_lines_ota},
+    {"anim_frame0", scene_anim_frame0},
+    {"anim_frame1", scene_anim_frame1},
+    {"text_utf8", scene_text_utf8},
+};
+
+#define SCENE_COUNT (sizeof(s_scenes) / sizeof(s_scenes[0]))
+
+static int cmd_render(const char *out_dir)
+{
+    int failures = 0;
+    for (size_t i = 0; i < SCENE_COUNT; ++i) {
+        char path[512];
+        const int n = snprintf(path, sizeof(path), "%s/%s.pbm", out_dir, s_scenes[i].name);
+        if (n <= 0 || (size_t)n >= sizeof(path)) {
+            fprintf(stderr, "path too long for scene %s\n", s_scenes[i].name);
+            return 2;
+        }
+
+        ssd1306_emu_stats_t before = {0};
+        ssd1306_emu_get_stats(&before);
+        ssd1306_emu_set_snapshot_path(path);
+        const esp_err_t err = s_scenes[i].render();
+        ssd1306_emu_set_snapshot_path(NULL);
+
+        ssd1306_emu_stats_t after = {0};
+        ssd1306_emu_get_stats(&after);
+        if (err != ESP_OK || after.frames != before.frames + 1U) {
+            fprintf(stderr, "scene %s failed: err=%d frames=%u\n",
+                    s_scenes[i].name, err, (unsigned)(after.frames - before.frames));
+            ++failures;
+            continue;
+        }
+        printf("%-22s -> %s\n", s_scenes[i].name, path);
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    const double da = *(const double *)a;
+    const double db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+typedef void (*bench_fn_t)(uint32_t i);
+
+static volatile uint32_t s_bench_sink;
+
+static void bench_clear(uint32_t i)
+{
+    (void)i;
+    oled_clear_buffer();
+}
+
+static void bench_set_pixel(uint32_t i)
+{
+    oled_set_pixel((int)(i & 127U), (int)((i >> 7) & 63U), (i & 1U) != 0);
+}
+
+static void bench_fill_rect_8x8(uint32_t i)
+{
+    oled_fill_rect((int)(i & 119U), (int)((i >> 3) & 55U), 8, 8, true);
+}
+
+static void bench_fill_rect_full(uint32_t i)
+{
+    oled_fill_rect(0, 0, OLED_WIDTH, OLED_HEIGHT, (i & 1U) != 0);
+}
+
+static void bench_bitmap_96x48(uint32_t i)
+{
+    oled_draw_bitmap_mono(16, 8, ANIM_W, ANIM_H, s_anim_bits[i & 1U], true);
+}
+
+static void bench_text_utf8(uint32_t i)
+{
+    s_bench_sink += (uint32_t)oled_draw_text_utf8(2, (int)(i & 31U), "AB BA AB BA", &s_test_font);
+}
+
+static void bench_present(uint32_t i)
+{
+    (void)i;
+    s_bench_sink += (uint32_t)oled_present();
+}
+
+static void bench_scene(uint32_t i)
+{
+    s_bench_sink += (uint32_t)s_scenes[i % SCENE_COUNT].render();
+}
+
+static double bench_run(const char *name, bench_fn_t fn, uint32_t iterations)
+{
+    double samples[BENCH_ROUNDS];
+    for (int round = 0; round < BENCH_ROUNDS; ++round) {
+        const uint64_t start = now_ns();
+        for (uint32_t i = 0; i < iterations; ++i) {
+            fn(i);
+        }
+        samples[round] = (double)(now_ns() - start) / (double)iterations;
+    }
+    qsort(samples, BENCH_ROUNDS, sizeof(samples[0]), cmp_double);
+    printf("%-28s min %10.1f ns  median %10.1f ns\n", name, samples[0], samples[BENCH_ROUNDS / 2]);
+    return samples[BENCH_ROUNDS / 2];
+}
+
+static int cmd_bench(uint32_t iterations)
+{
+    printf("oled_host bench: %u iterations x %d rounds per case (host ns/op; emulator I2C cost included in frames)\n",
+           (unsigned)iterations, BENCH_ROUNDS);
+
+    printf("-- primitives\n");
+    (void)bench_run("oled_clear_buffer", bench_clear, iterations);
+    (void)bench_run("oled_set_pixel", bench_set_pixel, iterations);
+    (void)bench_run("oled_fill_rect 8x8", bench_fill_rect_8x8, iterations);
+    (void)bench_run("oled_fill_rect 128x64", bench_fill_rect_full, iterations);
+    (void)bench_run("oled_draw_bitmap_mono 96x48", bench_bitmap_96x48, iterations);
+    (void)bench_run("oled_draw_text_utf8 11ch", bench_text_utf8, iterations);
+    (void)bench_run("oled_present", bench_present, iterations);
+
+    printf("-- full frames\n");
+    for (size_t s = 0; s < SCENE_COUNT; ++s) {
+        double samples[BENCH_ROUNDS];
+        for (int round = 0; round < BENCH_ROUNDS; ++round) {
+            const uint64_t start = now_ns();
+            for (uint32_t i = 0; i < iterations; ++i) {
+                bench_scene((uint32_t)s);
+            }
+            samples[round] = (double)(now_ns() - start) / (double)iterations;
+        }
+        qsort(samples, BENCH_ROUNDS, sizeof(samples[0]), cmp_double);
+        printf("%-28s min %10.1f ns  median %10.1f ns\n", s_scenes[s].name, samples[0], samples[BENCH_ROUNDS / 2]);
+    }
+
+    ssd1306_emu_stats_t before = {0};
+    ssd1306_emu_stats_t after = {0};
+    ssd1306_emu_get_stats(&before);
+    (void)oled_present();
+    ssd1306_emu_get_stats(&after);
+    const uint32_t bytes = (after.cmd_bytes - before.cmd_bytes) + (after.data_bytes - before.data_bytes) +
+                           (after.transactions - before.transactions) * 2U;
+    /* Each byte is 9 SCL clocks (8 data + ACK); the address byte and control byte are counted per transaction. */
+    const double bus_us = ((double)bytes * 9.0 * 1e6) / (double)MACRO_OLED_I2C_SCL_HZ;
+    printf("-- bus\n");
+    printf("oled_present: %u transactions, %u bytes, ~%.0f us at %u Hz SCL\n",
+           (unsigned)(after.transactions - before.transactions), (unsigned)bytes, bus_us,
+           (unsigned)MACRO_OLED_I2C_SCL_HZ);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s render <out_dir> | bench [iterations]\n", argv[0]);
+        return 2;
+    }
+
+    ssd1306_emu_reset();
+    build_animation();
+    if (oled_init() != ESP_OK) {
+        fprintf(stderr, "oled_init failed\n");
+        return 1;
+    }
+
+    if (strcmp(argv[1], "render") == 0 && argc >= 3) {
+        return cmd_render(argv[2]);
+    }
+    if (strcmp(argv[1], "bench") == 0) {
+        uint32_t iterations = 2000U;
+        if (argc >= 3) {
+            iterations = (uint32_t)strtoul(argv[2], NULL, 10);
+            if (iterations == 0U) {
+                iterations = 1U;
+            }
+        }
+        return cmd_bench(iterations);
+    }
+
+    fprintf(stderr, "unknown command: %s\n", argv[1]);
+    return 2;
+}
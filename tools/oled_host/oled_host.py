@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+"""Build main/oled.c for the host and render/compare/benchmark OLED scenes.
+
+Commands:
+  check   render all scenes and compare them with tools/oled_host/golden/*.pbm
+  update  re-render golden images (review the diff before committing)
+  render  render all scenes into --out
+  bench   print ns per render primitive and per full frame
+"""
+
+from __future__ import annotations
+
+import argparse
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+from pathlib import Path
+
+TOOL_DIR = Path(__file__).resolve().parent
+REPO_ROOT = TOOL_DIR.parents[1]
+GOLDEN_DIR = TOOL_DIR / "golden"
+MAIN_DIR = REPO_ROOT / "main"
+
+
+# Instrumentation headers oled.c includes; staged unchanged, their functions are no-ops in host_stubs.c.
+STAGED_HEADERS = ("oled.h", "bench.h", "metrics.h", "profiler.h", "trace_buffer.h", "json_writer.h")
+
+
+def write_config_shim(build_dir: Path) -> None:
+    # The generated header pulls in IDF/TinyUSB types; the OLED driver only needs its MACRO_OLED_* knobs
+    # (plus MACRO_PROFILER_* for profiler.h).
+    src = (MAIN_DIR / "keymap_config.h").read_text(encoding="utf-8")
+    defines = [line for line in src.splitlines() if re.match(r"#define MACRO_(OLED|PROFILER)_\w+ ", line)]
+    if not any(line.startswith("#define MACRO_OLED_") for line in defines):
+        raise RuntimeError("main/keymap_config.h has no MACRO_OLED_* defines; regenerate it first")
+    body = "\n".join(["// Host shim generated by tools/oled_host/oled_host.py", "#pragma once", "", *defines, ""])
+    (build_dir / "keymap_config.h").write_text(body, encoding="utf-8")
+
+
+def build(build_dir: Path, cc: str, opt: str) -> Path:
+    build_dir.mkdir(parents=True, exist_ok=True)
+    # Stage the driver next to the shim so its quoted "keymap_config.h" include resolves to the shim.
+    shutil.copy2(MAIN_DIR / "oled.c", build_dir / "oled.c")
+    for name in STAGED_HEADERS:
+        shutil.copy2(MAIN_DIR / name, build_dir / name)
+    write_config_shim(build_dir)
+
+    exe = build_dir / "oled_host"
+    cmd = [
+        cc,
+        "-std=gnu11",
+        opt,
+        "-Wall",
+        "-Wextra",
+        "-Werror",
+        "-I",
+        str(build_dir),
+        "-I",
+        str(TOOL_DIR),
+        "-I",
+        str(TOOL_DIR / "shim"),
+        str(build_dir / "oled.c"),
+        str(TOOL_DIR / "ssd1306_emu.c"),
+        str(TOOL_DIR / "oled_host.c"),
+        str(TOOL_DIR / "host_stubs.c"),
+        "-o",
+        str(exe),
+    ]
+    subprocess.run(cmd, check=True)
+    return exe
+
+
+def read_pbm(path: Path) -> tuple[int, int, list[bool]]:
+    toks = re.sub(rb"#[^\n]*", b"", path.read_bytes()).split()
+    if not toks or toks[0] != b"P1":
+        raise ValueError(f"{path}: expected plain P1 PBM")
+    w, h = int(toks[1]), int(toks[2])
+    digits = b"".join(toks[3:])
+    return w, h, [c == ord("1") for c in digits]
+
+
+def compare(rendered: Path, golden: Path) -> int:
+    failures = 0
+    names = sorted({p.name for p in golden.glob("*.pbm")} | {p.name for p in rendered.glob("*.pbm")})
+    for name in names:
+        got, want = rendered / name, golden / name
+        if not want.exists():
+            print(f"NEW   {name} (no golden image; run update)")
+            failures += 1
+            continue
+        if not got.exists():
+            print(f"MISS  {name} (scene no longer rendered)")
+            failures += 1
+            continue
+        gw, gh, gbits = read_pbm(got)
+        ww, wh, wbits = read_pbm(want)
+        if (gw, gh) != (ww, wh) or len(gbits) != len(wbits):
+            print(f"FAIL  {name}: size {gw}x{gh} != {ww}x{wh}")
+            failures += 1
+            continue
+        diff = [i for i, (a, b) in enumerate(zip(gbits, wbits)) if a != b]
+        if diff:
+            first = diff[0]
+            print(f"FAIL  {name}: {len(diff)} pixels differ (first at x={first % gw} y={first // gw})")
+            failures += 1
+        else:
+            print(f"OK    {name}")
+    return failures
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("command", choices=["check", "update", "render", "bench"])
+    parser.add_argument("--cc", default="cc", help="host C compiler")
+    parser.add_argument("--out", type=Path, help="output directory for 'render'")
+    parser.add_argument("--iterations", type=int, default=2000, help="iterations per bench round")
+    parser.add_argument("--build-dir", type=Path, help="keep build artifacts here instead of a temp dir")
+    args = parser.parse_args()
+
+    with tempfile.TemporaryDirectory(prefix="oled_host_") as tmp:
+        build_dir = args.build_dir or Path(tmp) / "build"
+        exe = build(build_dir, args.cc, "-O2")
+
+        if args.command == "bench":
+            return subprocess.run([str(exe), "bench", str(args.iterations)]).returncode
+
+        if args.command == "check":
+            out = Path(tmp) / "render"
+        elif args.command == "update":
+            out = GOLDEN_DIR
+            for old in GOLDEN_DIR.glob("*.pbm"):
+                old.unlink()
+        else:
+            if args.out is None:
+                parser.error("render requires --out")
+            out = args.out
+        out.mkdir(parents=True, exist_ok=True)
+
+        rc = subprocess.run([str(exe), "render", str(out)], stdout=subprocess.DEVNULL).returncode
+        if rc != 0 or args.command != "check":
+            return rc
+
+        failures = compare(out, GOLDEN_DIR)
+        print(f"{failures} scene(s) differ from golden" if failures else "all scenes match golden")
+        return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,26 @@
+#pragma once
+
+/* Host shim: error-return helpers with the same semantics as ESP-IDF. */
+
+#include <stdio.h>
+
+#include "esp_err.h"
+
+#define ESP_RETURN_ON_ERROR(x, log_tag, format, ...)                                   \
+    do {                                                                               \
+        const esp_err_t err_rc_ = (x);                                                 \
+        if (err_rc_ != ESP_OK) {                                                       \
+            fprintf(stderr, "E %s: %s(%d): " format "\n", log_tag, __func__, __LINE__, \
+                    ##__VA_ARGS__);                                                    \
+            return err_rc_;                                                            \
+        }                                                                              \
+    } while (0)
+
+#define ESP_RETURN_ON_FALSE(a, err_code, log_tag, format, ...)                         \
+    do {                                                                               \
+        if (!(a)) {                                                                    \
+            fprintf(stderr, "E %s: %s(%d): " format "\n", log_tag, __func__, __LINE__, \
+                    ##__VA_ARGS__);                                                    \
+            return (err_code);                                                         \
+        }                                                                              \
+    } while (0)
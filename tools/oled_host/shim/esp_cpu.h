@@ -0,0 +1,15 @@
+#pragma once
+
+/* Host shim: profiler.h reads the core id and cycle counter inline; the host has one fixed core. */
+
+#include <stdint.h>
+
+static inline int esp_cpu_get_core_id(void)
+{
+    return 0;
+}
+
+static inline uint32_t esp_cpu_get_cycle_count(void)
+{
+    return 0U;
+}
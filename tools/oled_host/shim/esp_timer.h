@@ -0,0 +1,7 @@
+#pragma once
+
+/* Host shim: monotonic microseconds, defined in host_stubs.c. */
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
@@ -0,0 +1,12 @@
+#pragma once
+
+/* Host shim: only the types oled.c's display lock needs. */
+
+#include <stdint.h>
+
+typedef int BaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFFU)
@@ -0,0 +1,12 @@
+#pragma once
+
+/* Host shim: the renderer runs on one thread, so the display lock is a depth counter that only
+ * catches unbalanced take/give pairs. Defined in host_stubs.c. */
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct host_sem *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
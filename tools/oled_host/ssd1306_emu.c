@@ -0,0 +1,229 @@
+#include "ssd1306_emu.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "driver/i2c_master.h"
+
+/*
+ * Minimal SSD1306 model: decodes the control-byte framed I2C stream that
+ * main/oled.c emits and applies it to a 128x64 page-addressed GDRAM.
+ * Column auto-increment is modelled per page; page wrap is not, because the
+ * driver always re-addresses each page before streaming it.
+ */
+
+#define EMU_PAGES (SSD1306_EMU_HEIGHT / 8)
+
+struct i2c_master_bus_t {
+    int unused;
+};
+
+struct i2c_master_dev_t {
+    uint16_t address;
+};
+
+typedef struct {
+    uint8_t gdram[SSD1306_EMU_WIDTH * EMU_PAGES];
+    uint8_t page;
+    uint8_t column;
+    uint8_t pending_cmd;
+    uint8_t pending_args;
+    bool page7_dirty;
+    char snapshot_path[512];
+    ssd1306_emu_stats_t stats;
+} ssd1306_emu_t;
+
+static ssd1306_emu_t s_emu;
+static struct i2c_master_bus_t s_bus;
+static struct i2c_master_dev_t s_dev;
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+    case ESP_OK:
+        return "ESP_OK";
+    case ESP_ERR_INVALID_ARG:
+        return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:
+        return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:
+        return "ESP_ERR_INVALID_SIZE";
+    default:
+        return "ESP_FAIL";
+    }
+}
+
+void esp_host_abort_on_error(esp_err_t err, const char *file, int line, const char *expr)
+{
+    fprintf(stderr, "ESP_ERROR_CHECK failed: %s (%d) at %s:%d: %s\n", esp_err_to_name(err), err, file, line, expr);
+    abort();
+}
+
+void ssd1306_emu_reset(void)
+{
+    memset(&s_emu, 0, sizeof(s_emu));
+    s_emu.stats.contrast = 0x7F;
+}
+
+void ssd1306_emu_set_snapshot_path(const char *path)
+{
+    if (path == NULL) {
+        s_emu.snapshot_path[0] = '\0';
+        return;
+    }
+    (void)snprintf(s_emu.snapshot_path, sizeof(s_emu.snapshot_path), "%s", path);
+}
+
+void ssd1306_emu_get_stats(ssd1306_emu_stats_t *out_stats)
+{
+    if (out_stats != NULL) {
+        *out_stats = s_emu.stats;
+    }
+}
+
+bool ssd1306_emu_get_pixel(int x, int y)
+{
+    if (x < 0 || x >= SSD1306_EMU_WIDTH || y < 0 || y >= SSD1306_EMU_HEIGHT) {
+        return false;
+    }
+    const uint8_t byte = s_emu.gdram[(size_t)x + ((size_t)y / 8U) * SSD1306_EMU_WIDTH];
+    return (byte & (uint8_t)(1U << (y & 0x7))) != 0;
+}
+
+const uint8_t *ssd1306_emu_gdram(void)
+{
+    return s_emu.gdram;
+}
+
+esp_err_t ssd1306_emu_write_pbm(const char *path)
+{
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        return ESP_FAIL;
+    }
+
+    /* Plain P1 keeps golden images diffable in review. */
+    fprintf(f, "P1\n%d %d\n", SSD1306_EMU_WIDTH, SSD1306_EMU_HEIGHT);
+    for (int y = 0; y < SSD1306_EMU_HEIGHT; ++y) {
+        for (int x = 0; x < SSD1306_EMU_WIDTH; ++x) {
+            fputc(ssd1306_emu_get_pixel(x, y) ? '1' : '0', f);
+        }
+        fputc('\n', f);
+    }
+    return (fclose(f) == 0) ? ESP_OK : ESP_FAIL;
+}
+
+static uint8_t cmd_arg_count(uint8_t cmd)
+{
+    switch (cmd) {
+    case 0x20: /* memory addressing mode */
+    case 0x81: /* contrast */
+    case 0x8D: /* charge pump */
+    case 0xA8: /* multiplex ratio */
+    case 0xD3: /* display offset */
+    case 0xD5: /* clock divide */
+    case 0xD9: /* pre-charge */
+    case 0xDA: /* COM pins */
+    case 0xDB: /* VCOMH */
+        return 1;
+    case 0x21: /* column address */
+    case 0x22: /* page address */
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+static void apply_cmd_byte(uint8_t b)
+{
+    ++s_emu.stats.cmd_bytes;
+
+    if (s_emu.pending_args > 0U) {
+        if (s_emu.pending_cmd == 0x81) {
+            s_emu.stats.contrast = b;
+        }
+        --s_emu.pending_args;
+        return;
+    }
+
+    if (b >= 0xB0 && b <= 0xB7) {
+        s_emu.page = (uint8_t)(b - 0xB0);
+    } else if (b <= 0x0F) {
+        s_emu.column = (uint8_t)((s_emu.column & 0xF0U) | b);
+    } else if (b >= 0x10 && b <= 0x1F) {
+        s_emu.column = (uint8_t)((s_emu.column & 0x0FU) | ((b & 0x0FU) << 4));
+    } else if (b == 0xAE || b == 0xAF) {
+        s_emu.stats.display_on = (b == 0xAF);
+    } else if (b == 0xA6 || b == 0xA7) {
+        s_emu.stats.inverted = (b == 0xA7);
+    } else {
+        s_emu.pending_cmd = b;
+        s_emu.pending_args = cmd_arg_count(b);
+    }
+}
+
+static void apply_data_byte(uint8_t b)
+{
+    ++s_emu.stats.data_bytes;
+    if (s_emu.column < SSD1306_EMU_WIDTH) {
+        s_emu.gdram[(size_t)s_emu.page * SSD1306_EMU_WIDTH + s_emu.column] = b;
+        if (s_emu.page == EMU_PAGES - 1U) {
+            s_emu.page7_dirty = true;
+        }
+    }
+    ++s_emu.column;
+}
+
+esp_err_t i2c_new_master_bus(const i2c_master_bus_config_t *bus_config, i2c_master_bus_handle_t *ret_bus_handle)
+{
+    if (bus_config == NULL || ret_bus_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *ret_bus_handle = &s_bus;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_bus_add_device(i2c_master_bus_handle_t bus_handle,
+                                    const i2c_device_config_t *dev_config,
+                                    i2c_master_dev_handle_t *ret_handle)
+{
+    if (bus_handle == NULL || dev_config == NULL || ret_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_dev.address = dev_config->device_address;
+    *ret_handle = &s_dev;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_transmit(i2c_master_dev_handle_t i2c_dev,
+                              const uint8_t *write_buffer,
+                              size_t write_size,
+                              int xfer_timeout_ms)
+{
+    (void)xfer_timeout_ms;
+    if (i2c_dev == NULL || write_buffer == NULL || write_size < 2U) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    ++s_emu.stats.transactions;
+
+    /* Control byte: Co=0 stream, D/C# selects command (0x00) or data (0x40). */
+    const bool data = (write_buffer[0] & 0x40U) != 0;
+    for (size_t i = 1; i < write_size; ++i) {
+        if (data) {
+            apply_data_byte(write_buffer[i]);
+        } else {
+            apply_cmd_byte(write_buffer[i]);
+        }
+    }
+
+    if (data && s_emu.page7_dirty && s_emu.column >= SSD1306_EMU_WIDTH) {
+        s_emu.page7_dirty = false;
+        ++s_emu.stats.frames;
+        if (s_emu.snapshot_path[0] != '\0') {
+            return ssd1306_emu_write_pbm(s_emu.snapshot_path);
+        }
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#define SSD1306_EMU_WIDTH 128
+#define SSD1306_EMU_HEIGHT 64
+
+typedef struct {
+    uint32_t cmd_bytes;
+    uint32_t data_bytes;
+    uint32_t transactions;
+    uint32_t frames;
+    uint8_t contrast;
+    bool display_on;
+    bool inverted;
+} ssd1306_emu_stats_t;
+
+void ssd1306_emu_reset(void);
+/* When set, every completed frame (page 7 written) is dumped to this path as PBM. */
+void ssd1306_emu_set_snapshot_path(const char *path);
+void ssd1306_emu_get_stats(ssd1306_emu_stats_t *out_stats);
+bool ssd1306_emu_get_pixel(int x, int y);
+const uint8_t *ssd1306_emu_gdram(void);
+esp_err_t ssd1306_emu_write_pbm(const char *path);